@@ -44,10 +44,12 @@ THE SOFTWARE.
 
 #include "llm_noq.h"
 #include "llm_mq.h"
+#include "llm_rmq.h"
 #include "hlm_nobuf.h"
 #include "hlm_buf.h"
 #include "hlm_dftl.h"
 #include "hlm_rsd.h"
+#include "hlm_wb.h"
 #include "devices.h"
 #include "pmu.h"
 
@@ -59,8 +61,7 @@ THE SOFTWARE.
 
 /* TEMP */
 //bdbm_ftl_inf_t _ftl_block_ftl, _ftl_dftl, _ftl_no_ftl;
-bdbm_ftl_inf_t _ftl_dftl, _ftl_no_ftl;
-bdbm_hlm_inf_t _hlm_dftl_inf, _hlm_buf_inf;
+bdbm_ftl_inf_t _ftl_no_ftl;
 bdbm_llm_inf_t _llm_noq_inf;
 /* TEMP */
 
@@ -113,6 +114,9 @@ int bdbm_drv_setup (
 	case HLM_DFTL:
 		bdi->ptr_hlm_inf = &_hlm_dftl_inf;
 		break;
+	case HLM_WRITE_BACK:
+		bdi->ptr_hlm_inf = &_hlm_wb_inf;
+		break;
 	default:
 		bdbm_error ("invalid hlm type");
 		bdbm_bug_on (1);
@@ -129,6 +133,9 @@ int bdbm_drv_setup (
 	case LLM_MULTI_QUEUE:
 		bdi->ptr_llm_inf = &_llm_mq_inf;
 		break;
+	case LLM_READ_PRIORITY:
+		bdi->ptr_llm_inf = &_llm_rmq_inf;
+		break;
 	default:
 		bdbm_error ("invalid llm type");
 		bdbm_bug_on (1);
@@ -0,0 +1,130 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2015 CSAIL, MIT
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#if defined(KERNEL_MODE)
+#include <linux/module.h>
+#include <linux/list.h>
+
+#elif defined(USER_MODE)
+#include <stdio.h>
+#include <stdint.h>
+
+#else
+#error Invalid Platform (KERNEL_MODE or USER_MODE)
+#endif
+
+#include "bdbm_drv.h"
+#include "debug.h"
+#include "usync.h"
+#include "ucredit.h"
+
+/* a submitter sleeping on its own semaphore until it gets credits */
+typedef struct {
+	struct list_head list;
+	int64_t nr_credits;
+	bdbm_sema_t wake;
+} bdbm_credit_waiter_t;
+
+void bdbm_credit_init (bdbm_credit_t* c, int64_t max_credits)
+{
+	bdbm_bug_on (max_credits <= 0);
+
+	bdbm_spin_lock_init (&c->lock);
+	c->nr_credits = max_credits;
+	c->max_credits = max_credits;
+	INIT_LIST_HEAD (&c->waiters);
+	atomic64_set (&c->nr_waits, 0);
+}
+
+void bdbm_credit_free (bdbm_credit_t* c)
+{
+	if (!list_empty (&c->waiters)) {
+		bdbm_warning ("there are submitters waiting for credits");
+	}
+	bdbm_spin_lock_destory (&c->lock);
+}
+
+void bdbm_credit_acquire (bdbm_credit_t* c, int64_t n)
+{
+	bdbm_credit_waiter_t w;
+	unsigned long flags;
+
+	bdbm_bug_on (n > c->max_credits);
+
+	bdbm_spin_lock_irqsave (&c->lock, flags);
+	if (list_empty (&c->waiters) && c->nr_credits >= n) {
+		/* fast path: nobody is ahead of us */
+		c->nr_credits -= n;
+		bdbm_spin_unlock_irqrestore (&c->lock, flags);
+		return;
+	}
+
+	/* wait in line; credits are handed over by bdbm_credit_release */
+	w.nr_credits = n;
+	bdbm_sema_init (&w.wake);
+	bdbm_sema_lock (&w.wake);
+	list_add_tail (&w.list, &c->waiters);
+	atomic64_inc (&c->nr_waits);
+	bdbm_spin_unlock_irqrestore (&c->lock, flags);
+
+	bdbm_sema_lock (&w.wake);
+	bdbm_sema_free (&w.wake);
+}
+
+void bdbm_credit_release (bdbm_credit_t* c, int64_t n)
+{
+	bdbm_credit_waiter_t* w = NULL;
+	bdbm_credit_waiter_t* tmp = NULL;
+	struct list_head wakeup;
+	unsigned long flags;
+
+	INIT_LIST_HEAD (&wakeup);
+
+	bdbm_spin_lock_irqsave (&c->lock, flags);
+	c->nr_credits += n;
+	bdbm_bug_on (c->nr_credits > c->max_credits);
+	list_for_each_entry_safe (w, tmp, &c->waiters, list) {
+		/* keep FIFO order; never let a later waiter pass the first one */
+		if (c->nr_credits < w->nr_credits)
+			break;
+		c->nr_credits -= w->nr_credits;
+		list_move_tail (&w->list, &wakeup);
+	}
+	bdbm_spin_unlock_irqrestore (&c->lock, flags);
+
+	/* w is not valid once it is woken up */
+	list_for_each_entry_safe (w, tmp, &wakeup, list) {
+		bdbm_sema_unlock (&w->wake);
+	}
+}
+
+int64_t bdbm_credit_get_nr_available (bdbm_credit_t* c)
+{
+	return c->nr_credits;
+}
+
+uint64_t bdbm_credit_get_nr_waits (bdbm_credit_t* c)
+{
+	return atomic64_read (&c->nr_waits);
+}
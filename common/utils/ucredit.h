@@ -0,0 +1,61 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2015 CSAIL, MIT
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _BLUEDBM_CREDIT_H
+#define _BLUEDBM_CREDIT_H
+
+#if defined(KERNEL_MODE)
+#include <linux/list.h>
+
+#elif defined(USER_MODE)
+#include <stdint.h>
+#include "uatomic64.h"
+#include "ulist.h"
+
+#else
+#error Invalid Platform (KERNEL_MODE or USER_MODE)
+#endif
+
+#include "usync.h"
+
+/* credit-based flow control: a submitter takes credits before putting 
+ * requests into a queue and sleeps if there are not enough of them; 
+ * credits given back on completion wake up sleeping submitters in FIFO 
+ * order */
+typedef struct {
+	bdbm_spinlock_t lock;
+	int64_t nr_credits;		/* available credits */
+	int64_t max_credits;
+	struct list_head waiters;	/* submitters waiting for credits */
+	atomic64_t nr_waits;	/* # of times submitters went to sleep */
+} bdbm_credit_t;
+
+void bdbm_credit_init (bdbm_credit_t* c, int64_t max_credits);
+void bdbm_credit_free (bdbm_credit_t* c);
+void bdbm_credit_acquire (bdbm_credit_t* c, int64_t n);
+void bdbm_credit_release (bdbm_credit_t* c, int64_t n);
+int64_t bdbm_credit_get_nr_available (bdbm_credit_t* c);
+uint64_t bdbm_credit_get_nr_waits (bdbm_credit_t* c);
+
+#endif /* _BLUEDBM_CREDIT_H */
@@ -155,7 +155,10 @@ void bdbm_flog (const char* filename, char* string)
 
 bdbm_file_t bdbm_fopen (const char* path, int flags, int rights) 
 {
-	return open (path, flags, rights);
+	int fd = open (path, flags, rights);
+
+	/* callers check for 0, which the kernel version returns on failure */
+	return (fd < 0) ? 0 : fd;
 }
 
 void bdbm_fclose (bdbm_file_t file) 
@@ -321,12 +321,14 @@ void bdbm_thread_wakeup (bdbm_thread_t* k)
 		return;
 	}
 
-	/* send a wake-up signal */
-	if ((ret = bdbm_mutex_try_lock (&k->thread_sleep)) == 1) {
+	/* send a wake-up signal; the lock must be waited for, since the 
+	 * thread holds it from checking its work to sleeping, and a signal 
+	 * sent in between would be lost */
+	if ((ret = bdbm_mutex_lock (&k->thread_sleep)) == 0) {
 		pthread_cond_signal (&k->thread_con);
 		bdbm_mutex_unlock (&k->thread_sleep);
 	} else {
-		/*bdbm_warning ("pthread lock failed: %u %s", ret, strerror (ret));*/
+		bdbm_warning ("pthread lock failed: %u %s", ret, strerror (ret));
 	}
 }
 
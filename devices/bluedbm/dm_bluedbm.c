@@ -491,6 +491,9 @@ void __copy_dma_to_bio (
 			if (r->fmain.kp_stt[loop] == KP_STT_DATA)
 				continue;
 		}
+		/* skip holes without buffers */
+		if (r->fmain.kp_ptr[loop] == NULL)
+			continue;
 		bdbm_memcpy (r->fmain.kp_ptr[loop], ptr_dma_addr + KERNEL_PAGE_SIZE * loop, KPAGE_SIZE);
 	}
 
@@ -517,6 +520,9 @@ void __copy_bio_to_dma (
 
 	/* copy the main page data to a buffer */
 	for (loop = 0; loop < nr_pages; loop++) {
+		/* skip holes without buffers */
+		if (r->fmain.kp_ptr[loop] == NULL)
+			continue;
 		bdbm_memcpy (ptr_dma_addr + KPAGE_SIZE * loop, r->fmain.kp_ptr[loop], KPAGE_SIZE);
 	}
 
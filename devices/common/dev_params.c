@@ -48,6 +48,7 @@ enum BDBM_DEFAULT_NAND_PARAMS {
 	NAND_PAGE_OOB_SIZE = 8*BDBM_MAX_PAGES,
 	NR_PAGES_PER_BLOCK = 128,
 	NR_BLOCKS_PER_CHIP = 192/BDBM_MAX_PAGES,
+	NR_PLANES_PER_CHIP = 1,
 	//NR_BLOCKS_PER_CHIP = 8/BDBM_MAX_PAGES,
 	NR_CHIPS_PER_CHANNEL = 4,
 	//NR_CHIPS_PER_CHANNEL = 8,
@@ -57,11 +58,13 @@ enum BDBM_DEFAULT_NAND_PARAMS {
 	NAND_PAGE_PROG_TIME_US = 500,		/* 1.3ms */	
 	NAND_PAGE_READ_TIME_US = 100,		/* 100us */
 	NAND_BLOCK_ERASE_TIME_US = 3000,	/* 3ms */
+	NAND_SUSPEND_OVERHEAD_US = 20,		/* 20us */
 };
 
 int _param_nr_channels 				= NR_CHANNELS;
 int _param_nr_chips_per_channel		= NR_CHIPS_PER_CHANNEL;
 int _param_nr_blocks_per_chip 		= NR_BLOCKS_PER_CHIP;
+int _param_nr_planes_per_chip		= NR_PLANES_PER_CHIP;
 int _param_nr_pages_per_block 		= NR_PAGES_PER_BLOCK;
 int _param_page_main_size 			= NAND_PAGE_SIZE;
 int _param_page_oob_size 			= NAND_PAGE_OOB_SIZE;
@@ -70,6 +73,7 @@ int _param_chip_bus_trans_time_us	= NAND_CHIP_BUS_TRANS_TIME_US;
 int _param_page_prog_time_us		= NAND_PAGE_PROG_TIME_US; 		
 int _param_page_read_time_us		= NAND_PAGE_READ_TIME_US;
 int _param_block_erase_time_us		= NAND_BLOCK_ERASE_TIME_US;
+int _param_suspend_overhead_us		= NAND_SUSPEND_OVERHEAD_US;
 
 /* TODO: Hmm... there might be a more fancy way than this... */
 #if defined (CONFIG_DEVICE_TYPE_RAMDRIVE)
@@ -92,6 +96,7 @@ int _param_device_type = DEVICE_TYPE_NOT_SPECIFIED;
 module_param (_param_nr_channels, int, 0000);
 module_param (_param_nr_chips_per_channel, int, 0000);
 module_param (_param_nr_blocks_per_chip, int, 0000);
+module_param (_param_nr_planes_per_chip, int, 0000);
 module_param (_param_nr_pages_per_block, int, 0000);
 module_param (_param_page_main_size, int, 0000);
 module_param (_param_page_oob_size, int, 0000);
@@ -100,11 +105,13 @@ module_param (_param_chip_bus_trans_time_us, int, 0000);
 module_param (_param_page_prog_time_us, int, 0000);
 module_param (_param_page_read_time_us, int, 0000);
 module_param (_param_block_erase_time_us, int, 0000);
+module_param (_param_suspend_overhead_us, int, 0000);
 module_param (_param_device_type, int, 0000);
 
 MODULE_PARM_DESC (_param_nr_channels, "# of channels");
 MODULE_PARM_DESC (_param_nr_chips_per_channel, "# of chips per channel");
 MODULE_PARM_DESC (_param_nr_blocks_per_chip, "# of blocks per chip");
+MODULE_PARM_DESC (_param_nr_planes_per_chip, "# of planes per chip (blocks are interleaved across planes)");
 MODULE_PARM_DESC (_param_nr_pages_per_block, "# of pages per block");
 MODULE_PARM_DESC (_param_page_main_size, "page main size");
 MODULE_PARM_DESC (_param_page_oob_size, "page oob size");
@@ -114,6 +121,7 @@ MODULE_PARM_DESC (_param_chip_bus_trans_time_us, "NAND bus transfer time");
 MODULE_PARM_DESC (_param_page_prog_time_us, "page program time");
 MODULE_PARM_DESC (_param_page_read_time_us, "page read time");
 MODULE_PARM_DESC (_param_block_erase_time_us, "block erasure time");
+MODULE_PARM_DESC (_param_suspend_overhead_us, "time added to a program/erase for each suspension");
 MODULE_PARM_DESC (_param_device_type, "device type"); /* it must be reset when implementing actual device modules */
 #endif
 
@@ -125,6 +133,7 @@ bdbm_device_params_t get_default_device_params (void)
 	p.nr_channels = _param_nr_channels;
  	p.nr_chips_per_channel = _param_nr_chips_per_channel;
  	p.nr_blocks_per_chip = _param_nr_blocks_per_chip;
+ 	p.nr_planes_per_chip = _param_nr_planes_per_chip > 0 ? _param_nr_planes_per_chip : 1;
  	p.nr_pages_per_block = _param_nr_pages_per_block;
  	p.page_main_size = _param_page_main_size;
  	p.page_oob_size = _param_page_oob_size;
@@ -132,6 +141,9 @@ bdbm_device_params_t get_default_device_params (void)
  	p.page_prog_time_us = _param_page_prog_time_us;
  	p.page_read_time_us = _param_page_read_time_us;
  	p.block_erase_time_us = _param_block_erase_time_us;
+ 	p.suspend_overhead_us = _param_suspend_overhead_us;
+ 	p.chip_bus_trans_time_us = _param_chip_bus_trans_time_us;
+ 	p.host_bus_trans_time_us = _param_host_bus_trans_time_us;
  
  	/* other parameters derived from user parameters */
  	p.nr_blocks_per_channel = p.nr_chips_per_channel * p.nr_blocks_per_chip;
@@ -165,12 +177,17 @@ void display_device_params (bdbm_device_params_t* p)
     bdbm_msg ("# of channels = %llu", p->nr_channels);
     bdbm_msg ("# of chips per channel = %llu", p->nr_chips_per_channel);
     bdbm_msg ("# of blocks per chip = %llu", p->nr_blocks_per_chip);
+    bdbm_msg ("# of planes per chip = %llu", p->nr_planes_per_chip);
     bdbm_msg ("# of pages per block = %llu", p->nr_pages_per_block);
 	bdbm_msg ("# of subpages per page = %llu", p->nr_subpages_per_page);
     bdbm_msg ("page main size  = %llu bytes", p->page_main_size);
     bdbm_msg ("page oob size = %llu bytes", p->page_oob_size);
 	bdbm_msg ("device type = %u (1: ramdrv, 2: ramdrive (intr), 3: ramdrive (timing), 4: BlueDBM, 5: libdummy, 6: libramdrive)", 
 			p->device_type);
+	bdbm_msg ("page read/prog time = %llu/%llu us, block erase time = %llu us", 
+			p->page_read_time_us, p->page_prog_time_us, p->block_erase_time_us);
+	bdbm_msg ("bus transfer time = %llu us (channel), %llu us (host)", 
+			p->chip_bus_trans_time_us, p->host_bus_trans_time_us);
     bdbm_msg ("");
 }
 
@@ -28,6 +28,7 @@ THE SOFTWARE.
 extern int _param_nr_channels;
 extern int _param_nr_chips_per_channel;
 extern int _param_nr_blocks_per_chip;
+extern int _param_nr_planes_per_chip;
 extern int _param_nr_pages_per_block;
 extern int _param_page_main_size; 
 extern int _param_page_oob_size;
@@ -37,6 +38,7 @@ extern int _param_chip_bus_trans_time_us;
 extern int _param_page_prog_time_us;
 extern int _param_page_read_time_us;
 extern int _param_block_erase_time_us;
+extern int _param_suspend_overhead_us;
 extern int _param_ramdrv_timing_mode;
 
 bdbm_device_params_t get_default_device_params (void);
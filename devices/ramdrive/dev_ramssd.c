@@ -180,6 +180,16 @@ static void __ramssd_free_ssdram (void* ptr_ramssd)
 	bdbm_free (ptr_ramssd);
 }
 
+static inline void __ramssd_account_copy (
+	dev_ramssd_info_t* ri, 
+	kp_stt_t kp_stt)
+{
+	if (kp_stt == KP_STT_DATA)
+		atomic64_add (KPAGE_SIZE, &ri->nr_data_bytes);
+	else
+		atomic64_add (KPAGE_SIZE, &ri->nr_hole_bytes);
+}
+
 static uint8_t __ramssd_read_page (
 	dev_ramssd_info_t* ri, 
 	uint64_t channel_no,
@@ -212,17 +222,22 @@ static uint8_t __ramssd_read_page (
 		goto fail;
 	}
 
-	/* copy the main page data to a buffer */
+	/* copy the main page data to a buffer; holes without buffers are not 
+	 * wanted by anybody, so they are skipped */
 	if (ri->np->nr_subpages_per_page == 1) {
 		for (loop = 0; loop < nr_kpages; loop++) {
 			if (partial == 1 && kp_stt[loop] == KP_STT_DATA) continue;
+			if (kp_ptr[loop] == NULL) continue;
 			bdbm_memcpy (kp_ptr[loop], ptr_ramssd_addr + KPAGE_SIZE * loop, KPAGE_SIZE);
+			__ramssd_account_copy (ri, kp_stt[loop]);
 		}
 	} else {
 		for (loop = 0; loop < nr_kpages; loop++) {
 			if (partial == 1 && kp_stt[loop] == KP_STT_DATA) continue;
 			if (partial == 0 && kp_stt[loop] != KP_STT_DATA) continue;
+			if (kp_ptr[loop] == NULL) continue;
 			bdbm_memcpy (kp_ptr[loop], ptr_ramssd_addr + KPAGE_SIZE * loop, KPAGE_SIZE);
+			__ramssd_account_copy (ri, kp_stt[loop]);
 		}
 	}
 
@@ -241,6 +256,7 @@ static uint8_t __ramssd_read_page (
  			int64_t lpa = ((uint64_t*)oob_data)[0];
 			if (lpa < 0 || lpa == 0xffffffffffffffff) continue;
 			if (partial == 1 && kp_stt[loop] == KP_STT_DATA)	continue;
+			if (kp_ptr[loop] == NULL) continue;
 			ptr_data_org = (uint8_t*)__get_ramssd_data_addr (ri, lpa);
 			if (memcmp (kp_ptr[loop], ptr_data_org+(loop*KPAGE_SIZE), KPAGE_SIZE) != 0) {
 				bdbm_msg ("[DATA CORRUPTION] lpa=%llu offset=%u", lpa, loop);
@@ -298,10 +314,13 @@ static uint8_t __ramssd_prog_page (
 		goto fail;
 	}
 
-	/* copy the main page data to a buffer */
+	/* copy the main page data to a buffer; holes without buffers have 
+	 * nothing to program */
 	if (ri->np->nr_subpages_per_page == 1) {
 		for (loop = 0; loop < nr_kpages; loop++) {
+			if (kp_ptr[loop] == NULL) continue;
 			bdbm_memcpy (ptr_ramssd_addr + KPAGE_SIZE * loop, kp_ptr[loop], KPAGE_SIZE);
+			__ramssd_account_copy (ri, kp_stt[loop]);
 		}
 	} else {
 		for (loop = 0; loop < nr_kpages; loop++) {
@@ -309,6 +328,7 @@ static uint8_t __ramssd_prog_page (
 			if (lpa < 0 || lpa == 0xffffffffffffffff) continue;
 			if (kp_stt[loop] != KP_STT_DATA) continue;
 			bdbm_memcpy (ptr_ramssd_addr + KPAGE_SIZE * loop, kp_ptr[loop], KPAGE_SIZE);
+			__ramssd_account_copy (ri, kp_stt[loop]);
 		}
 	}
 
@@ -327,6 +347,7 @@ static uint8_t __ramssd_prog_page (
 		for (loop = 0; loop < nr_kpages; loop++) {
 			int64_t lpa = ((int64_t*)oob_data)[0];
 			if (lpa < 0 || lpa == 0xffffffffffffffff) continue;
+			if (kp_ptr[loop] == NULL) continue;
 			ptr_data_org = (uint8_t*)__get_ramssd_data_addr (ri, lpa);
 			bdbm_memcpy (ptr_data_org+(loop*KPAGE_SIZE), kp_ptr[loop], KPAGE_SIZE);
 		}
@@ -441,6 +462,19 @@ static uint32_t __ramssd_send_cmd (
 	return ret;
 }
 
+/* send the reqs of a multi-plane operation */
+static uint32_t __ramssd_send_cmds (
+	dev_ramssd_info_t* ri, bdbm_llm_req_t* ptr_req)
+{
+	uint32_t ret = 0;
+
+	for (; ptr_req != NULL && ret == 0; ptr_req = ptr_req->mp_next) {
+		ret = __ramssd_send_cmd (ri, ptr_req);
+	}
+
+	return ret;
+}
+
 void __ramssd_cmd_done (dev_ramssd_info_t* ri)
 {
 	uint64_t loop, nr_parallel_units;
@@ -457,12 +491,24 @@ void __ramssd_cmd_done (dev_ramssd_info_t* ri)
 			elapsed_time_in_us = bdbm_stopwatch_get_elapsed_time_us (&punit->sw);
 
 			if (elapsed_time_in_us >= punit->target_elapsed_time_us) {
-				void* ptr_req = punit->ptr_req;
+				bdbm_llm_req_t* ptr_req = (bdbm_llm_req_t*)punit->ptr_req;
+				bdbm_llm_req_t* ptr_next = NULL;
 				punit->ptr_req = NULL;
+
+				/* resume a program/erase suspended for this read */
+				if (punit->ptr_suspended_req != NULL) {
+					punit->ptr_req = punit->ptr_suspended_req;
+					punit->target_elapsed_time_us = punit->suspended_time_us;
+					bdbm_stopwatch_start (&punit->sw);
+					punit->ptr_suspended_req = NULL;
+				}
 				bdbm_spin_unlock (&ri->ramssd_lock);
 
-				/* call the interrupt handler */
-				ri->intr_handler (ptr_req);
+				/* call the interrupt handler for each req of the operation */
+				for (; ptr_req != NULL; ptr_req = ptr_next) {
+					ptr_next = ptr_req->mp_next;
+					ri->intr_handler (ptr_req);
+				}
 			} else {
 				bdbm_spin_unlock (&ri->ramssd_lock);
 			}
@@ -606,7 +652,18 @@ dev_ramssd_info_t* dev_ramssd_create (
 	}
 	for (loop = 0; loop < nr_parallel_units; loop++) {
 		ri->ptr_punits[loop].ptr_req = NULL;
+		ri->ptr_punits[loop].ptr_suspended_req = NULL;
+	}
+
+	/* create channel buses */
+	if ((ri->channel_bus_free_us = (int64_t*)
+			bdbm_malloc_atomic (sizeof (int64_t) * dev_ramssd_get_channles_per_ssd (ri))) == NULL) {
+		bdbm_error ("bdbm_malloc_atomic failed");
+		goto fail_buses;
 	}
+	ri->host_bus_free_us = 0;
+	ri->bus_wait_us = 0;
+	bdbm_stopwatch_start (&ri->sw);
 
 	/* create and register a tasklet */
 	if (__ramssd_timing_create (ri) != 0) {
@@ -616,6 +673,9 @@ dev_ramssd_info_t* dev_ramssd_create (
 
 	/* create spin_lock */
 	bdbm_spin_lock_init (&ri->ramssd_lock);
+	atomic64_set (&ri->nr_data_bytes, 0);
+	atomic64_set (&ri->nr_hole_bytes, 0);
+	atomic64_set (&ri->nr_suspends, 0);
 
 	/* done */
 	ri->is_init = 1;
@@ -623,6 +683,9 @@ dev_ramssd_info_t* dev_ramssd_create (
 	return ri;
 
 fail_timing:
+	bdbm_free_atomic (ri->channel_bus_free_us);
+
+fail_buses:
 	bdbm_free_atomic (ri->ptr_punits);
 
 fail_punits:
@@ -637,6 +700,25 @@ fail:
 
 void dev_ramssd_destroy (dev_ramssd_info_t* ri)
 {
+	int64_t nr_data_bytes = atomic64_read (&ri->nr_data_bytes);
+	int64_t nr_hole_bytes = atomic64_read (&ri->nr_hole_bytes);
+
+	/* how many bytes were copied per byte of host data */
+	bdbm_msg ("ramssd memcpy: %lld bytes (data), %lld bytes (holes), %lld.%02lld bytes per data byte",
+		nr_data_bytes, nr_hole_bytes,
+		nr_data_bytes ? (nr_data_bytes + nr_hole_bytes) / nr_data_bytes : 0,
+		nr_data_bytes ? ((nr_data_bytes + nr_hole_bytes) * 100 / nr_data_bytes) % 100 : 0);
+
+	if (atomic64_read (&ri->nr_suspends) > 0) {
+		bdbm_msg ("ramssd suspends: %lld programs/erases suspended for reads",
+			atomic64_read (&ri->nr_suspends));
+	}
+
+	if (ri->emul_mode == DEVICE_TYPE_RAMDRIVE_TIMING) {
+		bdbm_msg ("ramssd buses: pages waited %llu us in total for busy channel/host buses",
+			ri->bus_wait_us);
+	}
+
 	/* kill tasklet */
 	__ramssd_timing_destory (ri);
 
@@ -644,57 +726,109 @@ void dev_ramssd_destroy (dev_ramssd_info_t* ri)
 	__ramssd_free_ssdram (ri->ptr_ssdram);
 
 	/* release other stuff */
+	bdbm_free_atomic (ri->channel_bus_free_us);
 	bdbm_free_atomic (ri->ptr_punits);
 	bdbm_free_atomic (ri);
 }
 
+/* reserve a bus for a page that is ready to move at ready_us; returns the 
+ * time the transfer ends. it must be called with ramssd_lock held */
+static int64_t __ramssd_bus_reserve (
+	dev_ramssd_info_t* ri, 
+	int64_t* free_us, 
+	int64_t ready_us, 
+	int64_t trans_us)
+{
+	if (trans_us == 0)
+		return ready_us;
+	if (*free_us > ready_us) {
+		ri->bus_wait_us += *free_us - ready_us;
+		ready_us = *free_us;
+	}
+	*free_us = ready_us + trans_us;
+
+	return *free_us;
+}
+
+/* get the target elapsed time depending on the type of req. data moves over
+ * the host bus and the channel bus one page at a time, while array 
+ * operations on chips of the same channel overlap. the pages of a 
+ * multi-plane operation move one by one but share a single array operation.
+ * it must be called with ramssd_lock held */
+static int64_t __ramssd_get_target_time (dev_ramssd_info_t* ri, bdbm_llm_req_t* r)
+{
+	int64_t* channel_free_us;
+	int64_t now_us, done_us;
+	bdbm_llm_req_t* m = NULL;
+
+	if (ri->emul_mode != DEVICE_TYPE_RAMDRIVE_TIMING)
+		return 0;
+
+	channel_free_us = &ri->channel_bus_free_us[r->phyaddr.channel_no];
+	now_us = bdbm_stopwatch_get_elapsed_time_us (&ri->sw);
+
+	switch (r->req_type) {
+	case REQTYPE_WRITE:
+	case REQTYPE_GC_WRITE:
+	case REQTYPE_RMW_WRITE:
+	case REQTYPE_META_WRITE:
+		/* data goes to the chip before it is programmed */
+		done_us = now_us;
+		for (m = r; m != NULL; m = m->mp_next) {
+			done_us = __ramssd_bus_reserve (ri, &ri->host_bus_free_us, 
+				done_us, ri->np->host_bus_trans_time_us);
+			done_us = __ramssd_bus_reserve (ri, channel_free_us, 
+				done_us, ri->np->chip_bus_trans_time_us);
+		}
+		done_us += ri->np->page_prog_time_us;
+		break;
+	case REQTYPE_READ:
+	case REQTYPE_GC_READ:
+	case REQTYPE_RMW_READ:
+	case REQTYPE_META_READ:
+		/* data leaves the chip after it is read */
+		done_us = now_us + ri->np->page_read_time_us;
+		for (m = r; m != NULL; m = m->mp_next) {
+			done_us = __ramssd_bus_reserve (ri, channel_free_us, 
+				done_us, ri->np->chip_bus_trans_time_us);
+			done_us = __ramssd_bus_reserve (ri, &ri->host_bus_free_us, 
+				done_us, ri->np->host_bus_trans_time_us);
+		}
+		break;
+	case REQTYPE_GC_ERASE:
+		done_us = now_us + ri->np->block_erase_time_us;
+		break;
+	case REQTYPE_READ_DUMMY:
+		done_us = now_us;	/* dummy read */
+		break;
+	default:
+		bdbm_error ("invalid REQTYPE (%u)", r->req_type);
+		bdbm_bug_on (1);
+		done_us = now_us;
+		break;
+	}
+	done_us -= now_us;
+	if (done_us > 0) {
+		done_us -= (done_us / 10);
+	}
+
+	return done_us;
+}
+
+/* r may be the first req of a multi-plane operation (see mp_next) */
 uint32_t dev_ramssd_send_cmd (dev_ramssd_info_t* ri, bdbm_llm_req_t* r)
 {
 	uint32_t ret;
 
-	if ((ret = __ramssd_send_cmd (ri, r)) == 0) {
-		int64_t target_elapsed_time_us = 0;
+	if ((ret = __ramssd_send_cmds (ri, r)) == 0) {
 		uint64_t punit_id = r->phyaddr.punit_id;
 
-		/* get the target elapsed time depending on the type of req */
-		if (ri->emul_mode == DEVICE_TYPE_RAMDRIVE_TIMING) {
-			switch (r->req_type) {
-			case REQTYPE_WRITE:
-			case REQTYPE_GC_WRITE:
-			case REQTYPE_RMW_WRITE:
-			case REQTYPE_META_WRITE:
-				target_elapsed_time_us = ri->np->page_prog_time_us;
-				break;
-			case REQTYPE_READ:
-			case REQTYPE_GC_READ:
-			case REQTYPE_RMW_READ:
-			case REQTYPE_META_READ:
-				target_elapsed_time_us = ri->np->page_read_time_us;
-				break;
-			case REQTYPE_GC_ERASE:
-				target_elapsed_time_us = ri->np->block_erase_time_us;
-				break;
-			case REQTYPE_READ_DUMMY:
-				target_elapsed_time_us = 0;	/* dummy read */
-				break;
-			default:
-				bdbm_error ("invalid REQTYPE (%u)", r->req_type);
-				bdbm_bug_on (1);
-				break;
-			}
-			if (target_elapsed_time_us > 0) {
-				target_elapsed_time_us -= (target_elapsed_time_us / 10);
-			}
-		} else {
-			target_elapsed_time_us = 0;
-		}
-
 		/* register reqs */
 		bdbm_spin_lock (&ri->ramssd_lock);
 		if (ri->ptr_punits[punit_id].ptr_req == NULL) {
 			ri->ptr_punits[punit_id].ptr_req = (void*)r;
 			bdbm_stopwatch_start (&ri->ptr_punits[punit_id].sw);
-			ri->ptr_punits[punit_id].target_elapsed_time_us = target_elapsed_time_us;
+			ri->ptr_punits[punit_id].target_elapsed_time_us = __ramssd_get_target_time (ri, r);
 		} else {
 			bdbm_error ("More than two requests are assigned to the same parallel unit (ptr=%p, punit=%llu)",
 				ri->ptr_punits[punit_id].ptr_req, punit_id);
@@ -712,6 +846,53 @@ fail:
 	return ret;
 }
 
+/* serve a read on a punit busy with a program/erase: the program/erase is
+ * suspended, and it resumes with suspend_overhead_us added once the read is
+ * done. if the punit became idle in the meantime, the read is served as
+ * usual. */
+uint32_t dev_ramssd_suspend_cmd (dev_ramssd_info_t* ri, bdbm_llm_req_t* r)
+{
+	uint32_t ret;
+
+	if ((ret = __ramssd_send_cmd (ri, r)) == 0) {
+		dev_ramssd_punit_t* punit = &ri->ptr_punits[r->phyaddr.punit_id];
+
+		bdbm_spin_lock (&ri->ramssd_lock);
+		if (punit->ptr_req != NULL) {
+			bdbm_llm_req_t* busy = (bdbm_llm_req_t*)punit->ptr_req;
+			int64_t remain_us;
+
+			if (punit->ptr_suspended_req != NULL ||
+				!(bdbm_is_write (busy->req_type) || bdbm_is_erase (busy->req_type))) {
+				bdbm_error ("punit %llu cannot be suspended (ptr=%p, type=%u)",
+					r->phyaddr.punit_id, busy, busy->req_type);
+				bdbm_spin_unlock (&ri->ramssd_lock);
+				ret = 1;
+				goto fail;
+			}
+
+			remain_us = punit->target_elapsed_time_us - 
+				bdbm_stopwatch_get_elapsed_time_us (&punit->sw);
+			if (remain_us < 0)
+				remain_us = 0;
+
+			punit->ptr_suspended_req = punit->ptr_req;
+			punit->suspended_time_us = remain_us + ri->np->suspend_overhead_us;
+			atomic64_inc (&ri->nr_suspends);
+		}
+		punit->ptr_req = (void*)r;
+		bdbm_stopwatch_start (&punit->sw);
+		punit->target_elapsed_time_us = __ramssd_get_target_time (ri, r);
+		bdbm_spin_unlock (&ri->ramssd_lock);
+
+		/* register reqs for callback */
+		__ramssd_timing_register_schedule (ri);
+	}
+
+fail:
+	return ret;
+}
+
 /* for snapshot */
 uint32_t dev_ramssd_load (dev_ramssd_info_t* ri, const char* fn)
 {
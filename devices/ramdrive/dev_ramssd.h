@@ -48,6 +48,10 @@ typedef struct {
 	void* ptr_req;
 	int64_t target_elapsed_time_us;
 	bdbm_stopwatch_t sw;
+
+	/* a program/erase suspended to serve ptr_req (a read) */
+	void* ptr_suspended_req;
+	int64_t suspended_time_us; /* time left to finish it */
 } dev_ramssd_punit_t;
 
 #if defined (KERNEL_MODE)
@@ -66,6 +70,19 @@ typedef struct {
 	bdbm_spinlock_t ramssd_lock;
 	void (*intr_handler) (void*);
 
+	/* bytes memcpy'd for host data and for holes (e.g., rmw) */
+	atomic64_t nr_data_bytes;
+	atomic64_t nr_hole_bytes;
+
+	/* # of programs/erases suspended for reads */
+	atomic64_t nr_suspends;
+
+	/* shared buses; times (us) on sw at which they become free */
+	bdbm_stopwatch_t sw;
+	int64_t* channel_bus_free_us;
+	int64_t host_bus_free_us;
+	uint64_t bus_wait_us;	/* time pages waited for busy buses */
+
 #if defined (KERNEL_MODE)
 	struct hrtimer hrtimer;	/* hrtimer must be at the end of the structure */
 	struct workqueue_struct *wq;
@@ -76,6 +93,7 @@ typedef struct {
 dev_ramssd_info_t* dev_ramssd_create (bdbm_device_params_t* np, void (*intr_handler)(void*));
 void dev_ramssd_destroy (dev_ramssd_info_t* ptr_ramssd_info);
 uint32_t dev_ramssd_send_cmd (dev_ramssd_info_t* ptr_ramssd_info, bdbm_llm_req_t* ptr_llm_req );
+uint32_t dev_ramssd_suspend_cmd (dev_ramssd_info_t* ptr_ramssd_info, bdbm_llm_req_t* ptr_llm_req);
 
 /* for snapshot */
 uint32_t dev_ramssd_load (dev_ramssd_info_t* ptr_ramssd_info, const char* fn);
@@ -53,6 +53,8 @@ bdbm_dm_inf_t _bdbm_dm_inf = {
 	.end_req = dm_ramdrive_end_req,
 	.load = dm_ramdrive_load,
 	.store = dm_ramdrive_store,
+	.suspend_req = dm_ramdrive_suspend_req,
+	.make_mp_req = dm_ramdrive_make_req,	/* dev_ramssd takes chained reqs */
 };
 
 /* private data structure for dm */
@@ -164,6 +166,18 @@ uint32_t dm_ramdrive_make_reqs (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* hr)
 	return ret;
 }
 
+uint32_t dm_ramdrive_suspend_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* ptr_llm_req)
+{
+	uint32_t ret;
+	dm_ramssd_private_t* p = BDBM_DM_PRIV (bdi);
+
+	if ((ret = dev_ramssd_suspend_cmd (p->ramssd, ptr_llm_req)) != 0) {
+		bdbm_error ("dev_ramssd_suspend_cmd failed");
+	}
+
+	return ret;
+}
+
 void dm_ramdrive_end_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* ptr_llm_req)
 {
 	bdbm_bug_on (ptr_llm_req == NULL);
@@ -36,6 +36,7 @@ void dm_ramdrive_close (bdbm_drv_info_t* bdi);
 uint32_t dm_ramdrive_make_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* ptr_llm_req);
 uint32_t dm_ramdrive_make_reqs (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* ptr_hlm_req);
 void dm_ramdrive_end_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* ptr_llm_req);
+uint32_t dm_ramdrive_suspend_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* ptr_llm_req);
 
 uint32_t dm_ramdrive_load (bdbm_drv_info_t* bdi, const char* fn);
 uint32_t dm_ramdrive_store (bdbm_drv_info_t* bdi, const char* fn);
@@ -165,6 +165,7 @@ static int __encode_bio_to_proxy_req (
 	r->bi_size = bio_sectors (bio);
 	r->bi_bvec_cnt = 0;
 	r->bio = (void*)bio;
+	r->bi_tenant = current->tgid;
 
 #if 0
 	if (r->bi_rw == REQTYPE_WRITE) {
@@ -195,6 +195,12 @@ uint32_t host_blkdev_register_device (bdbm_drv_info_t* bdi, make_request_fn* fn)
 	blk_queue_logical_block_size (bdbm_device.queue, bdi->parm_ftl.kernel_sector_size);
 	blk_queue_io_min (bdbm_device.queue, bdi->parm_dev.page_main_size);
 	blk_queue_io_opt (bdbm_device.queue, bdi->parm_dev.page_main_size);
+
+	/* a write-back buffer in hlm is a volatile cache; let the block layer 
+	 * send flush and FUA requests */
+	if (bdi->parm_ftl.hlm_type == HLM_WRITE_BACK)
+		blk_queue_flush (bdbm_device.queue, REQ_FLUSH | REQ_FUA);
+
 	/*blk_limits_max_hw_sectors (&bdbm_device.queue->limits, 16);*/
 
 	/* see if a TRIM command is used or not */
@@ -71,6 +71,8 @@ static bdbm_blkio_req_t* __get_blkio_req (struct bio *bio)
 	/* get the type of the bio request */
 	if (bio->bi_rw & REQ_DISCARD)
 		br->bi_rw = REQTYPE_TRIM;
+	else if ((bio->bi_rw & REQ_FLUSH) && bio_sectors (bio) == 0)
+		br->bi_rw = REQTYPE_FLUSH;	/* an empty flush */
 	else if (bio_data_dir (bio) == READ || bio_data_dir (bio) == READA)
 		br->bi_rw = REQTYPE_READ;
 	else if (bio_data_dir (bio) == WRITE)
@@ -80,14 +82,22 @@ static bdbm_blkio_req_t* __get_blkio_req (struct bio *bio)
 		goto fail;
 	}
 
+	/* get the flags of the bio; they matter only with write-back buffers */
+	br->bi_flags = 0;
+	if (bio->bi_rw & REQ_FLUSH)
+		br->bi_flags |= BDBM_BLKIO_FLUSH;
+	if (bio->bi_rw & REQ_FUA)
+		br->bi_flags |= BDBM_BLKIO_FUA;
+
 	/* get the offset and the length of the bio */
 	br->bi_offset = bio->bi_sector;
 	br->bi_size = bio_sectors (bio);
 	br->bi_bvec_cnt = 0;
 	br->bio = (void*)bio;
+	br->bi_tenant = current->tgid;	/* the LLM maps it to one of its tenants */
 
 	/* get the data from the bio */
-	if (br->bi_rw != REQTYPE_TRIM) {
+	if (br->bi_rw != REQTYPE_TRIM && br->bi_rw != REQTYPE_FLUSH) {
 		bio_for_each_segment (bvec, bio, loop) {
 			br->bi_bvec_ptr[br->bi_bvec_cnt] = (uint8_t*)page_address (bvec->bv_page);
 			br->bi_bvec_cnt++;
@@ -0,0 +1,560 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2015 CSAIL, MIT
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* A latency benchmark for the user-level driver.
+ *
+ * A few threads issue synchronous 4 KB random writes (and, optionally, 
+ * reads) over most of the logical space several times, so that the FTL 
+ * keeps running out of free blocks. The latency of every request is 
+ * recorded and the distributions of reads and writes are displayed at 
+ * the end. It is useful to see how write throttling smooths out GC stalls, 
+ * how much request merging combines interleaved sequential writes, and 
+ * how the read-priority LLM changes the read tail under mixed load.
+ *
+ * With -v, every page carries its lpa and a version number, and a thread 
+ * only writes the lpas equal to its id modulo the # of threads. A read 
+ * must return a version between the last one completed before it was sent 
+ * and the last one sent before it finished (reads of the other threads' 
+ * lpas may overlap their writes), and the whole space is read back at the 
+ * end; bench exits with 1 if any page is wrong. 'make bench-check' runs it 
+ * under several gc configurations.
+ *
+ * With -R, the flash is formatted by the FTL before the run, and the FTL is 
+ * stored to its snapshot and loaded back from it (as at unmount and mount) 
+ * before the space is read back; the snapshot files are kept in 
+ * /usr/share/bdbm_drv as the driver does.
+ *
+ * usage: bench [-t # of threads] [-f # of fills] [-b # of blocks per chip]
+ *              [-r read ratio (%)] [-s] [-w throttle target (%)] 
+ *              [-m merge window (us)] [-l llm type] [-d write deadline (us)]
+ *              [-u] [-p # of planes per chip] [-a] [-n # of tenants]
+ *              [-W weights of tenants] [-g # of pages per gc slice]
+ *              [-G host pages per gc page] [-e] [-F] [-H # of hlm workers]
+ *              [-B # of write-back buffer pages] [-c # of read cache pages] [-D]
+ *              [-P DFTL cache policy] [-v] [-R]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "bdbm_drv.h"
+#include "umemory.h"
+#include "params.h"
+#include "ftl_params.h"
+#include "dev_params.h"
+#include "debug.h"
+#include "userio.h"
+#include "usync.h"
+#include "utime.h"
+#include "devices.h"
+
+#define BENCH_MAX_THREADS	64
+#define BENCH_SPACE_PCT		80	/* portion of the logical space written */
+#define BENCH_NR_BUCKETS	32	/* log2 histogram of latencies (us) */
+#define BENCH_SNAPSHOT_DIR	"/usr/share/bdbm_drv"
+
+bdbm_drv_info_t* _bdi = NULL;
+
+typedef struct {
+	int id;
+	uint64_t nr_reqs;
+	uint64_t* lat_us;		/* latencies of requests */
+	uint8_t* is_read;		/* types of requests */
+	uint64_t elapsed_us;
+	bdbm_sema_t done;
+} bench_thread_t;
+
+static uint64_t _nr_kpages_space = 0;
+static int _nr_threads = 8;
+static int _sequential = 0;
+static int _read_pct = 0;
+static int _nr_tenants = 1;
+static int _verify = 0;
+static int _remount = 0;
+static volatile uint32_t* _versions = NULL;	/* the last version sent to each lpa (-v) */
+static volatile uint32_t* _versions_done = NULL;	/* the last version completed */
+static atomic64_t _nr_mismatches;
+
+/* a page written with -v has its lpa and version in every 16 bytes */
+static void bench_stamp (uint8_t* buf, uint64_t lpa, uint64_t ver)
+{
+	uint64_t* v = (uint64_t*)buf;
+	uint64_t i;
+
+	for (i = 0; i < KPAGE_SIZE / sizeof (uint64_t); i += 2) {
+		v[i] = lpa;
+		v[i+1] = ver;
+	}
+}
+
+static void bench_check (uint8_t* buf, uint64_t lpa, uint64_t ver_lo, uint64_t ver_hi)
+{
+	uint64_t* v = (uint64_t*)buf;
+	uint64_t i;
+
+	for (i = 0; i < KPAGE_SIZE / sizeof (uint64_t); i += 2) {
+		if (v[i] != lpa || v[i+1] < ver_lo || v[i+1] > ver_hi || v[i+1] != v[1]) {
+			if (atomic64_read (&_nr_mismatches) < 10) {
+				bdbm_warning ("[bench] lpa %llu: expected version %llu-%llu, but read lpa %llu version %llu (offset %llu)",
+					(unsigned long long)lpa, (unsigned long long)ver_lo, (unsigned long long)ver_hi,
+					(unsigned long long)v[i], (unsigned long long)v[i+1], 
+					(unsigned long long)i * sizeof (uint64_t));
+			}
+			atomic64_inc (&_nr_mismatches);
+			return;
+		}
+	}
+}
+
+static void bench_end_req (void* req)
+{
+	bdbm_blkio_req_t* r = (bdbm_blkio_req_t*)req;
+	bench_thread_t* t = (bench_thread_t*)r->user;
+
+	bdbm_sema_unlock (&t->done);
+}
+
+static uint64_t bench_submit (
+	bench_thread_t* t, 
+	bdbm_blkio_req_t* r, 
+	uint64_t rw, 
+	uint64_t lpa)
+{
+	bdbm_stopwatch_t sw;
+
+	r->bi_rw = rw;
+	r->bi_flags = 0;
+	r->bi_offset = lpa * NR_KSECTORS_IN (KPAGE_SIZE);
+	r->bi_size = NR_KSECTORS_IN (KPAGE_SIZE);
+	r->bi_bvec_cnt = 1;
+	r->user = (void*)t;
+	r->cb_done = bench_end_req;
+	r->bi_tenant = t->id % _nr_tenants;
+
+	/* send it and wait for it to finish */
+	bdbm_stopwatch_start (&sw);
+	bdbm_sema_lock (&t->done);
+	_bdi->ptr_host_inf->make_req (_bdi, r);
+	bdbm_sema_lock (&t->done);
+	bdbm_sema_unlock (&t->done);
+
+	return bdbm_stopwatch_get_elapsed_time_us (&sw);
+}
+
+static void* bench_thread_fn (void* data)
+{
+	bench_thread_t* t = (bench_thread_t*)data;
+	bdbm_blkio_req_t* r;
+	unsigned int seed = t->id + 1;
+	uint64_t i, lpa, ver_lo = 0;
+	bdbm_stopwatch_t sw;
+
+	if ((r = (bdbm_blkio_req_t*)bdbm_malloc (sizeof (bdbm_blkio_req_t))) == NULL ||
+		(r->bi_bvec_ptr[0] = (uint8_t*)bdbm_malloc (KPAGE_SIZE)) == NULL) {
+		bdbm_error ("bdbm_malloc () failed");
+		exit (-1);
+	}
+	bdbm_memset (r->bi_bvec_ptr[0], t->id, KPAGE_SIZE);
+
+	bdbm_stopwatch_start (&sw);
+	for (i = 0; i < t->nr_reqs; i++) {
+		if (_sequential)
+			lpa = (i * _nr_threads + t->id) % _nr_kpages_space;
+		else
+			lpa = (((uint64_t)rand_r (&seed) << 31) | rand_r (&seed)) % _nr_kpages_space;
+
+		t->is_read[i] = (rand_r (&seed) % 100) < _read_pct;
+		if (_verify && t->is_read[i]) {
+			bdbm_memset (r->bi_bvec_ptr[0], 0xff, KPAGE_SIZE);
+			ver_lo = _versions_done[lpa];
+		} else if (_verify) {
+			/* only this thread writes lpa */
+			lpa = lpa - lpa % _nr_threads + t->id;
+			if (lpa >= _nr_kpages_space)
+				lpa = t->id;
+			bench_stamp (r->bi_bvec_ptr[0], lpa, _versions[lpa] + 1);
+			_versions[lpa]++;
+		}
+		t->lat_us[i] = bench_submit (t, r, 
+			t->is_read[i] ? REQTYPE_READ : REQTYPE_WRITE, lpa);
+		if (_verify && t->is_read[i]) {
+			if (ver_lo > 0)
+				bench_check (r->bi_bvec_ptr[0], lpa, ver_lo, _versions[lpa]);
+		} else if (_verify) {
+			_versions_done[lpa] = _versions[lpa];
+		}
+	}
+	t->elapsed_us = bdbm_stopwatch_get_elapsed_time_us (&sw);
+
+	bdbm_free (r->bi_bvec_ptr[0]);
+	bdbm_free (r);
+
+	pthread_exit (0);
+}
+
+/* write the whole space once so that reads hit flash */
+static void bench_prefill (void)
+{
+	bench_thread_t t;
+	bdbm_blkio_req_t* r;
+	uint64_t lpa;
+
+	if ((r = (bdbm_blkio_req_t*)bdbm_malloc (sizeof (bdbm_blkio_req_t))) == NULL ||
+		(r->bi_bvec_ptr[0] = (uint8_t*)bdbm_malloc (KPAGE_SIZE)) == NULL) {
+		bdbm_error ("bdbm_malloc () failed");
+		exit (-1);
+	}
+	bdbm_sema_init (&t.done);
+	t.id = 0;
+	for (lpa = 0; lpa < _nr_kpages_space; lpa++) {
+		if (_verify)
+			bench_stamp (r->bi_bvec_ptr[0], lpa, ++_versions[lpa]);
+		bench_submit (&t, r, REQTYPE_WRITE, lpa);
+		if (_verify)
+			_versions_done[lpa] = _versions[lpa];
+	}
+	bdbm_sema_free (&t.done);
+
+	bdbm_free (r->bi_bvec_ptr[0]);
+	bdbm_free (r);
+}
+
+/* read the whole space back and check the last versions (-v) */
+static void bench_read_back (void)
+{
+	bench_thread_t t;
+	bdbm_blkio_req_t* r;
+	uint64_t lpa;
+
+	if ((r = (bdbm_blkio_req_t*)bdbm_malloc (sizeof (bdbm_blkio_req_t))) == NULL ||
+		(r->bi_bvec_ptr[0] = (uint8_t*)bdbm_malloc (KPAGE_SIZE)) == NULL) {
+		bdbm_error ("bdbm_malloc () failed");
+		exit (-1);
+	}
+	bdbm_sema_init (&t.done);
+	t.id = 0;
+	for (lpa = 0; lpa < _nr_kpages_space; lpa++) {
+		if (_versions[lpa] == 0)
+			continue;
+		bdbm_memset (r->bi_bvec_ptr[0], 0xff, KPAGE_SIZE);
+		bench_submit (&t, r, REQTYPE_READ, lpa);
+		bench_check (r->bi_bvec_ptr[0], lpa, _versions[lpa], _versions[lpa]);
+	}
+	bdbm_sema_free (&t.done);
+
+	bdbm_free (r->bi_bvec_ptr[0]);
+	bdbm_free (r);
+}
+
+/* store the FTL to its snapshot and load it back, as bdbm_drv_close and 
+ * bdbm_drv_run do with snapshots enabled; the flash is kept as it is (-R) */
+static int bench_remount (void)
+{
+	bdbm_ftl_inf_t* ftl = _bdi->ptr_ftl_inf;
+	bdbm_hlm_inf_t* hlm = _bdi->ptr_hlm_inf;
+	bdbm_stopwatch_t sw;
+
+	hlm->destroy (_bdi);
+	if (ftl->store (_bdi, BENCH_SNAPSHOT_DIR "/ftl.dat") != 0) {
+		bdbm_error ("storing the ftl failed");
+		return -1;
+	}
+	ftl->destroy (_bdi);
+
+	bdbm_stopwatch_start (&sw);
+	if (ftl->create (_bdi) != 0 || 
+		ftl->load (_bdi, BENCH_SNAPSHOT_DIR "/ftl.dat") != 0) {
+		bdbm_error ("loading the ftl failed");
+		return -1;
+	}
+	bdbm_msg ("[bench] the ftl is loaded in %llu us", 
+		(unsigned long long)bdbm_stopwatch_get_elapsed_time_us (&sw));
+	if (hlm->create (_bdi) != 0) {
+		bdbm_error ("hlm->create () failed");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int bench_cmp_u64 (const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+static void bench_display (const char* name, uint64_t* lat_us, uint64_t nr, uint64_t elapsed_us)
+{
+	uint64_t buckets[BENCH_NR_BUCKETS] = {0};
+	uint64_t i, sum = 0;
+
+	if (nr == 0)
+		return;
+
+	qsort (lat_us, nr, sizeof (uint64_t), bench_cmp_u64);
+	for (i = 0; i < nr; i++) {
+		uint64_t b = 0, v = lat_us[i];
+		sum += v;
+		while (v > 1 && b < BENCH_NR_BUCKETS - 1) {
+			v >>= 1;
+			b++;
+		}
+		buckets[b]++;
+	}
+
+	bdbm_msg ("[bench] %llu %s in %llu ms (%llu IOPS)", 
+		(unsigned long long)nr, name,
+		(unsigned long long)elapsed_us / 1000, 
+		(unsigned long long)(elapsed_us ? nr * 1000000 / elapsed_us : 0));
+	bdbm_msg ("[bench] %s latency (us): mean=%llu p50=%llu p90=%llu p99=%llu p99.9=%llu max=%llu",
+		name,
+		(unsigned long long)sum / nr,
+		(unsigned long long)lat_us[nr * 50 / 100],
+		(unsigned long long)lat_us[nr * 90 / 100],
+		(unsigned long long)lat_us[nr * 99 / 100],
+		(unsigned long long)lat_us[nr * 999 / 1000],
+		(unsigned long long)lat_us[nr - 1]);
+	for (i = 0; i < BENCH_NR_BUCKETS; i++) {
+		if (buckets[i] == 0)
+			continue;
+		bdbm_msg ("[bench]  < %10llu us: %llu", 
+			(unsigned long long)2 << i, (unsigned long long)buckets[i]);
+	}
+}
+
+static void bench_usage (const char* prog)
+{
+	bdbm_msg ("usage: %s [-t # of threads (1-%d)] [-f # of fills] [-b # of blocks per chip]", 
+		prog, BENCH_MAX_THREADS);
+	bdbm_msg ("          [-r read ratio (%%)] [-s] [-w throttle target (%%)] [-m merge window (us)]");
+	bdbm_msg ("          [-l llm type (2: multi-queue, 3: read-priority)] [-d write deadline (us)]");
+	bdbm_msg ("          [-u (suspend programs/erases for reads)] [-p # of planes per chip]");
+	bdbm_msg ("          [-a (load-aware write placement)] [-n # of tenants (threads join them in turn)]");
+	bdbm_msg ("          [-W weights of tenants (e.g., 4,1)] [-g # of pages per gc slice] [-G host pages per gc page]");
+	bdbm_msg ("          [-e (defer gc erases to idle punits)] [-F (forward reads from queued writes)]");
+	bdbm_msg ("          [-H # of workers (buffered hlm)] [-B # of pages (write-back hlm)]");
+	bdbm_msg ("          [-c # of pages (read cache of hlm_nobuf)] [-D (DFTL)]");
+	bdbm_msg ("          [-P DFTL cache policy (1: LRU, 2: 2Q, 3: ARC, 4: CLOCK-Pro)] [-v (check the data read)]");
+	bdbm_msg ("          [-R (format, and store and load the ftl before reading back; needs -v and an ftl with snapshots)]");
+}
+
+int main (int argc, char** argv)
+{
+	bench_thread_t threads[BENCH_MAX_THREADS];
+	pthread_t tids[BENCH_MAX_THREADS];
+	int nr_fills = 3;
+	int ret = 0;
+	bdbm_device_params_t* np;
+	bdbm_stopwatch_t sw;
+	uint64_t *lat_us, *lat_rd;
+	uint8_t* is_read;
+	uint64_t nr_total, nr_rd = 0, nr_wr = 0, elapsed_us, ofs, i, j, n;
+	char* w;
+	int opt;
+
+	/* keep the ramdrive small enough to fill it several times */
+	_param_nr_blocks_per_chip = 16;
+	/* the stub _llm_noq_inf in bdbm_main.c shadows llm_noq in libftl.a */
+	_param_llm_type = LLM_MULTI_QUEUE;
+
+	while ((opt = getopt (argc, argv, "t:f:b:r:sw:m:l:d:up:an:W:g:G:eFH:B:c:DP:vR")) != -1) {
+		switch (opt) {
+		case 't': _nr_threads = atoi (optarg); break;
+		case 'f': nr_fills = atoi (optarg); break;
+		case 'b': _param_nr_blocks_per_chip = atoi (optarg); break;
+		case 'r': _read_pct = atoi (optarg); break;
+		case 's': _sequential = 1; break;
+		case 'w': _param_hlm_throttle_free_pct = atoi (optarg); break;
+		case 'm': _param_hlm_merge_window_us = atoi (optarg); break;
+		case 'l': _param_llm_type = atoi (optarg); break;
+		case 'd': _param_llm_write_deadline_us = atoi (optarg); break;
+		case 'u': _param_llm_suspend = 1; break;
+		case 'p': _param_nr_planes_per_chip = atoi (optarg); break;
+		case 'a': _param_write_placement = WRITE_PLACEMENT_LOAD_AWARE; break;
+		case 'n': _nr_tenants = _param_llm_nr_tenants = atoi (optarg); break;
+		case 'g': _param_gc_slice_pages = atoi (optarg); break;
+		case 'G': _param_gc_host_ratio = atoi (optarg); break;
+		case 'e': _param_gc_defer_erase = 1; break;
+		case 'F': _param_llm_read_forward = 1; break;
+		case 'H': 
+			_param_hlm_type = HLM_BUFFER;
+			_param_hlm_nr_workers = atoi (optarg);
+			break;
+		case 'B': 
+			_param_hlm_type = HLM_WRITE_BACK;
+			_param_hlm_wb_nr_pages = atoi (optarg);
+			break;
+		case 'c': _param_hlm_rcache_nr_pages = atoi (optarg); break;
+		case 'D': 
+			_param_mapping_type = MAPPING_POLICY_DFTL;
+			_param_hlm_type = HLM_DFTL;
+			break;
+		case 'P': _param_dftl_cache_policy = atoi (optarg); break;
+		case 'v': _verify = 1; break;
+		case 'R': _remount = 1; break;
+		case 'W':
+			for (i = 0, w = strtok (optarg, ","); w != NULL && i < LLM_MAX_TENANTS; w = strtok (NULL, ","))
+				_param_llm_tenant_weights[i++] = atoi (w);
+			break;
+		default:
+			bench_usage (argv[0]);
+			return -1;
+		}
+	}
+	if (_nr_threads < 1 || _nr_threads > BENCH_MAX_THREADS || nr_fills < 1 || 
+		_param_nr_blocks_per_chip < 1 || _param_nr_planes_per_chip < 1 || _read_pct < 0 || _read_pct > 100 ||
+		_nr_tenants < 1 || _nr_tenants > LLM_MAX_TENANTS || (_remount && !_verify) ||
+		_param_dftl_cache_policy < DFTL_CACHE_POLICY_LRU || _param_dftl_cache_policy > DFTL_CACHE_POLICY_CLOCK_PRO ||
+		(_param_llm_type != LLM_MULTI_QUEUE && _param_llm_type != LLM_READ_PRIORITY)) {
+		bench_usage (argv[0]);
+		return -1;
+	}
+
+	if ((_bdi = bdbm_drv_create ()) == NULL) {
+		bdbm_error ("bdbm_drv_create () failed");
+		return -1;
+	}
+	if (bdbm_dm_init (_bdi) != 0) {
+		bdbm_error ("bdbm_dm_init () failed");
+		return -1;
+	}
+	if (bdbm_drv_setup (_bdi, &_userio_inf, bdbm_dm_get_inf (_bdi)) != 0) {
+		bdbm_error ("bdbm_drv_setup () failed");
+		return -1;
+	}
+	if (bdbm_drv_run (_bdi) != 0) {
+		bdbm_error ("bdbm_drv_run () failed");
+		return -1;
+	}
+	if (_remount) {
+		bdbm_ftl_inf_t* ftl = _bdi->ptr_ftl_inf;
+
+		if (ftl->load == NULL || ftl->store == NULL || ftl->scan_badblocks == NULL) {
+			bdbm_error ("the ftl does not support snapshots");
+			return -1;
+		}
+		mkdir (BENCH_SNAPSHOT_DIR, 0755);
+		if (ftl->scan_badblocks (_bdi) != 0) {
+			bdbm_error ("formatting the flash failed");
+			return -1;
+		}
+	}
+
+	np = BDBM_GET_DEVICE_PARAMS (_bdi);
+	_nr_kpages_space = np->nr_subpages_per_ssd * BENCH_SPACE_PCT / 100;
+	nr_total = _nr_kpages_space * nr_fills;
+	if ((lat_us = (uint64_t*)bdbm_malloc (nr_total * sizeof (uint64_t) * 2)) == NULL ||
+		(is_read = (uint8_t*)bdbm_malloc (nr_total)) == NULL) {
+		bdbm_error ("bdbm_malloc () failed");
+		return -1;
+	}
+	if (_verify) {
+		if ((_versions = (uint32_t*)bdbm_malloc (_nr_kpages_space * sizeof (uint32_t))) == NULL ||
+			(_versions_done = (uint32_t*)bdbm_malloc (_nr_kpages_space * sizeof (uint32_t))) == NULL) {
+			bdbm_error ("bdbm_malloc () failed");
+			return -1;
+		}
+		atomic64_set (&_nr_mismatches, 0);
+	}
+
+	if (_read_pct > 0) {
+		bdbm_msg ("[bench] prefill %llu pages", (unsigned long long)_nr_kpages_space);
+		bench_prefill ();
+	}
+
+	bdbm_msg ("[bench] %d threads send %llu requests (%d%% reads, %d%% of the space, %s); "
+		"llm=%d, throttle=%d%%, merge=%dus",
+		_nr_threads, (unsigned long long)nr_total, _read_pct, BENCH_SPACE_PCT, 
+		_sequential ? "sequential" : "random", 
+		_param_llm_type, _param_hlm_throttle_free_pct, _param_hlm_merge_window_us);
+
+	/* run clients */
+	bdbm_stopwatch_start (&sw);
+	for (i = 0, ofs = 0; i < _nr_threads; i++) {
+		bench_thread_t* t = &threads[i];
+		t->id = i;
+		t->nr_reqs = nr_total / _nr_threads + (i < nr_total % _nr_threads ? 1 : 0);
+		t->lat_us = lat_us + ofs;
+		t->is_read = is_read + ofs;
+		bdbm_sema_init (&t->done);
+		ofs += t->nr_reqs;
+		pthread_create (&tids[i], NULL, bench_thread_fn, (void*)t);
+	}
+	for (i = 0; i < _nr_threads; i++) {
+		pthread_join (tids[i], NULL);
+		bdbm_sema_free (&threads[i].done);
+	}
+	elapsed_us = bdbm_stopwatch_get_elapsed_time_us (&sw);
+
+	/* latencies of tenants; the upper half of lat_us is used as a buffer */
+	for (i = 0; _nr_tenants > 1 && i < _nr_tenants; i++) {
+		uint64_t tenant_us = 0;
+		char name[48];
+
+		for (j = i, n = 0; j < _nr_threads; j += _nr_tenants) {
+			bdbm_memcpy (lat_us + nr_total + n, threads[j].lat_us, 
+				threads[j].nr_reqs * sizeof (uint64_t));
+			n += threads[j].nr_reqs;
+			if (tenant_us < threads[j].elapsed_us)
+				tenant_us = threads[j].elapsed_us;
+		}
+		snprintf (name, sizeof (name), "reqs of tenant %llu", (unsigned long long)i);
+		bench_display (name, lat_us + nr_total, n, tenant_us);
+	}
+
+	/* split latencies by type; writes are compacted in place */
+	lat_rd = lat_us + nr_total;
+	for (i = 0; i < nr_total; i++) {
+		if (is_read[i])
+			lat_rd[nr_rd++] = lat_us[i];
+		else
+			lat_us[nr_wr++] = lat_us[i];
+	}
+	bench_display ("reads", lat_rd, nr_rd, elapsed_us);
+	bench_display ("writes", lat_us, nr_wr, elapsed_us);
+	bdbm_free (is_read);
+	bdbm_free (lat_us);
+
+	if (_remount && bench_remount () != 0)
+		return -1;
+	if (_verify) {
+		bench_read_back ();
+		bdbm_msg ("[bench] verify: %llu pages read with wrong data",
+			(unsigned long long)atomic64_read (&_nr_mismatches));
+		ret = atomic64_read (&_nr_mismatches) > 0 ? 1 : 0;
+		bdbm_free ((void*)_versions);
+		bdbm_free ((void*)_versions_done);
+	}
+
+	bdbm_drv_close (_bdi);
+	bdbm_dm_exit (_bdi);
+	bdbm_drv_destroy (_bdi);
+
+	return ret;
+}
@@ -207,7 +207,7 @@ uint32_t dm_proxy_make_req (
 	ior.phyaddr = r->phyaddr;
 	for (loop = 0; loop < nr_kpages; loop++) {
 		ior.kp_stt[loop] = r->fmain.kp_stt[loop];
-		if (bdbm_is_write (r->req_type)) {
+		if (bdbm_is_write (r->req_type) && r->fmain.kp_ptr[loop] != NULL) {
 			bdbm_memcpy (
 				p->punit_main_pages[punit_id] + (loop*KPAGE_SIZE),
 				r->fmain.kp_ptr[loop], 
@@ -280,6 +280,8 @@ int __dm_proxy_thread (void* arg)
 					/* copy Kernel-data to user-space if it is necessary */
 					if (bdbm_is_read (r->req_type)) {
 						for (k = 0; k < nr_kpages; k++) {
+							if (r->fmain.kp_ptr[k] == NULL)
+								continue;	/* a hole without a buffer */
 							bdbm_memcpy (
 								r->fmain.kp_ptr[k], 
 								p->punit_main_pages[loop] + (k*KPAGE_SIZE), 
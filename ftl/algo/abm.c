@@ -72,19 +72,21 @@ void __bdbm_abm_check_status (bdbm_abm_info_t* bai)
 		bai->nr_free_blks_prepared + 
 		bai->nr_clean_blks + 
 		bai->nr_dirty_blks + 
-		bai->nr_bad_blks);
+		bai->nr_bad_blks + 
+		bai->nr_erase_blks);
 }
 
 static inline
 void __bdbm_abm_display_status (bdbm_abm_info_t* bai) 
 {
-	bdbm_msg ("[ABM] Total: %llu => Free:%llu, Free(prepare):%llu, Clean:%llu, Dirty:%llu, Bad:%llu",
+	bdbm_msg ("[ABM] Total: %llu => Free:%llu, Free(prepare):%llu, Clean:%llu, Dirty:%llu, Bad:%llu, Erase:%llu",
 		bai->nr_total_blks,
 		bai->nr_free_blks, 
 		bai->nr_free_blks_prepared, 
 		bai->nr_clean_blks,
 		bai->nr_dirty_blks,
-		bai->nr_bad_blks);
+		bai->nr_bad_blks,
+		bai->nr_erase_blks);
 
 	__bdbm_abm_check_status (bai);
 }
@@ -151,10 +153,12 @@ bdbm_abm_info_t* bdbm_abm_create (
 	bai->list_head_clean = (struct list_head**)bdbm_zmalloc (sizeof (struct list_head*) * np->nr_channels);
 	bai->list_head_dirty = (struct list_head**)bdbm_zmalloc (sizeof (struct list_head*) * np->nr_channels);
 	bai->list_head_bad = (struct list_head**)bdbm_zmalloc (sizeof (struct list_head*) * np->nr_channels);
+	bai->list_head_erase = (struct list_head**)bdbm_zmalloc (sizeof (struct list_head*) * np->nr_channels);
 	if (bai->list_head_free == NULL || 
 		bai->list_head_clean == NULL || 
 		bai->list_head_dirty == NULL || 
-		bai->list_head_bad == NULL) {
+		bai->list_head_bad == NULL ||
+		bai->list_head_erase == NULL) {
 		bdbm_error ("bdbm_zmalloc failed");
 		goto fail;
 	}
@@ -169,11 +173,14 @@ bdbm_abm_info_t* bdbm_abm_create (
 			(sizeof (struct list_head) * np->nr_chips_per_channel);
 		bai->list_head_bad[loop] = (struct list_head*)bdbm_zmalloc 
 			(sizeof (struct list_head) * np->nr_chips_per_channel);
+		bai->list_head_erase[loop] = (struct list_head*)bdbm_zmalloc 
+			(sizeof (struct list_head) * np->nr_chips_per_channel);
 
 		if (bai->list_head_free[loop] == NULL || 
 			bai->list_head_clean[loop] == NULL || 
 			bai->list_head_dirty[loop] == NULL ||
-			bai->list_head_bad[loop] == NULL) {
+			bai->list_head_bad[loop] == NULL ||
+			bai->list_head_erase[loop] == NULL) {
 			bdbm_error ("bdbm_zmalloc failed");
 			goto fail;
 		}
@@ -182,6 +189,7 @@ bdbm_abm_info_t* bdbm_abm_create (
 			INIT_LIST_HEAD (&bai->list_head_clean[loop][subloop]);
 			INIT_LIST_HEAD (&bai->list_head_dirty[loop][subloop]);
 			INIT_LIST_HEAD (&bai->list_head_bad[loop][subloop]);
+			INIT_LIST_HEAD (&bai->list_head_erase[loop][subloop]);
 		}
 	}
 
@@ -198,6 +206,7 @@ bdbm_abm_info_t* bdbm_abm_create (
 	bai->nr_clean_blks = 0;
 	bai->nr_dirty_blks = 0;
 	bai->nr_bad_blks = 0;
+	bai->nr_erase_blks = 0;
 
 	/* done */
 	return bai;
@@ -235,6 +244,11 @@ void bdbm_abm_destroy (bdbm_abm_info_t* bai)
 			bdbm_free (bai->list_head_bad[loop]);
 		bdbm_free (bai->list_head_bad);
 	}
+	if (bai->list_head_erase != NULL) {
+		for (loop = 0; loop < bai->np->nr_channels; loop++)
+			bdbm_free (bai->list_head_erase[loop]);
+		bdbm_free (bai->list_head_erase);
+	}
 	if (bai->blocks != NULL) {
 		for (loop = 0; loop < bai->np->nr_blocks_per_ssd; loop++)
 			__bdbm_abm_destory_pst (bai->blocks[loop].pst);
@@ -300,6 +314,56 @@ bdbm_abm_block_t* bdbm_abm_get_free_block_prepare (
 	return blk;
 }
 
+/* the same as bdbm_abm_get_free_block_prepare (), but it prefers a block on 
+ * the given plane; any free block of the chip is taken if the plane has none */
+bdbm_abm_block_t* bdbm_abm_get_free_block_prepare_plane (
+	bdbm_abm_info_t* bai,
+	uint64_t channel_no,
+	uint64_t chip_no,
+	uint64_t plane_no) 
+{
+	struct list_head* pos = NULL;
+	bdbm_abm_block_t* blk = NULL;
+
+	if (bai->np->nr_planes_per_chip <= 1)
+		return bdbm_abm_get_free_block_prepare (bai, channel_no, chip_no);
+
+	list_for_each (pos, &(bai->list_head_free[channel_no][chip_no])) {
+		blk = list_entry (pos, bdbm_abm_block_t, list);
+		if (blk->status == BDBM_ABM_BLK_FREE &&
+			BDBM_GET_PLANE_NO (bai->np, blk) == plane_no) {
+			blk->status = BDBM_ABM_BLK_FREE_PREPARE;
+			__bdbm_abm_check_status (bai);
+
+			/* change the number of blks */
+			bai->nr_free_blks--;
+			bai->nr_free_blks_prepared++;
+			return blk;
+		}
+	}
+
+	return bdbm_abm_get_free_block_prepare (bai, channel_no, chip_no);
+}
+
+/* # of free blocks of a chip that are not prepared yet */
+uint64_t bdbm_abm_get_nr_free_blocks_chip (
+	bdbm_abm_info_t* bai,
+	uint64_t channel_no,
+	uint64_t chip_no)
+{
+	struct list_head* pos = NULL;
+	bdbm_abm_block_t* blk = NULL;
+	uint64_t nr_free_blks = 0;
+
+	list_for_each (pos, &(bai->list_head_free[channel_no][chip_no])) {
+		blk = list_entry (pos, bdbm_abm_block_t, list);
+		if (blk->status == BDBM_ABM_BLK_FREE)
+			nr_free_blks++;
+	}
+
+	return nr_free_blks;
+}
+
 void bdbm_abm_get_free_block_rollback (
 	bdbm_abm_info_t* bai,
 	bdbm_abm_block_t* blk)
@@ -341,6 +405,39 @@ void bdbm_abm_get_free_block_commit (
 	bai->nr_clean_blks++;
 }
 
+/* keep a dirty block whose pages are all invalid until it is erased; it 
+ * is moved to the free list by bdbm_abm_erase_block () when the erase is 
+ * done, and gc does not see it meanwhile */
+void bdbm_abm_pend_erase_block (
+	bdbm_abm_info_t* bai,
+	bdbm_abm_block_t* blk)
+{
+	bdbm_bug_on (blk->status != BDBM_ABM_BLK_DIRTY);
+	bdbm_bug_on (bai->nr_dirty_blks == 0);
+
+	list_del (&blk->list);
+	list_add_tail (&blk->list, &(bai->list_head_erase[blk->channel_no][blk->chip_no]));
+	bai->nr_dirty_blks--;
+	bai->nr_erase_blks++;
+	blk->status = BDBM_ABM_BLK_ERASE_PENDING;
+
+	__bdbm_abm_check_status (bai);
+}
+
+/* the block of a chip that has waited for an erase the longest */
+bdbm_abm_block_t* bdbm_abm_get_erase_pending_block (
+	bdbm_abm_info_t* bai,
+	uint64_t channel_no,
+	uint64_t chip_no)
+{
+	struct list_head* head = &(bai->list_head_erase[channel_no][chip_no]);
+
+	if (list_empty (head))
+		return NULL;
+
+	return list_entry (head->next, bdbm_abm_block_t, list);
+}
+
 void bdbm_abm_erase_block (
 	bdbm_abm_info_t* bai,
 	uint64_t channel_no,
@@ -388,6 +485,9 @@ void bdbm_abm_erase_block (
 	} else if (blk->status == BDBM_ABM_BLK_BAD) {
 		bdbm_bug_on (bai->nr_bad_blks == 0);
 		bai->nr_bad_blks--;
+	} else if (blk->status == BDBM_ABM_BLK_ERASE_PENDING) {
+		bdbm_bug_on (bai->nr_erase_blks == 0);
+		bai->nr_erase_blks--;
 	} else {
 		bdbm_bug_on (1);
 	}
@@ -591,6 +691,7 @@ uint32_t bdbm_abm_load (bdbm_abm_info_t* bai, const char* fn)
 	bai->nr_clean_blks = 0;
 	bai->nr_dirty_blks = 0;
 	bai->nr_bad_blks = 0;
+	bai->nr_erase_blks = 0;
 
 	for (i = 0; i < bai->np->nr_blocks_per_ssd; i++) {
 		bdbm_abm_block_t* b = &bai->blocks[i];
@@ -608,6 +709,10 @@ uint32_t bdbm_abm_load (bdbm_abm_info_t* bai, const char* fn)
 			list_add_tail (&b->list, &(bai->list_head_clean[b->channel_no][b->chip_no]));
 			bai->nr_clean_blks++;
 			break;
+		case BDBM_ABM_BLK_ERASE_PENDING:
+			/* gc takes it again; it has no valid pages */
+			b->status = BDBM_ABM_BLK_DIRTY;
+			/* fall through */
 		case BDBM_ABM_BLK_DIRTY:
 			list_add_tail (&b->list, &(bai->list_head_dirty[b->channel_no][b->chip_no]));
 			bai->nr_dirty_blks++;
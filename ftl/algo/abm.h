@@ -56,6 +56,7 @@ enum BDBM_ABM_BLK_STATUS {
 	BDBM_ABM_BLK_DIRTY,
 
 	BDBM_ABM_BLK_BAD,
+	BDBM_ABM_BLK_ERASE_PENDING,	/* no valid pages; it waits for an erase */
 };
 
 typedef struct {
@@ -77,6 +78,7 @@ typedef struct {
 	struct list_head** list_head_clean;
 	struct list_head** list_head_dirty;
 	struct list_head** list_head_bad;
+	struct list_head** list_head_erase;
 
 	/* # of blocks according to their types */
 	uint64_t nr_total_blks;
@@ -85,14 +87,19 @@ typedef struct {
 	uint64_t nr_clean_blks;
 	uint64_t nr_dirty_blks;
 	uint64_t nr_bad_blks;
+	uint64_t nr_erase_blks;
 } bdbm_abm_info_t;
 
 bdbm_abm_info_t* bdbm_abm_create (bdbm_device_params_t* np, uint8_t use_pst);
 void bdbm_abm_destroy (bdbm_abm_info_t* bai);
 bdbm_abm_block_t* bdbm_abm_get_block (bdbm_abm_info_t* bai, uint64_t channel_no, uint64_t chip_no, uint64_t block_no);
 bdbm_abm_block_t* bdbm_abm_get_free_block_prepare (bdbm_abm_info_t* bai, uint64_t channel_no, uint64_t chip_no);
+bdbm_abm_block_t* bdbm_abm_get_free_block_prepare_plane (bdbm_abm_info_t* bai, uint64_t channel_no, uint64_t chip_no, uint64_t plane_no);
+uint64_t bdbm_abm_get_nr_free_blocks_chip (bdbm_abm_info_t* bai, uint64_t channel_no, uint64_t chip_no);
 void bdbm_abm_get_free_block_rollback (bdbm_abm_info_t* bai, bdbm_abm_block_t* blk);
 void bdbm_abm_get_free_block_commit (bdbm_abm_info_t* bai, bdbm_abm_block_t* blk);
+void bdbm_abm_pend_erase_block (bdbm_abm_info_t* bai, bdbm_abm_block_t* blk);
+bdbm_abm_block_t* bdbm_abm_get_erase_pending_block (bdbm_abm_info_t* bai, uint64_t channel_no, uint64_t chip_no);
 void bdbm_abm_erase_block (bdbm_abm_info_t* bai, uint64_t channel_no, uint64_t chip_no, uint64_t block_no, uint8_t is_bad);
 void bdbm_abm_invalidate_page (bdbm_abm_info_t* bai, uint64_t channel_no, uint64_t chip_no, uint64_t block_no, uint64_t page_no, uint64_t subpage_no);
 void bdbm_abm_set_to_dirty_block (bdbm_abm_info_t* bai, uint64_t channel_no, uint64_t chip_no, uint64_t block_no);
@@ -101,6 +108,7 @@ static inline uint64_t bdbm_abm_get_nr_free_blocks (bdbm_abm_info_t* bai) { retu
 static inline uint64_t bdbm_abm_get_nr_free_blocks_prepared (bdbm_abm_info_t* bai) { return bai->nr_free_blks_prepared; }
 static inline uint64_t bdbm_abm_get_nr_clean_blocks (bdbm_abm_info_t* bai) { return bai->nr_clean_blks; }
 static inline uint64_t bdbm_abm_get_nr_dirty_blocks (bdbm_abm_info_t* bai) { return bai->nr_dirty_blks; }
+static inline uint64_t bdbm_abm_get_nr_erase_pending_blocks (bdbm_abm_info_t* bai) { return bai->nr_erase_blks; }
 static inline uint64_t bdbm_abm_get_nr_total_blocks (bdbm_abm_info_t* bai) { return bai->nr_total_blks; }
 
 uint32_t bdbm_abm_load (bdbm_abm_info_t* bai, const char* fn);
@@ -42,12 +42,17 @@ THE SOFTWARE.
 #include "debug.h"
 #include "utime.h"
 #include "ufile.h"
+#include "umemory.h"
+#include "hlm_reqs_pool.h"
 
 #include "algo/abm.h"
 #include "algo/dftl.h"
 #include "algo/dftl_map.h"
 
 
+/* # of map pages gc loads and writes back at once */
+#define DFTL_GC_NR_MAPBLKS 32
+
 /* FTL interface */
 bdbm_ftl_inf_t _ftl_dftl = {
 	.ptr_private = NULL,
@@ -59,6 +64,7 @@ bdbm_ftl_inf_t _ftl_dftl = {
 	.invalidate_lpa = bdbm_dftl_invalidate_lpa,
 	.do_gc = bdbm_dftl_do_gc,
 	.is_gc_needed = bdbm_dftl_is_gc_needed,
+	.get_free_space = bdbm_dftl_get_free_space,
 
 	/* intializationn */
 	.scan_badblocks = bdbm_dftl_badblock_scan,
@@ -78,6 +84,7 @@ typedef struct {
 	dftl_mapping_table_t* mt;
 	bdbm_spinlock_t ftl_lock;
 	uint64_t nr_punits;	
+	uint64_t nr_punits_pages;
 
 	/* for the management of active blocks */
 	uint64_t curr_puid;
@@ -87,11 +94,26 @@ typedef struct {
 	/* reserved for gc (reused whenever gc is invoked) */
 	bdbm_abm_block_t** gc_bab;
 	bdbm_hlm_req_gc_t gc_hlm;
+	bdbm_llm_req_t** gc_order;	/* data pages gc moves, sorted by lpa */
+	bdbm_mapblk_waiter_t gc_waiters[DFTL_GC_NR_MAPBLKS];	/* gc waits for map pages of data pages it moves */
+	bdbm_llm_req_t* gc_evictions[DFTL_GC_NR_MAPBLKS];	/* map pages gc writes back */
+	uint64_t nr_gc_mapblk_loads;
+	uint64_t nr_gc_mapblk_writes;
 
 	/* for bad-block scanning */
 	bdbm_sema_t badblk;
 } bdbm_dftl_private_t;
 
+/* a llm req that reads or writes a map page; the page is kept right after
+ * this structure */
+typedef struct {
+	bdbm_llm_req_t r;	/* it must be on top of this structure */
+	bdbm_sema_t done;
+	directory_slot_t* ds;
+	mapping_entry_t* me;
+	int64_t oob[BDBM_MAX_PAGES];
+} bdbm_dftl_mapblk_req_t;
+
 
 uint32_t __bdbm_dftl_get_active_blocks (
 	bdbm_device_params_t* np,
@@ -165,8 +187,13 @@ uint32_t bdbm_dftl_create (bdbm_drv_info_t* bdi)
 {
 	bdbm_dftl_private_t* p = NULL;
 	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
-	uint64_t i = 0, j = 0;
-	uint64_t nr_kp_per_fp = np->page_main_size / KERNEL_PAGE_SIZE;	/* e.g., 2 = 8 KB / 4 KB */
+
+	/* a mapping entry and the oob of a page cover a whole flash page */
+	if (np->nr_subpages_per_page != 1 || np->nr_planes_per_chip != 1) {
+		bdbm_error ("DFTL supports neither subpages nor planes (%llu subpages, %llu planes)",
+			np->nr_subpages_per_page, np->nr_planes_per_chip);
+		return 1;
+	}
 
 	/* create a private data structure */
 	if ((p = (bdbm_dftl_private_t*)bdbm_zmalloc 
@@ -177,6 +204,7 @@ uint32_t bdbm_dftl_create (bdbm_drv_info_t* bdi)
 	p->curr_puid = 0;
 	p->curr_page_ofs = 0;
 	p->nr_punits = np->nr_chips_per_channel * np->nr_channels;
+	p->nr_punits_pages = p->nr_punits * np->nr_pages_per_block;
 	bdbm_spin_lock_init (&p->ftl_lock);
 	_ftl_dftl.ptr_private = (void*)p;
 
@@ -188,7 +216,8 @@ uint32_t bdbm_dftl_create (bdbm_drv_info_t* bdi)
 	}
 
 	/* create a mapping table */
-	if ((p->mt = bdbm_dftl_create_mapping_table (np)) == NULL) {
+	if ((p->mt = bdbm_dftl_create_mapping_table (
+			np, BDBM_GET_DRIVER_PARAMS (bdi)->dftl_cache_policy)) == NULL) {
 		bdbm_error ("__bdbm_dftl_create_mapping_table failed");
 		bdbm_dftl_destroy (bdi);
 		return 1;
@@ -208,23 +237,20 @@ uint32_t bdbm_dftl_create (bdbm_drv_info_t* bdi)
 		bdbm_dftl_destroy (bdi);
 		return 1;
 	}
-	if ((p->gc_hlm.llm_reqs = (bdbm_llm_req_t*)bdbm_zmalloc
-			(sizeof (bdbm_llm_req_t) * p->nr_punits * np->nr_pages_per_block)) == NULL) {
+	if ((p->gc_order = (bdbm_llm_req_t**)bdbm_zmalloc 
+			(sizeof (bdbm_llm_req_t*) * p->nr_punits_pages)) == NULL) {
 		bdbm_error ("bdbm_zmalloc failed");
 		bdbm_dftl_destroy (bdi);
 		return 1;
 	}
-
-	while (i < p->nr_punits * np->nr_pages_per_block) {
-		bdbm_llm_req_t* r = &p->gc_hlm.llm_reqs[i];
-		r->kpg_flags = NULL;
-		r->pptr_kpgs = (uint8_t**)bdbm_malloc_atomic (sizeof(uint8_t*) * nr_kp_per_fp);
-		for (j = 0; j < nr_kp_per_fp; j++)
-			r->pptr_kpgs[j] = (uint8_t*)get_zeroed_page (GFP_KERNEL);
-		r->ptr_oob = (uint8_t*)bdbm_malloc_atomic (sizeof (uint8_t) * np->page_oob_size);
-		i++;
+	if ((p->gc_hlm.llm_reqs = (bdbm_llm_req_t*)bdbm_zmalloc
+			(sizeof (bdbm_llm_req_t) * p->nr_punits_pages)) == NULL) {
+		bdbm_error ("bdbm_zmalloc failed");
+		bdbm_dftl_destroy (bdi);
+		return 1;
 	}
-	bdbm_sema_init (&p->gc_hlm.gc_done);
+	bdbm_sema_init (&p->gc_hlm.done);
+	hlm_reqs_pool_allocate_llm_reqs (p->gc_hlm.llm_reqs, p->nr_punits_pages, RP_MEM_PHY);
 
 	return 0;
 }
@@ -232,36 +258,35 @@ uint32_t bdbm_dftl_create (bdbm_drv_info_t* bdi)
 void bdbm_dftl_destroy (bdbm_drv_info_t* bdi)
 {
 	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
-	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
 
 	if (!p)
 		return;
 
 	if (p->gc_hlm.llm_reqs) {
-		uint64_t i = 0, j = 0;
-		uint64_t nr_kp_per_fp = np->page_main_size / KERNEL_PAGE_SIZE;	/* e.g., 2 = 8 KB / 4 KB */
-		while (i < p->nr_punits * np->nr_pages_per_block) {
-			bdbm_llm_req_t* r = &p->gc_hlm.llm_reqs[i];
-			for (j = 0; j < nr_kp_per_fp; j++)
-				free_page ((unsigned long)r->pptr_kpgs[j]);
-			bdbm_free_atomic (r->pptr_kpgs);
-			bdbm_free_atomic (r->ptr_oob);
-			i++;
-		}
+		hlm_reqs_pool_release_llm_reqs (p->gc_hlm.llm_reqs, p->nr_punits_pages, RP_MEM_PHY);
+		bdbm_sema_free (&p->gc_hlm.done);
 		bdbm_free (p->gc_hlm.llm_reqs);
 	}
+	if (p->gc_order)
+		bdbm_free (p->gc_order);
 	if (p->gc_bab)
 		bdbm_free (p->gc_bab);
 	if (p->ac_bab)
 		__bdbm_dftl_destroy_active_blocks (p->ac_bab);
-	if (p->mt) 
+	if (p->mt) {
+		bdbm_msg ("DFTL: gc loaded %llu map pages and wrote them back %llu times", 
+			p->nr_gc_mapblk_loads, p->nr_gc_mapblk_writes);
 		bdbm_dftl_destroy_mapping_table (p->mt);
+	}
 	if (p->bai)
 		bdbm_abm_destroy (p->bai);
 	bdbm_free (p);
 }
 
-uint32_t bdbm_dftl_get_free_ppa (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_phyaddr_t* ppa)
+uint32_t bdbm_dftl_get_free_ppa (
+	bdbm_drv_info_t* bdi, 
+	int64_t lpa, 
+	bdbm_phyaddr_t* ppa)
 {
 	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
 	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
@@ -295,14 +320,6 @@ uint32_t bdbm_dftl_get_free_ppa (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_phyadd
 		if (p->curr_page_ofs == np->nr_pages_per_block) {
 			/* get active blocks */
 			if (__bdbm_dftl_get_active_blocks (np, p->bai, p->ac_bab) != 0) {
-				/*
-				bdbm_msg ("free_blks: %llu clean_blks: %llu, dirty_blks: %llu, total_blks: %llu",
-						bdbm_abm_get_nr_free_blocks (p->bai),
-						bdbm_abm_get_nr_clean_blocks (p->bai),
-						bdbm_abm_get_nr_dirty_blocks (p->bai),
-						bdbm_abm_get_nr_total_blocks (p->bai)
-						);
-				*/
 				bdbm_error ("__bdbm_dftl_get_active_blocks failed");
 				return 1;
 			}
@@ -318,14 +335,31 @@ uint32_t bdbm_dftl_get_free_ppa (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_phyadd
 	return 0;
 }
 
-uint32_t bdbm_dftl_map_lpa_to_ppa (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_phyaddr_t* ptr_phyaddr)
+uint32_t bdbm_dftl_map_lpa_to_ppa (
+	bdbm_drv_info_t* bdi, 
+	bdbm_logaddr_t* logaddr,
+	bdbm_phyaddr_t* phyaddr)
 {
 	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
 	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
+	int64_t lpa = logaddr->lpa[0];
 	mapping_entry_t me;
 
+	/* the page must be set to invalid for gc if it has no data */
+	if (lpa == -1) {
+		bdbm_abm_invalidate_page (
+			p->bai, 
+			phyaddr->channel_no, 
+			phyaddr->chip_no,
+			phyaddr->block_no,
+			phyaddr->page_no,
+			0
+		);
+		return 0;
+	}
+
 	/* is it a valid logical address */
-	if (lpa >= np->nr_pages_per_ssd) {
+	if (lpa >= np->nr_subpages_per_ssd) {
 		bdbm_error ("LPA is beyond logical space (%llX)", lpa);
 		return 1;
 	}
@@ -344,22 +378,27 @@ uint32_t bdbm_dftl_map_lpa_to_ppa (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_phya
 			me.phyaddr.channel_no, 
 			me.phyaddr.chip_no,
 			me.phyaddr.block_no,
-			me.phyaddr.page_no
+			me.phyaddr.page_no,
+			0
 		);
 	}
 
 	/* update the mapping entry to point to a new physical location */
 	me.status = DFTL_PAGE_VALID;
-	me.phyaddr.channel_no = ptr_phyaddr->channel_no;
-	me.phyaddr.chip_no = ptr_phyaddr->chip_no;
-	me.phyaddr.block_no = ptr_phyaddr->block_no;
-	me.phyaddr.page_no = ptr_phyaddr->page_no;
+	me.phyaddr.channel_no = phyaddr->channel_no;
+	me.phyaddr.chip_no = phyaddr->chip_no;
+	me.phyaddr.block_no = phyaddr->block_no;
+	me.phyaddr.page_no = phyaddr->page_no;
 	bdbm_dftl_set_mapping_entry (p->mt, lpa, &me);
 
 	return 0;
 }
 
-uint32_t bdbm_dftl_get_ppa (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_phyaddr_t* ppa)
+uint32_t bdbm_dftl_get_ppa (
+	bdbm_drv_info_t* bdi, 
+	int64_t lpa, 
+	bdbm_phyaddr_t* ppa,
+	uint64_t* sp_off)
 {
 	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
 	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
@@ -367,19 +406,13 @@ uint32_t bdbm_dftl_get_ppa (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_phyaddr_t*
 	uint32_t ret;
 
 	/* is it a valid logical address */
-	if (lpa >= np->nr_pages_per_ssd) {
+	if (lpa >= np->nr_subpages_per_ssd) {
 		bdbm_error ("A given lpa is beyond logical space (%llu)", lpa);
 		return 1;
 	}
 
 	/* get the mapping entry for lpa */
 	me = bdbm_dftl_get_mapping_entry (p->mt, lpa);
-	/*
-	if (me.status == DFTL_PAGE_NOT_EXIST) {
-		bdbm_error ("A given lpa is not found in the mapping table (%llu)", lpa);
-		return 1;
-	}
-	*/
 
 	/* NOTE: sometimes a file system attempts to read 
 	 * a logical address that was not written before.
@@ -389,6 +422,7 @@ uint32_t bdbm_dftl_get_ppa (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_phyaddr_t*
 		ppa->chip_no = 0;
 		ppa->block_no = 0;
 		ppa->page_no = 0;
+		ppa->punit_id = 0;
 		ret = 1;
 	} else {
 		ppa->channel_no = me.phyaddr.channel_no;
@@ -398,11 +432,15 @@ uint32_t bdbm_dftl_get_ppa (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_phyaddr_t*
 		ppa->punit_id = BDBM_GET_PUNIT_ID (bdi, ppa);
 		ret = 0;
 	}
+	*sp_off = 0;
 
 	return ret;
 }
 
-uint32_t bdbm_dftl_invalidate_lpa (bdbm_drv_info_t* bdi, uint64_t lpa, uint64_t len)
+uint32_t bdbm_dftl_invalidate_lpa (
+	bdbm_drv_info_t* bdi, 
+	int64_t lpa, 
+	uint64_t len)
 {	
 	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
 	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
@@ -410,9 +448,9 @@ uint32_t bdbm_dftl_invalidate_lpa (bdbm_drv_info_t* bdi, uint64_t lpa, uint64_t
 	uint64_t loop;
 
 	/* check the range of input addresses */
-	if ((lpa + len) > np->nr_pages_per_ssd) {
+	if ((lpa + len) > np->nr_subpages_per_ssd) {
 		bdbm_warning ("LPA is beyond logical space (%llu = %llu+%llu) %llu", 
-			lpa+len, lpa, len, np->nr_pages_per_ssd);
+			lpa+len, lpa, len, np->nr_subpages_per_ssd);
 		return 1;
 	}
 
@@ -420,10 +458,8 @@ uint32_t bdbm_dftl_invalidate_lpa (bdbm_drv_info_t* bdi, uint64_t lpa, uint64_t
 	for (loop = lpa; loop < (lpa + len); loop++) {
 		me = bdbm_dftl_get_mapping_entry (p->mt, loop);
 		if (me.status == DFTL_PAGE_NOT_EXIST) {
-			/* don't do TRIM */
-			return 0;
-			/*bdbm_error ("A given lpa is not found in the mapping table (%llu)", lpa);*/
-			/*return 1;*/
+			/* the map page was never written, so nothing is mapped */
+			continue;
 		}
 
 		if (me.status == DFTL_PAGE_VALID) {
@@ -433,7 +469,8 @@ uint32_t bdbm_dftl_invalidate_lpa (bdbm_drv_info_t* bdi, uint64_t lpa, uint64_t
 				me.phyaddr.channel_no, 
 				me.phyaddr.chip_no,
 				me.phyaddr.block_no,
-				me.phyaddr.page_no
+				me.phyaddr.page_no,
+				0
 			);
 
 			/* update a mapping entry to invalid */
@@ -446,7 +483,18 @@ uint32_t bdbm_dftl_invalidate_lpa (bdbm_drv_info_t* bdi, uint64_t lpa, uint64_t
 	return 0;
 }
 
-uint8_t bdbm_dftl_is_gc_needed (bdbm_drv_info_t* bdi)
+void bdbm_dftl_get_free_space (
+	bdbm_drv_info_t* bdi, 
+	uint64_t* nr_free_blks, 
+	uint64_t* nr_total_blks)
+{
+	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
+
+	*nr_free_blks = bdbm_abm_get_nr_free_blocks (p->bai);
+	*nr_total_blks = bdbm_abm_get_nr_total_blocks (p->bai);
+}
+
+uint8_t bdbm_dftl_is_gc_needed (bdbm_drv_info_t* bdi, int64_t lpa)
 {
 	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
 	uint64_t nr_total_blks = bdbm_abm_get_nr_total_blocks (p->bai);
@@ -458,52 +506,12 @@ uint8_t bdbm_dftl_is_gc_needed (bdbm_drv_info_t* bdi)
 			/* there are no blocks to garbage collect */
 			return 0;
 		}
-		/*
-		bdbm_msg ("free_blks: %llu clean_blks: %llu, dirty_blks: %llu, total_blks: %llu",
-				nr_free_blks,
-				bdbm_abm_get_nr_clean_blocks (p->bai),
-				bdbm_abm_get_nr_dirty_blocks (p->bai),
-				bdbm_abm_get_nr_total_blocks (p->bai)
-				);
-		*/
 		return 1;
 	}
 
-	/* invoke gc when there is only one dirty block (for debugging) */
-	/*
-	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
-	if (bdbm_abm_get_nr_dirty_blocks (p->bai) > 1) {
-		return 1;
-	}
-	*/
-
 	return 0;
 }
 
-/* VICTIM SELECTION - First Selection:
- * select the first dirty block in a list */
-bdbm_abm_block_t* __bdbm_dftl_victim_selection (
-	bdbm_drv_info_t* bdi,
-	uint64_t channel_no,
-	uint64_t chip_no)
-{
-	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
-	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
-	bdbm_abm_block_t* a = NULL;
-	bdbm_abm_block_t* b = NULL;
-	struct list_head* pos = NULL;
-
-	a = p->ac_bab[channel_no*np->nr_chips_per_channel + chip_no];
-	bdbm_abm_list_for_each_dirty_block (pos, p->bai, channel_no, chip_no) {
-		b = bdbm_abm_fetch_dirty_block (pos);
-		if (a != b)
-			break;
-		b = NULL;
-	}
-
-	return b;
-}
-
 /* VICTIM SELECTION - Greedy:
  * select a dirty block with a small number of valid pages */
 bdbm_abm_block_t* __bdbm_dftl_victim_selection_greedy (
@@ -524,7 +532,7 @@ bdbm_abm_block_t* __bdbm_dftl_victim_selection_greedy (
 		b = bdbm_abm_fetch_dirty_block (pos);
 		if (a == b)
 			continue;
-		if (b->nr_invalid_pages == np->nr_pages_per_block) {
+		if (b->nr_invalid_subpages == np->nr_subpages_per_block) {
 			v = b;
 			break;
 		}
@@ -532,28 +540,184 @@ bdbm_abm_block_t* __bdbm_dftl_victim_selection_greedy (
 			v = b;
 			continue;
 		}
-		if (a->nr_invalid_pages > v->nr_invalid_pages)
+		if (b->nr_invalid_subpages > v->nr_invalid_subpages)
 			v = b;
 	}
 
 	return v;
 }
 
+/* send the reqs [first, first + nr_llm_reqs) of gc_hlm to llm and wait for them */
+static void __bdbm_dftl_gc_send (
+	bdbm_drv_info_t* bdi, 
+	uint32_t req_type, 
+	uint64_t first,
+	uint64_t nr_llm_reqs)
+{
+	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
+	bdbm_hlm_req_gc_t* hlm_gc = &p->gc_hlm;
+	uint64_t i;
+
+	hlm_gc->req_type = req_type;
+	hlm_gc->nr_llm_reqs = nr_llm_reqs;
+	atomic64_set (&hlm_gc->nr_llm_reqs_done, 0);
+	bdbm_sema_lock (&hlm_gc->done);
+	for (i = first; i < first + nr_llm_reqs; i++) {
+		if ((bdi->ptr_llm_inf->make_req (bdi, &hlm_gc->llm_reqs[i])) != 0) {
+			bdbm_error ("llm_make_req failed");
+			bdbm_bug_on (1);
+		}
+	}
+	bdbm_sema_lock (&hlm_gc->done);
+	bdbm_sema_unlock (&hlm_gc->done);
+}
+
+/* sort data pages by lpa, so that those of the same map page are adjacent */
+static void __bdbm_dftl_sift_down (
+	bdbm_llm_req_t** rr, 
+	uint64_t root, 
+	uint64_t n)
+{
+	bdbm_llm_req_t* t;
+	uint64_t child;
+
+	while ((child = 2 * root + 1) < n) {
+		if (child + 1 < n && rr[child]->logaddr.lpa[0] < rr[child + 1]->logaddr.lpa[0])
+			child++;
+		if (rr[root]->logaddr.lpa[0] >= rr[child]->logaddr.lpa[0])
+			return;
+		t = rr[root]; rr[root] = rr[child]; rr[child] = t;
+		root = child;
+	}
+}
+
+static void __bdbm_dftl_sort_by_lpa (
+	bdbm_llm_req_t** rr, 
+	uint64_t n)
+{
+	bdbm_llm_req_t* t;
+	uint64_t i;
+
+	if (n < 2)
+		return;
+	for (i = n / 2; i > 0; i--)
+		__bdbm_dftl_sift_down (rr, i - 1, n);
+	for (i = n - 1; i > 0; i--) {
+		t = rr[0]; rr[0] = rr[i]; rr[i] = t;
+		__bdbm_dftl_sift_down (rr, 0, i);
+	}
+}
+
+static bdbm_llm_req_t* __bdbm_dftl_prepare_dir_eviction (bdbm_drv_info_t* bdi, directory_slot_t* ds);
+
+/* take (up to DFTL_GC_NR_MAPBLKS) given slots out of DRAM, writing back the 
+ * dirty ones; it returns the # of map pages written */
+static uint64_t __bdbm_dftl_write_back_dirs (
+	bdbm_drv_info_t* bdi, 
+	directory_slot_t** dirs,
+	uint64_t nr)
+{
+	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
+	bdbm_llm_req_t* r = NULL;
+	uint64_t i, nr_evictions = 0;
+
+	for (i = 0; i < nr; i++) {
+		directory_slot_t* ds = bdbm_dftl_prepare_victim_dir (p->mt, dirs[i]->id);
+
+		if (ds == NULL || (r = __bdbm_dftl_prepare_dir_eviction (bdi, ds)) == NULL)
+			continue;
+		p->gc_evictions[nr_evictions++] = r;
+		bdbm_sema_lock (r->done);
+		if ((bdi->ptr_llm_inf->make_req (bdi, r)) != 0) {
+			bdbm_error ("llm_make_req failed");
+			bdbm_bug_on (1);
+		}
+	}
+	for (i = 0; i < nr_evictions; i++) {
+		/* r->done is unlocked by hlm_dftl_end_req */
+		r = p->gc_evictions[i];
+		bdbm_sema_lock (r->done);
+		bdbm_sema_unlock (r->done);
+		bdbm_dftl_finish_mapblk_eviction (bdi, r);
+	}
+
+	return nr_evictions;
+}
+
+/* remap the data pages gc_order[first, nr) that belong to the next (up to) 
+ * DFTL_GC_NR_MAPBLKS map pages. A map page that is not in DRAM is read once, 
+ * gets all of its updates together, and is written back once right after, 
+ * so that the cold entries gc moves do not push hot ones out of DRAM. It 
+ * returns the first data page of the next batch */
+static uint64_t __bdbm_dftl_gc_remap_batch (
+	bdbm_drv_info_t* bdi, 
+	uint64_t first,
+	uint64_t nr)
+{
+	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
+	uint64_t nr_entries = p->mt->nr_entires_per_dir_slot;
+	directory_slot_t* loaded[DFTL_GC_NR_MAPBLKS];
+	bdbm_llm_req_t** rr = p->gc_order;
+	bdbm_llm_req_t* r = NULL;
+	uint64_t i, last, nr_loaded = 0;
+	dftl_miss_group_t g;
+
+	/* load the map pages that are not in DRAM */
+	bdbm_dftl_miss_group_init (&g);
+	for (i = first; i < nr && nr_loaded < DFTL_GC_NR_MAPBLKS; ) {
+		int64_t lpa = rr[i]->logaddr.lpa[0];
+
+		if (bdbm_dftl_check_mapblk (bdi, lpa) == 1) {
+			/* it is finished by hlm_dftl_end_req, which wakes up the waiter */
+			loaded[nr_loaded] = &p->mt->dir[lpa / nr_entries];
+			bdbm_dftl_miss_group_add (&g, &p->gc_waiters[nr_loaded]);
+			if ((r = bdbm_dftl_prepare_mapblk_load (bdi, lpa, &p->gc_waiters[nr_loaded])) != NULL &&
+				(bdi->ptr_llm_inf->make_req (bdi, r)) != 0) {
+				bdbm_error ("llm_make_req failed");
+				bdbm_bug_on (1);
+			}
+			nr_loaded++;
+		}
+
+		/* skip the other data pages of the map page */
+		while (i < nr && rr[i]->logaddr.lpa[0] / nr_entries == lpa / nr_entries)
+			i++;
+	}
+	last = i;
+	bdbm_dftl_miss_group_wait (&g);
+	p->nr_gc_mapblk_loads += nr_loaded;
+
+	/* apply the updates; those of a map page are adjacent */
+	for (i = first; i < last; i++) {
+		if (bdbm_dftl_get_free_ppa (bdi, rr[i]->logaddr.lpa[0], &rr[i]->phyaddr) != 0) {
+			bdbm_error ("bdbm_dftl_get_free_ppa failed");
+			bdbm_bug_on (1);
+		}
+		if (bdbm_dftl_map_lpa_to_ppa (bdi, &rr[i]->logaddr, &rr[i]->phyaddr) != 0) {
+			bdbm_error ("bdbm_dftl_map_lpa_to_ppa failed");
+			bdbm_bug_on (1);
+		}
+	}
+
+	/* write back the map pages loaded above */
+	p->nr_gc_mapblk_writes += __bdbm_dftl_write_back_dirs (bdi, loaded, nr_loaded);
+
+	return last;
+}
+
 /* TODO: need to improve it for background gc */
-uint32_t bdbm_dftl_do_gc (bdbm_drv_info_t* bdi)
+uint32_t bdbm_dftl_do_gc (bdbm_drv_info_t* bdi, int64_t lpa)
 {
 	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
 	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
 	bdbm_hlm_req_gc_t* hlm_gc = &p->gc_hlm;
 	uint64_t nr_gc_blks = 0;
 	uint64_t nr_llm_reqs = 0;
-	uint64_t nr_punits = 0;
+	uint64_t nr_mapblks = 0;
 	uint64_t i, j;
 
-	nr_punits = np->nr_channels * np->nr_chips_per_channel;
-
 	/* choose victim blocks for individual parallel units */
-	bdbm_memset (p->gc_bab, 0x00, sizeof (bdbm_abm_block_t*) * nr_punits);
+	bdbm_memset (p->gc_bab, 0x00, sizeof (bdbm_abm_block_t*) * p->nr_punits);
 	for (i = 0, nr_gc_blks = 0; i < np->nr_channels; i++) {
 		for (j = 0; j < np->nr_chips_per_channel; j++) {
 			bdbm_abm_block_t* b; 
@@ -563,32 +727,33 @@ uint32_t bdbm_dftl_do_gc (bdbm_drv_info_t* bdi)
 			}
 		}
 	}
-	if (nr_gc_blks < nr_punits) {
+	if (nr_gc_blks < p->nr_punits) {
 		/* TODO: we need to implement a load balancing feature to avoid this */
-		/*bdbm_warning ("TODO: this warning will be removed with load-balancing");*/
 		return 0;
 	}
 
-	/* build hlm_req_gc for reads */
-	for (i = 0, nr_llm_reqs = 0; i < nr_gc_blks; i++) {
+	/* build read reqs for the valid pages of the victims */
+	for (i = 0; i < nr_gc_blks; i++) {
 		bdbm_abm_block_t* b = p->gc_bab[i];
-		if (b == NULL)
-			break;
+
 		for (j = 0; j < np->nr_pages_per_block; j++) {
-			if (b->pst[j] != BDBM_ABM_PAGE_INVALID) {
-				bdbm_llm_req_t* r = &hlm_gc->llm_reqs[nr_llm_reqs];
-				r->req_type = REQTYPE_GC_READ;
-				r->lpa = -1ULL; /* lpa is not available now */
-				r->ptr_hlm_req = (void*)hlm_gc;
-				r->phyaddr = &r->phyaddr_r;
-				r->phyaddr->channel_no = b->channel_no;
-				r->phyaddr->chip_no = b->chip_no;
-				r->phyaddr->block_no = b->block_no;
-				r->phyaddr->page_no = j;
-				r->phyaddr->punit_id = BDBM_GET_PUNIT_ID (bdi, r->phyaddr);
-				r->ret = 0;
-				nr_llm_reqs++;
-			}
+			bdbm_llm_req_t* r = &hlm_gc->llm_reqs[nr_llm_reqs];
+
+			if (b->pst[j] == BDBM_ABM_SUBPAGE_INVALID)
+				continue;
+
+			hlm_reqs_pool_reset_fmain (&r->fmain);
+			hlm_reqs_pool_reset_logaddr (&r->logaddr);
+			r->fmain.kp_stt[0] = KP_STT_DATA;
+			r->req_type = REQTYPE_GC_READ;
+			r->phyaddr.channel_no = b->channel_no;
+			r->phyaddr.chip_no = b->chip_no;
+			r->phyaddr.block_no = b->block_no;
+			r->phyaddr.page_no = j;
+			r->phyaddr.punit_id = BDBM_GET_PUNIT_ID (bdi, (&r->phyaddr));
+			r->ptr_hlm_req = (void*)hlm_gc;
+			r->ret = 0;
+			nr_llm_reqs++;
 		}
 	}
 
@@ -596,147 +761,82 @@ uint32_t bdbm_dftl_do_gc (bdbm_drv_info_t* bdi)
 	 * TODO: it might be possible to further optimize this */
 	bdi->ptr_llm_inf->flush (bdi);
 
-	if (nr_llm_reqs == 0) 
-		goto erase_blks;
-
-	/* send read reqs to llm */
-	hlm_gc->req_type = REQTYPE_GC_READ;
-	hlm_gc->nr_done_reqs = 0;
-	hlm_gc->nr_reqs = nr_llm_reqs;
-	bdbm_sema_lock (&hlm_gc->gc_done);
-	for (i = 0; i < nr_llm_reqs; i++) {
-		if ((bdi->ptr_llm_inf->make_req (bdi, &hlm_gc->llm_reqs[i])) != 0) {
-			bdbm_error ("llm_make_req failed");
-			bdbm_bug_on (1);
-		}
-	}
-	bdbm_sema_lock (&hlm_gc->gc_done);
-	bdbm_sema_unlock (&hlm_gc->gc_done);
-
-	/* load mapping entries that do existing in DRAM */
-	{
-		bdbm_llm_req_t** rr = (bdbm_llm_req_t**)bdbm_malloc (sizeof (bdbm_llm_req_t*)*nr_llm_reqs);
-
-		/* FIXME: need to improve to exploit parallelism */
-		for (i = 0; i < nr_llm_reqs; i++) {
-			uint64_t lpa = ((uint64_t*)hlm_gc->llm_reqs[i].ptr_oob)[0]; /* update LPA */
+	/* map pages of the victims may be being read by the translation of
+	 * hlm; they are moved and erased after the reads finish */
+	bdbm_dftl_wait_for_loads (p->mt);
 
-			/* is it a mapping entry? */
-			if ((int64_t)lpa == -2LL) {
-				continue;
-			}
-
-			if ((int64_t)lpa >= np->nr_pages_per_ssd || (int64_t)lpa < 0) {
-				/*bdbm_msg ("what??? %llu", lpa);*/
-				continue;
-			}
+	if (nr_llm_reqs == 0)
+		goto erase_blks;
 
-			/* see if lpa exists in DRAM */
-			if (bdbm_dftl_check_mapblk (bdi, lpa) == 0) 
-				continue;	/* a mapping entry exists, so go to the next req */
+	/* read the valid pages */
+	__bdbm_dftl_gc_send (bdi, REQTYPE_GC_READ, 0, nr_llm_reqs);
 
-			/* load missing maing entries from Flash */
-			if ((rr[i] = bdbm_dftl_prepare_mapblk_load (bdi, lpa)) == NULL)
-				continue;
+	/* the pages go to new locations; map pages are put ahead of data pages */
+	for (i = 0, nr_mapblks = 0; i < nr_llm_reqs; i++) {
+		bdbm_llm_req_t* r = &hlm_gc->llm_reqs[i];
+		int64_t lpa = ((int64_t*)r->foob.data)[0];
 
-			/* send reqs to llm */
-			bdbm_sema_lock (rr[i]->done);
-			bdi->ptr_llm_inf->make_req (bdi, rr[i]);
+		if (lpa == -1 || lpa >= (int64_t)np->nr_subpages_per_ssd) {
+			bdbm_error ("a valid page has no lpa in its oob (%lld)", lpa);
+			bdbm_bug_on (1);
 		}
-		for (i = 0; i < nr_llm_reqs; i++) {
-			if (rr[i]) {
-				bdbm_sema_lock (rr[i]->done);
-				bdbm_dftl_finish_mapblk_load (bdi, rr[i]);
+
+		r->req_type = REQTYPE_GC_WRITE;
+		r->logaddr.lpa[0] = lpa;
+		r->ret = 0;
+		if (DFTL_IS_MAPBLK_LPA (lpa)) {
+			if (i != nr_mapblks) {
+				bdbm_llm_req_t t = hlm_gc->llm_reqs[nr_mapblks];
+				hlm_gc->llm_reqs[nr_mapblks] = *r;
+				*r = t;
 			}
+			nr_mapblks++;
 		}
-
-		bdbm_free (rr);
 	}
 
-	/* build hlm_req_gc for writes */
-	for (i = 0; i < nr_llm_reqs; i++) {
+	/* map pages move first, so that those loaded below are read from their 
+	 * new locations; the GTD points to them once they are written */
+	for (i = 0; i < nr_mapblks; i++) {
 		bdbm_llm_req_t* r = &hlm_gc->llm_reqs[i];
-		r->req_type = REQTYPE_GC_WRITE;	/* change to write */
-		r->lpa = ((uint64_t*)r->ptr_oob)[0]; /* update LPA */
-
-		if ((int64_t)r->lpa == -2LL) {
-			/* This page currently keeps mapping entries;
-			 * its phyaddr in DS must be updated */
-			int64_t id = ((uint64_t*)r->ptr_oob)[1];
-			
-			if (bdbm_dftl_get_free_ppa (bdi, r->lpa, r->phyaddr) != 0) {
-				bdbm_error ("bdbm_dftl_get_free_ppa failed");
-				bdbm_bug_on (1);
-			}
-
-			bdbm_dftl_update_dir_phyaddr (p->mt, id, r->phyaddr);
-		} else if ((int64_t)r->lpa >= np->nr_pages_per_ssd || (int64_t)r->lpa < 0) {
-			/*bdbm_msg ("what??? %llu", r->lpa);*/
-		} else {
-			if (bdbm_dftl_get_free_ppa (bdi, r->lpa, r->phyaddr) != 0) {
-				bdbm_error ("bdbm_dftl_get_free_ppa failed");
-				bdbm_bug_on (1);
-			}
 
-			if (bdbm_dftl_map_lpa_to_ppa (bdi, r->lpa, r->phyaddr) != 0) {
-				bdbm_error ("bdbm_dftl_map_lpa_to_ppa failed");
-				bdbm_bug_on (1);
-			}
+		if (bdbm_dftl_get_free_ppa (bdi, r->logaddr.lpa[0], &r->phyaddr) != 0) {
+			bdbm_error ("bdbm_dftl_get_free_ppa failed");
+			bdbm_bug_on (1);
 		}
 	}
-
-	/* send write reqs to llm */
-	hlm_gc->req_type = REQTYPE_GC_WRITE;
-	hlm_gc->nr_done_reqs = 0;
-	hlm_gc->nr_reqs = nr_llm_reqs;
-	bdbm_sema_lock (&hlm_gc->gc_done);
-	for (i = 0; i < nr_llm_reqs; i++) {
+	if (nr_mapblks > 0)
+		__bdbm_dftl_gc_send (bdi, REQTYPE_GC_WRITE, 0, nr_mapblks);
+	for (i = 0; i < nr_mapblks; i++) {
 		bdbm_llm_req_t* r = &hlm_gc->llm_reqs[i];
-		if ((int64_t)r->lpa >= np->nr_pages_per_ssd || (int64_t)r->lpa < 0) {
-			/*bdbm_msg ("what??? %llu", r->lpa);*/
-			hlm_gc->nr_reqs--;
-			continue;
-		}
-		if ((bdi->ptr_llm_inf->make_req (bdi, &hlm_gc->llm_reqs[i])) != 0) {
-			bdbm_error ("llm_make_req failed");
-			bdbm_bug_on (1);
-		}
+		bdbm_dftl_update_dir_phyaddr (p->mt, DFTL_MAPBLK_ID (r->logaddr.lpa[0]), &r->phyaddr);
 	}
-	/*bdbm_msg ("gc-3");*/
-	bdbm_sema_lock (&hlm_gc->gc_done);
-	bdbm_sema_unlock (&hlm_gc->gc_done);
 
-	/* erase blocks */
+	/* data pages move their mapping entries in the order of lpas, so that 
+	 * each map page is updated once */
+	for (i = nr_mapblks; i < nr_llm_reqs; i++)
+		p->gc_order[i - nr_mapblks] = &hlm_gc->llm_reqs[i];
+	__bdbm_dftl_sort_by_lpa (p->gc_order, nr_llm_reqs - nr_mapblks);
+	for (i = 0; i < nr_llm_reqs - nr_mapblks; )
+		i = __bdbm_dftl_gc_remap_batch (bdi, i, nr_llm_reqs - nr_mapblks);
+	if (nr_llm_reqs > nr_mapblks)
+		__bdbm_dftl_gc_send (bdi, REQTYPE_GC_WRITE, nr_mapblks, nr_llm_reqs - nr_mapblks);
+
 erase_blks:
+	/* erase blocks */
 	for (i = 0; i < nr_gc_blks; i++) {
 		bdbm_abm_block_t* b = p->gc_bab[i];
 		bdbm_llm_req_t* r = &hlm_gc->llm_reqs[i];
 		r->req_type = REQTYPE_GC_ERASE;
-		r->lpa = -1ULL; /* lpa is not available now */
+		r->logaddr.lpa[0] = -1ULL; /* lpa is not available now */
+		r->phyaddr.channel_no = b->channel_no;
+		r->phyaddr.chip_no = b->chip_no;
+		r->phyaddr.block_no = b->block_no;
+		r->phyaddr.page_no = 0;
+		r->phyaddr.punit_id = BDBM_GET_PUNIT_ID (bdi, (&r->phyaddr));
 		r->ptr_hlm_req = (void*)hlm_gc;
-		r->phyaddr = &r->phyaddr_w;
-		r->phyaddr->channel_no = b->channel_no;
-		r->phyaddr->chip_no = b->chip_no;
-		r->phyaddr->block_no = b->block_no;
-		r->phyaddr->page_no = 0;
-		r->phyaddr->punit_id = BDBM_GET_PUNIT_ID (bdi, r->phyaddr);
 		r->ret = 0;
 	}
-
-	/* send erase reqs to llm */
-	hlm_gc->req_type = REQTYPE_GC_ERASE;
-	hlm_gc->nr_done_reqs = 0;
-	hlm_gc->nr_reqs = nr_gc_blks;
-	bdbm_sema_lock (&hlm_gc->gc_done);
-	for (i = 0; i < nr_gc_blks; i++) {
-		if ((bdi->ptr_llm_inf->make_req (bdi, &hlm_gc->llm_reqs[i])) != 0) {
-			bdbm_error ("llm_make_req failed");
-			bdbm_bug_on (1);
-		}
-	}
-	/*bdbm_msg ("gc-5");*/
-	bdbm_sema_lock (&hlm_gc->gc_done);
-	bdbm_sema_unlock (&hlm_gc->gc_done);
+	__bdbm_dftl_gc_send (bdi, REQTYPE_GC_ERASE, 0, nr_gc_blks);
 
 	/* FIXME: what happens if block erasure fails */
 	for (i = 0; i < nr_gc_blks; i++) {
@@ -750,17 +850,135 @@ erase_blks:
 	return 0;
 }
 
-/* for snapshot */
+/* for snapshot; only the GTD is kept in 'fn' (and the GTD journal), and map 
+ * pages are loaded from flash on demand after it */
 uint32_t bdbm_dftl_load (bdbm_drv_info_t* bdi, const char* fn)
 {
-	bdbm_warning ("bdbm_dftl_load is not implemented yet");
+	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+
+	/* step1: load abm */
+	if (bdbm_abm_load (p->bai, "/usr/share/bdbm_drv/abm.dat") != 0) {
+		bdbm_error ("bdbm_abm_load failed");
+		return 1;
+	}
+
+	/* step2: load the GTD */
+	if (bdbm_dftl_load_gtd (p->mt, fn) != 0) {
+		bdbm_error ("bdbm_dftl_load_gtd failed");
+		return 1;
+	}
+
+	/* step3: get active blocks */
+	if (__bdbm_dftl_get_active_blocks (np, p->bai, p->ac_bab) != 0) {
+		bdbm_error ("__bdbm_dftl_get_active_blocks failed");
+		return 1;
+	}
+	p->curr_puid = 0;
+	p->curr_page_ofs = 0;
+
+	return 0;
+}
+
+static void __bdbm_dftl_write_back_dirty_dirs (bdbm_drv_info_t* bdi)
+{
+	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
+	directory_slot_t* dirs[DFTL_GC_NR_MAPBLKS];
+	uint64_t i, n;
+
+	for (i = 0, n = 0; i < p->mt->nr_total_dir_slots; i++) {
+		if (p->mt->dir[i].status == DFTL_DIR_DIRTY)
+			dirs[n++] = &p->mt->dir[i];
+		if (n == DFTL_GC_NR_MAPBLKS || (n > 0 && i + 1 == p->mt->nr_total_dir_slots)) {
+			__bdbm_dftl_write_back_dirs (bdi, dirs, n);
+			n = 0;
+		}
+	}
+}
+
+/* does every punit have a free block for its active block */
+static uint8_t __bdbm_dftl_has_free_blocks (bdbm_drv_info_t* bdi)
+{
+	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	uint64_t i, j;
+
+	for (i = 0; i < np->nr_channels; i++) {
+		for (j = 0; j < np->nr_chips_per_channel; j++) {
+			if (bdbm_abm_get_nr_free_blocks_chip (p->bai, i, j) == 0)
+				return 0;
+		}
+	}
 	return 1;
 }
 
 uint32_t bdbm_dftl_store (bdbm_drv_info_t* bdi, const char* fn)
 {
-	bdbm_warning ("bdbm_dftl_store is not implemented yet");
-	return 1;
+	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	bdbm_abm_block_t* b = NULL;
+	uint64_t i, j, k, nr_free_blks;
+
+	/* step1: write back dirty map pages; the active blocks are given up 
+	 * below, so gc makes free blocks for new ones to be used after a load 
+	 * (gc may make map pages dirty again) */
+	for (;;) {
+		__bdbm_dftl_write_back_dirty_dirs (bdi);
+		if (__bdbm_dftl_has_free_blocks (bdi))
+			break;
+		nr_free_blks = bdbm_abm_get_nr_free_blocks (p->bai);
+		bdbm_dftl_do_gc (bdi, 0);
+		if (bdbm_abm_get_nr_free_blocks (p->bai) <= nr_free_blks) {
+			bdbm_warning ("no free blocks are left for active blocks");
+			break;
+		}
+	}
+
+	/* step2: make active blocks invalid (it's ugly!!!) */
+	while (1) {
+		/* get the channel & chip numbers */
+		i = p->curr_puid % np->nr_channels;
+		j = p->curr_puid / np->nr_channels;
+
+		/* get the physical offset of the active blocks */
+		b = p->ac_bab[i*np->nr_chips_per_channel + j];
+
+		/* invalidate remaining pages */
+		for (k = 0; k < np->nr_subpages_per_page; k++) {
+			bdbm_abm_invalidate_page (
+				p->bai, 
+				b->channel_no, 
+				b->chip_no, 
+				b->block_no, 
+				p->curr_page_ofs, 
+				k);
+		}
+		bdbm_bug_on (b->channel_no != i);
+		bdbm_bug_on (b->chip_no != j);
+
+		/* go to the next parallel unit */
+		if ((p->curr_puid + 1) == p->nr_punits) {
+			p->curr_puid = 0;
+			p->curr_page_ofs++;	/* go to the next page */
+
+			/* see if there are sufficient free pages or not */
+			if (p->curr_page_ofs == np->nr_pages_per_block) {
+				p->curr_page_ofs = 0;
+				break;
+			}
+		} else {
+			p->curr_puid++;
+		}
+	}
+
+	/* step3: store the GTD */
+	if (bdbm_dftl_store_gtd (p->mt, fn) != 0) {
+		bdbm_error ("bdbm_dftl_store_gtd failed");
+		return 1;
+	}
+
+	/* step4: store abm */
+	return bdbm_abm_store (p->bai, "/usr/share/bdbm_drv/abm.dat");
 }
 
 static void __bdbm_dftl_badblock_scan_eraseblks (
@@ -788,31 +1006,19 @@ static void __bdbm_dftl_badblock_scan_eraseblks (
 
 			r = &hlm_gc->llm_reqs[punit_id];
 			r->req_type = REQTYPE_GC_ERASE;
-			r->lpa = -1ULL; /* lpa is not available now */
+			r->logaddr.lpa[0] = -1ULL; /* lpa is not available now */
+			r->phyaddr.channel_no = b->channel_no;
+			r->phyaddr.chip_no = b->chip_no;
+			r->phyaddr.block_no = b->block_no;
+			r->phyaddr.page_no = 0;
+			r->phyaddr.punit_id = BDBM_GET_PUNIT_ID (bdi, (&r->phyaddr));
 			r->ptr_hlm_req = (void*)hlm_gc;
-			r->phyaddr = &r->phyaddr_w;
-			r->phyaddr->channel_no = b->channel_no;
-			r->phyaddr->chip_no = b->chip_no;
-			r->phyaddr->block_no = b->block_no;
-			r->phyaddr->page_no = 0;
-			r->phyaddr->punit_id = BDBM_GET_PUNIT_ID (bdi, r->phyaddr);
 			r->ret = 0;
 		}
 	}
 
 	/* send erase reqs to llm */
-	hlm_gc->req_type = REQTYPE_GC_ERASE;
-	hlm_gc->nr_done_reqs = 0;
-	hlm_gc->nr_reqs = p->nr_punits;
-	bdbm_sema_lock (&hlm_gc->gc_done);
-	for (i = 0; i < p->nr_punits; i++) {
-		if ((bdi->ptr_llm_inf->make_req (bdi, &hlm_gc->llm_reqs[i])) != 0) {
-			bdbm_error ("llm_make_req failed");
-			bdbm_bug_on (1);
-		}
-	}
-	bdbm_sema_lock (&hlm_gc->gc_done);
-	bdbm_sema_unlock (&hlm_gc->gc_done);
+	__bdbm_dftl_gc_send (bdi, REQTYPE_GC_ERASE, 0, p->nr_punits);
 
 	for (i = 0; i < p->nr_punits; i++) {
 		uint8_t ret = 0;
@@ -824,42 +1030,16 @@ static void __bdbm_dftl_badblock_scan_eraseblks (
 
 		bdbm_abm_erase_block (p->bai, b->channel_no, b->chip_no, b->block_no, ret);
 	}
-
-	/* measure gc elapsed time */
-}
-
-static void __bdbm_dftl_mark_it_dead (
-	bdbm_drv_info_t* bdi,
-	uint64_t block_no)
-{
-	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
-	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
-	int i, j;
-
-	for (i = 0; i < np->nr_channels; i++) {
-		for (j = 0; j < np->nr_chips_per_channel; j++) {
-			bdbm_abm_block_t* b = NULL;
-
-			if ((b = bdbm_abm_get_block (p->bai, i, j, block_no)) == NULL) {
-				bdbm_error ("oops! bdbm_abm_get_block failed");
-				bdbm_bug_on (1);
-			}
-
-			bdbm_abm_set_to_dirty_block (p->bai, i, j, block_no);
-		}
-	}
 }
 
-
 uint32_t bdbm_dftl_badblock_scan (bdbm_drv_info_t* bdi)
 {
-	/*#if 0*/
 	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
 	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
 	uint64_t i = 0;
 	uint32_t ret = 0;
 
-	bdbm_msg ("[WARNING] 'bdbm_page_badblock_scan' is called! All of the flash blocks will be erased!!!");
+	bdbm_msg ("[WARNING] 'bdbm_dftl_badblock_scan' is called! All of the flash blocks will be erased!!!");
 
 	/* step1: reset the page-level mapping table */
 	bdbm_msg ("step1: reset the page-level mapping table");
@@ -871,11 +1051,15 @@ uint32_t bdbm_dftl_badblock_scan (bdbm_drv_info_t* bdi)
 		__bdbm_dftl_badblock_scan_eraseblks (bdi, i);
 	}
 
-	/* step3: store abm */
+	/* step3: store abm and an empty GTD */
 	if ((ret = bdbm_abm_store (p->bai, "/usr/share/bdbm_drv/abm.dat"))) {
 		bdbm_error ("bdbm_abm_store failed");
 		return 1;
 	}
+	if ((ret = bdbm_dftl_store_gtd (p->mt, "/usr/share/bdbm_drv/ftl.dat"))) {
+		bdbm_error ("bdbm_dftl_store_gtd failed");
+		return 1;
+	}
 
 	/* step4: get active blocks */
 	bdbm_msg ("step2: get active blocks");
@@ -889,110 +1073,87 @@ uint32_t bdbm_dftl_badblock_scan (bdbm_drv_info_t* bdi)
 	bdbm_msg ("done");
 	 
 	return 0;
-	/*#endif*/
+}
 
-#if 0
-	/* TEMP: on-demand format */
-	bdbm_dftl_private_t* p = _ftl_dftl.ptr_private;
+/* for mapping blocks management */
+static bdbm_dftl_mapblk_req_t* __bdbm_dftl_create_mapblk_req (
+	bdbm_drv_info_t* bdi,
+	uint32_t req_type,
+	directory_slot_t* ds)
+{
 	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
-	uint64_t i = 0;
-	uint32_t ret = 0;
-	uint32_t erased_blocks = 0;
-
-	bdbm_msg ("[WARNING] 'bdbm_page_badblock_scan' is called! All of the flash blocks will be dirty!!!");
-
-	/* step1: reset the page-level mapping table */
-	bdbm_msg ("step1: reset the page-level mapping table");
-	bdbm_dftl_init_mapping_table (p->mt, np);
-
-	/* step2: erase all the blocks */
-	bdi->ptr_llm_inf->flush (bdi);
-	for (i = 0; i < np->nr_blocks_per_chip; i++) {
-		if (erased_blocks <= p->nr_punits)
-			__bdbm_dftl_badblock_scan_eraseblks (bdi, i);
-		else
-			__bdbm_dftl_mark_it_dead (bdi, i);
-		erased_blocks += np->nr_channels;
-	}
+	bdbm_dftl_mapblk_req_t* mr = NULL;
+	bdbm_llm_req_t* r = NULL;
+	uint64_t k;
 
-	/* step3: store abm */
-	if ((ret = bdbm_abm_store (p->bai, "/usr/share/bdbm_drv/abm.dat"))) {
-		bdbm_error ("bdbm_abm_store failed");
-		return 1;
+	/* a map page being loaded is released where llm finishes it */
+	if ((mr = (bdbm_dftl_mapblk_req_t*)bdbm_malloc_atomic 
+			(sizeof (bdbm_dftl_mapblk_req_t) + np->page_main_size)) == NULL) {
+		bdbm_error ("bdbm_malloc_atomic failed");
+		return NULL;
 	}
-
-	/* step4: get active blocks */
-	bdbm_msg ("step2: get active blocks");
-	if (__bdbm_dftl_get_active_blocks (np, p->bai, p->ac_bab) != 0) {
-		bdbm_error ("__bdbm_dftl_get_active_blocks failed");
-		return 1;
+	mr->ds = ds;
+	mr->me = (mapping_entry_t*)(mr + 1);
+	bdbm_sema_init (&mr->done);
+
+	/* build the parameters of the llm_req; map pages of different slots use
+	 * different keys, so llm does not order them after each other */
+	r = &mr->r;
+	r->req_type = req_type;
+	hlm_reqs_pool_reset_logaddr (&r->logaddr);
+	r->logaddr.lpa[0] = DFTL_MAPBLK_LPA (ds->id);
+	for (k = 0; k < NR_KPAGES_IN (np->page_main_size); k++) {
+		r->fmain.kp_stt[k] = KP_STT_DATA;
+		r->fmain.kp_ptr[k] = (uint8_t*)mr->me + k * KPAGE_SIZE;
 	}
-	p->curr_puid = 0;
-	p->curr_page_ofs = 0;
+	r->foob.data = (uint8_t*)mr->oob;
+	r->ptr_hlm_req = NULL;
+	r->done = &mr->done;
 
-	bdbm_msg ("[summary] Total: %llu, Free: %llu, Clean: %llu, Dirty: %llu",
-		bdbm_abm_get_nr_total_blocks (p->bai),
-		bdbm_abm_get_nr_free_blocks (p->bai),
-		bdbm_abm_get_nr_clean_blocks (p->bai),
-		bdbm_abm_get_nr_dirty_blocks (p->bai)
-	);
-#endif
-	bdbm_msg ("done");
-	 
-	return 0;
+	return mr;
+}
 
+static void __bdbm_dftl_destroy_mapblk_req (
+	bdbm_dftl_mapblk_req_t* mr)
+{
+	bdbm_sema_free (&mr->done);
+	bdbm_free_atomic (mr);
 }
 
-/* for mapping blocks management */
 uint8_t bdbm_dftl_check_mapblk (
 	bdbm_drv_info_t* bdi,
 	uint64_t lpa)
 {
 	bdbm_dftl_private_t* p = (bdbm_dftl_private_t*)BDBM_FTL_PRIV (bdi);
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+
+	/* get_ppa and map_lpa_to_ppa report lpas beyond logical space */
+	if (lpa >= np->nr_subpages_per_ssd)
+		return 0;
 
 	return bdbm_dftl_check_mapping_entry (p->mt, lpa);
 }
 
 bdbm_llm_req_t* bdbm_dftl_prepare_mapblk_load (
 	bdbm_drv_info_t* bdi,
-	uint64_t lpa)
+	uint64_t lpa,
+	bdbm_mapblk_waiter_t* w)
 {
 	bdbm_dftl_private_t* p = (bdbm_dftl_private_t*)BDBM_FTL_PRIV (bdi);
-	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
-	mapping_entry_t* me = NULL;
+	bdbm_dftl_mapblk_req_t* mr = NULL;
 	directory_slot_t* ds = NULL;
-	bdbm_llm_req_t* r = NULL;
-	uint32_t nr_kp_per_fp = np->page_main_size / KERNEL_PAGE_SIZE;
-	uint32_t i;
 
-	/* is there a victim mapblk to evict to flash */
-	if ((ds = bdbm_dftl_missing_dir_prepare (p->mt, lpa)) == NULL) {
-		/* there are enough space to keep in-memory mapping entries */
+	/* is there a map page to load from flash; w waits for it */
+	if ((ds = bdbm_dftl_missing_dir_prepare (p->mt, lpa, w)) == NULL) {
+		/* it is in DRAM or is being loaded by someone else */
 		return NULL;
 	}
 
-	/* create a hlm_req that stores mapping entries */
-	r = (bdbm_llm_req_t*)bdbm_malloc(sizeof (bdbm_llm_req_t));
-	r->pptr_kpgs = (uint8_t**)bdbm_malloc(sizeof (uint8_t*) * nr_kp_per_fp);
-	me = (mapping_entry_t*)bdbm_malloc(
-			(sizeof (mapping_entry_t) * p->mt->nr_entires_per_dir_slot));
-	bdbm_bug_on ((sizeof (mapping_entry_t) * p->mt->nr_entires_per_dir_slot) != 4096);
-	for (i = 0; i < nr_kp_per_fp; i++)
-		r->pptr_kpgs[i] = (uint8_t*)(me) + (i * KERNEL_PAGE_SIZE);
-
-	/* build the parameters of the hlm_req */
-	r->req_type = REQTYPE_META_READ;
-	r->lpa = -2ULL;	/* not available for mapblks */
-	r->phyaddr_r = ds->phyaddr;
-	r->phyaddr_w = ds->phyaddr;
-	r->phyaddr = &r->phyaddr_r;
-	r->ds = (void*)ds;
-	r->ptr_hlm_req = (void*)NULL;
-	r->ptr_oob = (uint8_t*)bdbm_malloc(sizeof (uint8_t) * np->page_oob_size);
-
-	r->done = NULL;
-	r->done = (bdbm_sema_t*)bdbm_malloc(sizeof (bdbm_sema_t));
-	bdbm_sema_init (r->done);
+	if ((mr = __bdbm_dftl_create_mapblk_req (bdi, REQTYPE_META_READ, ds)) == NULL) {
+		bdbm_bug_on (1);
+		return NULL;
+	}
+	mr->r.phyaddr = ds->phyaddr;
 
 #ifdef DFTL_DEBUG
 	bdbm_msg ("[dftl] [Fetch] lpa: %llu dir: %llu (phyaddr: %llu %lld %lld %lld %lld)", 
@@ -1005,7 +1166,7 @@ bdbm_llm_req_t* bdbm_dftl_prepare_mapblk_load (
 		ds->phyaddr.page_no);
 #endif
 	/* ok! return it */
-	return r;
+	return &mr->r;
 }
 
 void bdbm_dftl_finish_mapblk_load (
@@ -1013,108 +1174,80 @@ void bdbm_dftl_finish_mapblk_load (
 	bdbm_llm_req_t* r)
 {
 	bdbm_dftl_private_t* p = (bdbm_dftl_private_t*)BDBM_FTL_PRIV (bdi);
-	directory_slot_t* ds = (directory_slot_t*)r->ds;
-	mapping_entry_t* me = NULL;
-
-	/* copy mapping entries to ds */
-	me = (mapping_entry_t*)r->pptr_kpgs[0];
-
-	if (((int64_t*)r->ptr_oob)[0] != -2LL) {
-		/*
-		bdbm_msg ("---------------------------------------------------------------------");
-		bdbm_warning ("oob is not match: %lld", ((int64_t*)r->ptr_oob)[0]);
-		bdbm_warning ("lpa: %lld", r->lpa);
-		bdbm_warning ("dir: %llu (phyaddr: %llu %lld %lld %lld %lld)", 
-			ds->id,
-			ds->phyaddr.punit_id,
-			ds->phyaddr.channel_no,
-			ds->phyaddr.chip_no,
-			ds->phyaddr.block_no,
-			ds->phyaddr.page_no);
-		bdbm_warning ("flash-dir: %lld", ((int64_t*)r->ptr_oob)[1]);
-		bdbm_msg ("---------------------------------------------------------------------");
-		*/
-
-		bdbm_dftl_missing_dir_done_error (p->mt, ds, me);
-	} else {
-		/* finish the load */
-		bdbm_dftl_missing_dir_done (p->mt, ds, me);
+	bdbm_dftl_mapblk_req_t* mr = (bdbm_dftl_mapblk_req_t*)r;
+	directory_slot_t* ds = mr->ds;
+
+	/* the page must be the map page of ds */
+	if (r->ret != 0 || mr->oob[0] != DFTL_MAPBLK_LPA (ds->id)) {
+		bdbm_error ("the map page of dir %llu is broken (ret: %u, oob: %lld)", 
+			ds->id, r->ret, mr->oob[0]);
+		bdbm_bug_on (1);
 	}
 
-	/* remove a llm_req */
-	bdbm_free(r->ptr_oob);
-	bdbm_free(r->done);
-	bdbm_free(me); /* free an array of mapblks */
-	bdbm_free(r->pptr_kpgs); /* free pptr_kpgs */
-	bdbm_free(r);
+	/* finish the load */
+	bdbm_dftl_missing_dir_done (p->mt, ds, mr->me);
+	__bdbm_dftl_destroy_mapblk_req (mr);
 
 #ifdef DFTL_DEBUG
 	bdbm_msg ("[dftl] [Fetch] dir: %llu (done)\n", ds->id);
 #endif
 }
 
-bdbm_llm_req_t* bdbm_dftl_prepare_mapblk_eviction (
-	bdbm_drv_info_t* bdi)
+/* build a llm_req that writes back a slot taken out of DRAM; a clean one is 
+ * the same as its copy in flash, so it is just dropped and NULL is returned */
+static bdbm_llm_req_t* __bdbm_dftl_prepare_dir_eviction (
+	bdbm_drv_info_t* bdi,
+	directory_slot_t* ds)
 {
 	bdbm_dftl_private_t* p = (bdbm_dftl_private_t*)BDBM_FTL_PRIV (bdi);
-	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
-	mapping_entry_t* me = NULL;
-	directory_slot_t* ds = NULL;
-	bdbm_llm_req_t* r = NULL;
-	uint32_t nr_kp_per_fp = np->page_main_size / KERNEL_PAGE_SIZE;
-	uint32_t i;
+	bdbm_dftl_mapblk_req_t* mr = NULL;
 
-	/* is there a victim mapblk to evict to flash */
-	if ((ds = bdbm_dftl_prepare_victim_mapblk (p->mt)) == NULL) {
-		/* there are enough space to keep in-memory mapping entries */
+	if (ds->status == DFTL_DIR_CLEAN) {
+		bdbm_dftl_finish_victim_mapblk (p->mt, ds);
 		return NULL;
 	}
 
-	/* create a hlm_req that stores mapping entries */
-	r = (bdbm_llm_req_t*)bdbm_malloc(sizeof (bdbm_llm_req_t));
-	r->pptr_kpgs = (uint8_t**)bdbm_malloc(sizeof (uint8_t*) * nr_kp_per_fp);
-	me = (mapping_entry_t*)bdbm_malloc(
-			(sizeof (mapping_entry_t) * p->mt->nr_entires_per_dir_slot));
-	bdbm_bug_on ((sizeof (mapping_entry_t) * p->mt->nr_entires_per_dir_slot) != 4096);
-	for (i = 0; i < nr_kp_per_fp; i++)
-		r->pptr_kpgs[i] = (uint8_t*)(me) + (i * KERNEL_PAGE_SIZE);
-
-	/* build the parameters of the hlm_req */
-	r->req_type = REQTYPE_META_WRITE;
-	r->lpa = -2ULL;	/* not available for me */
-	r->phyaddr = &r->phyaddr_w;
-	r->ds = (void*)ds;
-	if (ds->status != DFTL_DIR_CLEAN) {
-		bdbm_dftl_get_free_ppa (bdi, r->lpa, r->phyaddr); /* get a new page */
-	} else {
-		/* if ds->status is not dirty, 
-		 * we don't need to write it to NAND flash */
+	/* create a llm_req that stores mapping entries */
+	if ((mr = __bdbm_dftl_create_mapblk_req (bdi, REQTYPE_META_WRITE, ds)) == NULL) {
+		bdbm_bug_on (1);
+		return NULL;
 	}
-	r->phyaddr_r = r->phyaddr_w;
-	for (i = 0; i < p->mt->nr_entires_per_dir_slot; i++)
-		me[i] = ds->me[i];
-	r->ptr_oob = (uint8_t*)bdbm_malloc(np->page_oob_size);
-	r->ptr_hlm_req = (void*)NULL;
-	((int64_t*)r->ptr_oob)[0] = -2LL; /* magic # */
-	((int64_t*)r->ptr_oob)[1] = ds->id; /* ds ID */
-
-	r->done = NULL;
-	r->done = (bdbm_sema_t*)bdbm_malloc(sizeof (bdbm_sema_t));
-	bdbm_sema_init (r->done);
+	if (bdbm_dftl_get_free_ppa (bdi, mr->r.logaddr.lpa[0], &mr->r.phyaddr) != 0) {
+		bdbm_error ("bdbm_dftl_get_free_ppa failed");
+		bdbm_bug_on (1);
+	}
+	bdbm_memcpy (mr->me, ds->me, 
+		sizeof (mapping_entry_t) * p->mt->nr_entires_per_dir_slot);
+	mr->oob[0] = DFTL_MAPBLK_LPA (ds->id);
 
 #ifdef DFTL_DEBUG
-	if (ds->status != DFTL_DIR_CLEAN) {
-		bdbm_msg ("[dftl] [Evict] dir: %llu (phyaddr: %llu %lld %lld %lld %lld)", 
-			ds->id,
-			r->phyaddr->punit_id,
-			r->phyaddr->channel_no,
-			r->phyaddr->chip_no,
-			r->phyaddr->block_no,
-			r->phyaddr->page_no);
-	}
+	bdbm_msg ("[dftl] [Evict] dir: %llu (phyaddr: %llu %lld %lld %lld %lld)", 
+		ds->id,
+		mr->r.phyaddr.punit_id,
+		mr->r.phyaddr.channel_no,
+		mr->r.phyaddr.chip_no,
+		mr->r.phyaddr.block_no,
+		mr->r.phyaddr.page_no);
 #endif
 	/* ok! return it */
-	return r;
+	return &mr->r;
+}
+
+bdbm_llm_req_t* bdbm_dftl_prepare_mapblk_eviction (
+	bdbm_drv_info_t* bdi)
+{
+	bdbm_dftl_private_t* p = (bdbm_dftl_private_t*)BDBM_FTL_PRIV (bdi);
+	bdbm_llm_req_t* r = NULL;
+	directory_slot_t* ds = NULL;
+
+	/* is there a victim mapblk to evict to flash */
+	while ((ds = bdbm_dftl_prepare_victim_mapblk (p->mt)) != NULL) {
+		if ((r = __bdbm_dftl_prepare_dir_eviction (bdi, ds)) != NULL)
+			return r;
+	}
+
+	/* there are enough space to keep in-memory mapping entries */
+	return NULL;
 }
 
 void bdbm_dftl_finish_mapblk_eviction (
@@ -1122,39 +1255,33 @@ void bdbm_dftl_finish_mapblk_eviction (
 	bdbm_llm_req_t* r)
 {
 	bdbm_dftl_private_t* p = (bdbm_dftl_private_t*)BDBM_FTL_PRIV (bdi);
-	directory_slot_t* ds = (directory_slot_t*)r->ds;
-	mapping_entry_t* me = (mapping_entry_t*)r->pptr_kpgs[0];
+	bdbm_dftl_mapblk_req_t* mr = (bdbm_dftl_mapblk_req_t*)r;
+	directory_slot_t* ds = mr->ds;
 
 	/* invalidate an old page if ds was kept in flash before */
-	if (ds->status != DFTL_DIR_CLEAN) {
-		if (ds->phyaddr.channel_no != DFTL_PAGE_INVALID_ADDR) {
+	if (ds->phyaddr.channel_no != DFTL_PAGE_INVALID_ADDR) {
 #ifdef DFTL_DEBUG
-			bdbm_msg ("[dftl] [Evict] dir: %llu (invalidate: %lld %lld %lld %lld)", 
-				ds->id,
-				ds->phyaddr.channel_no, 
-				ds->phyaddr.chip_no,
-				ds->phyaddr.block_no,
-				ds->phyaddr.page_no);
+		bdbm_msg ("[dftl] [Evict] dir: %llu (invalidate: %lld %lld %lld %lld)", 
+			ds->id,
+			ds->phyaddr.channel_no, 
+			ds->phyaddr.chip_no,
+			ds->phyaddr.block_no,
+			ds->phyaddr.page_no);
 #endif
-			bdbm_abm_invalidate_page (
-				p->bai, 
-				ds->phyaddr.channel_no, 
-				ds->phyaddr.chip_no,
-				ds->phyaddr.block_no,
-				ds->phyaddr.page_no
-			);
-		}
+		bdbm_abm_invalidate_page (
+			p->bai, 
+			ds->phyaddr.channel_no, 
+			ds->phyaddr.chip_no,
+			ds->phyaddr.block_no,
+			ds->phyaddr.page_no,
+			0
+		);
 	}
 
 	/* finish the eviction */
-	bdbm_dftl_finish_victim_mapblk (p->mt, ds, r->phyaddr);
-
-	/* remove a llm_req */
-	bdbm_free(r->done);
-	bdbm_free(r->ptr_oob);
-	bdbm_free(me);
-	bdbm_free(r->pptr_kpgs); /* free pptr_kpgs */
-	bdbm_free(r);
+	bdbm_dftl_update_dir_phyaddr (p->mt, ds->id, &r->phyaddr);
+	bdbm_dftl_finish_victim_mapblk (p->mt, ds);
+	__bdbm_dftl_destroy_mapblk_req (mr);
 
 #ifdef DFTL_DEBUG
 	bdbm_msg ("[dftl] [Evict] dir: %llu (done)\n", ds->id);
@@ -29,26 +29,30 @@ extern bdbm_ftl_inf_t _ftl_dftl;
 
 uint32_t bdbm_dftl_create (bdbm_drv_info_t* bdi);
 void bdbm_dftl_destroy (bdbm_drv_info_t* bdi);
-uint32_t bdbm_dftl_get_free_ppa (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_phyaddr_t* ppa);
-uint32_t bdbm_dftl_get_ppa (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_phyaddr_t* ppa);
-uint32_t bdbm_dftl_map_lpa_to_ppa (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_phyaddr_t* ptr_phyaddr);
-uint32_t bdbm_dftl_invalidate_lpa (bdbm_drv_info_t* bdi, uint64_t lpa, uint64_t len);
-uint8_t bdbm_dftl_is_gc_needed (bdbm_drv_info_t* bdi);
-uint32_t bdbm_dftl_do_gc (bdbm_drv_info_t* bdi);
+uint32_t bdbm_dftl_get_free_ppa (bdbm_drv_info_t* bdi, int64_t lpa, bdbm_phyaddr_t* ppa);
+uint32_t bdbm_dftl_get_ppa (bdbm_drv_info_t* bdi, int64_t lpa, bdbm_phyaddr_t* ppa, uint64_t* sp_off);
+uint32_t bdbm_dftl_map_lpa_to_ppa (bdbm_drv_info_t* bdi, bdbm_logaddr_t* logaddr, bdbm_phyaddr_t* ppa);
+uint32_t bdbm_dftl_invalidate_lpa (bdbm_drv_info_t* bdi, int64_t lpa, uint64_t len);
+uint8_t bdbm_dftl_is_gc_needed (bdbm_drv_info_t* bdi, int64_t lpa);
+uint32_t bdbm_dftl_do_gc (bdbm_drv_info_t* bdi, int64_t lpa);
+void bdbm_dftl_get_free_space (bdbm_drv_info_t* bdi, uint64_t* nr_free_blks, uint64_t* nr_total_blks);
 
 uint32_t bdbm_dftl_badblock_scan (bdbm_drv_info_t* bdi);
 uint32_t bdbm_dftl_load (bdbm_drv_info_t* bdi, const char* fn);
 uint32_t bdbm_dftl_store (bdbm_drv_info_t* bdi, const char* fn);
 
+/* map pages are read and written by llm reqs that prepare_* returns. For 
+ * an eviction, a caller locks r->done before sending r to llm, waits for 
+ * r->done, and then hands r to finish_*, which releases it. A load is 
+ * handed to finish_* when llm finishes it, and it wakes up the waiters of 
+ * the map page; prepare_mapblk_load returns NULL if a read is not needed.
+ * Misses on a map page being evicted wait until its eviction finishes, and 
+ * then it is kept in DRAM */
 uint8_t bdbm_dftl_check_mapblk (bdbm_drv_info_t* bdi, uint64_t lpa);
 bdbm_llm_req_t* bdbm_dftl_prepare_mapblk_eviction (bdbm_drv_info_t* bdi);
 void bdbm_dftl_finish_mapblk_eviction (bdbm_drv_info_t* bdi, bdbm_llm_req_t* r);
-bdbm_llm_req_t* bdbm_dftl_prepare_mapblk_load (bdbm_drv_info_t* bdi, uint64_t lpa);
+bdbm_llm_req_t* bdbm_dftl_prepare_mapblk_load (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_mapblk_waiter_t* w);
 void bdbm_dftl_finish_mapblk_load (bdbm_drv_info_t* bdi, bdbm_llm_req_t* r);
 
-void bdbm_dftl_finish_mapblk_load_2 (
-	bdbm_drv_info_t* bdi, 
-	bdbm_llm_req_t* r);
-
 #endif /* _BLUEDBM_FTL_DFTL_H */
 
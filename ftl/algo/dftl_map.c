@@ -42,12 +42,381 @@ THE SOFTWARE.
 #include "debug.h"
 #include "utime.h"
 #include "ufile.h"
+#include "umemory.h"
+#include "uthread.h"
 
 #include "algo/abm.h"
 #include "algo/dftl_map.h"
 
+/* 
+ * replacement policies for directory slots kept in DRAM 
+ */
+static struct list_head* __dftl_cache_list (dftl_cache_t* c, uint8_t q)
+{
+	switch (q) {
+	case DFTL_CACHE_Q_T1: return &c->t1_list;
+	case DFTL_CACHE_Q_T2: return &c->t2_list;
+	case DFTL_CACHE_Q_B1: return &c->b1_list;
+	case DFTL_CACHE_Q_B2: return &c->b2_list;
+	default: break;
+	}
+	return NULL;
+}
+
+static uint64_t* __dftl_cache_nr (dftl_cache_t* c, uint8_t q)
+{
+	switch (q) {
+	case DFTL_CACHE_Q_T1: return &c->nr_t1;
+	case DFTL_CACHE_Q_T2: return &c->nr_t2;
+	case DFTL_CACHE_Q_B1: return &c->nr_b1;
+	case DFTL_CACHE_Q_B2: return &c->nr_b2;
+	default: break;
+	}
+	return NULL;
+}
+
+static void __dftl_cache_del (dftl_cache_t* c, directory_slot_t* ds)
+{
+	if (ds->cache_q == DFTL_CACHE_Q_NONE)
+		return;
+	list_del (&ds->list);
+	(*__dftl_cache_nr (c, ds->cache_q))--;
+	ds->cache_q = DFTL_CACHE_Q_NONE;
+}
+
+static void __dftl_cache_add_tail (dftl_cache_t* c, directory_slot_t* ds, uint8_t q)
+{
+	__dftl_cache_del (c, ds);
+	list_add_tail (&ds->list, __dftl_cache_list (c, q));
+	(*__dftl_cache_nr (c, q))++;
+	ds->cache_q = q;
+}
+
+static directory_slot_t* __dftl_cache_head (dftl_cache_t* c, uint8_t q)
+{
+	struct list_head* l = __dftl_cache_list (c, q);
+	if (list_empty (l))
+		return NULL;
+	return list_entry (l->next, directory_slot_t, list);
+}
+
+static void __dftl_cache_init (dftl_cache_t* c, uint32_t cache_policy, uint64_t max_slots)
+{
+	INIT_LIST_HEAD (&c->t1_list);
+	INIT_LIST_HEAD (&c->t2_list);
+	INIT_LIST_HEAD (&c->b1_list);
+	INIT_LIST_HEAD (&c->b2_list);
+	c->nr_t1 = c->nr_t2 = c->nr_b1 = c->nr_b2 = 0;
+	c->cache_policy = cache_policy;
+	if (c->cache_policy == DFTL_CACHE_POLICY_CLOCK_PRO)
+		c->target_t1 = (max_slots > 1) ? max_slots / 2 : 1;
+	else
+		c->target_t1 = 0;
+	atomic64_set (&c->nr_hits, 0);
+	atomic64_set (&c->nr_misses, 0);
+	atomic64_set (&c->nr_evictions, 0);
+	atomic64_set (&c->nr_coalesced, 0);
+}
+
+static void __dftl_cache_empty (dftl_cache_t* c)
+{
+	directory_slot_t* ds = NULL;
+	uint8_t q;
+
+	for (q = DFTL_CACHE_Q_T1; q <= DFTL_CACHE_Q_B2; q++) {
+		while ((ds = __dftl_cache_head (c, q)) != NULL)
+			__dftl_cache_del (c, ds);
+	}
+}
+
+/* a directory slot becomes resident in DRAM */
+static void __dftl_cache_insert (dftl_mapping_table_t* mt, directory_slot_t* ds)
+{
+	dftl_cache_t* c = &mt->cache;
+	uint64_t delta;
+
+	switch (c->cache_policy) {
+	case DFTL_CACHE_POLICY_2Q:
+		/* re-referenced after leaving A1in: it goes to Am */
+		if (ds->cache_q == DFTL_CACHE_Q_B1)
+			__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T2);
+		else
+			__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T1);
+		break;
+
+	case DFTL_CACHE_POLICY_ARC:
+		if (ds->cache_q == DFTL_CACHE_Q_B1) {
+			delta = (c->nr_b2 > c->nr_b1) ? c->nr_b2 / c->nr_b1 : 1;
+			c->target_t1 += delta;
+			if (c->target_t1 > mt->max_cached_dir_slots)
+				c->target_t1 = mt->max_cached_dir_slots;
+			__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T2);
+		} else if (ds->cache_q == DFTL_CACHE_Q_B2) {
+			delta = (c->nr_b1 > c->nr_b2) ? c->nr_b1 / c->nr_b2 : 1;
+			c->target_t1 = (c->target_t1 > delta) ? c->target_t1 - delta : 0;
+			__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T2);
+		} else {
+			__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T1);
+		}
+		break;
+
+	case DFTL_CACHE_POLICY_CLOCK_PRO:
+		ds->ref = 0;
+		if (ds->cache_q == DFTL_CACHE_Q_B1) {
+			/* re-accessed during its test period: more room for cold pages */
+			if (c->target_t1 < mt->max_cached_dir_slots)
+				c->target_t1++;
+			ds->in_test = 0;
+			__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T2);
+		} else {
+			ds->in_test = 1;
+			__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T1);
+		}
+		break;
+
+	case DFTL_CACHE_POLICY_LRU:
+	default:
+		__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T1);
+		break;
+	}
+}
+
+/* a resident directory slot is referenced */
+static void __dftl_cache_touch (dftl_mapping_table_t* mt, directory_slot_t* ds)
+{
+	dftl_cache_t* c = &mt->cache;
+
+	/* a victim being evicted is not kept in any list */
+	if (ds->cache_q != DFTL_CACHE_Q_T1 && ds->cache_q != DFTL_CACHE_Q_T2)
+		return;
+
+	switch (c->cache_policy) {
+	case DFTL_CACHE_POLICY_2Q:
+		/* correlated references to A1in are ignored */
+		if (ds->cache_q == DFTL_CACHE_Q_T2)
+			__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T2);
+		break;
+	case DFTL_CACHE_POLICY_ARC:
+		__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T2);
+		break;
+	case DFTL_CACHE_POLICY_CLOCK_PRO:
+		ds->ref = 1;
+		break;
+	case DFTL_CACHE_POLICY_LRU:
+	default:
+		__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T1);
+		break;
+	}
+}
+
+/* drop the oldest ghost entries so that a ghost list keeps at most 'limit' slots */
+static void __dftl_cache_trim_ghost (dftl_cache_t* c, uint8_t q, uint64_t limit)
+{
+	directory_slot_t* ds = NULL;
+
+	while (*__dftl_cache_nr (c, q) > limit) {
+		ds = __dftl_cache_head (c, q);
+		__dftl_cache_del (c, ds);
+		if (c->cache_policy == DFTL_CACHE_POLICY_CLOCK_PRO) {
+			/* its test period is over without a re-access */
+			if (c->target_t1 > 1)
+				c->target_t1--;
+		}
+	}
+}
 
-dftl_mapping_table_t* bdbm_dftl_create_mapping_table (bdbm_device_params_t* np)
+static directory_slot_t* __dftl_cache_victim_clock_pro (dftl_mapping_table_t* mt)
+{
+	dftl_cache_t* c = &mt->cache;
+	directory_slot_t* ds = NULL;
+	uint64_t max_hot = mt->max_cached_dir_slots - c->target_t1;
+
+	for (;;) {
+		/* HAND-hot: demote hot slots that have not been referenced */
+		while (c->nr_t2 > max_hot || (c->nr_t1 == 0 && c->nr_t2 > 0)) {
+			ds = __dftl_cache_head (c, DFTL_CACHE_Q_T2);
+			if (ds->ref && c->nr_t1 > 0) {
+				ds->ref = 0;
+				__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T2);
+			} else {
+				ds->ref = 0;
+				ds->in_test = 0;
+				__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T1);
+				break;
+			}
+		}
+
+		/* HAND-cold: find a cold slot without a reference */
+		if ((ds = __dftl_cache_head (c, DFTL_CACHE_Q_T1)) == NULL)
+			return NULL;
+
+		if (ds->ref) {
+			ds->ref = 0;
+			if (ds->in_test) {
+				/* re-referenced in its test period: it becomes hot */
+				ds->in_test = 0;
+				__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T2);
+			} else {
+				ds->in_test = 1;
+				__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_T1);
+			}
+			continue;
+		}
+
+		__dftl_cache_del (c, ds);
+		if (ds->in_test) {
+			/* keep it as a non-resident cold slot until its test period ends */
+			__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_B1);
+			__dftl_cache_trim_ghost (c, DFTL_CACHE_Q_B1, mt->max_cached_dir_slots);
+		}
+		return ds;
+	}
+}
+
+/* choose a resident directory slot to evict; it is detached from resident lists */
+static directory_slot_t* __dftl_cache_victim (dftl_mapping_table_t* mt)
+{
+	dftl_cache_t* c = &mt->cache;
+	directory_slot_t* ds = NULL;
+	uint64_t max_slots = mt->max_cached_dir_slots;
+
+	switch (c->cache_policy) {
+	case DFTL_CACHE_POLICY_2Q:
+		/* Kin = 25% and Kout = 50% of the cache */
+		if (c->nr_t1 > 0 && (c->nr_t1 > max_slots / 4 || c->nr_t2 == 0)) {
+			ds = __dftl_cache_head (c, DFTL_CACHE_Q_T1);
+			__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_B1);
+			__dftl_cache_trim_ghost (c, DFTL_CACHE_Q_B1, max_slots / 2);
+		} else {
+			ds = __dftl_cache_head (c, DFTL_CACHE_Q_T2);
+			__dftl_cache_del (c, ds);
+		}
+		break;
+
+	case DFTL_CACHE_POLICY_ARC:
+		if (c->nr_t1 > 0 && (c->nr_t1 > c->target_t1 || c->nr_t2 == 0)) {
+			ds = __dftl_cache_head (c, DFTL_CACHE_Q_T1);
+			__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_B1);
+		} else {
+			ds = __dftl_cache_head (c, DFTL_CACHE_Q_T2);
+			__dftl_cache_add_tail (c, ds, DFTL_CACHE_Q_B2);
+		}
+		/* |T1| + |B1| <= c and |T1| + |T2| + |B1| + |B2| <= 2c */
+		__dftl_cache_trim_ghost (c, DFTL_CACHE_Q_B1, 
+			(max_slots > c->nr_t1) ? max_slots - c->nr_t1 : 0);
+		__dftl_cache_trim_ghost (c, DFTL_CACHE_Q_B2, 
+			2 * max_slots - (c->nr_t1 + c->nr_t2 + c->nr_b1));
+		break;
+
+	case DFTL_CACHE_POLICY_CLOCK_PRO:
+		ds = __dftl_cache_victim_clock_pro (mt);
+		break;
+
+	case DFTL_CACHE_POLICY_LRU:
+	default:
+		ds = __dftl_cache_head (c, DFTL_CACHE_Q_T1);
+		__dftl_cache_del (c, ds);
+		break;
+	}
+
+	bdbm_bug_on (ds == NULL);
+	atomic64_inc (&c->nr_evictions);
+
+	return ds;
+}
+
+void bdbm_dftl_display_cache_stat (dftl_mapping_table_t* mt)
+{
+	dftl_cache_t* c = &mt->cache;
+	uint64_t nr_hits = atomic64_read (&c->nr_hits);
+	uint64_t nr_misses = atomic64_read (&c->nr_misses);
+	uint64_t nr_lookups = nr_hits + nr_misses;
+	uint64_t hit_ratio = 0;
+
+	if (nr_lookups > 0)
+		hit_ratio = (nr_hits * 10000) / nr_lookups;
+
+	bdbm_msg ("DFTL: cache policy: %u (1: LRU, 2: 2Q, 3: ARC, 4: CLOCK-Pro)", c->cache_policy);
+	bdbm_msg ("DFTL: lookups: %llu, hits: %llu, misses: %llu, evictions: %lld",
+		nr_lookups, nr_hits, nr_misses, atomic64_read (&c->nr_evictions));
+	bdbm_msg ("DFTL: hit ratio: %llu.%02llu%%", hit_ratio / 100, hit_ratio % 100);
+	bdbm_msg ("DFTL: misses on map pages being loaded: %lld", atomic64_read (&c->nr_coalesced));
+}
+
+/* 
+ * pending misses: a map page is read from flash only once, and all the 
+ * requests that miss on it wait for that read 
+ */
+static void __dftl_miss_group_wakeup (void* arg)
+{
+	dftl_miss_group_t* g = (dftl_miss_group_t*)arg;
+
+	if (atomic64_dec_and_test (&g->nr_pending))
+		bdbm_sema_unlock (&g->done);
+}
+
+void bdbm_dftl_miss_group_init (dftl_miss_group_t* g)
+{
+	bdbm_sema_init (&g->done);
+	bdbm_sema_lock (&g->done);
+	atomic64_set (&g->nr_pending, 1); /* dropped by bdbm_dftl_miss_group_wait */
+}
+
+void bdbm_dftl_miss_group_add (dftl_miss_group_t* g, bdbm_mapblk_waiter_t* w)
+{
+	atomic64_inc (&g->nr_pending);
+	w->wakeup = __dftl_miss_group_wakeup;
+	w->arg = (void*)g;
+}
+
+void bdbm_dftl_miss_group_wait (dftl_miss_group_t* g)
+{
+	if (!atomic64_dec_and_test (&g->nr_pending)) {
+		/* wait until the last waiter is woken up */
+		bdbm_sema_lock (&g->done);
+	}
+	bdbm_sema_unlock (&g->done);
+	bdbm_sema_free (&g->done);
+}
+
+/* wake up all the waiters of ds; mt->lock must be held by a caller */
+static void __dftl_complete_pending_miss (
+	dftl_mapping_table_t* mt, 
+	directory_slot_t* ds)
+{
+	dftl_pending_miss_t* pm = NULL;
+	struct list_head* next, *temp;
+
+	ds->is_under_load = 0;
+	HASH_FIND (hh, mt->pending_misses, &ds->id, sizeof (uint64_t), pm);
+	if (pm == NULL)
+		return;
+	HASH_DEL (mt->pending_misses, pm);
+
+	list_for_each_safe (next, temp, &pm->waiters) {
+		bdbm_mapblk_waiter_t* w = list_entry (next, bdbm_mapblk_waiter_t, list);
+		list_del (&w->list);
+		w->wakeup (w->arg);
+	}
+	bdbm_free_atomic (pm);
+}
+
+static void __dftl_clear_pending_misses (dftl_mapping_table_t* mt)
+{
+	dftl_pending_miss_t* pm = NULL, *tmp = NULL;
+
+	/* pending misses must be finished before; remove them just in case */
+	HASH_ITER (hh, mt->pending_misses, pm, tmp) {
+		bdbm_warning ("a pending miss for dir %llu is not finished", pm->id);
+		HASH_DEL (mt->pending_misses, pm);
+		bdbm_free_atomic (pm);
+	}
+}
+
+
+dftl_mapping_table_t* bdbm_dftl_create_mapping_table (
+	bdbm_device_params_t* np, 
+	uint32_t cache_policy)
 {
 	dftl_mapping_table_t* mt = NULL;
 	uint64_t i;
@@ -57,14 +426,25 @@ dftl_mapping_table_t* bdbm_dftl_create_mapping_table (bdbm_device_params_t* np)
 			(sizeof (dftl_mapping_table_t))) == NULL) {
 		return NULL;
 	}
-	INIT_LIST_HEAD (&mt->lru_list);
 	mt->mapping_entry_size = sizeof (mapping_entry_t);
 	mt->nr_entires_per_dir_slot = np->page_main_size / mt->mapping_entry_size;
-	mt->nr_total_dir_slots = np->nr_pages_per_ssd / mt->nr_entires_per_dir_slot;
+	mt->nr_total_dir_slots = 
+		(np->nr_subpages_per_ssd + mt->nr_entires_per_dir_slot - 1) / 
+		mt->nr_entires_per_dir_slot;
 	/*mt->max_cached_dir_slots = 20000;*/
 	/*mt->max_cached_dir_slots = 20;*/
-	mt->max_cached_dir_slots = mt->nr_total_dir_slots * 0.2;
+	mt->max_cached_dir_slots = mt->nr_total_dir_slots / 5; /* 20% */
+	if (mt->max_cached_dir_slots == 0)
+		mt->max_cached_dir_slots = 1;
 	atomic64_set (&mt->nr_cached_slots, 0);
+	atomic64_set (&mt->nr_loading, 0);
+	__dftl_cache_init (&mt->cache, cache_policy, mt->max_cached_dir_slots);
+	bdbm_spin_lock_init (&mt->lock);
+	mt->pending_misses = NULL;
+	bdbm_mutex_init (&mt->gtd.lock);
+	mt->gtd.journal = 0;
+	mt->gtd.nr_records = 0;
+	mt->gtd.generation = 0;
 
 	bdbm_msg ("DFTL: mapping_entry_size: %llu", mt->mapping_entry_size);
 	bdbm_msg ("DFTL: nr_entires_per_dir_slot: %llu", mt->nr_entires_per_dir_slot);
@@ -84,6 +464,10 @@ dftl_mapping_table_t* bdbm_dftl_create_mapping_table (bdbm_device_params_t* np)
 		ds->id = i;
 		ds->status = DFTL_DIR_EMPTY;
 		ds->is_under_load = 0;
+		ds->is_under_eviction = 0;
+		ds->cache_q = DFTL_CACHE_Q_NONE;
+		ds->ref = 0;
+		ds->in_test = 0;
 		ds->phyaddr.channel_no = DFTL_PAGE_INVALID_ADDR;
 		ds->phyaddr.chip_no = DFTL_PAGE_INVALID_ADDR;
 		ds->phyaddr.block_no = DFTL_PAGE_INVALID_ADDR;
@@ -107,7 +491,7 @@ dftl_mapping_table_t* bdbm_dftl_create_mapping_table (bdbm_device_params_t* np)
 		
 		/* add the directory slot to the tail of the dirty linked-list */
 		atomic64_inc (&mt->nr_cached_slots);
-		list_add_tail (&ds->list, &mt->lru_list);
+		__dftl_cache_insert (mt, ds);
 		/******/
 #endif
 	}
@@ -119,15 +503,21 @@ dftl_mapping_table_t* bdbm_dftl_create_mapping_table (bdbm_device_params_t* np)
 
 void bdbm_dftl_destroy_mapping_table (dftl_mapping_table_t* mt)
 {
-	struct list_head* next, *temp;
 	int i = 0;
 
-	/* empty dirty list */
-	list_for_each_safe (next, temp, &mt->lru_list) {
-		directory_slot_t* ds = NULL;
-		ds = list_entry (next, directory_slot_t, list);
-		list_del (&ds->list);
+	bdbm_dftl_display_cache_stat (mt);
+
+	/* empty cache lists */
+	__dftl_cache_empty (&mt->cache);
+	__dftl_clear_pending_misses (mt);
+	bdbm_spin_lock_destory (&mt->lock);
+
+	/* close the GTD journal */
+	if (mt->gtd.journal != 0) {
+		bdbm_fsync (mt->gtd.journal);
+		bdbm_fclose (mt->gtd.journal);
 	}
+	bdbm_mutex_free (&mt->gtd.lock);
 
 	/* remove directories */
 	if (mt->dir) {
@@ -142,7 +532,13 @@ void bdbm_dftl_destroy_mapping_table (dftl_mapping_table_t* mt)
 void bdbm_dftl_init_mapping_table (dftl_mapping_table_t* mt, bdbm_device_params_t* np)
 {
 	uint64_t i = 0;
-	struct list_head* next, *temp;
+
+	/* empty cache lists */
+	__dftl_cache_empty (&mt->cache);
+	__dftl_clear_pending_misses (mt);
+	__dftl_cache_init (&mt->cache, mt->cache.cache_policy, mt->max_cached_dir_slots);
+	atomic64_set (&mt->nr_cached_slots, 0);
+	atomic64_set (&mt->nr_loading, 0);
 
 	/* initialize mapping table */
 	for (i = 0; i < mt->nr_total_dir_slots; i++) {
@@ -151,6 +547,10 @@ void bdbm_dftl_init_mapping_table (dftl_mapping_table_t* mt, bdbm_device_params_
 		ds->id = i;
 		ds->status = DFTL_DIR_EMPTY;
 		ds->is_under_load = 0;
+		ds->is_under_eviction = 0;
+		ds->cache_q = DFTL_CACHE_Q_NONE;
+		ds->ref = 0;
+		ds->in_test = 0;
 		ds->phyaddr.channel_no = DFTL_PAGE_INVALID_ADDR;
 		ds->phyaddr.chip_no = DFTL_PAGE_INVALID_ADDR;
 		ds->phyaddr.block_no = DFTL_PAGE_INVALID_ADDR;
@@ -159,13 +559,6 @@ void bdbm_dftl_init_mapping_table (dftl_mapping_table_t* mt, bdbm_device_params_
 			bdbm_free(ds->me);
 		ds->me = NULL;
 	}
-
-	/* empty dirty list */
-	list_for_each_safe (next, temp, &mt->lru_list) {
-		directory_slot_t* ds = NULL;
-		ds = list_entry (next, directory_slot_t, list);
-		list_del (&ds->list);
-	}
 }
 
 mapping_entry_t bdbm_dftl_get_mapping_entry (dftl_mapping_table_t* mt, uint64_t lpa)
@@ -208,6 +601,7 @@ int bdbm_dftl_set_mapping_entry (dftl_mapping_table_t* mt, uint64_t lpa, mapping
 	uint64_t dir_idx = lpa / mt->nr_entires_per_dir_slot;
 	uint64_t map_idx = lpa % mt->nr_entires_per_dir_slot;
 	directory_slot_t* ds = NULL;
+	unsigned long flags;
 
 	bdbm_bug_on (dir_idx >= mt->nr_total_dir_slots);
 	bdbm_bug_on (map_idx >= mt->nr_entires_per_dir_slot);
@@ -221,9 +615,10 @@ int bdbm_dftl_set_mapping_entry (dftl_mapping_table_t* mt, uint64_t lpa, mapping
 	ds->me[map_idx] = *me;
 	ds->status = DFTL_DIR_DIRTY;
 
-	/* the directory slot is moved to the tail */
-	list_del (&ds->list);
-	list_add_tail (&ds->list, &mt->lru_list);
+	/* let the cache policy know that the directory slot is referenced */
+	bdbm_spin_lock_irqsave (&mt->lock, flags);
+	__dftl_cache_touch (mt, ds);
+	bdbm_spin_unlock_irqrestore (&mt->lock, flags);
 
 	return 0;
 }
@@ -254,6 +649,7 @@ int bdbm_dftl_check_mapping_entry (
 	uint64_t lpa)
 {
 	directory_slot_t* ds = NULL;
+	unsigned long flags;
 
 	/* get a directory slot */
 	ds = &mt->dir[lpa/mt->nr_entires_per_dir_slot];
@@ -265,79 +661,152 @@ int bdbm_dftl_check_mapping_entry (
 	}
 	bdbm_bug_on (ds == NULL);
 
-	if (ds->status == DFTL_DIR_EMPTY || 
-		ds->status == DFTL_DIR_FLASH) {
-		/* a mapping entry is not available */
+	if (ds->status == DFTL_DIR_FLASH || ds->is_under_eviction) {
+		/* a mapping entry must be loaded from flash (or its write-back 
+		 * must finish) */
+		atomic64_inc (&mt->cache.nr_misses);
 		return 1; 
 	}
 
+	if (ds->status == DFTL_DIR_EMPTY) {
+		/* a mapping entry is not written before */
+		atomic64_inc (&mt->cache.nr_misses);
+		return 2; 
+	}
+
 	/* a mapping entry is available */
+	atomic64_inc (&mt->cache.nr_hits);
+	bdbm_spin_lock_irqsave (&mt->lock, flags);
+	__dftl_cache_touch (mt, ds);
+	bdbm_spin_unlock_irqrestore (&mt->lock, flags);
 	return 0; 
 }
 
+static mapping_entry_t* __dftl_alloc_mapping_entries (dftl_mapping_table_t* mt)
+{
+	mapping_entry_t* me = NULL;
+	int j = 0;
+
+	me = (mapping_entry_t*)bdbm_malloc
+		(sizeof (mapping_entry_t) * mt->nr_entires_per_dir_slot);
+	bdbm_bug_on (me == NULL);
+
+	/* initialize all the entries */
+	for (j = 0; j < mt->nr_entires_per_dir_slot; j++) {
+		me[j].status = DFTL_PAGE_NOT_MAPPED;
+		me[j].phyaddr.channel_no = DFTL_PAGE_INVALID_ADDR;
+		me[j].phyaddr.chip_no = DFTL_PAGE_INVALID_ADDR;
+		me[j].phyaddr.block_no = DFTL_PAGE_INVALID_ADDR;
+		me[j].phyaddr.page_no = DFTL_PAGE_INVALID_ADDR;
+	}
+
+	return me;
+}
+
+/* It returns 'ds' if a caller has to read its mapping entries from flash.
+ * 'w' (if not NULL) is woken up once when they become available; if they 
+ * are already in DRAM, it is woken up here. */
 directory_slot_t* bdbm_dftl_missing_dir_prepare (
 	dftl_mapping_table_t* mt,
-	uint64_t lpa)
+	uint64_t lpa,
+	bdbm_mapblk_waiter_t* w)
 {
 	directory_slot_t* ds = NULL;
+	dftl_pending_miss_t* pm = NULL;
+	mapping_entry_t* me = NULL;
+	unsigned long flags;
 
 	ds = &mt->dir[lpa/mt->nr_entires_per_dir_slot];
 	bdbm_bug_on (lpa/mt->nr_entires_per_dir_slot >= mt->nr_total_dir_slots);
 
 	/* check error cases */
 	bdbm_bug_on (ds == NULL);
-	/*bdbm_bug_on (ds->me != NULL);*/
-	if (ds->status != DFTL_DIR_FLASH && 
-		ds->status != DFTL_DIR_EMPTY) {
-		bdbm_bug_on (1);
-	}
 
-	if (ds->status == DFTL_DIR_EMPTY) {
-		int j = 0;
+	/* the entries are built here, because a map page is loaded in 
+	 * the context where llm finishes a read */
+	if (ds->status == DFTL_DIR_EMPTY || 
+		(ds->status == DFTL_DIR_FLASH && ds->is_under_load == 0))
+		me = __dftl_alloc_mapping_entries (mt);
 
-		/* this directory slot is not written before */
-		ds->me = (mapping_entry_t*)bdbm_malloc
-			(sizeof (mapping_entry_t) * mt->nr_entires_per_dir_slot);
-		bdbm_bug_on (ds->me == NULL);
+	bdbm_spin_lock_irqsave (&mt->lock, flags);
 
-		/* initialize all the entries */
-		for (j = 0; j < mt->nr_entires_per_dir_slot; j++) {
-			ds->me[j].status = DFTL_PAGE_NOT_MAPPED;
-			ds->me[j].phyaddr.channel_no = DFTL_PAGE_INVALID_ADDR;
-			ds->me[j].phyaddr.chip_no = DFTL_PAGE_INVALID_ADDR;
-			ds->me[j].phyaddr.block_no = DFTL_PAGE_INVALID_ADDR;
-			ds->me[j].phyaddr.page_no = DFTL_PAGE_INVALID_ADDR;
-		}
+	if (ds->status == DFTL_DIR_EMPTY) {
+		/* this directory slot is not written before */
+		ds->me = me;
+		me = NULL;
 		ds->status = DFTL_DIR_DIRTY; /* this table is newly created, so it starts with dirty */
 
-		/* add the directory slot to the tail of the dirty linked-list */
+		/* add the directory slot to the cache */
 		atomic64_inc (&mt->nr_cached_slots);
-		list_add_tail (&ds->list, &mt->lru_list);
+		__dftl_cache_insert (mt, ds);
+	}
 
+	if (ds->status != DFTL_DIR_FLASH && ds->is_under_eviction == 0) {
+		/* it is in DRAM now */
+		bdbm_spin_unlock_irqrestore (&mt->lock, flags);
+		if (me)
+			bdbm_free (me);
+		if (w)
+			w->wakeup (w->arg);
 		return NULL;
 	}
 
-	if (ds->is_under_load == 1)
+	HASH_FIND (hh, mt->pending_misses, &ds->id, sizeof (uint64_t), pm);
+	if (pm != NULL) {
+		/* it is being loaded (or written back) by someone else; wait for 
+		 * that read (or write) */
+		bdbm_bug_on (ds->is_under_load == 0 && ds->is_under_eviction == 0);
+		if (w)
+			list_add_tail (&w->list, &pm->waiters);
+		atomic64_inc (&mt->cache.nr_coalesced);
+		bdbm_spin_unlock_irqrestore (&mt->lock, flags);
+		if (me)
+			bdbm_free (me);
 		return NULL;
+	}
 
+	/* the first miss on ds: a caller reads its map page */
+	if ((pm = (dftl_pending_miss_t*)bdbm_malloc_atomic 
+			(sizeof (dftl_pending_miss_t))) == NULL) {
+		bdbm_error ("bdbm_malloc_atomic failed");
+		bdbm_bug_on (1);
+	}
+	pm->id = ds->id;
+	INIT_LIST_HEAD (&pm->waiters);
+	if (w)
+		list_add_tail (&w->list, &pm->waiters);
+	HASH_ADD (hh, mt->pending_misses, id, sizeof (uint64_t), pm);
+	if (ds->is_under_eviction) {
+		/* it is being written back; it stays in DRAM when the write 
+		 * finishes, so there is nothing to read */
+		bdbm_spin_unlock_irqrestore (&mt->lock, flags);
+		if (me)
+			bdbm_free (me);
+		return NULL;
+	}
+	bdbm_bug_on (me == NULL || ds->me != NULL);
+	ds->me = me;
 	ds->is_under_load = 1;
+	atomic64_inc (&mt->nr_loading);
+
+	bdbm_spin_unlock_irqrestore (&mt->lock, flags);
 
 	return ds;
 }
 
+/* it is called when a map page is read from flash; it wakes up all the 
+ * requests that missed on ds */
 int bdbm_dftl_missing_dir_done (
 	dftl_mapping_table_t* mt, 
 	directory_slot_t* ds,
 	mapping_entry_t* me)
 {
+	unsigned long flags;
 	uint32_t i;
 
 	/* build mapping entires for ds */
-	if (ds->me == NULL) {
-		bdbm_bug_on (ds->status != DFTL_DIR_EMPTY);
-		ds->me = (mapping_entry_t*)bdbm_malloc
-			(sizeof (mapping_entry_t) * mt->nr_entires_per_dir_slot);
-	}
+	bdbm_bug_on (ds->status != DFTL_DIR_FLASH);
+	bdbm_bug_on (ds->me == NULL);
 
 	for (i = 0; i < mt->nr_entires_per_dir_slot; i++) {
 		ds->me[i] = me[i];
@@ -346,30 +815,16 @@ int bdbm_dftl_missing_dir_done (
 	/* NOTE: initially, the status of ds is clean even if it has invalid pages.
 	 * It becomes dirty only when its mapping entries are updated.  */
 	bdbm_bug_on (ds->phyaddr.channel_no == DFTL_PAGE_INVALID_ADDR);
-	ds->status = DFTL_DIR_CLEAN;
-	ds->is_under_load = 0;
 
+	bdbm_spin_lock_irqsave (&mt->lock, flags);
+	ds->status = DFTL_DIR_CLEAN;
 	atomic64_inc (&mt->nr_cached_slots);
-	list_add_tail (&ds->list, &mt->lru_list);
-
-	return 0;
-}
-
-int bdbm_dftl_missing_dir_done_error (
-	dftl_mapping_table_t* mt, 
-	directory_slot_t* ds,
-	mapping_entry_t* me)
-{
-	uint32_t i;
-
-	bdbm_bug_on (ds->status == DFTL_DIR_EMPTY);
+	__dftl_cache_insert (mt, ds);
 
-	if (ds->status == DFTL_DIR_FLASH) {
-		atomic64_inc (&mt->nr_cached_slots);
-		list_add_tail (&ds->list, &mt->lru_list);
-		ds->status = DFTL_DIR_CLEAN;
-	}
-	ds->is_under_load = 0;
+	/* wake up all the requests waiting for ds */
+	__dftl_complete_pending_miss (mt, ds);
+	atomic64_dec (&mt->nr_loading);
+	bdbm_spin_unlock_irqrestore (&mt->lock, flags);
 
 	return 0;
 }
@@ -378,48 +833,115 @@ directory_slot_t* bdbm_dftl_prepare_victim_mapblk (
 	dftl_mapping_table_t* mt)
 {
 	directory_slot_t* ds = NULL;
-	struct list_head* pos = NULL;
 	uint64_t nr_slots = 0;
+	unsigned long flags;
+
+	bdbm_spin_lock_irqsave (&mt->lock, flags);
 
 	/* get the number of slots kept in DRAM */
 	nr_slots = atomic64_read (&mt->nr_cached_slots);
 	if (nr_slots < mt->max_cached_dir_slots) {
+		bdbm_spin_unlock_irqrestore (&mt->lock, flags);
 		return NULL;
 	}
 
-	/* get a victim dir from lru-list */
-	list_for_each (pos, &mt->lru_list) {
-		ds = list_entry (pos, directory_slot_t, list);
-		bdbm_bug_on (ds == NULL);
-		break;
-	}
+	/* get a victim dir according to the cache policy */
+	ds = __dftl_cache_victim (mt);
+	atomic64_dec (&mt->nr_cached_slots);
+	ds->is_under_eviction = 1;
 
-	/* temp */
-	list_del (&ds->list);
+	bdbm_spin_unlock_irqrestore (&mt->lock, flags);
+
+	return ds;
+}
+
+/* take a given resident slot out of DRAM regardless of the cache policy; 
+ * it is finished by bdbm_dftl_finish_victim_mapblk as well */
+directory_slot_t* bdbm_dftl_prepare_victim_dir (
+	dftl_mapping_table_t* mt,
+	uint64_t dir_id)
+{
+	directory_slot_t* ds = &mt->dir[dir_id];
+	unsigned long flags;
+
+	bdbm_spin_lock_irqsave (&mt->lock, flags);
+
+	if ((ds->status & DFTL_DIR_DRAM) == 0 || ds->is_under_eviction) {
+		bdbm_spin_unlock_irqrestore (&mt->lock, flags);
+		return NULL;
+	}
+	__dftl_cache_del (&mt->cache, ds);
 	atomic64_dec (&mt->nr_cached_slots);
-	/* end */
+	ds->is_under_eviction = 1;
+
+	bdbm_spin_unlock_irqrestore (&mt->lock, flags);
 
 	return ds;
 }
 
 void bdbm_dftl_finish_victim_mapblk (
 	dftl_mapping_table_t* mt, 
-	directory_slot_t* ds,
-	bdbm_phyaddr_t* phyaddr)
+	directory_slot_t* ds)
 {
-	/* update a directory slot */
-	if (ds->status != DFTL_DIR_CLEAN) {
-		ds->phyaddr = *phyaddr;
+	dftl_pending_miss_t* pm = NULL;
+	mapping_entry_t* me = NULL;
+	unsigned long flags;
+
+	bdbm_spin_lock_irqsave (&mt->lock, flags);
+
+	/* its new location is set by bdbm_dftl_update_dir_phyaddr before */
+	ds->is_under_eviction = 0;
+
+	HASH_FIND (hh, mt->pending_misses, &ds->id, sizeof (uint64_t), pm);
+	if (pm != NULL) {
+		/* some missed on it while it was written back; it is the same as 
+		 * its copy in flash now, so it is kept in DRAM as a clean one */
+		ds->status = DFTL_DIR_CLEAN;
+		atomic64_inc (&mt->nr_cached_slots);
+		__dftl_cache_insert (mt, ds);
+		__dftl_complete_pending_miss (mt, ds);
+	} else {
+		/* mapping entries are now in flash, so they are removed from DRAM */
+		ds->status = DFTL_DIR_FLASH;
+		me = ds->me;
+		ds->me = NULL;
 	}
 
-	ds->status = DFTL_DIR_FLASH;
-#ifdef REMOVE_ME
-	bdbm_free(ds->me);	
-	ds->me = NULL;
-#endif
+	bdbm_spin_unlock_irqrestore (&mt->lock, flags);
+
+	if (me)
+		bdbm_free (me);
+}
+
+/* it waits until no map page is being read from flash; GC calls it before 
+ * it moves map pages, so that a read does not go to an erased one */
+void bdbm_dftl_wait_for_loads (dftl_mapping_table_t* mt)
+{
+	while (atomic64_read (&mt->nr_loading) > 0)
+		bdbm_thread_yield ();
+}
 
-	/*list_del (&ds->list);*/
-	/*atomic64_dec (&mt->nr_cached_slots);*/
+/* append an update of the GTD to the journal with an end mark after it; 
+ * gtd.lock must be held */
+static void __dftl_gtd_append (
+	dftl_mapping_table_t* mt, 
+	uint64_t ds_id,
+	bdbm_phyaddr_t* phyaddr)
+{
+	dftl_gtd_record_t rec[2];
+	uint64_t ofs = mt->gtd.nr_records * sizeof (dftl_gtd_record_t);
+
+	bdbm_memset (rec, 0x00, sizeof (rec));
+	rec[0].generation = mt->gtd.generation;
+	rec[0].id = ds_id;
+	rec[0].phyaddr = *phyaddr;
+	rec[1].generation = mt->gtd.generation;
+	rec[1].id = DFTL_GTD_END;
+	if (bdbm_fwrite (mt->gtd.journal, ofs, (uint8_t*)rec, sizeof (rec)) != sizeof (rec)) {
+		bdbm_error ("bdbm_fwrite failed (GTD journal)");
+		return;
+	}
+	mt->gtd.nr_records++;
 }
 
 void bdbm_dftl_update_dir_phyaddr (
@@ -431,5 +953,155 @@ void bdbm_dftl_update_dir_phyaddr (
 	bdbm_bug_on (ds_id>= mt->nr_total_dir_slots);
 	bdbm_bug_on (ds == NULL);
 	ds->phyaddr = *phyaddr;
+
+	/* it is kept in the journal once there is a checkpoint */
+	if (mt->gtd.journal != 0) {
+		bdbm_mutex_lock (&mt->gtd.lock);
+		__dftl_gtd_append (mt, ds_id, phyaddr);
+		bdbm_mutex_unlock (&mt->gtd.lock);
+	}
 }
 
+/* store the GTD; updates are already in the journal, so a new checkpoint is 
+ * written only when the journal is longer than a checkpoint (or there is no 
+ * checkpoint yet) */
+uint32_t bdbm_dftl_store_gtd (
+	dftl_mapping_table_t* mt,
+	const char* fn)
+{
+	dftl_gtd_header_t hdr;
+	dftl_gtd_record_t rec;
+	bdbm_file_t fp = 0;
+	uint64_t i, pos = 0;
+
+	bdbm_mutex_lock (&mt->gtd.lock);
+
+	if (mt->gtd.journal != 0 && mt->gtd.nr_records < mt->nr_total_dir_slots) {
+		bdbm_fsync (mt->gtd.journal);
+		bdbm_mutex_unlock (&mt->gtd.lock);
+		bdbm_msg ("DFTL: GTD journal (generation: %llu, %llu records)", 
+			mt->gtd.generation, mt->gtd.nr_records);
+		return 0;
+	}
+
+	/* step1: write a checkpoint */
+	if ((fp = bdbm_fopen (fn, O_CREAT | O_WRONLY, 0777)) == 0) {
+		bdbm_mutex_unlock (&mt->gtd.lock);
+		bdbm_error ("bdbm_fopen failed");
+		return 1;
+	}
+	hdr.magic = DFTL_GTD_MAGIC;
+	hdr.generation = mt->gtd.generation + 1;
+	hdr.nr_total_dir_slots = mt->nr_total_dir_slots;
+	hdr.nr_entires_per_dir_slot = mt->nr_entires_per_dir_slot;
+	pos += bdbm_fwrite (fp, pos, (uint8_t*)&hdr, sizeof (hdr));
+	for (i = 0; i < mt->nr_total_dir_slots; i++) {
+		pos += bdbm_fwrite (fp, pos, 
+			(uint8_t*)&mt->dir[i].phyaddr, sizeof (bdbm_phyaddr_t));
+	}
+	bdbm_fsync (fp);
+	bdbm_fclose (fp);
+	if (pos != sizeof (hdr) + sizeof (bdbm_phyaddr_t) * mt->nr_total_dir_slots) {
+		bdbm_mutex_unlock (&mt->gtd.lock);
+		bdbm_error ("bdbm_fwrite failed (GTD checkpoint)");
+		return 1;
+	}
+
+	/* step2: restart the journal; records of the old checkpoint are 
+	 * ignored from now on */
+	if (mt->gtd.journal == 0 &&
+		(mt->gtd.journal = bdbm_fopen (DFTL_GTD_JOURNAL, O_CREAT | O_RDWR, 0777)) == 0) {
+		bdbm_warning ("bdbm_fopen failed; GTD updates are not journaled");
+	}
+	mt->gtd.generation = hdr.generation;
+	mt->gtd.nr_records = 0;
+	if (mt->gtd.journal != 0) {
+		bdbm_memset (&rec, 0x00, sizeof (rec));
+		rec.generation = mt->gtd.generation;
+		rec.id = DFTL_GTD_END;
+		bdbm_fwrite (mt->gtd.journal, 0, (uint8_t*)&rec, sizeof (rec));
+		bdbm_fsync (mt->gtd.journal);
+	}
+
+	bdbm_mutex_unlock (&mt->gtd.lock);
+
+	bdbm_msg ("DFTL: GTD checkpoint (generation: %llu, %llu slots)", 
+		hdr.generation, mt->nr_total_dir_slots);
+
+	return 0;
+}
+
+/* rebuild the GTD from its checkpoint and journal; map pages are not read 
+ * here, but are loaded on demand when they are referenced first */
+uint32_t bdbm_dftl_load_gtd (
+	dftl_mapping_table_t* mt,
+	const char* fn)
+{
+	dftl_gtd_header_t hdr;
+	dftl_gtd_record_t rec;
+	bdbm_file_t fp = 0;
+	uint64_t i, pos = 0;
+	uint64_t nr_flash = 0;
+
+	if ((fp = bdbm_fopen (fn, O_RDWR, 0777)) == 0) {
+		bdbm_error ("bdbm_fopen failed");
+		return 1;
+	}
+
+	/* step1: check the header */
+	pos += bdbm_fread (fp, pos, (uint8_t*)&hdr, sizeof (hdr));
+	if (pos != sizeof (hdr) ||
+		hdr.magic != DFTL_GTD_MAGIC ||
+		hdr.nr_total_dir_slots != mt->nr_total_dir_slots ||
+		hdr.nr_entires_per_dir_slot != mt->nr_entires_per_dir_slot) {
+		bdbm_error ("invalid GTD checkpoint");
+		bdbm_fclose (fp);
+		return 1;
+	}
+
+	/* step2: read the checkpoint */
+	bdbm_dftl_init_mapping_table (mt, NULL);
+	for (i = 0; i < mt->nr_total_dir_slots; i++) {
+		if (bdbm_fread (fp, pos, (uint8_t*)&mt->dir[i].phyaddr, 
+				sizeof (bdbm_phyaddr_t)) != sizeof (bdbm_phyaddr_t)) {
+			bdbm_error ("bdbm_fread failed (GTD checkpoint)");
+			bdbm_dftl_init_mapping_table (mt, NULL);
+			bdbm_fclose (fp);
+			return 1;
+		}
+		pos += sizeof (bdbm_phyaddr_t);
+	}
+	bdbm_fclose (fp);
+
+	/* step3: replay the updates made after the checkpoint; later updates 
+	 * are appended after them */
+	bdbm_mutex_lock (&mt->gtd.lock);
+	if (mt->gtd.journal == 0 &&
+		(mt->gtd.journal = bdbm_fopen (DFTL_GTD_JOURNAL, O_CREAT | O_RDWR, 0777)) == 0) {
+		bdbm_warning ("bdbm_fopen failed; GTD updates are not journaled");
+	}
+	mt->gtd.generation = hdr.generation;
+	mt->gtd.nr_records = 0;
+	while (mt->gtd.journal != 0 && 
+			bdbm_fread (mt->gtd.journal, mt->gtd.nr_records * sizeof (rec), 
+				(uint8_t*)&rec, sizeof (rec)) == sizeof (rec)) {
+		if (rec.generation != hdr.generation || rec.id >= mt->nr_total_dir_slots)
+			break;
+		mt->dir[rec.id].phyaddr = rec.phyaddr;
+		mt->gtd.nr_records++;
+	}
+	bdbm_mutex_unlock (&mt->gtd.lock);
+
+	/* step4: the map pages written before are in flash */
+	for (i = 0; i < mt->nr_total_dir_slots; i++) {
+		if (mt->dir[i].phyaddr.channel_no != DFTL_PAGE_INVALID_ADDR) {
+			mt->dir[i].status = DFTL_DIR_FLASH;
+			nr_flash++;
+		}
+	}
+
+	bdbm_msg ("DFTL: GTD loaded (generation: %llu, %llu map pages in flash, %llu records replayed)",
+		hdr.generation, nr_flash, mt->gtd.nr_records);
+
+	return 0;
+}
@@ -25,6 +25,9 @@ THE SOFTWARE.
 #ifndef __FTL_DFTL_MAP_H
 #define __FTL_DFTL_MAP_H
 
+#include "uthash.h"
+#include "ufile.h"
+
 /* data structures for DFTL */
 typedef enum {
 	DFTL_DIR_EMPTY = 0,
@@ -42,6 +45,12 @@ enum BDBM_DFTL_PAGE_STATUS {
 	DFTL_PAGE_INVALID_ADDR = -1,
 };
 
+/* a map page keeps -2 - (the id of its directory slot) in the OOB in place of 
+ * a lpa, so that GC can tell it from data pages (-1 is a hole) */
+#define DFTL_MAPBLK_LPA(ds_id) (-2LL - (int64_t)(ds_id))
+#define DFTL_IS_MAPBLK_LPA(lpa) ((int64_t)(lpa) <= -2LL)
+#define DFTL_MAPBLK_ID(lpa) ((uint64_t)(-2LL - (int64_t)(lpa)))
+
 typedef struct {
 	uint8_t channel_no;
 	uint8_t chip_no;
@@ -54,6 +63,17 @@ typedef struct {
 	mapblk_phyaddr_t phyaddr; /* physical location */
 } mapping_entry_t;
 
+/* lists used by the cache policies; their meaning depends on the policy:
+ * LRU: T1 only; 2Q: A1in, Am, A1out; ARC: T1, T2, B1, B2;
+ * CLOCK-Pro: cold, hot, non-resident cold (in its test period) */
+typedef enum {
+	DFTL_CACHE_Q_NONE = 0,
+	DFTL_CACHE_Q_T1,
+	DFTL_CACHE_Q_T2,
+	DFTL_CACHE_Q_B1,	/* ghost (non-resident) */
+	DFTL_CACHE_Q_B2,	/* ghost (non-resident) */
+} dftl_cache_q;
+
 typedef struct {
 	/* linked-list: to quickly find a victim for eviction */
 	struct list_head list;
@@ -63,20 +83,91 @@ typedef struct {
 	mapping_entry_t* me;	/* the size of me is equal to a single flash size */
 
 	uint32_t is_under_load;
+	uint32_t is_under_eviction;	/* being written back; misses on it wait for the write */
+
+	/* for cache replacement */
+	uint8_t cache_q;	/* a list that 'list' currently belongs to */
+	uint8_t ref;		/* reference bit (CLOCK-Pro) */
+	uint8_t in_test;	/* test period (CLOCK-Pro) */
 } directory_slot_t;
 
 typedef struct {
-	struct list_head lru_list; /* dirty-list header */
+	uint32_t cache_policy;
+	struct list_head t1_list;
+	struct list_head t2_list;
+	struct list_head b1_list;
+	struct list_head b2_list;
+	uint64_t nr_t1;
+	uint64_t nr_t2;
+	uint64_t nr_b1;
+	uint64_t nr_b2;
+	uint64_t target_t1;	/* adaptive size of T1 (ARC) or cold pages (CLOCK-Pro) */
+
+	/* statistics */
+	atomic64_t nr_hits;
+	atomic64_t nr_misses;
+	atomic64_t nr_evictions;
+	atomic64_t nr_coalesced;	/* misses on map pages that were being loaded */
+} dftl_cache_t;
+
+/* misses on a map page being read from flash (or written back); the misses 
+ * after the first one wait for the same read */
+typedef struct {
+	uint64_t id;	/* the id of a directory slot (key) */
+	struct list_head waiters;	/* bdbm_mapblk_waiter_t */
+	UT_hash_handle hh;
+} dftl_pending_miss_t;
+
+/* a request sleeps on it once until all the map pages it missed are loaded */
+typedef struct {
+	bdbm_sema_t done;
+	atomic64_t nr_pending;
+} dftl_miss_group_t;
+
+/* the global translation directory (GTD), i.e., the locations of map pages, 
+ * is kept persistent by a checkpoint and a journal of the updates made after 
+ * it; a record is always followed by an end mark, and records of older 
+ * checkpoints are told apart by their generation numbers */
+#define DFTL_GTD_MAGIC		0x4446544c2d475444ULL	/* "DFTL-GTD" */
+#define DFTL_GTD_JOURNAL	"/usr/share/bdbm_drv/dftl_gtd.log"
+#define DFTL_GTD_END		-1ULL	/* the id of an end mark */
+
+typedef struct {
+	uint64_t magic;
+	uint64_t generation;
+	uint64_t nr_total_dir_slots;
+	uint64_t nr_entires_per_dir_slot;
+} dftl_gtd_header_t;
+
+typedef struct {
+	uint64_t generation;
+	uint64_t id;	/* the id of a directory slot */
+	bdbm_phyaddr_t phyaddr;
+} dftl_gtd_record_t;
+
+typedef struct {
+	bdbm_mutex_t lock;
+	bdbm_file_t journal;	/* 0 until a checkpoint is stored or loaded */
+	uint64_t nr_records;	/* # of records after the checkpoint */
+	uint64_t generation;
+} dftl_gtd_t;
+
+typedef struct {
+	bdbm_spinlock_t lock;	/* for cache lists, slots being loaded and pending_misses */
+	dftl_pending_miss_t* pending_misses;
+	dftl_cache_t cache;
 	uint64_t mapping_entry_size;
 	uint64_t nr_entires_per_dir_slot;
 	uint64_t nr_total_dir_slots;
 	uint64_t max_cached_dir_slots;
 	atomic64_t nr_cached_slots;
+	atomic64_t nr_loading;	/* # of map pages being read from flash */
 	directory_slot_t* dir;	/* always maintained in DRAM */
+	dftl_gtd_t gtd;
 } dftl_mapping_table_t;
 
 
-dftl_mapping_table_t* bdbm_dftl_create_mapping_table (bdbm_device_params_t* np);
+dftl_mapping_table_t* bdbm_dftl_create_mapping_table (bdbm_device_params_t* np, uint32_t cache_policy);
 void bdbm_dftl_destroy_mapping_table (dftl_mapping_table_t* mt);
 void bdbm_dftl_init_mapping_table (dftl_mapping_table_t* mt, bdbm_device_params_t* np);
 
@@ -90,11 +181,14 @@ int bdbm_dftl_check_mapping_entry (dftl_mapping_table_t* mt, uint64_t lpa);
 directory_slot_t* 
 bdbm_dftl_prepare_victim_mapblk (dftl_mapping_table_t* mt);
 
+directory_slot_t* 
+bdbm_dftl_prepare_victim_dir (dftl_mapping_table_t* mt, uint64_t dir_id);
+
 void 
-bdbm_dftl_finish_victim_mapblk (dftl_mapping_table_t* mt, directory_slot_t* ds, bdbm_phyaddr_t* phyaddr);
+bdbm_dftl_finish_victim_mapblk (dftl_mapping_table_t* mt, directory_slot_t* ds);
 
 directory_slot_t* 
-bdbm_dftl_missing_dir_prepare (dftl_mapping_table_t* mt, uint64_t lpa);
+bdbm_dftl_missing_dir_prepare (dftl_mapping_table_t* mt, uint64_t lpa, bdbm_mapblk_waiter_t* w);
 
 int 
 bdbm_dftl_missing_dir_done (dftl_mapping_table_t* mt, directory_slot_t* ds, mapping_entry_t* me);
@@ -104,11 +198,17 @@ void bdbm_dftl_update_dir_phyaddr (
 	uint64_t ds_id,
 	bdbm_phyaddr_t* phyaddr);
 
-int 
-bdbm_dftl_missing_dir_done_error (
-	dftl_mapping_table_t* mt, 
-	directory_slot_t* ds,
-	mapping_entry_t* me);
+void bdbm_dftl_wait_for_loads (dftl_mapping_table_t* mt);
+
+/* persistence of the GTD */
+uint32_t bdbm_dftl_store_gtd (dftl_mapping_table_t* mt, const char* fn);
+uint32_t bdbm_dftl_load_gtd (dftl_mapping_table_t* mt, const char* fn);
+
+void bdbm_dftl_display_cache_stat (dftl_mapping_table_t* mt);
 
+/* a request that misses on map pages waits for them with a miss group */
+void bdbm_dftl_miss_group_init (dftl_miss_group_t* g);
+void bdbm_dftl_miss_group_add (dftl_miss_group_t* g, bdbm_mapblk_waiter_t* w);
+void bdbm_dftl_miss_group_wait (dftl_miss_group_t* g);
 
 #endif
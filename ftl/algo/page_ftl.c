@@ -60,6 +60,8 @@ bdbm_ftl_inf_t _ftl_page_ftl = {
 	.invalidate_lpa = bdbm_page_ftl_invalidate_lpa,
 	.do_gc = bdbm_page_ftl_do_gc,
 	.is_gc_needed = bdbm_page_ftl_is_gc_needed,
+	.get_free_space = bdbm_page_ftl_get_free_space,
+	.run_erases = bdbm_page_ftl_run_erases,
 	.scan_badblocks = bdbm_page_badblock_scan,
 	/*.load = bdbm_page_ftl_load,*/
 	/*.store = bdbm_page_ftl_store,*/
@@ -90,14 +92,41 @@ typedef struct {
 
 	/* for the management of active blocks */
 	uint64_t curr_puid;
+	uint64_t curr_plane;
 	uint64_t curr_page_ofs;
-	bdbm_abm_block_t** ac_bab;
+	uint64_t nr_planes;
+	bdbm_abm_block_t** ac_bab;	/* [punit * nr_planes + plane] */
+
+	/* for load-aware placement; active blocks of punits fill independently */
+	uint8_t load_aware;
+	uint64_t* ac_page_ofs;	/* the next page of the active blocks of a punit */
 
 	/* reserved for gc (reused whenever gc is invoked) */
 	bdbm_abm_block_t** gc_bab;
 	bdbm_hlm_req_gc_t gc_hlm;
 	bdbm_hlm_req_gc_t gc_hlm_w;
 
+	/* for sliced gc; a cycle goes on over calls of do_gc */
+	uint64_t gc_slice_pages;	/* max. # of pages copied by a slice; 0: no limit */
+	uint64_t gc_host_ratio;	/* # of host pages written between slices per page copied */
+	uint64_t nr_gc_blks;	/* # of victims of the cycle; 0: no cycle is running */
+	uint64_t gc_page;	/* the next page to copy is gc_page of victim gc_blk */
+	uint64_t gc_blk;
+	uint64_t nr_alloc_pages;	/* # of pages get_free_ppa gave out */
+	uint64_t gc_next_slice;	/* the next slice waits until nr_alloc_pages reaches it */
+	uint64_t nr_gc_cycles;
+	uint64_t nr_gc_slices;
+	uint64_t gc_slice_max_us;
+
+	/* for deferred erases; victims wait on the erase lists of abm */
+	uint8_t defer_erase;
+	uint64_t erase_floor;	/* erases of a chip are forced below this # of free blocks */
+	bdbm_abm_block_t** erase_bab;	/* the block being erased by a punit */
+	bdbm_hlm_req_gc_t* erase_hlm;	/* an erase req for each punit */
+	bdbm_llm_req_t* erase_reqs;
+	uint64_t nr_erases_idle;
+	uint64_t nr_erases_forced;
+
 	/* for bad-block scanning */
 	bdbm_sema_t badblk;
 } bdbm_page_ftl_private_t;
@@ -143,19 +172,21 @@ uint32_t __bdbm_page_ftl_get_active_blocks (
 	bdbm_abm_info_t* bai,
 	bdbm_abm_block_t** bab)
 {
-	uint64_t i, j;
+	uint64_t i, j, k;
 
-	/* get a set of free blocks for active blocks */
+	/* get a set of free blocks for active blocks; one for each plane */
 	for (i = 0; i < np->nr_channels; i++) {
 		for (j = 0; j < np->nr_chips_per_channel; j++) {
-			/* prepare & commit free blocks */
-			if ((*bab = bdbm_abm_get_free_block_prepare (bai, i, j))) {
-				bdbm_abm_get_free_block_commit (bai, *bab);
-				/*bdbm_msg ("active blk = %p", *bab);*/
-				bab++;
-			} else {
-				bdbm_error ("bdbm_abm_get_free_block_prepare failed");
-				return 1;
+			for (k = 0; k < np->nr_planes_per_chip; k++) {
+				/* prepare & commit free blocks */
+				if ((*bab = bdbm_abm_get_free_block_prepare_plane (bai, i, j, k))) {
+					bdbm_abm_get_free_block_commit (bai, *bab);
+					/*bdbm_msg ("active blk = %p", *bab);*/
+					bab++;
+				} else {
+					bdbm_error ("bdbm_abm_get_free_block_prepare failed");
+					return 1;
+				}
 			}
 		}
 	}
@@ -174,7 +205,7 @@ bdbm_abm_block_t** __bdbm_page_ftl_create_active_blocks (
 
 	/* create a set of active blocks */
 	if ((bab = (bdbm_abm_block_t**)bdbm_zmalloc 
-			(sizeof (bdbm_abm_block_t*) * nr_punits)) == NULL) {
+			(sizeof (bdbm_abm_block_t*) * nr_punits * np->nr_planes_per_chip)) == NULL) {
 		bdbm_error ("bdbm_zmalloc failed");
 		goto fail;
 	}
@@ -204,6 +235,124 @@ void __bdbm_page_ftl_destroy_active_blocks (
 	bdbm_free (bab);
 }
 
+/* blocks waiting for erases are as good as free ones */
+static uint64_t __bdbm_page_ftl_get_nr_free_blocks (bdbm_page_ftl_private_t* p)
+{
+	return bdbm_abm_get_nr_free_blocks (p->bai) + 
+		bdbm_abm_get_nr_erase_pending_blocks (p->bai);
+}
+
+/* send an erase of b; if llm does not take it, b stays at the head of 
+ * the erase list of its chip and the next tick tries it again */
+static uint32_t __bdbm_page_ftl_erase_issue (
+	bdbm_drv_info_t* bdi, 
+	uint64_t punit_id, 
+	bdbm_abm_block_t* b)
+{
+	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
+	bdbm_hlm_req_gc_t* hlm = &p->erase_hlm[punit_id];
+	bdbm_llm_req_t* r = hlm->llm_reqs;
+
+	r->req_type = REQTYPE_GC_ERASE;
+	r->logaddr.lpa[0] = -1ULL; /* lpa is not available now */
+	r->phyaddr.channel_no = b->channel_no;
+	r->phyaddr.chip_no = b->chip_no;
+	r->phyaddr.block_no = b->block_no;
+	r->phyaddr.page_no = 0;
+	r->phyaddr.punit_id = BDBM_GET_PUNIT_ID (bdi, (&r->phyaddr));
+	r->ptr_hlm_req = (void*)hlm;
+	r->ret = 0;
+
+	hlm->req_type = REQTYPE_GC_ERASE;
+	hlm->nr_llm_reqs = 1;
+	atomic64_set (&hlm->nr_llm_reqs_done, 0);
+	bdbm_sema_lock (&hlm->done);
+	p->erase_bab[punit_id] = b;
+	if ((bdi->ptr_llm_inf->make_req (bdi, r)) != 0) {
+		bdbm_error ("llm_make_req failed; the erase of block (%llu %llu %llu) is retried later",
+			b->channel_no, b->chip_no, b->block_no);
+		p->erase_bab[punit_id] = NULL;
+		bdbm_sema_unlock (&hlm->done);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* move the block erased by a punit to the free list if the erase is done 
+ * (or after waiting for it); it returns 0 if the erase is still going on */
+static uint8_t __bdbm_page_ftl_erase_reap (
+	bdbm_drv_info_t* bdi, 
+	uint64_t punit_id, 
+	uint8_t wait)
+{
+	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
+	bdbm_hlm_req_gc_t* hlm = &p->erase_hlm[punit_id];
+	bdbm_abm_block_t* b = p->erase_bab[punit_id];
+
+	if (b == NULL)
+		return 1;
+	if (!wait && atomic64_read (&hlm->nr_llm_reqs_done) < hlm->nr_llm_reqs)
+		return 0;
+
+	/* the sema is unlocked right after the req is counted */
+	bdbm_sema_lock (&hlm->done);
+	bdbm_sema_unlock (&hlm->done);
+
+	/* FIXME: what happens if block erasure fails */
+	bdbm_abm_erase_block (p->bai, b->channel_no, b->chip_no, b->block_no, 
+		hlm->llm_reqs[0].ret != 0 ? 1 : 0);
+	p->erase_bab[punit_id] = NULL;
+
+	return 1;
+}
+
+/* ERASE MANAGER:
+ * victims copied by gc wait on the erase lists of abm, so that host 
+ * requests are not held by erases. a punit erases them one by one when it 
+ * has nothing else to do, or right away when its chip has fewer than 
+ * erase_floor free blocks; if the chip cannot refill its active blocks, 
+ * the erase is waited for. hlm runs it through run_erases before it 
+ * checks gc for a write */
+void bdbm_page_ftl_run_erases (bdbm_drv_info_t* bdi)
+{
+	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	bdbm_abm_block_t* b = NULL;
+	uint64_t punit_id, channel_no, chip_no, nr_free_blks;
+
+	if (!p->defer_erase)
+		return;
+
+	for (punit_id = 0; punit_id < p->nr_punits; punit_id++) {
+		channel_no = punit_id / np->nr_chips_per_channel;
+		chip_no = punit_id % np->nr_chips_per_channel;
+
+		for (;;) {
+			if (!__bdbm_page_ftl_erase_reap (bdi, punit_id, 0))
+				break;
+			if ((b = bdbm_abm_get_erase_pending_block (p->bai, channel_no, chip_no)) == NULL)
+				break;
+
+			nr_free_blks = bdbm_abm_get_nr_free_blocks_chip (p->bai, channel_no, chip_no);
+			if (nr_free_blks >= p->erase_floor) {
+				if (bdi->ptr_llm_inf->get_punit_load != NULL &&
+					bdi->ptr_llm_inf->get_punit_load (bdi, punit_id) > 0)
+					break;
+				p->nr_erases_idle++;
+			} else {
+				p->nr_erases_forced++;
+			}
+			if (__bdbm_page_ftl_erase_issue (bdi, punit_id, b) != 0)
+				break;
+
+			if (nr_free_blks >= p->nr_planes)
+				break;
+			__bdbm_page_ftl_erase_reap (bdi, punit_id, 1);
+		}
+	}
+}
+
 uint32_t bdbm_page_ftl_create (bdbm_drv_info_t* bdi)
 {
 	uint32_t i = 0, j = 0;
@@ -217,7 +366,9 @@ uint32_t bdbm_page_ftl_create (bdbm_drv_info_t* bdi)
 		return 1;
 	}
 	p->curr_puid = 0;
+	p->curr_plane = 0;
 	p->curr_page_ofs = 0;
+	p->nr_planes = np->nr_planes_per_chip;
 	p->nr_punits = np->nr_chips_per_channel * np->nr_channels;
 	p->nr_punits_pages = p->nr_punits * np->nr_pages_per_block;
 	bdbm_spin_lock_init (&p->ftl_lock);
@@ -244,6 +395,50 @@ uint32_t bdbm_page_ftl_create (bdbm_drv_info_t* bdi)
 		return 1;
 	}
 
+	/* allocate page offsets for load-aware placement */
+	if ((p->ac_page_ofs = (uint64_t*)bdbm_zmalloc 
+			(sizeof (uint64_t) * p->nr_punits)) == NULL) {
+		bdbm_error ("bdbm_zmalloc failed");
+		bdbm_page_ftl_destroy (bdi);
+		return 1;
+	}
+	if (BDBM_GET_DRIVER_PARAMS (bdi)->write_placement == WRITE_PLACEMENT_LOAD_AWARE) {
+		if (bdi->ptr_llm_inf->get_punit_load != NULL) {
+			p->load_aware = 1;
+		} else {
+			bdbm_warning ("the llm does not report punit loads; writes are placed round-robin");
+		}
+	}
+
+	/* gc copies at most gc_slice_pages at once; it is limited by gc_hlm */
+	p->gc_slice_pages = BDBM_GET_DRIVER_PARAMS (bdi)->gc_slice_pages;
+	if (p->gc_slice_pages > p->nr_punits_pages)
+		p->gc_slice_pages = p->nr_punits_pages;
+	p->gc_host_ratio = BDBM_GET_DRIVER_PARAMS (bdi)->gc_host_ratio;
+
+	/* allocate an erase req for each punit if erases are deferred */
+	if (BDBM_GET_DRIVER_PARAMS (bdi)->gc_defer_erase) {
+		p->erase_floor = BDBM_GET_DRIVER_PARAMS (bdi)->gc_erase_floor;
+		if (p->erase_floor < p->nr_planes)
+			p->erase_floor = p->nr_planes;
+		if ((p->erase_bab = (bdbm_abm_block_t**)bdbm_zmalloc 
+				(sizeof (bdbm_abm_block_t*) * p->nr_punits)) == NULL ||
+			(p->erase_hlm = (bdbm_hlm_req_gc_t*)bdbm_zmalloc 
+				(sizeof (bdbm_hlm_req_gc_t) * p->nr_punits)) == NULL ||
+			(p->erase_reqs = (bdbm_llm_req_t*)bdbm_zmalloc 
+				(sizeof (bdbm_llm_req_t) * p->nr_punits)) == NULL) {
+			bdbm_error ("bdbm_zmalloc failed");
+			bdbm_page_ftl_destroy (bdi);
+			return 1;
+		}
+		hlm_reqs_pool_allocate_llm_reqs (p->erase_reqs, p->nr_punits, RP_MEM_PHY);
+		for (i = 0; i < p->nr_punits; i++) {
+			p->erase_hlm[i].llm_reqs = &p->erase_reqs[i];
+			bdbm_sema_init (&p->erase_hlm[i].done);
+		}
+		p->defer_erase = 1;
+	}
+
 	/* allocate gc stuff */
 	if ((p->gc_bab = (bdbm_abm_block_t**)bdbm_zmalloc 
 			(sizeof (bdbm_abm_block_t*) * p->nr_punits)) == NULL) {
@@ -279,6 +474,26 @@ void bdbm_page_ftl_destroy (bdbm_drv_info_t* bdi)
 
 	if (!p)
 		return;
+	if (p->nr_gc_slices > 0) {
+		bdbm_msg ("page_ftl gc: %llu cycles in %llu slices, the longest slice = %llu us",
+			p->nr_gc_cycles, p->nr_gc_slices, p->gc_slice_max_us);
+	}
+	if (p->defer_erase) {
+		uint64_t i;
+		for (i = 0; i < p->nr_punits; i++) {
+			__bdbm_page_ftl_erase_reap (bdi, i, 1);
+			bdbm_sema_free (&p->erase_hlm[i].done);
+		}
+		hlm_reqs_pool_release_llm_reqs (p->erase_reqs, p->nr_punits, RP_MEM_PHY);
+		bdbm_msg ("page_ftl erases: %llu on idle punits, %llu forced, %llu blocks still pending",
+			p->nr_erases_idle, p->nr_erases_forced, bdbm_abm_get_nr_erase_pending_blocks (p->bai));
+	}
+	if (p->erase_reqs)
+		bdbm_free (p->erase_reqs);
+	if (p->erase_hlm)
+		bdbm_free (p->erase_hlm);
+	if (p->erase_bab)
+		bdbm_free (p->erase_bab);
 	if (p->gc_hlm_w.llm_reqs) {
 		hlm_reqs_pool_release_llm_reqs (p->gc_hlm_w.llm_reqs, p->nr_punits_pages, RP_MEM_PHY);
 		bdbm_sema_free (&p->gc_hlm_w.done);
@@ -291,6 +506,8 @@ void bdbm_page_ftl_destroy (bdbm_drv_info_t* bdi)
 	}
 	if (p->gc_bab)
 		bdbm_free (p->gc_bab);
+	if (p->ac_page_ofs)
+		bdbm_free (p->ac_page_ofs);
 	if (p->ac_bab)
 		__bdbm_page_ftl_destroy_active_blocks (p->ac_bab);
 	if (p->ptr_mapping_table)
@@ -300,6 +517,97 @@ void bdbm_page_ftl_destroy (bdbm_drv_info_t* bdi)
 	bdbm_free (p);
 }
 
+/* get new active blocks for one punit; it fails if the chip does not have 
+ * a free block for every plane */
+static uint32_t __bdbm_page_ftl_refill_active_blocks (
+	bdbm_page_ftl_private_t* p,
+	bdbm_device_params_t* np,
+	uint64_t punit_id)
+{
+	bdbm_abm_block_t** bab = &p->ac_bab[punit_id * p->nr_planes];
+	uint64_t channel_no = punit_id / np->nr_chips_per_channel;
+	uint64_t chip_no = punit_id % np->nr_chips_per_channel;
+	uint64_t k;
+
+	if (bdbm_abm_get_nr_free_blocks_chip (p->bai, channel_no, chip_no) < p->nr_planes)
+		return 1;
+
+	for (k = 0; k < p->nr_planes; k++) {
+		bab[k] = bdbm_abm_get_free_block_prepare_plane (p->bai, channel_no, chip_no, k);
+		bdbm_abm_get_free_block_commit (p->bai, bab[k]);
+	}
+	p->ac_page_ofs[punit_id] = 0;
+
+	return 0;
+}
+
+/* LOAD-AWARE PLACEMENT:
+ * a write goes to the punit with the fewest reqs in the llm among the ones 
+ * with free pages in their active blocks. the search starts after the 
+ * punit chosen last and goes over channels first, as round-robin does, so 
+ * that idle punits are used in turn */
+static uint32_t __bdbm_page_ftl_get_free_ppa_load_aware (
+	bdbm_drv_info_t* bdi, 
+	bdbm_phyaddr_t* ppa)
+{
+	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	bdbm_abm_block_t* b = NULL;
+	uint64_t i, puid, punit_id, load;
+	uint64_t best = p->nr_punits, best_load = -1ULL;
+
+	/* the planes of a punit are filled together; pick a punit for the first */
+	if (p->curr_plane == 0) {
+		for (i = 0; i < p->nr_punits; i++) {
+			puid = (p->curr_puid + i) % p->nr_punits;
+			punit_id = (puid % np->nr_channels) * np->nr_chips_per_channel + 
+				puid / np->nr_channels;
+			if (p->ac_page_ofs[punit_id] == np->nr_pages_per_block &&
+				__bdbm_page_ftl_refill_active_blocks (p, np, punit_id) != 0)
+				continue;
+			if ((load = bdi->ptr_llm_inf->get_punit_load (bdi, punit_id)) < best_load) {
+				best = puid;
+				best_load = load;
+				if (load == 0)
+					break;
+			}
+		}
+		if (best == p->nr_punits) {
+			bdbm_error ("no active blocks have free pages");
+			return 1;
+		}
+		p->curr_puid = best;
+	}
+
+	puid = p->curr_puid;
+	punit_id = (puid % np->nr_channels) * np->nr_chips_per_channel + puid / np->nr_channels;
+
+	b = p->ac_bab[punit_id * p->nr_planes + p->curr_plane];
+	ppa->channel_no =  b->channel_no;
+	ppa->chip_no = b->chip_no;
+	ppa->block_no = b->block_no;
+	ppa->page_no = p->ac_page_ofs[punit_id];
+	ppa->punit_id = BDBM_GET_PUNIT_ID (bdi, ppa);
+
+	bdbm_bug_on (ppa->punit_id != punit_id);
+	bdbm_bug_on (ppa->page_no >= np->nr_pages_per_block);
+
+	if ((p->curr_plane + 1) < p->nr_planes) {
+		p->curr_plane++;
+		return 0;
+	}
+	p->curr_plane = 0;
+
+	/* get new active blocks as soon as they are full; if the chip has no 
+	 * free blocks now, it is tried again when the punit is searched */
+	if (++p->ac_page_ofs[punit_id] == np->nr_pages_per_block)
+		__bdbm_page_ftl_refill_active_blocks (p, np, punit_id);
+
+	p->curr_puid = (puid + 1) % p->nr_punits;
+
+	return 0;
+}
+
 uint32_t bdbm_page_ftl_get_free_ppa (
 	bdbm_drv_info_t* bdi, 
 	int64_t lpa,
@@ -311,12 +619,17 @@ uint32_t bdbm_page_ftl_get_free_ppa (
 	uint64_t curr_channel;
 	uint64_t curr_chip;
 
+	p->nr_alloc_pages++;
+
+	if (p->load_aware)
+		return __bdbm_page_ftl_get_free_ppa_load_aware (bdi, ppa);
+
 	/* get the channel & chip numbers */
 	curr_channel = p->curr_puid % np->nr_channels;
 	curr_chip = p->curr_puid / np->nr_channels;
 
 	/* get the physical offset of the active blocks */
-	b = p->ac_bab[curr_channel * np->nr_chips_per_channel + curr_chip];
+	b = p->ac_bab[(curr_channel * np->nr_chips_per_channel + curr_chip) * p->nr_planes + p->curr_plane];
 	ppa->channel_no =  b->channel_no;
 	ppa->chip_no = b->chip_no;
 	ppa->block_no = b->block_no;
@@ -328,6 +641,14 @@ uint32_t bdbm_page_ftl_get_free_ppa (
 	bdbm_bug_on (ppa->chip_no != curr_chip);
 	bdbm_bug_on (ppa->page_no >= np->nr_pages_per_block);
 
+	/* fill the same page of the other planes first so that the pages can 
+	 * be programmed together */
+	if ((p->curr_plane + 1) < p->nr_planes) {
+		p->curr_plane++;
+		return 0;
+	}
+	p->curr_plane = 0;
+
 	/* go to the next parallel unit */
 	if ((p->curr_puid + 1) == p->nr_punits) {
 		p->curr_puid = 0;
@@ -488,11 +809,37 @@ uint32_t bdbm_page_ftl_invalidate_lpa (
 	return 0;
 }
 
+void bdbm_page_ftl_get_free_space (
+	bdbm_drv_info_t* bdi, 
+	uint64_t* nr_free_blks, 
+	uint64_t* nr_total_blks)
+{
+	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
+
+	*nr_free_blks = __bdbm_page_ftl_get_nr_free_blocks (p);
+	*nr_total_blks = bdbm_abm_get_nr_total_blocks (p->bai);
+}
+
 uint8_t bdbm_page_ftl_is_gc_needed (bdbm_drv_info_t* bdi, int64_t lpa)
 {
 	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
 	uint64_t nr_total_blks = bdbm_abm_get_nr_total_blocks (p->bai);
-	uint64_t nr_free_blks = bdbm_abm_get_nr_free_blocks (p->bai);
+	uint64_t nr_free_blks;
+	uint64_t nr_plane_blks = p->nr_punits * (p->nr_planes - 1);
+
+	nr_free_blks = __bdbm_page_ftl_get_nr_free_blocks (p);
+
+	/* a gc cycle is going on slice by slice */
+	if (p->nr_gc_blks > 0) {
+		return 1;
+	}
+
+	/* active blocks of the other planes are refilled together; keep free 
+	 * blocks for them on top of the usual threshold */
+	if (nr_free_blks <= nr_plane_blks) {
+		return 1;
+	}
+	nr_free_blks -= nr_plane_blks;
 
 	/* invoke gc when remaining free blocks are less than 1% of total blocks */
 	if ((nr_free_blks * 100 / nr_total_blks) <= 2) {
@@ -510,6 +857,23 @@ uint8_t bdbm_page_ftl_is_gc_needed (bdbm_drv_info_t* bdi, int64_t lpa)
 	return 0;
 }
 
+/* see if b is one of the active blocks of its punit */
+static uint8_t __bdbm_page_ftl_is_active_block (
+	bdbm_page_ftl_private_t* p,
+	bdbm_device_params_t* np,
+	bdbm_abm_block_t* b)
+{
+	bdbm_abm_block_t** a = &p->ac_bab[
+		(b->channel_no * np->nr_chips_per_channel + b->chip_no) * p->nr_planes];
+	uint64_t k;
+
+	for (k = 0; k < p->nr_planes; k++) {
+		if (a[k] == b)
+			return 1;
+	}
+	return 0;
+}
+
 /* VICTIM SELECTION - First Selection:
  * select the first dirty block in a list */
 bdbm_abm_block_t* __bdbm_page_ftl_victim_selection (
@@ -519,14 +883,12 @@ bdbm_abm_block_t* __bdbm_page_ftl_victim_selection (
 {
 	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
 	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
-	bdbm_abm_block_t* a = NULL;
 	bdbm_abm_block_t* b = NULL;
 	struct list_head* pos = NULL;
 
-	a = p->ac_bab[channel_no*np->nr_chips_per_channel + chip_no];
 	bdbm_abm_list_for_each_dirty_block (pos, p->bai, channel_no, chip_no) {
 		b = bdbm_abm_fetch_dirty_block (pos);
-		if (a != b)
+		if (!__bdbm_page_ftl_is_active_block (p, np, b))
 			break;
 		b = NULL;
 	}
@@ -548,11 +910,11 @@ bdbm_abm_block_t* __bdbm_page_ftl_victim_selection_greedy (
 	bdbm_abm_block_t* v = NULL;
 	struct list_head* pos = NULL;
 
-	a = p->ac_bab[channel_no*np->nr_chips_per_channel + chip_no];
+	a = p->ac_bab[(channel_no*np->nr_chips_per_channel + chip_no) * p->nr_planes];
 
 	bdbm_abm_list_for_each_dirty_block (pos, p->bai, channel_no, chip_no) {
 		b = bdbm_abm_fetch_dirty_block (pos);
-		if (a == b)
+		if (__bdbm_page_ftl_is_active_block (p, np, b))
 			continue;
 		if (b->nr_invalid_subpages == np->nr_subpages_per_block) {
 			v = b;
@@ -747,24 +1109,16 @@ erase_blks:
 }
 #endif
 
-uint32_t bdbm_page_ftl_do_gc (bdbm_drv_info_t* bdi, int64_t lpa)
+/* choose a victim block for every punit; it returns the # of victims */
+static uint64_t __bdbm_page_ftl_gc_select_victims (bdbm_drv_info_t* bdi)
 {
 	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
 	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
-	bdbm_hlm_req_gc_t* hlm_gc = &p->gc_hlm;
-	bdbm_hlm_req_gc_t* hlm_gc_w = &p->gc_hlm_w;
 	uint64_t nr_gc_blks = 0;
-	uint64_t nr_llm_reqs = 0;
-	uint64_t nr_punits = 0;
-	uint64_t i, j, k;
-	bdbm_stopwatch_t sw;
-
-	nr_punits = np->nr_channels * np->nr_chips_per_channel;
+	uint64_t i, j;
 
-	/* choose victim blocks for individual parallel units */
-	bdbm_memset (p->gc_bab, 0x00, sizeof (bdbm_abm_block_t*) * nr_punits);
-	bdbm_stopwatch_start (&sw);
-	for (i = 0, nr_gc_blks = 0; i < np->nr_channels; i++) {
+	bdbm_memset (p->gc_bab, 0x00, sizeof (bdbm_abm_block_t*) * p->nr_punits);
+	for (i = 0; i < np->nr_channels; i++) {
 		for (j = 0; j < np->nr_chips_per_channel; j++) {
 			bdbm_abm_block_t* b; 
 			if ((b = __bdbm_page_ftl_victim_selection_greedy (bdi, i, j))) {
@@ -773,67 +1127,108 @@ uint32_t bdbm_page_ftl_do_gc (bdbm_drv_info_t* bdi, int64_t lpa)
 			}
 		}
 	}
-	if (nr_gc_blks < nr_punits) {
-		/* TODO: we need to implement a load balancing feature to avoid this */
-		/*bdbm_warning ("TODO: this warning will be removed with load-balancing");*/
-		return 0;
-	}
 
-	/* TEMP */
-	for (i = 0; i < nr_punits * np->nr_pages_per_block; i++) {
-		hlm_reqs_pool_reset_fmain (&hlm_gc->llm_reqs[i].fmain);
+	return nr_gc_blks;
+}
+
+/* build a read req for a page of a victim; it returns 0 if the page has 
+ * no valid subpages */
+static uint8_t __bdbm_page_ftl_gc_build_read (
+	bdbm_drv_info_t* bdi, 
+	bdbm_abm_block_t* b, 
+	uint64_t page_no, 
+	bdbm_llm_req_t* r)
+{
+	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	int has_valid = 0;
+	uint64_t k;
+
+	/* are there any valid subpages in a block */
+	hlm_reqs_pool_reset_fmain (&r->fmain);
+	hlm_reqs_pool_reset_logaddr (&r->logaddr);
+	for (k = 0; k < np->nr_subpages_per_page; k++) {
+		if (b->pst[page_no*np->nr_subpages_per_page+k] != BDBM_ABM_SUBPAGE_INVALID) {
+			has_valid = 1;
+			r->logaddr.lpa[k] = -1; /* the subpage contains new data */
+			r->fmain.kp_stt[k] = KP_STT_DATA;
+		} else {
+			r->logaddr.lpa[k] = -1;	/* the subpage contains obsolate data */
+			r->fmain.kp_stt[k] = KP_STT_HOLE;
+		}
 	}
-	/* TEMP */
+	if (!has_valid)
+		return 0;
 
-	/* build hlm_req_gc for reads */
-	for (i = 0, nr_llm_reqs = 0; i < nr_gc_blks; i++) {
-		bdbm_abm_block_t* b = p->gc_bab[i];
-		if (b == NULL)
-			break;
-		for (j = 0; j < np->nr_pages_per_block; j++) {
-			bdbm_llm_req_t* r = &hlm_gc->llm_reqs[nr_llm_reqs];
-			int has_valid = 0;
-			/* are there any valid subpages in a block */
-			hlm_reqs_pool_reset_fmain (&r->fmain);
-			hlm_reqs_pool_reset_logaddr (&r->logaddr);
-			for (k = 0; k < np->nr_subpages_per_page; k++) {
-				if (b->pst[j*np->nr_subpages_per_page+k] != BDBM_ABM_SUBPAGE_INVALID) {
-					has_valid = 1;
-					r->logaddr.lpa[k] = -1; /* the subpage contains new data */
-					r->fmain.kp_stt[k] = KP_STT_DATA;
-				} else {
-					r->logaddr.lpa[k] = -1;	/* the subpage contains obsolate data */
-					r->fmain.kp_stt[k] = KP_STT_HOLE;
-				}
+	/* if it is, selects it as the gc candidates */
+	r->req_type = REQTYPE_GC_READ;
+	r->phyaddr.channel_no = b->channel_no;
+	r->phyaddr.chip_no = b->chip_no;
+	r->phyaddr.block_no = b->block_no;
+	r->phyaddr.page_no = page_no;
+	r->phyaddr.punit_id = BDBM_GET_PUNIT_ID (bdi, (&r->phyaddr));
+	r->ptr_hlm_req = (void*)&p->gc_hlm;
+	r->ret = 0;
+
+	return 1;
+}
+
+/* build read reqs for up to max_pages pages of the victims that still have 
+ * valid subpages, starting at the gc cursor. in a slice, the pages at the 
+ * same offset of all the victims go together so that it keeps every punit 
+ * busy; without slicing, the victims are read block by block as before */
+static uint64_t __bdbm_page_ftl_gc_build_reads (
+	bdbm_drv_info_t* bdi, 
+	uint64_t max_pages)
+{
+	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	bdbm_hlm_req_gc_t* hlm_gc = &p->gc_hlm;
+	uint64_t nr_llm_reqs = 0;
+	uint64_t i, j;
+
+	if (p->gc_slice_pages == 0) {
+		for (i = 0; i < p->nr_gc_blks; i++) {
+			for (j = 0; j < np->nr_pages_per_block; j++) {
+				if (__bdbm_page_ftl_gc_build_read (bdi, p->gc_bab[i], j, 
+						&hlm_gc->llm_reqs[nr_llm_reqs]))
+					nr_llm_reqs++;
 			}
-			/* if it is, selects it as the gc candidates */
-			if (has_valid) {
-				r->req_type = REQTYPE_GC_READ;
-				r->phyaddr.channel_no = b->channel_no;
-				r->phyaddr.chip_no = b->chip_no;
-				r->phyaddr.block_no = b->block_no;
-				r->phyaddr.page_no = j;
-				r->phyaddr.punit_id = BDBM_GET_PUNIT_ID (bdi, (&r->phyaddr));
-				r->ptr_hlm_req = (void*)hlm_gc;
-				r->ret = 0;
+		}
+		p->gc_page = np->nr_pages_per_block;
+		return nr_llm_reqs;
+	}
+
+	for (; p->gc_page < np->nr_pages_per_block; p->gc_page++, p->gc_blk = 0) {
+		for (; p->gc_blk < p->nr_gc_blks; p->gc_blk++) {
+			if (nr_llm_reqs == max_pages)
+				return nr_llm_reqs;
+			if (__bdbm_page_ftl_gc_build_read (bdi, p->gc_bab[p->gc_blk], p->gc_page, 
+					&hlm_gc->llm_reqs[nr_llm_reqs]))
 				nr_llm_reqs++;
-			}
 		}
 	}
 
-	/*
-	bdbm_msg ("----------------------------------------------");
-	bdbm_msg ("gc-victim: %llu pages, %llu blocks, %llu us", 
-		nr_llm_reqs, nr_gc_blks, bdbm_stopwatch_get_elapsed_time_us (&sw));
-	*/
+	return nr_llm_reqs;
+}
 
-	/* wait until Q in llm becomes empty 
+/* read the pages built by __bdbm_page_ftl_gc_build_reads () and write 
+ * their valid subpages to new locations */
+static void __bdbm_page_ftl_gc_copy (
+	bdbm_drv_info_t* bdi, 
+	uint64_t nr_llm_reqs)
+{
+	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	bdbm_hlm_req_gc_t* hlm_gc = &p->gc_hlm;
+	bdbm_hlm_req_gc_t* hlm_gc_w = &p->gc_hlm_w;
+	uint64_t i, k;
+
+	/* wait until Q in llm becomes empty; the last pages of a victim that 
+	 * has just been filled may still be waiting to be programmed 
 	 * TODO: it might be possible to further optimize this */
 	bdi->ptr_llm_inf->flush (bdi);
 
-	if (nr_llm_reqs == 0) 
-		goto erase_blks;
-
 	/* send read reqs to llm */
 	hlm_gc->req_type = REQTYPE_GC_READ;
 	hlm_gc->nr_llm_reqs = nr_llm_reqs;
@@ -941,9 +1336,20 @@ uint32_t bdbm_page_ftl_do_gc (bdbm_drv_info_t* bdi, int64_t lpa)
 	bdbm_sema_lock (&hlm_gc_w->done);
 	bdbm_sema_unlock (&hlm_gc_w->done);
 #endif
+}
+
+/* erase the victims; it is done once all of their valid pages are copied */
+static void __bdbm_page_ftl_gc_erase (bdbm_drv_info_t* bdi)
+{
+	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
+	bdbm_hlm_req_gc_t* hlm_gc = &p->gc_hlm;
+	uint64_t nr_gc_blks = p->nr_gc_blks;
+	uint64_t i;
+
+	/* wait until Q in llm becomes empty; host reads sent before the 
+	 * victims were copied may still read them */
+	bdi->ptr_llm_inf->flush (bdi);
 
-	/* erase blocks */
-erase_blks:
 	for (i = 0; i < nr_gc_blks; i++) {
 		bdbm_abm_block_t* b = p->gc_bab[i];
 		bdbm_llm_req_t* r = &hlm_gc->llm_reqs[i];
@@ -960,7 +1366,7 @@ erase_blks:
 
 	/* send erase reqs to llm */
 	hlm_gc->req_type = REQTYPE_GC_ERASE;
-	hlm_gc->nr_llm_reqs = p->nr_punits;
+	hlm_gc->nr_llm_reqs = nr_gc_blks;
 	atomic64_set (&hlm_gc->nr_llm_reqs_done, 0);
 	bdbm_sema_lock (&hlm_gc->done);
 	for (i = 0; i < nr_gc_blks; i++) {
@@ -980,6 +1386,75 @@ erase_blks:
 			ret = 1;	/* bad block */
 		bdbm_abm_erase_block (p->bai, b->channel_no, b->chip_no, b->block_no, ret);
 	}
+}
+
+/* leave the victims to the erase manager */
+static void __bdbm_page_ftl_gc_pend_erase (bdbm_drv_info_t* bdi)
+{
+	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
+	uint64_t i;
+
+	/* host reads sent before the victims were copied may still read them */
+	bdi->ptr_llm_inf->flush (bdi);
+
+	for (i = 0; i < p->nr_gc_blks; i++)
+		bdbm_abm_pend_erase_block (p->bai, p->gc_bab[i]);
+}
+
+/* GC runs in slices of gc_slice_pages page copies (0: all at once), so 
+ * host requests waiting for it are held for at most one slice. a cycle 
+ * picks a victim for every punit, copies their valid pages slice by slice 
+ * (pages invalidated by the host in between are skipped), and erases them 
+ * after the last one. between slices, the host writes gc_host_ratio pages 
+ * per page copied by gc unless free blocks run out */
+uint32_t bdbm_page_ftl_do_gc (bdbm_drv_info_t* bdi, int64_t lpa)
+{
+	bdbm_page_ftl_private_t* p = _ftl_page_ftl.ptr_private;
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	uint64_t nr_llm_reqs = 0;
+	uint64_t elapsed_us;
+	bdbm_stopwatch_t sw;
+
+	bdbm_stopwatch_start (&sw);
+
+	if (p->nr_gc_blks == 0) {
+		/* start a new cycle */
+		if (__bdbm_page_ftl_gc_select_victims (bdi) < p->nr_punits) {
+			/* TODO: we need to implement a load balancing feature to avoid this */
+			/*bdbm_warning ("TODO: this warning will be removed with load-balancing");*/
+			return 0;
+		}
+		p->nr_gc_blks = p->nr_punits;
+		p->gc_page = 0;
+		p->gc_blk = 0;
+		p->nr_gc_cycles++;
+	} else if (p->nr_alloc_pages < p->gc_next_slice && 
+			__bdbm_page_ftl_get_nr_free_blocks (p) > p->nr_punits * p->nr_planes) {
+		/* it is the turn of the host */
+		return 0;
+	}
+
+	/* copy a slice of valid pages */
+	nr_llm_reqs = __bdbm_page_ftl_gc_build_reads (bdi, 
+		p->gc_slice_pages > 0 ? p->gc_slice_pages : p->nr_punits_pages);
+	if (nr_llm_reqs > 0)
+		__bdbm_page_ftl_gc_copy (bdi, nr_llm_reqs);
+
+	/* erase the victims if all of them are copied */
+	if (p->gc_page == np->nr_pages_per_block) {
+		if (p->defer_erase)
+			__bdbm_page_ftl_gc_pend_erase (bdi);
+		else
+			__bdbm_page_ftl_gc_erase (bdi);
+		p->nr_gc_blks = 0;
+	}
+
+	p->gc_next_slice = p->nr_alloc_pages + p->gc_host_ratio * nr_llm_reqs;
+
+	p->nr_gc_slices++;
+	elapsed_us = bdbm_stopwatch_get_elapsed_time_us (&sw);
+	if (p->gc_slice_max_us < elapsed_us)
+		p->gc_slice_max_us = elapsed_us;
 
 	return 0;
 }
@@ -1024,7 +1499,9 @@ uint32_t bdbm_page_ftl_load (bdbm_drv_info_t* bdi, const char* fn)
 		return 1;
 	}
 	p->curr_puid = 0;
+	p->curr_plane = 0;
 	p->curr_page_ofs = 0;
+	bdbm_memset (p->ac_page_ofs, 0x00, sizeof (uint64_t) * p->nr_punits);
 
 	bdbm_fclose (fp);
 
@@ -1048,39 +1525,66 @@ uint32_t bdbm_page_ftl_store (bdbm_drv_info_t* bdi, const char* fn)
 		return 1;
 	}
 
-	while (1) {
-		/* get the channel & chip numbers */
-		i = p->curr_puid % np->nr_channels;
-		j = p->curr_puid / np->nr_channels;
-
-		/* get the physical offset of the active blocks */
-		b = p->ac_bab[i*np->nr_chips_per_channel + j];
-
-		/* invalidate remaining pages */
-		for (k = 0; k < np->nr_subpages_per_page; k++) {
-			bdbm_abm_invalidate_page (
-				p->bai, 
-				b->channel_no, 
-				b->chip_no, 
-				b->block_no, 
-				p->curr_page_ofs, 
-				k);
+	if (p->load_aware) {
+		/* active blocks of punits are at different pages; the planes of 
+		 * the punit chosen last may be partly used at its page */
+		uint64_t l, curr = -1ULL;
+		if (p->curr_plane > 0) {
+			curr = (p->curr_puid % np->nr_channels) * np->nr_chips_per_channel + 
+				p->curr_puid / np->nr_channels;
 		}
-		bdbm_bug_on (b->channel_no != i);
-		bdbm_bug_on (b->chip_no != j);
+		for (i = 0; i < p->nr_punits; i++) {
+			for (j = p->ac_page_ofs[i]; j < np->nr_pages_per_block; j++) {
+				l = (i == curr && j == p->ac_page_ofs[i]) ? p->curr_plane : 0;
+				for (; l < p->nr_planes; l++) {
+					b = p->ac_bab[i * p->nr_planes + l];
+					for (k = 0; k < np->nr_subpages_per_page; k++) {
+						bdbm_abm_invalidate_page (
+							p->bai, b->channel_no, b->chip_no, b->block_no, j, k);
+					}
+				}
+			}
+			p->ac_page_ofs[i] = 0;
+		}
+		p->curr_plane = 0;
+	} else {
+		while (1) {
+			/* get the channel & chip numbers */
+			i = p->curr_puid % np->nr_channels;
+			j = p->curr_puid / np->nr_channels;
+
+			/* get the physical offset of the active blocks */
+			for (; p->curr_plane < p->nr_planes; p->curr_plane++) {
+				b = p->ac_bab[(i*np->nr_chips_per_channel + j) * p->nr_planes + p->curr_plane];
+
+				/* invalidate remaining pages */
+				for (k = 0; k < np->nr_subpages_per_page; k++) {
+					bdbm_abm_invalidate_page (
+						p->bai, 
+						b->channel_no, 
+						b->chip_no, 
+						b->block_no, 
+						p->curr_page_ofs, 
+						k);
+				}
+				bdbm_bug_on (b->channel_no != i);
+				bdbm_bug_on (b->chip_no != j);
+			}
+			p->curr_plane = 0;
 
-		/* go to the next parallel unit */
-		if ((p->curr_puid + 1) == p->nr_punits) {
-			p->curr_puid = 0;
-			p->curr_page_ofs++;	/* go to the next page */
+			/* go to the next parallel unit */
+			if ((p->curr_puid + 1) == p->nr_punits) {
+				p->curr_puid = 0;
+				p->curr_page_ofs++;	/* go to the next page */
 
-			/* see if there are sufficient free pages or not */
-			if (p->curr_page_ofs == np->nr_pages_per_block) {
-				p->curr_page_ofs = 0;
-				break;
+				/* see if there are sufficient free pages or not */
+				if (p->curr_page_ofs == np->nr_pages_per_block) {
+					p->curr_page_ofs = 0;
+					break;
+				}
+			} else {
+				p->curr_puid++;
 			}
-		} else {
-			p->curr_puid++;
 		}
 	}
 
@@ -1225,7 +1729,9 @@ uint32_t bdbm_page_badblock_scan (bdbm_drv_info_t* bdi)
 		return 1;
 	}
 	p->curr_puid = 0;
+	p->curr_plane = 0;
 	p->curr_page_ofs = 0;
+	bdbm_memset (p->ac_page_ofs, 0x00, sizeof (uint64_t) * p->nr_punits);
 
 	bdbm_msg ("done");
 	 
@@ -1276,7 +1782,9 @@ uint32_t bdbm_page_badblock_scan (bdbm_drv_info_t* bdi)
 		return 1;
 	}
 	p->curr_puid = 0;
+	p->curr_plane = 0;
 	p->curr_page_ofs = 0;
+	bdbm_memset (p->ac_page_ofs, 0x00, sizeof (uint64_t) * p->nr_punits);
 
 	bdbm_msg ("[summary] Total: %llu, Free: %llu, Clean: %llu, Dirty: %llu",
 		bdbm_abm_get_nr_total_blocks (p->bai),
@@ -49,6 +49,8 @@ uint32_t bdbm_page_ftl_map_lpa_to_ppa (bdbm_drv_info_t* bdi, bdbm_logaddr_t* log
 uint32_t bdbm_page_ftl_invalidate_lpa (bdbm_drv_info_t* bdi, int64_t lpa, uint64_t len);
 uint8_t bdbm_page_ftl_is_gc_needed (bdbm_drv_info_t* bdi, int64_t lpa);
 uint32_t bdbm_page_ftl_do_gc (bdbm_drv_info_t* bdi, int64_t lpa);
+void bdbm_page_ftl_get_free_space (bdbm_drv_info_t* bdi, uint64_t* nr_free_blks, uint64_t* nr_total_blks);
+void bdbm_page_ftl_run_erases (bdbm_drv_info_t* bdi);
 uint32_t bdbm_page_badblock_scan (bdbm_drv_info_t* bdi);
 uint32_t bdbm_page_ftl_load (bdbm_drv_info_t* bdi, const char* fn);
 uint32_t bdbm_page_ftl_store (bdbm_drv_info_t* bdi, const char* fn);
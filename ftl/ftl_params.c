@@ -56,10 +56,70 @@ int _param_mapping_type				= MAPPING_POLICY_PAGE;
 /*int _param_llm_type					= LLM_MULTI_QUEUE;*/
 int _param_llm_type					= LLM_NO_QUEUE;
 int _param_hlm_type					= HLM_NO_BUFFER;
+int _param_hlm_nr_workers			= 1;
+int _param_hlm_queue_depth			= 256;
+int _param_llm_queue_depth			= 96;
+int _param_llm_write_deadline_us	= 10000;	/* 10 ms; 0: strict read priority */
+int _param_llm_suspend				= 0;	/* 0: disable (default), 1: enable */
+int _param_llm_read_forward			= 0;	/* 0: disable (default), 1: enable */
+int _param_hlm_wb_nr_pages			= 4096;	/* 16 MB with 4 KB pages */
+int _param_hlm_rcache_nr_pages		= 0;	/* 0: disable the read cache */
+int _param_hlm_throttle_free_pct	= 0;	/* 0: disable write throttling */
+int _param_hlm_merge_window_us		= 0;	/* 0: disable request merging */
+int _param_write_placement			= WRITE_PLACEMENT_ROUND_ROBIN;
+int _param_gc_slice_pages			= 0;	/* 0: gc copies all the victims at once */
+int _param_gc_host_ratio			= 1;
+int _param_gc_defer_erase			= 0;	/* 0: erase victims at once */
+int _param_gc_erase_floor			= 2;
+int _param_llm_nr_tenants			= 1;	/* 1: disable fair sharing */
+int _param_llm_tenant_weights[LLM_MAX_TENANTS];	/* 0: the default weight (1) */
+int _param_dftl_cache_policy		= DFTL_CACHE_POLICY_LRU;
+
+#if defined (KERNEL_MODE)
+module_param (_param_llm_type, int, 0000);
+MODULE_PARM_DESC (_param_llm_type, "LLM type (1: no queue, 2: multi-queue, 3: read-priority)");
+module_param (_param_hlm_nr_workers, int, 0000);
+MODULE_PARM_DESC (_param_hlm_nr_workers, "# of worker threads for the buffered HLM");
+module_param (_param_hlm_queue_depth, int, 0000);
+MODULE_PARM_DESC (_param_hlm_queue_depth, "# of requests buffered in HLM before submitters sleep");
+module_param (_param_llm_queue_depth, int, 0000);
+MODULE_PARM_DESC (_param_llm_queue_depth, "# of requests queued in LLM before submitters sleep");
+module_param (_param_llm_write_deadline_us, int, 0000);
+MODULE_PARM_DESC (_param_llm_write_deadline_us, "time (us) after which the read-priority LLM serves a waiting write before reads (0: never)");
+module_param (_param_llm_suspend, int, 0000);
+MODULE_PARM_DESC (_param_llm_suspend, "suspend programs/erases for waiting reads (multi-queue LLM; 0: disable, 1: enable)");
+module_param (_param_llm_read_forward, int, 0000);
+MODULE_PARM_DESC (_param_llm_read_forward, "serve reads from writes waiting in the queue (multi-queue LLM; 0: disable, 1: enable)");
+module_param (_param_hlm_wb_nr_pages, int, 0000);
+MODULE_PARM_DESC (_param_hlm_wb_nr_pages, "# of pages in the write-back buffer of HLM");
+module_param (_param_hlm_rcache_nr_pages, int, 0000);
+MODULE_PARM_DESC (_param_hlm_rcache_nr_pages, "# of pages in the read cache of HLM (0: disable)");
+module_param (_param_hlm_throttle_free_pct, int, 0000);
+MODULE_PARM_DESC (_param_hlm_throttle_free_pct, "free space (%) below which HLM throttles host writes (0: disable)");
+module_param (_param_hlm_merge_window_us, int, 0000);
+MODULE_PARM_DESC (_param_hlm_merge_window_us, "max. time (us) HLM holds requests to merge sequential ones (0: disable)");
+module_param (_param_write_placement, int, 0000);
+MODULE_PARM_DESC (_param_write_placement, "write placement of the page-level FTL (1: round-robin, 2: load-aware)");
+module_param (_param_gc_slice_pages, int, 0000);
+MODULE_PARM_DESC (_param_gc_slice_pages, "max. # of pages the page-level FTL copies in a gc slice (0: no slicing)");
+module_param (_param_gc_host_ratio, int, 0000);
+MODULE_PARM_DESC (_param_gc_host_ratio, "# of host pages written between gc slices per page copied");
+module_param (_param_gc_defer_erase, int, 0000);
+MODULE_PARM_DESC (_param_gc_defer_erase, "defer erases of gc victims to idle punits (0: disable, 1: enable)");
+module_param (_param_gc_erase_floor, int, 0000);
+MODULE_PARM_DESC (_param_gc_erase_floor, "# of free blocks of a chip below which deferred erases are forced");
+module_param (_param_llm_nr_tenants, int, 0000);
+MODULE_PARM_DESC (_param_llm_nr_tenants, "# of tenants sharing punits fairly in the multi-queue LLM (1: disable)");
+module_param_array (_param_llm_tenant_weights, int, NULL, 0000);
+MODULE_PARM_DESC (_param_llm_tenant_weights, "weights of tenants for their shares of punit time (e.g., 4,1,1)");
+module_param (_param_dftl_cache_policy, int, 0000);
+MODULE_PARM_DESC (_param_dftl_cache_policy, "how DFTL evicts map pages from DRAM (1: LRU, 2: 2Q, 3: ARC, 4: CLOCK-Pro)");
+#endif
 
 bdbm_ftl_params get_default_ftl_params (void)
 {
 	bdbm_ftl_params p;
+	int i;
 
 	/* setup driver parameters */
 	p.gc_policy = _param_gc_policy;
@@ -71,12 +131,33 @@ bdbm_ftl_params get_default_ftl_params (void)
 	p.mapping_type = _param_mapping_type;
 	p.llm_type = _param_llm_type;
 	p.hlm_type = _param_hlm_type;
+	p.hlm_nr_workers = _param_hlm_nr_workers;
+	p.hlm_queue_depth = _param_hlm_queue_depth;
+	p.llm_queue_depth = _param_llm_queue_depth;
+	p.llm_write_deadline_us = _param_llm_write_deadline_us;
+	p.llm_suspend = _param_llm_suspend;
+	p.llm_read_forward = _param_llm_read_forward;
+	p.hlm_wb_nr_pages = _param_hlm_wb_nr_pages;
+	p.hlm_rcache_nr_pages = _param_hlm_rcache_nr_pages;
+	p.hlm_throttle_free_pct = _param_hlm_throttle_free_pct;
+	p.hlm_merge_window_us = _param_hlm_merge_window_us;
+	p.write_placement = _param_write_placement;
+	p.gc_slice_pages = _param_gc_slice_pages;
+	p.gc_host_ratio = _param_gc_host_ratio;
+	p.gc_defer_erase = _param_gc_defer_erase;
+	p.gc_erase_floor = _param_gc_erase_floor;
+	p.llm_nr_tenants = _param_llm_nr_tenants;
+	for (i = 0; i < LLM_MAX_TENANTS; i++)
+		p.llm_tenant_weights[i] = _param_llm_tenant_weights[i] > 0 ? _param_llm_tenant_weights[i] : 1;
+	p.dftl_cache_policy = _param_dftl_cache_policy;
 
 	return p;
 }
 
 void display_ftl_params (bdbm_ftl_params* p)
 {
+	int i;
+
 	if (p == NULL) {
 		bdbm_msg ("oops! the parameters are not loaded properly");
 		return;
@@ -90,6 +171,50 @@ void display_ftl_params (bdbm_ftl_params* p)
 	bdbm_msg ("wl policy = %d (1: none, 2: swap)", p->wl_policy);
 	bdbm_msg ("trim mode = %d (1: enable, 2: disable)", p->trim);
 	bdbm_msg ("kernel sector = %d bytes", p->kernel_sector_size);
+	bdbm_msg ("llm type = %d (1: no queue, 2: multi-queue, 3: read-priority)", p->llm_type);
+	if (p->llm_type == LLM_READ_PRIORITY) {
+		bdbm_msg ("llm write deadline = %d us", p->llm_write_deadline_us);
+	}
+	if (p->llm_type == LLM_MULTI_QUEUE && p->llm_suspend) {
+		bdbm_msg ("llm program/erase suspend = enabled");
+	}
+	if (p->llm_type == LLM_MULTI_QUEUE && p->llm_read_forward) {
+		bdbm_msg ("llm read forwarding from queued writes = enabled");
+	}
+	if (p->llm_type == LLM_MULTI_QUEUE && p->llm_nr_tenants > 1) {
+		bdbm_msg ("llm fair sharing among %d tenants", p->llm_nr_tenants);
+		for (i = 0; i < p->llm_nr_tenants && i < LLM_MAX_TENANTS; i++)
+			bdbm_msg ("  tenant %d: weight = %d", i, p->llm_tenant_weights[i]);
+	}
+	if (p->mapping_type == MAPPING_POLICY_PAGE) {
+		bdbm_msg ("write placement = %d (1: round-robin, 2: load-aware)", p->write_placement);
+		if (p->gc_slice_pages > 0) {
+			bdbm_msg ("gc slices = %d pages, %d host pages per page copied", 
+				p->gc_slice_pages, p->gc_host_ratio);
+		}
+		if (p->gc_defer_erase) {
+			bdbm_msg ("gc erases = deferred (forced below %d free blocks of a chip)", p->gc_erase_floor);
+		}
+	}
+	if (p->mapping_type == MAPPING_POLICY_DFTL) {
+		bdbm_msg ("dftl cache policy = %d (1: LRU, 2: 2Q, 3: ARC, 4: CLOCK-Pro)", p->dftl_cache_policy);
+	}
+	if (p->hlm_type == HLM_BUFFER) {
+		bdbm_msg ("hlm workers = %d", p->hlm_nr_workers);
+	}
+	if (p->hlm_type == HLM_WRITE_BACK) {
+		bdbm_msg ("hlm write-back buffer = %d pages", p->hlm_wb_nr_pages);
+	}
+	if (p->hlm_type == HLM_NO_BUFFER && p->hlm_rcache_nr_pages > 0) {
+		bdbm_msg ("hlm read cache = %d pages", p->hlm_rcache_nr_pages);
+	}
+	if (p->hlm_type == HLM_NO_BUFFER && p->hlm_throttle_free_pct > 0) {
+		bdbm_msg ("hlm write throttling below %d%% free space", p->hlm_throttle_free_pct);
+	}
+	if (p->hlm_type == HLM_NO_BUFFER && p->hlm_merge_window_us > 0) {
+		bdbm_msg ("hlm request merging within %d us", p->hlm_merge_window_us);
+	}
+	bdbm_msg ("queue depth = %d (hlm), %d (llm)", p->hlm_queue_depth, p->llm_queue_depth);
 	bdbm_msg ("");
 }
 
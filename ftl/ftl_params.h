@@ -34,6 +34,24 @@ extern int _param_snapshot;
 extern int _param_mapping_type;
 extern int _param_llm_type;
 extern int _param_hlm_type;
+extern int _param_hlm_nr_workers;
+extern int _param_hlm_queue_depth;
+extern int _param_llm_queue_depth;
+extern int _param_llm_write_deadline_us;
+extern int _param_llm_suspend;
+extern int _param_llm_read_forward;
+extern int _param_hlm_wb_nr_pages;
+extern int _param_hlm_rcache_nr_pages;
+extern int _param_hlm_throttle_free_pct;
+extern int _param_hlm_merge_window_us;
+extern int _param_write_placement;
+extern int _param_gc_slice_pages;
+extern int _param_gc_host_ratio;
+extern int _param_gc_defer_erase;
+extern int _param_gc_erase_floor;
+extern int _param_llm_nr_tenants;
+extern int _param_llm_tenant_weights[LLM_MAX_TENANTS];
+extern int _param_dftl_cache_policy;
 
 bdbm_ftl_params get_default_ftl_params (void);
 void display_ftl_params (bdbm_ftl_params* p);
@@ -40,6 +40,8 @@ THE SOFTWARE.
 #include "hlm_nobuf.h"
 #include "hlm_buf.h"
 #include "uthread.h"
+#include "umemory.h"
+#include "ucredit.h"
 
 #include "algo/no_ftl.h"
 #include "algo/block_ftl.h"
@@ -56,40 +58,164 @@ bdbm_hlm_inf_t _hlm_buf_inf = {
 	.end_req = hlm_buf_end_req,
 };
 
+/* requests are steered to workers by LPA stripes; while a stripe has 
+ * requests in a worker, new requests for it go to the same worker, so that 
+ * requests for overlapping LPAs are handled in order */
+#define HLM_BUF_STRIPE_SIZE	1024	/* # of LPAs in a stripe */
+
+typedef struct {
+	uint32_t owner;	/* a worker that has requests for the stripe */
+	uint32_t refs;	/* # of requests for the stripe in the worker */
+} bdbm_hlm_buf_stripe_t;
+
+typedef struct {
+	bdbm_drv_info_t* bdi;
+	uint64_t id;
+	bdbm_thread_t* thread;
+} bdbm_hlm_buf_worker_t;
 
 /* data structures for hlm_buf */
 struct bdbm_hlm_buf_private {
 	bdbm_ftl_inf_t* ptr_ftl_inf;	/* for hlm_nobuff (it must be on top of this structure) */
 
-	/* for thread management */
+	/* for thread management; a queue per worker */
 	bdbm_queue_t* q;
-	bdbm_thread_t* hlm_thread;
+	uint64_t nr_workers;
+	bdbm_hlm_buf_worker_t* workers;
+	bdbm_credit_t credit;	/* for flow control of requests in q */
+
+	/* for request steering */
+	bdbm_spinlock_t stripe_lock;
+	uint64_t nr_stripes;
+	bdbm_hlm_buf_stripe_t* stripes;
+
+	/* FTL functions are not thread-safe */
+	bdbm_mutex_t ftl_lock;
 };
 
 
+static void __hlm_buf_get_stripes (
+	struct bdbm_hlm_buf_private* p,
+	bdbm_hlm_req_t* r, 
+	uint64_t* first,
+	uint64_t* last)
+{
+	uint64_t min_lpa = -1ULL, max_lpa = 0;
+	bdbm_llm_req_t* lr = NULL;
+	uint64_t i = 0;
+
+	if (bdbm_is_trim (r->req_type)) {
+		min_lpa = r->lpa;
+		max_lpa = (r->len > 0) ? r->lpa + r->len - 1 : r->lpa;
+	} else {
+		bdbm_hlm_for_each_llm_req (lr, r, i) {
+			if (lr->logaddr.lpa[0] < min_lpa)
+				min_lpa = lr->logaddr.lpa[0];
+			if (lr->logaddr.lpa[0] > max_lpa)
+				max_lpa = lr->logaddr.lpa[0];
+		}
+	}
+
+	*first = (min_lpa / HLM_BUF_STRIPE_SIZE) % p->nr_stripes;
+	*last = (max_lpa / HLM_BUF_STRIPE_SIZE) % p->nr_stripes;
+	if (*last < *first)
+		*last = *first;
+}
+
+/* pick a worker for the stripes and hold them; it returns -1 if the stripes 
+ * are held by different workers and the caller has to try again later */
+static int64_t __hlm_buf_hold_stripes (
+	struct bdbm_hlm_buf_private* p,
+	uint64_t first,
+	uint64_t last)
+{
+	int64_t wid = -1;
+	unsigned long flags;
+	uint64_t i;
+
+	bdbm_spin_lock_irqsave (&p->stripe_lock, flags);
+	for (i = first; i <= last; i++) {
+		if (p->stripes[i].refs == 0)
+			continue;
+		if (wid == -1) {
+			wid = p->stripes[i].owner;
+		} else if (wid != p->stripes[i].owner) {
+			bdbm_spin_unlock_irqrestore (&p->stripe_lock, flags);
+			return -1;
+		}
+	}
+	if (wid == -1)
+		wid = first % p->nr_workers;
+	for (i = first; i <= last; i++) {
+		p->stripes[i].owner = wid;
+		p->stripes[i].refs++;
+	}
+	bdbm_spin_unlock_irqrestore (&p->stripe_lock, flags);
+
+	return wid;
+}
+
+static void __hlm_buf_release_stripes (
+	struct bdbm_hlm_buf_private* p,
+	uint64_t first,
+	uint64_t last)
+{
+	unsigned long flags;
+	uint64_t i;
+
+	bdbm_spin_lock_irqsave (&p->stripe_lock, flags);
+	for (i = first; i <= last; i++) {
+		bdbm_bug_on (p->stripes[i].refs == 0);
+		p->stripes[i].refs--;
+	}
+	bdbm_spin_unlock_irqrestore (&p->stripe_lock, flags);
+}
+
 /* kernel thread for _llm_q */
 int __hlm_buf_thread (void* arg)
 {
-	bdbm_drv_info_t* bdi = (bdbm_drv_info_t*)arg;
+	bdbm_hlm_buf_worker_t* w = (bdbm_hlm_buf_worker_t*)arg;
+	bdbm_drv_info_t* bdi = w->bdi;
 	struct bdbm_hlm_buf_private* p = (struct bdbm_hlm_buf_private*)BDBM_HLM_PRIV(bdi);
 	bdbm_hlm_req_t* r;
+	uint64_t first, last;
+	uint32_t ret;
 
 	for (;;) {
-		if (bdbm_queue_is_all_empty (p->q)) {
-			if (bdbm_thread_schedule (p->hlm_thread) == SIGKILL) {
-				break;
+		/* go to sleep if Q is empty; check it again with the sleep lock 
+		 * held so that a wake-up sent in between is not lost */
+		if (bdbm_queue_is_empty (p->q, w->id)) {
+			bdbm_thread_schedule_setup (w->thread);
+			if (bdbm_queue_is_empty (p->q, w->id)) {
+				if (bdbm_thread_schedule_sleep (w->thread) == SIGKILL)
+					break;
+			} else {
+				bdbm_thread_schedule_cancel (w->thread);
 			}
 		}
 
 		/* if nothing is in Q, then go to the next punit */
-		while (!bdbm_queue_is_empty (p->q, 0)) {
-			if ((r = (bdbm_hlm_req_t*)bdbm_queue_dequeue (p->q, 0)) != NULL) {
-				if (hlm_nobuf_make_req (bdi, r)) {
+		while (!bdbm_queue_is_empty (p->q, w->id)) {
+			if ((r = (bdbm_hlm_req_t*)bdbm_queue_dequeue (p->q, w->id)) != NULL) {
+				bdbm_credit_release (&p->credit, 1);
+				__hlm_buf_get_stripes (p, r, &first, &last);
+
+				/* only FTL mapping is serialized among workers */
+				bdbm_mutex_lock (&p->ftl_lock);
+				ret = hlm_nobuf_map_req (bdi, r);
+				bdbm_mutex_unlock (&p->ftl_lock);
+
+				if (ret == 0)
+					ret = hlm_nobuf_submit_req (bdi, r);
+				if (ret) {
 					/* if it failed, we directly call 'ptr_host_inf->end_req' */
 					bdi->ptr_host_inf->end_req (bdi, r);
 					bdbm_warning ("oops! make_req failed");
 					/* [CAUTION] r is now NULL */
 				}
+
+				/* the following requests for the stripes can go to any worker */
+				__hlm_buf_release_stripes (p, first, last);
 			} else {
 				bdbm_error ("r == NULL");
 				bdbm_bug_on (1);
@@ -103,44 +229,94 @@ int __hlm_buf_thread (void* arg)
 /* interface functions for hlm_buf */
 uint32_t hlm_buf_create (bdbm_drv_info_t* bdi)
 {
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
 	struct bdbm_hlm_buf_private* p;
+	uint64_t i;
 
 	/* create private */
-	if ((p = (struct bdbm_hlm_buf_private*)bdbm_malloc_atomic
+	if ((p = (struct bdbm_hlm_buf_private*)bdbm_zmalloc
 			(sizeof(struct bdbm_hlm_buf_private))) == NULL) {
-		bdbm_error ("bdbm_malloc_atomic failed");
+		bdbm_error ("bdbm_zmalloc failed");
 		return 1;
 	}
 
 	/* setup FTL function pointers */
 	if ((p->ptr_ftl_inf = BDBM_GET_FTL_INF (bdi)) == NULL) {
 		bdbm_error ("ftl is not valid");
+		bdbm_free (p);
 		return 1;
 	}
 
-	/* create a single queue */
-	if ((p->q = bdbm_queue_create (1, INFINITE_QUEUE)) == NULL) {
+	p->nr_workers = BDBM_GET_DRIVER_PARAMS (bdi)->hlm_nr_workers;
+	if (p->nr_workers == 0)
+		p->nr_workers = 1;
+	bdbm_mutex_init (&p->ftl_lock);
+	bdbm_credit_init (&p->credit, 
+		BDBM_GET_DRIVER_PARAMS (bdi)->hlm_queue_depth > 0 ? 
+		BDBM_GET_DRIVER_PARAMS (bdi)->hlm_queue_depth : 256);
+
+	/* create stripes for request steering */
+	p->nr_stripes = np->nr_subpages_per_ssd / HLM_BUF_STRIPE_SIZE + 1;
+	if ((p->stripes = (bdbm_hlm_buf_stripe_t*)bdbm_zmalloc
+			(sizeof (bdbm_hlm_buf_stripe_t) * p->nr_stripes)) == NULL) {
+		bdbm_error ("bdbm_zmalloc failed");
+		goto fail;
+	}
+	bdbm_spin_lock_init (&p->stripe_lock);
+
+	/* create a queue for each worker */
+	if ((p->q = bdbm_queue_create (p->nr_workers, INFINITE_QUEUE)) == NULL) {
 		bdbm_error ("bdbm_queue_create failed");
-		return -1;
+		goto fail;
 	}
 
 	/* keep the private structure */
 	bdi->ptr_hlm_inf->ptr_private = (void*)p;
 
-	/* create & run a thread */
-	if ((p->hlm_thread = bdbm_thread_create (
-			__hlm_buf_thread, bdi, "__hlm_buf_thread")) == NULL) {
-		bdbm_error ("kthread_create failed");
-		return -1;
+	/* create & run threads */
+	if ((p->workers = (bdbm_hlm_buf_worker_t*)bdbm_zmalloc
+			(sizeof (bdbm_hlm_buf_worker_t) * p->nr_workers)) == NULL) {
+		bdbm_error ("bdbm_zmalloc failed");
+		goto fail;
+	}
+	for (i = 0; i < p->nr_workers; i++) {
+		bdbm_hlm_buf_worker_t* w = &p->workers[i];
+
+		w->bdi = bdi;
+		w->id = i;
+		if ((w->thread = bdbm_thread_create (
+				__hlm_buf_thread, w, "__hlm_buf_thread")) == NULL) {
+			bdbm_error ("kthread_create failed");
+			goto fail;
+		}
+		bdbm_thread_run (w->thread);
 	}
-	bdbm_thread_run (p->hlm_thread);
 
 	return 0;
+
+fail:
+	if (p->workers) {
+		for (i = 0; i < p->nr_workers; i++) {
+			if (p->workers[i].thread)
+				bdbm_thread_stop (p->workers[i].thread);
+		}
+		bdbm_free (p->workers);
+	}
+	if (p->q)
+		bdbm_queue_destroy (p->q);
+	if (p->stripes)
+		bdbm_free (p->stripes);
+	bdbm_credit_free (&p->credit);
+	bdbm_mutex_free (&p->ftl_lock);
+	bdbm_free (p);
+	bdi->ptr_hlm_inf->ptr_private = NULL;
+	return 1;
 }
 
 void hlm_buf_destroy (bdbm_drv_info_t* bdi)
 {
 	struct bdbm_hlm_buf_private* p = (struct bdbm_hlm_buf_private*)bdi->ptr_hlm_inf->ptr_private;
+	uint64_t i;
 
 	/* wait until Q becomes empty */
 	while (!bdbm_queue_is_all_empty (p->q)) {
@@ -148,14 +324,22 @@ void hlm_buf_destroy (bdbm_drv_info_t* bdi)
 		bdbm_thread_msleep (1);
 	}
 
-	/* kill kthread */
-	bdbm_thread_stop (p->hlm_thread);
+	/* kill kthreads */
+	for (i = 0; i < p->nr_workers; i++)
+		bdbm_thread_stop (p->workers[i].thread);
+	bdbm_free (p->workers);
 
 	/* destroy queue */
 	bdbm_queue_destroy (p->q);
 
 	/* free priv */
-	bdbm_free_atomic (p);
+	bdbm_msg ("hlm submitters slept %llu times for credits", 
+		bdbm_credit_get_nr_waits (&p->credit));
+	bdbm_credit_free (&p->credit);
+	bdbm_spin_lock_destory (&p->stripe_lock);
+	bdbm_mutex_free (&p->ftl_lock);
+	bdbm_free (p->stripes);
+	bdbm_free (p);
 }
 
 uint32_t hlm_buf_make_req (
@@ -164,6 +348,8 @@ uint32_t hlm_buf_make_req (
 {
 	uint32_t ret;
 	struct bdbm_hlm_buf_private* p = (struct bdbm_hlm_buf_private*)BDBM_HLM_PRIV(bdi);
+	uint64_t first, last;
+	int64_t wid;
 
 	if (bdbm_queue_is_full (p->q)) {
 		/* FIXME: wait unti queue has a enough room */
@@ -171,17 +357,24 @@ uint32_t hlm_buf_make_req (
 		bdbm_bug_on (1);
 	} 
 
-	while (bdbm_queue_get_nr_items (p->q) >= 256) {
+	/* sleep until the queues have a room */
+	bdbm_credit_acquire (&p->credit, 1);
+
+	/* find a worker for the request */
+	__hlm_buf_get_stripes (p, r, &first, &last);
+	while ((wid = __hlm_buf_hold_stripes (p, first, last)) == -1) {
 		bdbm_thread_yield ();
 	}
 	
 	/* put a request into Q */
-	if ((ret = bdbm_queue_enqueue (p->q, 0, (void*)r))) {
+	if ((ret = bdbm_queue_enqueue (p->q, wid, (void*)r))) {
 		bdbm_msg ("bdbm_queue_enqueue failed");
+		__hlm_buf_release_stripes (p, first, last);
+		bdbm_credit_release (&p->credit, 1);
 	}
 
 	/* wake up thread if it sleeps */
-	bdbm_thread_wakeup (p->hlm_thread);
+	bdbm_thread_wakeup (p->workers[wid].thread);
 
 	return ret;
 }
@@ -21,7 +21,6 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
-
 #if defined(KERNEL_MODE)
 #include <linux/module.h>
 #include <linux/blkdev.h>
@@ -40,14 +39,14 @@ THE SOFTWARE.
 #include "hlm_nobuf.h"
 #include "hlm_dftl.h"
 #include "uthread.h"
-
-#include "algo/no_ftl.h"
-#include "algo/block_ftl.h"
-#include "algo/page_ftl.h"
+#include "umemory.h"
+#include "ucredit.h"
 #include "queue/queue.h"
+#include "algo/dftl_map.h"
 
 
-/*#define USE_THREAD*/
+/* # of map pages evicted at once, or missed on by a trim before it sleeps */
+#define HLM_DFTL_MAX_MAPBLK_REQS BDBM_BLKIO_MAX_VECS
 
 /* interface for hlm_dftl */
 bdbm_hlm_inf_t _hlm_dftl_inf = {
@@ -58,287 +57,511 @@ bdbm_hlm_inf_t _hlm_dftl_inf = {
 	.end_req = hlm_dftl_end_req,
 };
 
+/* a request goes through three stages, each of which is run by a thread:
+ * (1) translation: reads of the map pages it misses on are sent to llm, but 
+ *     are not waited for; it moves on when the last of them is loaded
+ * (2) data I/O: it is mapped by the FTL (after foreground GC) and sent to llm
+ * (3) eviction: map pages are written back until they fit in DRAM
+ * so that the map-page reads of a request overlap with the data I/O and the 
+ * evictions of earlier ones. The stages are connected by bounded queues, and 
+ * at most hlm_queue_depth requests are in them */
+typedef struct {
+	bdbm_drv_info_t* bdi;
+	bdbm_hlm_req_t* hr;
+	atomic64_t nr_pending;	/* # of map pages it waits for (+1 while they are sent) */
+	bdbm_mapblk_waiter_t waiters[BDBM_BLKIO_MAX_VECS];	/* one for each llm_req */
+} bdbm_hlm_dftl_xlat_t;
+
 /* data structures for hlm_dftl */
 typedef struct {
 	bdbm_ftl_inf_t* ftl;	/* for hlm_nobuff (it must be on top of this structure) */
 
-	/* for thread management */
-	bdbm_queue_t* q;
-#ifdef USE_THREAD
-	bdbm_thread_t* hlm_thread;
-	bdbm_sema_t ftl_lock;
-#endif
+	/* for the stages */
+	bdbm_credit_t credit;	/* for flow control of requests in the pipeline */
+	bdbm_queue_t* xlat_q;	/* requests to translate */
+	bdbm_queue_t* io_q;		/* requests whose map pages are in DRAM */
+	bdbm_thread_t* xlat_thread;
+	bdbm_thread_t* io_thread;
+	bdbm_thread_t* evict_thread;
+	atomic64_t evict_needed;
+
+	/* FTL functions are not thread-safe; the lock is not held while map 
+	 * pages are read or written back */
+	bdbm_mutex_t ftl_lock;
+	atomic64_t nr_evicting;	/* # of map pages being written back */
+
+	/* map pages being evicted (by the eviction stage) */
+	bdbm_llm_req_t* mapblk_reqs[HLM_DFTL_MAX_MAPBLK_REQS];
+	uint32_t nr_mapblk_reqs;
+
+	/* map pages a trim waits for (in the data I/O stage) */
+	dftl_miss_group_t misses;
+	bdbm_mapblk_waiter_t waiters[HLM_DFTL_MAX_MAPBLK_REQS];
+	uint32_t nr_waiters;
+
+	/* statistics */
+	atomic64_t nr_reqs;
+	atomic64_t nr_retranslated;	/* requests whose map pages were evicted before they were mapped */
 } bdbm_hlm_dftl_private_t;
 
-#ifdef USE_THREAD
-/* kernel thread for _llm_q */
-int __hlm_dftl_thread (void* arg)
+
+/* a map page of x is in DRAM; x moves to the data I/O stage after the last one */
+static void __hlm_dftl_xlat_done (void* arg)
+{
+	bdbm_hlm_dftl_xlat_t* x = (bdbm_hlm_dftl_xlat_t*)arg;
+	bdbm_hlm_dftl_private_t* p = (bdbm_hlm_dftl_private_t*)BDBM_HLM_PRIV(x->bdi);
+
+	if (!atomic64_dec_and_test (&x->nr_pending))
+		return;
+
+	if (bdbm_queue_enqueue (p->io_q, 0, (void*)x)) {
+		bdbm_error ("bdbm_queue_enqueue failed");
+		bdbm_bug_on (1);
+	}
+	bdbm_thread_wakeup (p->io_thread);
+}
+
+/* let x wait for the map page of lpa; it is read by the first miss on it and 
+ * is finished by hlm_dftl_end_req. ftl_lock must be held */
+static void __hlm_dftl_wait_mapblk (
+	bdbm_drv_info_t* bdi,
+	bdbm_hlm_dftl_xlat_t* x,
+	uint64_t i,
+	uint64_t lpa)
 {
-	bdbm_drv_info_t* bdi = (bdbm_drv_info_t*)arg;
 	bdbm_hlm_dftl_private_t* p = (bdbm_hlm_dftl_private_t*)BDBM_HLM_PRIV(bdi);
-	bdbm_hlm_req_t* r = NULL;
+	bdbm_mapblk_waiter_t* w = &x->waiters[i];
+	bdbm_llm_req_t* r = NULL;
 
-	for (;;) {
-		/* Go to sleep if there are not requests in Q */
-		if (bdbm_queue_is_all_empty (p->q)) {
-			bdbm_thread_schedule_setup (p->hlm_thread);
-			if (bdbm_queue_is_all_empty (p->q)) {
-				if (bdbm_thread_schedule_sleep (p->hlm_thread) == SIGKILL) 
-					break;
-			} else {
-				bdbm_thread_schedule_cancel (p->hlm_thread);
-			}
-		}
+	atomic64_inc (&x->nr_pending);
+	w->wakeup = __hlm_dftl_xlat_done;
+	w->arg = (void*)x;
 
-		while (!bdbm_queue_is_empty (p->q, 0)) {
-			if ((r = (bdbm_hlm_req_t*)bdbm_queue_dequeue (p->q, 0)) != NULL) {
-			} else {
-				bdbm_error ("r == NULL");
-				bdbm_bug_on (1);
-			}
-		} 
+	if ((r = p->ftl->prepare_mapblk_load (bdi, lpa, w)) == NULL)
+		return;
+
+	if (bdi->ptr_llm_inf->make_req (bdi, r) != 0) {
+		bdbm_error ("oops! make_req () failed");
+		bdbm_bug_on (1);
 	}
+}
 
-	return 0;
+/* STAGE1: start loading the map pages that x misses on; it never waits for 
+ * flash. Each of them is looked up once, so that the cache counts it once */
+static void __hlm_dftl_translate (
+	bdbm_drv_info_t* bdi,
+	bdbm_hlm_dftl_xlat_t* x)
+{
+	bdbm_hlm_dftl_private_t* p = (bdbm_hlm_dftl_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_llm_req_t* lr = NULL;
+	uint64_t i;
+
+	atomic64_set (&x->nr_pending, 1);
+
+	bdbm_mutex_lock (&p->ftl_lock);
+	bdbm_hlm_for_each_llm_req (lr, x->hr, i) {
+		if (lr->logaddr.lpa[0] == -1)
+			continue;
+		if (p->ftl->check_mapblk (bdi, lr->logaddr.lpa[0]) == 0)
+			continue;
+		__hlm_dftl_wait_mapblk (bdi, x, i, lr->logaddr.lpa[0]);
+	}
+	bdbm_mutex_unlock (&p->ftl_lock);
+
+	__hlm_dftl_xlat_done ((void*)x);
 }
-#endif
 
-int __fetch_me_and_make_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* r)
+/* wait until no map page is being written back; GC and trims wait for map 
+ * pages with ftl_lock held, while the eviction stage needs it to finish 
+ * evictions. ftl_lock is held when it returns, so no eviction starts */
+static void __hlm_dftl_wait_evictions (
+	bdbm_drv_info_t* bdi)
 {
 	bdbm_hlm_dftl_private_t* p = (bdbm_hlm_dftl_private_t*)BDBM_HLM_PRIV(bdi);
-	int i = 0, nr_missed_dir = 0;
+
+	while (atomic64_read (&p->nr_evicting) > 0) {
+		bdbm_mutex_unlock (&p->ftl_lock);
+		bdbm_thread_yield ();
+		bdbm_mutex_lock (&p->ftl_lock);
+	}
+}
+
+/* start loading the map page of lpa for a trim if it is in flash; nothing 
+ * is mapped to lpas whose map pages are not written */
+static void __hlm_dftl_load_mapblk (
+	bdbm_drv_info_t* bdi, 
+	uint64_t lpa)
+{
+	bdbm_hlm_dftl_private_t* p = (bdbm_hlm_dftl_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_mapblk_waiter_t* w = NULL;
+	bdbm_llm_req_t* r = NULL;
+
+	if (p->ftl->check_mapblk (bdi, lpa) != 1)
+		return;
+
+	/* wait for earlier ones if there are too many */
+	if (p->nr_waiters == HLM_DFTL_MAX_MAPBLK_REQS) {
+		bdbm_dftl_miss_group_wait (&p->misses);
+		bdbm_dftl_miss_group_init (&p->misses);
+		p->nr_waiters = 0;
+	}
+	w = &p->waiters[p->nr_waiters++];
+	bdbm_dftl_miss_group_add (&p->misses, w);
+
+	if ((r = p->ftl->prepare_mapblk_load (bdi, lpa, w)) == NULL)
+		return;
+
+	/* it is finished by hlm_dftl_end_req */
+	if (bdi->ptr_llm_inf->make_req (bdi, r) != 0) {
+		bdbm_error ("oops! make_req () failed");
+		bdbm_bug_on (1);
+	}
+}
+
+/* load all the mapping entries that a trim needs; it sleeps once until all 
+ * of them are in DRAM. A trim can cover more map pages than a request has 
+ * waiters, so it is not translated by STAGE1. ftl_lock must be held */
+static void __hlm_dftl_load_mapblks (
+	bdbm_drv_info_t* bdi, 
+	bdbm_hlm_req_t* hr)
+{
+	bdbm_hlm_dftl_private_t* p = (bdbm_hlm_dftl_private_t*)BDBM_HLM_PRIV(bdi);
+	uint64_t i;
+
+	__hlm_dftl_wait_evictions (bdi);
+
+	bdbm_dftl_miss_group_init (&p->misses);
+	p->nr_waiters = 0;
+	for (i = 0; i < hr->len; i++)
+		__hlm_dftl_load_mapblk (bdi, hr->lpa + i);
+	bdbm_dftl_miss_group_wait (&p->misses);
+}
+
+/* STAGE2: map x and send it to llm. Its map pages could be evicted after 
+ * STAGE1; if so, they are loaded again and x comes back here later */
+static void __hlm_dftl_submit (
+	bdbm_drv_info_t* bdi,
+	bdbm_hlm_dftl_xlat_t* x)
+{
+	bdbm_hlm_dftl_private_t* p = (bdbm_hlm_dftl_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_hlm_req_t* hr = x->hr;
+	bdbm_llm_req_t* lr = NULL;
+	uint32_t ret, loop;
+	uint64_t i;
+
+	bdbm_mutex_lock (&p->ftl_lock);
 
 	/* see if foreground GC is needed or not */
-	for (i = 0; i < 10; i++) {
-		if ((r->req_type == REQTYPE_WRITE || r->req_type == REQTYPE_READ) &&
-			 p->ftl->is_gc_needed != NULL && 
-			 p->ftl->is_gc_needed (bdi)) {
+	for (loop = 0; loop < 10; loop++) {
+		if (hr->req_type == REQTYPE_WRITE &&
+			p->ftl->is_gc_needed != NULL && 
+			p->ftl->is_gc_needed (bdi, 0)) {
 			/* perform GC before sending requests */ 
-			p->ftl->do_gc (bdi);
+			__hlm_dftl_wait_evictions (bdi);
+			p->ftl->do_gc (bdi, 0);
 		} else
 			break;
 	}
-	if (i > 1) {
-		bdbm_msg ("GC invokation: %d", i);
-	}
 
-	/* STEP1: read missing mapping entries */
-	nr_missed_dir = r->len;
-	{
-		bdbm_llm_req_t** rr = (bdbm_llm_req_t**)bdbm_malloc (sizeof (bdbm_llm_req_t*) * nr_missed_dir);
-
-		/* FIXME: need to improve to exploit parallelism */
-		memset (rr, 0x00, sizeof (bdbm_llm_req_t*) * nr_missed_dir);
-		for (i = 0; i < nr_missed_dir; i++) {
-			/* check the availability of mapping entries again */
-			if (p->ftl->check_mapblk (bdi, r->lpa + i) == 0)
-				continue;
-
-			/* fetch mapping entries to DRAM from Flash */
-			if ((rr[i] = p->ftl->prepare_mapblk_load (bdi, r->lpa + i)) == NULL)
-				continue;
-
-			/* send read requets to llm */
-			bdbm_sema_lock (rr[i]->done);
-			bdi->ptr_llm_inf->make_req (bdi, rr[i]);
+	if (bdbm_is_trim (hr->req_type)) {
+		__hlm_dftl_load_mapblks (bdi, hr);
+	} else if (!bdbm_is_flush (hr->req_type)) {
+		atomic64_set (&x->nr_pending, 1);
+		bdbm_hlm_for_each_llm_req (lr, hr, i) {
+			if (lr->logaddr.lpa[0] != -1)
+				__hlm_dftl_wait_mapblk (bdi, x, i, lr->logaddr.lpa[0]);
 		}
-		for (i = 0; i < nr_missed_dir; i++) {
-			if (rr[i]) {
-				bdbm_sema_lock (rr[i]->done);
-				p->ftl->finish_mapblk_load (bdi, rr[i]);
-			}
+		if (!atomic64_dec_and_test (&x->nr_pending)) {
+			bdbm_mutex_unlock (&p->ftl_lock);
+			atomic64_inc (&p->nr_retranslated);
+			return;
 		}
-		bdbm_free (rr);
 	}
 
-	/* STEP2: send origianl requests to llm */
-	if (hlm_nobuf_make_req (bdi, r)) {
+	ret = hlm_nobuf_map_req (bdi, hr);
+	bdbm_mutex_unlock (&p->ftl_lock);
+
+	bdbm_free_atomic (x);
+	if (ret == 0)
+		ret = hlm_nobuf_submit_req (bdi, hr);
+	if (ret) {
 		/* if it failed, we directly call 'ptr_host_inf->end_req' */
-		bdi->ptr_host_inf->end_req (bdi, r);
+		bdi->ptr_host_inf->end_req (bdi, hr);
 		bdbm_warning ("oops! make_req failed");
-		/* [CAUTION] r is now NULL */
+		/* [CAUTION] hr is now NULL */
 	}
+	atomic64_inc (&p->nr_reqs);
+	bdbm_credit_release (&p->credit, 1);
 
-	/* STEP4: evict mapping entries if there is not enough DRAM space */
-	{
-		bdbm_llm_req_t** rr = (bdbm_llm_req_t**)bdbm_malloc (sizeof (bdbm_llm_req_t*) * nr_missed_dir);
+	/* see if map pages have to be evicted */
+	atomic64_set (&p->evict_needed, 1);
+	bdbm_thread_wakeup (p->evict_thread);
+}
 
-		memset (rr, 0x00, sizeof (bdbm_llm_req_t*) * nr_missed_dir);
-		for (i = 0; i < nr_missed_dir; i++) {
-#include "algo/dftl_map.h"
-			directory_slot_t* ds;
+/* STAGE3: write map pages back to flash until they fit in DRAM; ftl_lock is 
+ * not held while they are written, and misses on them wait until they are 
+ * finished */
+static void __hlm_dftl_evict_mapblks (
+	bdbm_drv_info_t* bdi)
+{
+	bdbm_hlm_dftl_private_t* p = (bdbm_hlm_dftl_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_llm_req_t* r = NULL;
+	uint32_t i;
+
+	do {
+		bdbm_mutex_lock (&p->ftl_lock);
+		p->nr_mapblk_reqs = 0;
+		while (p->nr_mapblk_reqs < HLM_DFTL_MAX_MAPBLK_REQS &&
+			   (r = p->ftl->prepare_mapblk_eviction (bdi)) != NULL)
+			p->mapblk_reqs[p->nr_mapblk_reqs++] = r;
+		atomic64_add (p->nr_mapblk_reqs, &p->nr_evicting);
+		bdbm_mutex_unlock (&p->ftl_lock);
+
+		/* send them to llm; they are waited for here */
+		for (i = 0; i < p->nr_mapblk_reqs; i++) {
+			r = p->mapblk_reqs[i];
+			bdbm_sema_lock (r->done);
+			if (bdi->ptr_llm_inf->make_req (bdi, r) != 0) {
+				bdbm_error ("oops! make_req () failed");
+				bdbm_bug_on (1);
+			}
+		}
+		for (i = 0; i < p->nr_mapblk_reqs; i++) {
+			r = p->mapblk_reqs[i];
+			bdbm_sema_lock (r->done);
+			bdbm_sema_unlock (r->done);
+		}
+
+		bdbm_mutex_lock (&p->ftl_lock);
+		for (i = 0; i < p->nr_mapblk_reqs; i++)
+			p->ftl->finish_mapblk_eviction (bdi, p->mapblk_reqs[i]);
+		atomic64_sub (p->nr_mapblk_reqs, &p->nr_evicting);
+		bdbm_mutex_unlock (&p->ftl_lock);
+	} while (p->nr_mapblk_reqs == HLM_DFTL_MAX_MAPBLK_REQS);
+}
+
+static int __hlm_dftl_xlat_thread (void* arg)
+{
+	bdbm_drv_info_t* bdi = (bdbm_drv_info_t*)arg;
+	bdbm_hlm_dftl_private_t* p = (bdbm_hlm_dftl_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_hlm_dftl_xlat_t* x = NULL;
+
+	for (;;) {
+		/* go to sleep if Q is empty; check it again with the sleep lock 
+		 * held so that a wake-up sent in between is not lost */
+		if (bdbm_queue_is_empty (p->xlat_q, 0)) {
+			bdbm_thread_schedule_setup (p->xlat_thread);
+			if (bdbm_queue_is_empty (p->xlat_q, 0)) {
+				if (bdbm_thread_schedule_sleep (p->xlat_thread) == SIGKILL)
+					break;
+			} else {
+				bdbm_thread_schedule_cancel (p->xlat_thread);
+			}
+		}
+
+		while ((x = (bdbm_hlm_dftl_xlat_t*)bdbm_queue_dequeue (p->xlat_q, 0)) != NULL)
+			__hlm_dftl_translate (bdi, x);
+	}
 
-			/* drop mapping enries to Flash */
-			if ((rr[i] = p->ftl->prepare_mapblk_eviction (bdi)) == NULL)
-				break;
+	return 0;
+}
+
+static int __hlm_dftl_io_thread (void* arg)
+{
+	bdbm_drv_info_t* bdi = (bdbm_drv_info_t*)arg;
+	bdbm_hlm_dftl_private_t* p = (bdbm_hlm_dftl_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_hlm_dftl_xlat_t* x = NULL;
 
-			/* send a req to llm */
-			ds = (directory_slot_t*)rr[i]->ds;
-			if (ds->status != DFTL_DIR_CLEAN) {
-				bdbm_sema_lock (rr[i]->done);
-				bdi->ptr_llm_inf->make_req (bdi, rr[i]);
+	for (;;) {
+		if (bdbm_queue_is_empty (p->io_q, 0)) {
+			bdbm_thread_schedule_setup (p->io_thread);
+			if (bdbm_queue_is_empty (p->io_q, 0)) {
+				if (bdbm_thread_schedule_sleep (p->io_thread) == SIGKILL)
+					break;
+			} else {
+				bdbm_thread_schedule_cancel (p->io_thread);
 			}
 		}
 
-		for (i = 0; i < nr_missed_dir; i++) {
-			if (rr[i]) {
-				bdbm_sema_lock (rr[i]->done);
-				p->ftl->finish_mapblk_eviction (bdi, rr[i]);
+		while ((x = (bdbm_hlm_dftl_xlat_t*)bdbm_queue_dequeue (p->io_q, 0)) != NULL)
+			__hlm_dftl_submit (bdi, x);
+	}
+
+	return 0;
+}
+
+static int __hlm_dftl_evict_thread (void* arg)
+{
+	bdbm_drv_info_t* bdi = (bdbm_drv_info_t*)arg;
+	bdbm_hlm_dftl_private_t* p = (bdbm_hlm_dftl_private_t*)BDBM_HLM_PRIV(bdi);
+
+	for (;;) {
+		if (atomic64_read (&p->evict_needed) == 0) {
+			bdbm_thread_schedule_setup (p->evict_thread);
+			if (atomic64_read (&p->evict_needed) == 0) {
+				if (bdbm_thread_schedule_sleep (p->evict_thread) == SIGKILL)
+					break;
+			} else {
+				bdbm_thread_schedule_cancel (p->evict_thread);
 			}
 		}
 
-		bdbm_free (rr);
+		atomic64_set (&p->evict_needed, 0);
+		__hlm_dftl_evict_mapblks (bdi);
 	}
 
 	return 0;
 }
 
+static void __hlm_dftl_free_private (bdbm_hlm_dftl_private_t* p)
+{
+	/* kill kthreads; the eviction stage goes last, since the others wake it up */
+	if (p->xlat_thread)
+		bdbm_thread_stop (p->xlat_thread);
+	if (p->io_thread)
+		bdbm_thread_stop (p->io_thread);
+	if (p->evict_thread)
+		bdbm_thread_stop (p->evict_thread);
+
+	if (p->xlat_q)
+		bdbm_queue_destroy (p->xlat_q);
+	if (p->io_q)
+		bdbm_queue_destroy (p->io_q);
+	bdbm_credit_free (&p->credit);
+	bdbm_mutex_free (&p->ftl_lock);
+	bdbm_free (p);
+}
+
 /* interface functions for hlm_dftl */
 uint32_t hlm_dftl_create (bdbm_drv_info_t* bdi)
 {
 	bdbm_hlm_dftl_private_t* p;
+	int64_t depth;
 
 	/* create private */
-	if ((p = (bdbm_hlm_dftl_private_t*)bdbm_malloc_atomic
+	if ((p = (bdbm_hlm_dftl_private_t*)bdbm_zmalloc
 			(sizeof(bdbm_hlm_dftl_private_t))) == NULL) {
-		bdbm_error ("bdbm_malloc_atomic failed");
+		bdbm_error ("bdbm_zmalloc failed");
 		return 1;
 	}
 
 	/* setup FTL function pointers */
 	if ((p->ftl= BDBM_GET_FTL_INF (bdi)) == NULL) {
 		bdbm_error ("ftl is not valid");
+		bdbm_free (p);
 		return 1;
 	}
 
-	/* create a single queue */
-	if ((p->q = bdbm_queue_create (1, INFINITE_QUEUE)) == NULL) {
-		bdbm_error ("bdbm_queue_create failed");
-		return -1;
+	/* hlm_dftl moves map pages with the FTL */
+	if (p->ftl->check_mapblk == NULL || 
+		p->ftl->prepare_mapblk_load == NULL ||
+		p->ftl->prepare_mapblk_eviction == NULL) {
+		bdbm_error ("the FTL does not manage map pages; use it with DFTL");
+		bdbm_free (p);
+		return 1;
 	}
 
+	depth = BDBM_GET_DRIVER_PARAMS (bdi)->hlm_queue_depth > 0 ? 
+		BDBM_GET_DRIVER_PARAMS (bdi)->hlm_queue_depth : 256;
+	bdbm_credit_init (&p->credit, depth);
+	bdbm_mutex_init (&p->ftl_lock);
+	atomic64_set (&p->evict_needed, 0);
+	atomic64_set (&p->nr_evicting, 0);
+	atomic64_set (&p->nr_reqs, 0);
+	atomic64_set (&p->nr_retranslated, 0);
+
 	/* keep the private structure */
 	bdi->ptr_hlm_inf->ptr_private = (void*)p;
 
-#ifdef USE_THREAD
-	bdbm_sema_init (&p->ftl_lock);
+	/* a request is in one of the queues at a time, so they never overflow */
+	if ((p->xlat_q = bdbm_queue_create (1, depth)) == NULL ||
+		(p->io_q = bdbm_queue_create (1, depth)) == NULL) {
+		bdbm_error ("bdbm_queue_create failed");
+		goto fail;
+	}
 
-	/* create & run a thread */
-	if ((p->hlm_thread = bdbm_thread_create (
-			__hlm_dftl_thread, bdi, "__hlm_dftl_thread")) == NULL) {
+	/* create & run threads for the stages */
+	if ((p->xlat_thread = bdbm_thread_create (
+			__hlm_dftl_xlat_thread, bdi, "__hlm_dftl_xlat_thread")) == NULL ||
+		(p->io_thread = bdbm_thread_create (
+			__hlm_dftl_io_thread, bdi, "__hlm_dftl_io_thread")) == NULL ||
+		(p->evict_thread = bdbm_thread_create (
+			__hlm_dftl_evict_thread, bdi, "__hlm_dftl_evict_thread")) == NULL) {
 		bdbm_error ("kthread_create failed");
-		return -1;
+		goto fail;
 	}
-	bdbm_thread_run (p->hlm_thread);
-#endif
+	bdbm_thread_run (p->xlat_thread);
+	bdbm_thread_run (p->io_thread);
+	bdbm_thread_run (p->evict_thread);
 
 	return 0;
+
+fail:
+	__hlm_dftl_free_private (p);
+	bdi->ptr_hlm_inf->ptr_private = NULL;
+	return 1;
 }
 
 void hlm_dftl_destroy (bdbm_drv_info_t* bdi)
 {
 	bdbm_hlm_dftl_private_t* p = (bdbm_hlm_dftl_private_t*)bdi->ptr_hlm_inf->ptr_private;
 
-	/* wait until Q becomes empty */
-	while (!bdbm_queue_is_all_empty (p->q)) {
-		bdbm_msg ("hlm items = %llu", bdbm_queue_get_nr_items (p->q));
+	if (p == NULL)
+		return;
+
+	/* wait until the pipeline becomes empty */
+	while (bdbm_credit_get_nr_available (&p->credit) < p->credit.max_credits) {
+		bdbm_msg ("hlm items = %lld", 
+			p->credit.max_credits - bdbm_credit_get_nr_available (&p->credit));
 		bdbm_thread_msleep (1);
 	}
 
-#ifdef USE_THREAD
-	bdbm_sema_free (&p->ftl_lock);
-
-	/* kill kthread */
-	bdbm_thread_stop (p->hlm_thread);
-#endif
-
-	/* destroy queue */
-	bdbm_queue_destroy (p->q);
+	bdbm_msg ("hlm_dftl: %lld reqs, %lld of them translated again, submitters slept %llu times for credits", 
+		atomic64_read (&p->nr_reqs),
+		atomic64_read (&p->nr_retranslated),
+		bdbm_credit_get_nr_waits (&p->credit));
 
 	/* free priv */
-	bdbm_free_atomic (p);
+	__hlm_dftl_free_private (p);
+	bdi->ptr_hlm_inf->ptr_private = NULL;
 }
 
 uint32_t hlm_dftl_make_req (
 	bdbm_drv_info_t* bdi, 
-	bdbm_hlm_req_t* r)
+	bdbm_hlm_req_t* hr)
 {
-	uint32_t ret, i, loop;
-	uint32_t avail = 0;
 	bdbm_hlm_dftl_private_t* p = (bdbm_hlm_dftl_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_hlm_dftl_xlat_t* x = NULL;
+	uint32_t ret;
 
-	/*bdbm_stopwatch_t sw;*/
-	/*bdbm_stopwatch_start (&sw);*/
-
-	if (bdbm_queue_is_full (p->q)) {
-		/* FIXME: wait unti queue has a enough room */
-		bdbm_error ("it should not be happened!");
-		bdbm_bug_on (1);
-	} 
-
-	/*bdbm_msg ("%llu %llu", r->lpa, r->len);*/
-
-	/* see if mapping entries for hlm_req are available */
-#ifdef USE_THREAD
-	bdbm_sema_lock (&p->ftl_lock);
-#endif
-
-	/* see if foreground GC is needed or not */
-	for (loop = 0; loop < 10; loop++) {
-		if ((r->req_type == REQTYPE_WRITE || r->req_type == REQTYPE_READ) &&
-			 p->ftl->is_gc_needed != NULL && 
-			 p->ftl->is_gc_needed (bdi)) {
-			p->ftl->do_gc (bdi);
-		} else
-			break;
+	if (hr->nr_llm_reqs > BDBM_BLKIO_MAX_VECS) {
+		bdbm_error ("too many llm_reqs (%llu)", hr->nr_llm_reqs);
+		return 1;
 	}
-
-	/* see if there are missing entries */
-	if (r->req_type == REQTYPE_WRITE ||
-		r->req_type == REQTYPE_READ) {
-		for (i = 0; i < r->len; i++) {
-			if ((avail = p->ftl->check_mapblk (bdi, r->lpa + i)) == 1)
-				break;
-		}
-	} else if (r->req_type == REQTYPE_TRIM) {
-		/* don't fetch mapping entries for TRIM */
-	} else {
-		bdbm_msg ("oops! invalid req_type (%d)", r->req_type);
-		bdbm_bug_on (1);
+	if ((x = (bdbm_hlm_dftl_xlat_t*)bdbm_malloc_atomic 
+			(sizeof (bdbm_hlm_dftl_xlat_t))) == NULL) {
+		bdbm_error ("bdbm_malloc_atomic failed");
+		return 1;
 	}
+	x->bdi = bdi;
+	x->hr = hr;
 
-	/* handle hlm_req */
-	if (avail == 0) {
-		/* If all of the mapping entries are available, send a hlm_req to llm directly */
-		/*bdbm_msg ("main-3");*/
-		if ((ret = hlm_nobuf_make_req (bdi, r))) {
-			/* if it failed, we directly call 'ptr_host_inf->end_req' */
-			bdi->ptr_host_inf->end_req (bdi, r);
-			bdbm_warning ("oops! make_req failed");
-			/* [CAUTION] r is now NULL */
-		}
+	/* sleep until the pipeline has a room */
+	bdbm_credit_acquire (&p->credit, 1);
+
+	/* trims and flushes have no map pages to translate */
+	if (bdbm_is_trim (hr->req_type) || bdbm_is_flush (hr->req_type)) {
+		if ((ret = bdbm_queue_enqueue (p->io_q, 0, (void*)x)) == 0)
+			bdbm_thread_wakeup (p->io_thread);
 	} else {
-#ifdef USE_THREAD
-		/* If some of the mapping entries are *not* available, put a hlm_req to queue. 
-		 * This allows other incoming requests not to be affected by a hlm_req
-		 * with missing mapping entries */
-		bdbm_msg ("put queue");
-		if ((ret = bdbm_queue_enqueue (p->q, 0, (void*)r))) {
-			bdbm_msg ("bdbm_queue_enqueue failed");
-		}
-#endif
-		ret = __fetch_me_and_make_req (bdi, r);
+		if ((ret = bdbm_queue_enqueue (p->xlat_q, 0, (void*)x)) == 0)
+			bdbm_thread_wakeup (p->xlat_thread);
+	}
+	if (ret) {
+		bdbm_msg ("bdbm_queue_enqueue failed");
+		bdbm_credit_release (&p->credit, 1);
+		bdbm_free_atomic (x);
 	}
-
-#ifdef USE_THREAD
-	bdbm_sema_unlock (&p->ftl_lock);
-
-	/* wake up thread if it sleeps */
-	bdbm_thread_wakeup (p->hlm_thread);
-#endif
-
-	/*bdbm_msg ("%llu us +", */
-	/*bdbm_stopwatch_get_elapsed_time_us (&sw));*/
 
 	return ret;
 }
@@ -347,11 +570,17 @@ void hlm_dftl_end_req (
 	bdbm_drv_info_t* bdi, 
 	bdbm_llm_req_t* r)
 {
-	if (r->done && r->ds) {
-		/* FIXME: r->done is set to not NULL for mapblk */
+	/* map pages are also read and written back by the FTL itself (e.g., by 
+	 * bdbm_dftl_store after hlm is destroyed), so they do not use hlm's data */
+	if (bdbm_is_meta (r->req_type) && bdbm_is_read (r->req_type)) {
+		/* a map page is loaded; it wakes up the requests waiting for it */
+		bdi->ptr_ftl_inf->finish_mapblk_load (bdi, r);
+		return;
+	}
+	if (bdbm_is_meta (r->req_type)) {
+		/* map pages being evicted are waited for by the eviction stage */
 		bdbm_sema_unlock (r->done);
 		return;
 	}
 	hlm_nobuf_end_req (bdi, r);
 }
-
@@ -33,8 +33,6 @@ uint32_t hlm_dftl_create (bdbm_drv_info_t* bdi);
 void hlm_dftl_destroy (bdbm_drv_info_t* bdi);
 uint32_t hlm_dftl_make_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* req);
 void hlm_dftl_end_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* req);
-uint32_t hlm_dftl_load (bdbm_drv_info_t* bdi, const char* fn);
-uint32_t hlm_dftl_store (bdbm_drv_info_t* bdi, const char* fn);
 
 #endif
 
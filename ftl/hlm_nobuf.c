@@ -39,8 +39,10 @@ THE SOFTWARE.
 #include "bdbm_drv.h"
 #include "hlm_nobuf.h"
 #include "hlm_reqs_pool.h"
+#include "hlm_rcache.h"
 #include "utime.h"
 #include "umemory.h"
+#include "uthread.h"
 
 #include "algo/no_ftl.h"
 #include "algo/block_ftl.h"
@@ -52,21 +54,415 @@ bdbm_hlm_inf_t _hlm_nobuf_inf = {
 	.ptr_private = NULL,
 	.create = hlm_nobuf_create,
 	.destroy = hlm_nobuf_destroy,
-	.make_req = hlm_nobuf_make_req,
-	.end_req = hlm_nobuf_end_req,
+	.make_req = hlm_nobuf_make_cached_req,
+	.end_req = hlm_nobuf_end_cached_req,
 	/*.load = hlm_nobuf_load,*/
 	/*.store = hlm_nobuf_store,*/
 };
 
+/* write throttling; once free space drops below the target, host writes 
+ * are paced by a token bucket whose refill rate shrinks as free space 
+ * approaches the level at which the FTL starts GC */
+#define HLM_NOBUF_GC_FREE_PCT			2		/* same as page_ftl */
+#define HLM_NOBUF_THROTTLE_WINDOW_US	100000	/* reclaim rate sampling */
+#define HLM_NOBUF_THROTTLE_MAX_DELAY_MS	100
+
+typedef struct {
+	bdbm_spinlock_t lock;
+	uint64_t target_bp;			/* target free space (0.01%); 0: disabled */
+	uint64_t gc_bp;				/* free space at which GC starts (0.01%) */
+	int64_t tokens;				/* # of pages that can be written; < 0 is debt */
+	bdbm_stopwatch_t sw_refill;
+	uint64_t last_free_blks;
+	uint64_t reclaimed_blks;	/* # of blocks reclaimed in the window */
+	bdbm_stopwatch_t sw_window;
+	uint64_t reclaim_rate;		/* pages/sec reclaimed by GC (moving average) */
+	uint64_t nr_delays;
+	uint64_t delay_ms;
+} bdbm_hlm_nobuf_throttle_t;
+
+/* merging of sequential requests; LPA-contiguous requests of the same 
+ * type that arrive within a short window go to the FTL and llm as one 
+ * request, and each original request ends as soon as its own pages are done */
+#define HLM_NOBUF_NR_MERGES	4
+
+typedef struct {
+	bdbm_hlm_req_t hr;		/* llm_reqs are copies of those of the original requests */
+	struct list_head list;
+	bdbm_stopwatch_t sw;	/* started when the first request is added */
+	uint64_t nr_hrs;		/* # of original requests */
+} bdbm_hlm_nobuf_merge_t;
+
+typedef struct {
+	uint64_t window_us;		/* latency budget; 0: disabled */
+	bdbm_mutex_t lock;		/* serializes the FTL between make_req and the thread */
+	bdbm_spinlock_t free_lock;
+	struct list_head free_list;
+	bdbm_hlm_nobuf_merge_t* merges;
+	bdbm_hlm_nobuf_merge_t* pending;	/* being filled; NULL if there is none */
+	bdbm_thread_t* thread;
+	uint64_t nr_merged;		/* # of requests sent as a part of others */
+	uint64_t nr_batches;
+} bdbm_hlm_nobuf_merger_t;
+
 /* data structures for hlm_nobuf */
 typedef struct {
 	bdbm_hlm_req_t tmp_hr;
+	bdbm_hlm_rcache_t* rcache;	/* NULL if the read cache is disabled */
+	bdbm_hlm_nobuf_throttle_t throttle;
+	bdbm_hlm_nobuf_merger_t merger;
 } bdbm_hlm_nobuf_private_t;
 
 
+static void __hlm_nobuf_throttle_init (
+	bdbm_drv_info_t* bdi, 
+	bdbm_hlm_nobuf_throttle_t* t)
+{
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	bdbm_ftl_params* dp = BDBM_GET_DRIVER_PARAMS (bdi);
+	uint64_t half = np->nr_pages_per_block / 2;
+	uint64_t gc_us;
+
+	if (dp->hlm_throttle_free_pct == 0)
+		return;
+	if (dp->hlm_throttle_free_pct <= HLM_NOBUF_GC_FREE_PCT ||
+		dp->hlm_throttle_free_pct >= 100) {
+		bdbm_warning ("write throttling needs a target between %d%% and 100%%; disable it",
+			HLM_NOBUF_GC_FREE_PCT);
+		return;
+	}
+
+	bdbm_spin_lock_init (&t->lock);
+	t->target_bp = dp->hlm_throttle_free_pct * 100;
+	t->gc_bp = HLM_NOBUF_GC_FREE_PCT * 100;
+	t->tokens = BDBM_BLKIO_MAX_VECS;
+	t->last_free_blks = np->nr_blocks_per_ssd;
+	bdbm_stopwatch_start (&t->sw_refill);
+	bdbm_stopwatch_start (&t->sw_window);
+
+	/* until GC is observed, assume that every parallel unit reclaims a 
+	 * half-valid block in the time it takes to copy and erase it */
+	gc_us = half * (np->page_read_time_us + np->page_prog_time_us) + np->block_erase_time_us;
+	if (gc_us == 0)
+		gc_us = 1;
+	t->reclaim_rate = BDBM_GET_NR_PUNITS (bdi->parm_dev) * half * 1000000 / gc_us;
+	if (t->reclaim_rate == 0)
+		t->reclaim_rate = 1;
+}
+
+/* delay a write of 'nr_pages' pages; it returns the time slept in ms */
+static uint64_t __hlm_nobuf_throttle (
+	bdbm_drv_info_t* bdi, 
+	bdbm_hlm_nobuf_throttle_t* t, 
+	uint64_t nr_pages)
+{
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	bdbm_ftl_inf_t* ftl = BDBM_GET_FTL_INF (bdi);
+	uint64_t nr_free_blks, nr_total_blks, free_bp, pressure_bp, rate;
+	int64_t elapsed_us, delay_ms = 0;
+	unsigned long flags;
+
+	if (t->target_bp == 0 || ftl->get_free_space == NULL)
+		return 0;
+
+	ftl->get_free_space (bdi, &nr_free_blks, &nr_total_blks);
+	if (nr_total_blks == 0)
+		return 0;
+	free_bp = nr_free_blks * 10000 / nr_total_blks;
+
+	bdbm_spin_lock_irqsave (&t->lock, flags);
+
+	/* free blocks only grow when GC erases them; update the reclaim rate
+	 * once per window, but only if GC was actually running */
+	if (nr_free_blks > t->last_free_blks)
+		t->reclaimed_blks += nr_free_blks - t->last_free_blks;
+	t->last_free_blks = nr_free_blks;
+	elapsed_us = bdbm_stopwatch_get_elapsed_time_us (&t->sw_window);
+	if (elapsed_us >= HLM_NOBUF_THROTTLE_WINDOW_US) {
+		if (t->reclaimed_blks > 0) {
+			uint64_t sample = t->reclaimed_blks * np->nr_pages_per_block * 1000000 / elapsed_us;
+			t->reclaim_rate = (t->reclaim_rate * 3 + sample) / 4;
+			if (t->reclaim_rate == 0)
+				t->reclaim_rate = 1;
+		}
+		t->reclaimed_blks = 0;
+		bdbm_stopwatch_start (&t->sw_window);
+	}
+
+	/* enough free space; let a burst through right away */
+	if (free_bp >= t->target_bp) {
+		t->tokens = BDBM_BLKIO_MAX_VECS;
+		bdbm_stopwatch_start (&t->sw_refill);
+		bdbm_spin_unlock_irqrestore (&t->lock, flags);
+		return 0;
+	}
+
+	/* the allowed write rate goes down to the reclaim rate as free space 
+	 * falls from the target to the GC threshold */
+	if (free_bp <= t->gc_bp)
+		pressure_bp = 10000;
+	else
+		pressure_bp = (t->target_bp - free_bp) * 10000 / (t->target_bp - t->gc_bp);
+	if (pressure_bp == 0)
+		pressure_bp = 1;
+	rate = t->reclaim_rate * 10000 / pressure_bp;
+
+	/* refill tokens and take ours */
+	elapsed_us = bdbm_stopwatch_get_elapsed_time_us (&t->sw_refill);
+	bdbm_stopwatch_start (&t->sw_refill);
+	if (elapsed_us > HLM_NOBUF_THROTTLE_WINDOW_US)
+		elapsed_us = HLM_NOBUF_THROTTLE_WINDOW_US;
+	t->tokens += rate * elapsed_us / 1000000;
+	if (t->tokens > BDBM_BLKIO_MAX_VECS)
+		t->tokens = BDBM_BLKIO_MAX_VECS;
+	t->tokens -= nr_pages;
+
+	/* in debt; wait until the bucket would be refilled */
+	if (t->tokens < 0) {
+		delay_ms = (-t->tokens) * 1000 / rate;
+		if (delay_ms > HLM_NOBUF_THROTTLE_MAX_DELAY_MS)
+			delay_ms = HLM_NOBUF_THROTTLE_MAX_DELAY_MS;
+		if (delay_ms > 0) {
+			t->nr_delays++;
+			t->delay_ms += delay_ms;
+		}
+	}
+
+	bdbm_spin_unlock_irqrestore (&t->lock, flags);
+
+	if (delay_ms > 0)
+		bdbm_thread_msleep (delay_ms);
+
+	return delay_ms;
+}
+
+static void __hlm_nobuf_throttle_display (bdbm_hlm_nobuf_throttle_t* t)
+{
+	if (t->target_bp == 0)
+		return;
+
+	bdbm_msg ("[hlm_nobuf] throttle: %llu delays, %llu ms in total, reclaim rate = %llu pages/s",
+		t->nr_delays, t->delay_ms, t->reclaim_rate);
+}
+
+static uint8_t __hlm_nobuf_merge_can_append (
+	bdbm_hlm_nobuf_merge_t* mg, 
+	bdbm_hlm_req_t* hr)
+{
+	bdbm_llm_req_t* last = &mg->hr.llm_reqs[mg->hr.nr_llm_reqs - 1];
+
+	if (mg->hr.req_type != hr->req_type || mg->hr.tenant_id != hr->tenant_id)
+		return 0;
+	if (mg->hr.nr_llm_reqs + hr->nr_llm_reqs > BDBM_BLKIO_MAX_VECS)
+		return 0;
+	if (hr->llm_reqs[0].logaddr.lpa[0] != last->logaddr.lpa[0] + 1)
+		return 0;
+	return 1;
+}
+
+static void __hlm_nobuf_merge_append (
+	bdbm_hlm_nobuf_merge_t* mg, 
+	bdbm_hlm_req_t* hr)
+{
+	/* llm_reqs still point to the original request, so completions go 
+	 * back to it; their buffers stay owned by the original request */
+	bdbm_memcpy (&mg->hr.llm_reqs[mg->hr.nr_llm_reqs], hr->llm_reqs, 
+		sizeof (bdbm_llm_req_t) * hr->nr_llm_reqs);
+	mg->hr.nr_llm_reqs += hr->nr_llm_reqs;
+	mg->nr_hrs++;
+}
+
+/* send the pending request to flash; merger->lock must be held */
+static void __hlm_nobuf_merge_submit (bdbm_drv_info_t* bdi)
+{
+	bdbm_hlm_nobuf_private_t* p = (bdbm_hlm_nobuf_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_hlm_nobuf_merger_t* m = &p->merger;
+	bdbm_hlm_nobuf_merge_t* mg = m->pending;
+
+	if (mg == NULL)
+		return;
+	m->pending = NULL;
+
+	m->nr_merged += mg->nr_hrs - 1;
+	m->nr_batches++;
+
+	if (hlm_nobuf_map_req (bdi, &mg->hr) != 0) {
+		bdbm_error ("hlm_nobuf_map_req failed");
+		bdbm_bug_on (1);
+	}
+	/* mg can be recycled before it returns */
+	hlm_nobuf_submit_req (bdi, &mg->hr);
+}
+
+/* a merged request is recycled when all of its llm_reqs are done */
+static uint8_t __hlm_nobuf_merge_end_req (
+	bdbm_hlm_nobuf_merger_t* m, 
+	bdbm_llm_req_t* lr)
+{
+	bdbm_hlm_nobuf_merge_t* mg;
+	unsigned long flags;
+	uint64_t ofs;
+
+	if (m->merges == NULL ||
+		(uint8_t*)lr < (uint8_t*)m->merges ||
+		(uint8_t*)lr >= (uint8_t*)(m->merges + HLM_NOBUF_NR_MERGES))
+		return 0;
+
+	ofs = ((uint8_t*)lr - (uint8_t*)m->merges) / sizeof (bdbm_hlm_nobuf_merge_t);
+	mg = &m->merges[ofs];
+
+	bdbm_spin_lock_irqsave (&m->free_lock, flags);
+	atomic64_inc (&mg->hr.nr_llm_reqs_done);
+	if (atomic64_read (&mg->hr.nr_llm_reqs_done) == mg->hr.nr_llm_reqs)
+		list_add_tail (&mg->list, &m->free_list);
+	bdbm_spin_unlock_irqrestore (&m->free_lock, flags);
+
+	return 1;
+}
+
+/* make_req with merging; merger->lock must be held */
+static uint32_t __hlm_nobuf_make_merged_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* hr)
+{
+	bdbm_hlm_nobuf_private_t* p = (bdbm_hlm_nobuf_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_hlm_nobuf_merger_t* m = &p->merger;
+	bdbm_hlm_nobuf_merge_t* mg = NULL;
+	unsigned long flags;
+
+	if (m->window_us == 0)
+		return hlm_nobuf_make_req (bdi, hr);
+
+	/* trims and flushes must not overtake pending requests */
+	if (bdbm_is_trim (hr->req_type) || bdbm_is_flush (hr->req_type)) {
+		__hlm_nobuf_merge_submit (bdi);
+		return hlm_nobuf_make_req (bdi, hr);
+	}
+
+	/* append it to the pending request if it is contiguous */
+	if (m->pending && __hlm_nobuf_merge_can_append (m->pending, hr)) {
+		__hlm_nobuf_merge_append (m->pending, hr);
+		if (m->pending->hr.nr_llm_reqs == BDBM_BLKIO_MAX_VECS ||
+			bdbm_stopwatch_get_elapsed_time_us (&m->pending->sw) >= m->window_us)
+			__hlm_nobuf_merge_submit (bdi);
+		return 0;
+	}
+	__hlm_nobuf_merge_submit (bdi);
+
+	/* start a new pending request */
+	bdbm_spin_lock_irqsave (&m->free_lock, flags);
+	if (!list_empty (&m->free_list)) {
+		mg = list_entry (m->free_list.next, bdbm_hlm_nobuf_merge_t, list);
+		list_del (&mg->list);
+	}
+	bdbm_spin_unlock_irqrestore (&m->free_lock, flags);
+	if (mg == NULL)
+		return hlm_nobuf_make_req (bdi, hr);	/* all of them are in flight */
+
+	mg->hr.req_type = hr->req_type;
+	mg->hr.tenant_id = hr->tenant_id;
+	mg->hr.nr_llm_reqs = 0;
+	atomic64_set (&mg->hr.nr_llm_reqs_done, 0);
+	mg->nr_hrs = 0;
+	bdbm_stopwatch_start (&mg->sw);
+	__hlm_nobuf_merge_append (mg, hr);
+	m->pending = mg;
+
+	/* the thread sends it when the window is closed */
+	bdbm_thread_wakeup (m->thread);
+
+	return 0;
+}
+
+int __hlm_nobuf_merge_thread (void* arg)
+{
+	bdbm_drv_info_t* bdi = (bdbm_drv_info_t*)arg;
+	bdbm_hlm_nobuf_private_t* p = (bdbm_hlm_nobuf_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_hlm_nobuf_merger_t* m = &p->merger;
+
+	for (;;) {
+		if (m->pending == NULL) {
+			if (bdbm_thread_schedule (m->thread) == SIGKILL)
+				break;
+			continue;
+		}
+
+		bdbm_thread_msleep (1);
+
+		bdbm_mutex_lock (&m->lock);
+		if (m->pending && 
+			bdbm_stopwatch_get_elapsed_time_us (&m->pending->sw) >= m->window_us)
+			__hlm_nobuf_merge_submit (bdi);
+		bdbm_mutex_unlock (&m->lock);
+	}
+
+	return 0;
+}
+
+static uint32_t __hlm_nobuf_merge_init (
+	bdbm_drv_info_t* bdi, 
+	bdbm_hlm_nobuf_merger_t* m)
+{
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	bdbm_ftl_params* dp = BDBM_GET_DRIVER_PARAMS (bdi);
+	uint64_t i;
+
+	bdbm_mutex_init (&m->lock);
+	if (dp->hlm_merge_window_us == 0)
+		return 0;
+	if (np->nr_subpages_per_page != 1) {
+		bdbm_warning ("request merging does not support sub-pages; disable it");
+		return 0;
+	}
+
+	if ((m->merges = (bdbm_hlm_nobuf_merge_t*)bdbm_zmalloc 
+			(sizeof (bdbm_hlm_nobuf_merge_t) * HLM_NOBUF_NR_MERGES)) == NULL) {
+		bdbm_error ("bdbm_zmalloc failed");
+		bdbm_mutex_free (&m->lock);
+		return 1;
+	}
+	bdbm_spin_lock_init (&m->free_lock);
+	INIT_LIST_HEAD (&m->free_list);
+	for (i = 0; i < HLM_NOBUF_NR_MERGES; i++)
+		list_add_tail (&m->merges[i].list, &m->free_list);
+
+	if ((m->thread = bdbm_thread_create (
+			__hlm_nobuf_merge_thread, bdi, "__hlm_nobuf_merge_thread")) == NULL) {
+		bdbm_error ("kthread_create failed");
+		bdbm_spin_lock_destory (&m->free_lock);
+		bdbm_free (m->merges);
+		m->merges = NULL;
+		bdbm_mutex_free (&m->lock);
+		return 1;
+	}
+	m->window_us = dp->hlm_merge_window_us;
+
+	return 0;
+}
+
+static void __hlm_nobuf_merge_destroy (
+	bdbm_drv_info_t* bdi, 
+	bdbm_hlm_nobuf_merger_t* m)
+{
+	if (m->window_us > 0) {
+		bdbm_mutex_lock (&m->lock);
+		__hlm_nobuf_merge_submit (bdi);
+		bdbm_mutex_unlock (&m->lock);
+
+		bdbm_thread_stop (m->thread);
+		bdbm_spin_lock_destory (&m->free_lock);
+		bdbm_free (m->merges);
+
+		bdbm_msg ("[hlm_nobuf] merge: %llu requests merged into %llu batches",
+			m->nr_merged, m->nr_batches);
+	}
+	bdbm_mutex_free (&m->lock);
+}
+
+
 /* functions for hlm_nobuf */
 uint32_t hlm_nobuf_create (bdbm_drv_info_t* bdi)
 {
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	bdbm_ftl_params* dp = BDBM_GET_DRIVER_PARAMS (bdi);
 	bdbm_hlm_nobuf_private_t* p;
 
 	/* create private */
@@ -76,9 +472,34 @@ uint32_t hlm_nobuf_create (bdbm_drv_info_t* bdi)
 		return 1;
 	}
 
+	/* create the read cache */
+	if (dp->hlm_rcache_nr_pages > 0) {
+		if (np->nr_subpages_per_page != 1) {
+			bdbm_warning ("the read cache does not support sub-pages; disable it");
+		} else if ((p->rcache = bdbm_hlm_rcache_create (dp->hlm_rcache_nr_pages)) == NULL) {
+			bdbm_error ("bdbm_hlm_rcache_create failed");
+			bdbm_free (p);
+			return 1;
+		}
+	}
+
+	/* set up write throttling */
+	__hlm_nobuf_throttle_init (bdi, &p->throttle);
+
 	/* keep the private structure */
 	bdi->ptr_hlm_inf->ptr_private = (void*)p;
 
+	/* set up request merging; the thread needs the private structure */
+	if (__hlm_nobuf_merge_init (bdi, &p->merger) != 0) {
+		if (p->rcache)
+			bdbm_hlm_rcache_destroy (p->rcache);
+		bdbm_free (p);
+		bdi->ptr_hlm_inf->ptr_private = NULL;
+		return 1;
+	}
+	if (p->merger.window_us > 0)
+		bdbm_thread_run (p->merger.thread);
+
 	return 0;
 }
 
@@ -86,6 +507,20 @@ void hlm_nobuf_destroy (bdbm_drv_info_t* bdi)
 {
 	bdbm_hlm_nobuf_private_t* p = (bdbm_hlm_nobuf_private_t*)BDBM_HLM_PRIV(bdi);
 
+	/* send pending requests and stop merging */
+	__hlm_nobuf_merge_destroy (bdi, &p->merger);
+
+	/* display throttling stats */
+	__hlm_nobuf_throttle_display (&p->throttle);
+	if (p->throttle.target_bp > 0)
+		bdbm_spin_lock_destory (&p->throttle.lock);
+
+	/* free the read cache */
+	if (p->rcache) {
+		bdbm_hlm_rcache_display (p->rcache);
+		bdbm_hlm_rcache_destroy (p->rcache);
+	}
+
 	/* free priv */
 	bdbm_free (p);
 }
@@ -102,7 +537,7 @@ uint32_t __hlm_nobuf_make_trim_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* ptr_hl
 	return 0;
 }
 
-uint32_t __hlm_nobuf_make_rw_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* hr)
+uint32_t __hlm_nobuf_map_rw_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* hr)
 {
 	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS(bdi);
 	bdbm_ftl_inf_t* ftl = BDBM_GET_FTL_INF(bdi);
@@ -168,6 +603,17 @@ uint32_t __hlm_nobuf_make_rw_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* hr)
 		}
 	}
 
+	return 0;
+
+fail:
+	return 1;
+}
+
+uint32_t __hlm_nobuf_submit_rw_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* hr)
+{
+	bdbm_llm_req_t* lr = NULL;
+	uint64_t i = 0;
+
 	/* (3) send llm_req to llm */
 	if (bdi->ptr_llm_inf->make_reqs == NULL) {
 		/* send individual llm-reqs to llm */
@@ -188,9 +634,6 @@ uint32_t __hlm_nobuf_make_rw_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* hr)
 	bdbm_bug_on (hr->nr_llm_reqs != i);
 
 	return 0;
-
-fail:
-	return 1;
 }
 
 /* TODO: it must be more general... */
@@ -203,6 +646,9 @@ void __hlm_nobuf_check_ondemand_gc (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* hr)
 		uint32_t loop;
 		/* see if foreground GC is needed or not */
 		for (loop = 0; loop < 10; loop++) {
+			/* let the FTL erase gc victims first; they count as free blocks */
+			if (hr->req_type == REQTYPE_WRITE && ftl->run_erases != NULL)
+				ftl->run_erases (bdi);
 			if (hr->req_type == REQTYPE_WRITE && 
 				ftl->is_gc_needed != NULL && 
 				ftl->is_gc_needed (bdi, 0)) {
@@ -260,18 +706,109 @@ uint32_t hlm_nobuf_make_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* hr)
 #endif
 
 	/* perform i/o */
+	if ((ret = hlm_nobuf_map_req (bdi, hr)) == 0)
+		ret = hlm_nobuf_submit_req (bdi, hr);
+
+	return ret;
+}
+
+/* the first half of make_req; it does all the work with the FTL, so 
+ * callers running it concurrently must serialize it */
+uint32_t hlm_nobuf_map_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* hr)
+{
+	if (bdbm_is_trim (hr->req_type))
+		return __hlm_nobuf_make_trim_req (bdi, hr);
+	if (bdbm_is_flush (hr->req_type))
+		return 0;	/* nothing is buffered here */
+
+	/* do we need to do garbage collection? */
+	__hlm_nobuf_check_ondemand_gc (bdi, hr);
+
+	return __hlm_nobuf_map_rw_req (bdi, hr);
+}
+
+/* the second half of make_req; it sends a mapped request to llm */
+uint32_t hlm_nobuf_submit_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* hr)
+{
+	if (bdbm_is_trim (hr->req_type) || bdbm_is_flush (hr->req_type)) {
+		/* call 'ptr_host_inf->end_req' directly */
+		bdi->ptr_host_inf->end_req (bdi, hr);
+		/* hr is now NULL */
+		return 0;
+	}
+
+	return __hlm_nobuf_submit_rw_req (bdi, hr);
+}
+
+static uint32_t __hlm_nobuf_make_cached_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* hr)
+{
+	bdbm_hlm_nobuf_private_t* p = (bdbm_hlm_nobuf_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_llm_req_t* lr = NULL;
+	uint8_t hits[BDBM_BLKIO_MAX_VECS];
+	uint64_t i = 0, nr_hits = 0;
+	uint32_t ret;
+
+	if (p->rcache == NULL || bdbm_is_flush (hr->req_type))
+		return __hlm_nobuf_make_merged_req (bdi, hr);
+
 	if (bdbm_is_trim (hr->req_type)) {
-		if ((ret = __hlm_nobuf_make_trim_req (bdi, hr)) == 0) {
-			/* call 'ptr_host_inf->end_req' directly */
-			bdi->ptr_host_inf->end_req (bdi, hr);
-			/* hr is now NULL */
+		bdbm_hlm_rcache_trim (p->rcache, hr->lpa, hr->len);
+		return __hlm_nobuf_make_merged_req (bdi, hr);
+	}
+
+	if (bdbm_is_write (hr->req_type)) {
+		bdbm_hlm_for_each_llm_req (lr, hr, i) {
+			bdbm_hlm_rcache_write (p->rcache, lr);
 		}
-	} else {
-		/* do we need to do garbage collection? */
-		__hlm_nobuf_check_ondemand_gc (bdi, hr);
+		return __hlm_nobuf_make_merged_req (bdi, hr);
+	}
+
+	/* read pages from the cache if they are there */
+	bdbm_hlm_for_each_llm_req (lr, hr, i) {
+		hits[i] = bdbm_hlm_rcache_read (p->rcache, lr, (void*)hr);
+		nr_hits += hits[i];
+	}
+	if (nr_hits == hr->nr_llm_reqs) {
+		bdi->ptr_host_inf->end_req (bdi, hr);
+		return 0;
+	}
 
-		ret = __hlm_nobuf_make_rw_req (bdi, hr);
-	} 
+	/* a pending write may hold newer data of a page missed in the cache 
+	 * (e.g., its entry was evicted), so it must be mapped first */
+	__hlm_nobuf_merge_submit (bdi);
+
+	if ((ret = hlm_nobuf_map_req (bdi, hr)) != 0)
+		return ret;
+
+	/* pages found in the cache don't go to flash */
+	if (nr_hits > 0) {
+		bdbm_hlm_for_each_llm_req (lr, hr, i) {
+			if (hits[i])
+				lr->req_type = REQTYPE_READ_DUMMY;
+		}
+	}
+
+	return hlm_nobuf_submit_req (bdi, hr);
+}
+
+/* make_req of hlm_nobuf; writes are throttled, the read cache is looked 
+ * up, and sequential requests are merged before they go to flash. Other 
+ * HLMs reuse hlm_nobuf_make_req () without any of them. */
+uint32_t hlm_nobuf_make_cached_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* hr)
+{
+	bdbm_hlm_nobuf_private_t* p = (bdbm_hlm_nobuf_private_t*)BDBM_HLM_PRIV(bdi);
+	uint32_t ret;
+
+	/* pace host writes when free space is running low */
+	if (bdbm_is_write (hr->req_type))
+		__hlm_nobuf_throttle (bdi, &p->throttle, hr->nr_llm_reqs);
+
+	if (p->merger.window_us == 0)
+		return __hlm_nobuf_make_cached_req (bdi, hr);
+
+	bdbm_mutex_lock (&p->merger.lock);
+	ret = __hlm_nobuf_make_cached_req (bdi, hr);
+	bdbm_mutex_unlock (&p->merger.lock);
 
 	return ret;
 }
@@ -311,3 +848,19 @@ void hlm_nobuf_end_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* lr)
 	}
 }
 
+void hlm_nobuf_end_cached_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* lr)
+{
+	bdbm_hlm_nobuf_private_t* p = (bdbm_hlm_nobuf_private_t*)BDBM_HLM_PRIV(bdi);
+
+	/* keep pages read from flash in the cache */
+	if (p->rcache != NULL && 
+		bdbm_is_normal (lr->req_type) && 
+		bdbm_is_read (lr->req_type)) {
+		bdbm_hlm_rcache_fill (p->rcache, lr, lr->ptr_hlm_req);
+	}
+
+	hlm_nobuf_end_req (bdi, lr);
+
+	/* recycle a merged request if it is done */
+	__hlm_nobuf_merge_end_req (&p->merger, lr);
+}
@@ -32,7 +32,11 @@ extern bdbm_hlm_inf_t _hlm_nobuf_inf;
 uint32_t hlm_nobuf_create (bdbm_drv_info_t* bdi);
 void hlm_nobuf_destroy (bdbm_drv_info_t* bdi);
 uint32_t hlm_nobuf_make_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* req);
+uint32_t hlm_nobuf_make_cached_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* req);
+uint32_t hlm_nobuf_map_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* req);
+uint32_t hlm_nobuf_submit_req (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* req);
 void hlm_nobuf_end_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* req);
+void hlm_nobuf_end_cached_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* req);
 
 #endif
 
@@ -0,0 +1,356 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2015 CSAIL, MIT
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#if defined(KERNEL_MODE)
+#include <linux/module.h>
+#include <linux/blkdev.h>
+
+#elif defined(USER_MODE)
+#include <stdio.h>
+#include <stdint.h>
+
+#else
+#error Invalid Platform (KERNEL_MODE or USER_MODE)
+#endif
+
+#include "debug.h"
+#include "bdbm_drv.h"
+#include "hlm_rcache.h"
+#include "umemory.h"
+#include "usync.h"
+
+
+#define HLM_RCACHE_PAGE_SIZE	(KPAGE_SIZE * BDBM_MAX_PAGES)
+
+enum {
+	HLM_RCACHE_FREE = 0,
+	HLM_RCACHE_FILLING,	/* a read for the page is in progress */
+	HLM_RCACHE_VALID,
+};
+
+static inline bdbm_hlm_rcache_shard_t* __hlm_rcache_get_shard (
+	bdbm_hlm_rcache_t* rc, 
+	int64_t lpa)
+{
+	return &rc->shards[lpa % HLM_RCACHE_NR_SHARDS];
+}
+
+static uint8_t __hlm_rcache_is_full_page (bdbm_llm_req_t* lr)
+{
+	uint64_t i;
+
+	for (i = 0; i < BDBM_MAX_PAGES; i++) {
+		if (lr->fmain.kp_stt[i] != KP_STT_DATA)
+			return 0;
+	}
+	return 1;
+}
+
+static void __hlm_rcache_remove (
+	bdbm_hlm_rcache_shard_t* s, 
+	bdbm_hlm_rcache_entry_t* e)
+{
+	HASH_DEL (s->ht, e);
+	list_del (&e->list);
+	if (e->is_protected)
+		s->nr_protected--;
+	e->lpa = -1;
+	e->status = HLM_RCACHE_FREE;
+	e->is_protected = 0;
+	e->owner = NULL;
+	list_add_tail (&e->list, &s->free_list);
+}
+
+/* a page is referenced again; move it to the MRU end of the protected 
+ * segment, demoting the LRU page of the segment if it is full */
+static void __hlm_rcache_touch (
+	bdbm_hlm_rcache_shard_t* s, 
+	bdbm_hlm_rcache_entry_t* e)
+{
+	bdbm_hlm_rcache_entry_t* d = NULL;
+
+	list_del (&e->list);
+	list_add_tail (&e->list, &s->protected_list);
+	if (e->is_protected)
+		return;
+
+	e->is_protected = 1;
+	s->nr_protected++;
+	if (s->nr_protected > s->max_protected) {
+		d = list_entry (s->protected_list.next, bdbm_hlm_rcache_entry_t, list);
+		list_del (&d->list);
+		list_add_tail (&d->list, &s->probation_list);
+		d->is_protected = 0;
+		s->nr_protected--;
+	}
+}
+
+/* get a free entry for lpa; the LRU page of the probationary segment is 
+ * evicted if the shard is full */
+static bdbm_hlm_rcache_entry_t* __hlm_rcache_alloc (
+	bdbm_hlm_rcache_t* rc,
+	bdbm_hlm_rcache_shard_t* s, 
+	int64_t lpa)
+{
+	bdbm_hlm_rcache_entry_t* e = NULL;
+
+	if (list_empty (&s->free_list)) {
+		if (!list_empty (&s->probation_list))
+			e = list_entry (s->probation_list.next, bdbm_hlm_rcache_entry_t, list);
+		else
+			e = list_entry (s->protected_list.next, bdbm_hlm_rcache_entry_t, list);
+		__hlm_rcache_remove (s, e);
+		atomic64_inc (&rc->nr_evictions);
+	}
+
+	e = list_entry (s->free_list.next, bdbm_hlm_rcache_entry_t, list);
+	list_del (&e->list);
+	e->lpa = lpa;
+	HASH_ADD (hh, s->ht, lpa, sizeof (int64_t), e);
+	list_add_tail (&e->list, &s->probation_list);
+
+	return e;
+}
+
+bdbm_hlm_rcache_t* bdbm_hlm_rcache_create (uint64_t nr_pages)
+{
+	bdbm_hlm_rcache_t* rc = NULL;
+	bdbm_hlm_rcache_shard_t* s = NULL;
+	uint64_t nr_pages_per_shard;
+	uint64_t i, j;
+
+	/* every shard has the same # of pages */
+	nr_pages_per_shard = (nr_pages + HLM_RCACHE_NR_SHARDS - 1) / HLM_RCACHE_NR_SHARDS;
+	if (nr_pages_per_shard == 0)
+		nr_pages_per_shard = 1;
+
+	if ((rc = (bdbm_hlm_rcache_t*)bdbm_zmalloc (sizeof (bdbm_hlm_rcache_t))) == NULL) {
+		bdbm_error ("bdbm_zmalloc failed");
+		return NULL;
+	}
+	rc->nr_pages = nr_pages_per_shard * HLM_RCACHE_NR_SHARDS;
+	if ((rc->entries = (bdbm_hlm_rcache_entry_t*)bdbm_zmalloc 
+			(sizeof (bdbm_hlm_rcache_entry_t) * rc->nr_pages)) == NULL ||
+		(rc->data = (uint8_t*)bdbm_malloc 
+			(HLM_RCACHE_PAGE_SIZE * rc->nr_pages)) == NULL) {
+		bdbm_error ("bdbm_malloc failed");
+		if (rc->entries)
+			bdbm_free (rc->entries);
+		bdbm_free (rc);
+		return NULL;
+	}
+
+	for (i = 0; i < HLM_RCACHE_NR_SHARDS; i++) {
+		s = &rc->shards[i];
+		bdbm_spin_lock_init (&s->lock);
+		s->ht = NULL;
+		INIT_LIST_HEAD (&s->probation_list);
+		INIT_LIST_HEAD (&s->protected_list);
+		INIT_LIST_HEAD (&s->free_list);
+		s->nr_protected = 0;
+		s->max_protected = nr_pages_per_shard * 4 / 5;
+		if (s->max_protected == 0)
+			s->max_protected = 1;
+		for (j = 0; j < nr_pages_per_shard; j++) {
+			bdbm_hlm_rcache_entry_t* e = &rc->entries[i * nr_pages_per_shard + j];
+			e->lpa = -1;
+			e->data = rc->data + HLM_RCACHE_PAGE_SIZE * (i * nr_pages_per_shard + j);
+			e->status = HLM_RCACHE_FREE;
+			list_add_tail (&e->list, &s->free_list);
+		}
+	}
+
+	atomic64_set (&rc->nr_lookups, 0);
+	atomic64_set (&rc->nr_hits, 0);
+	atomic64_set (&rc->nr_fills, 0);
+	atomic64_set (&rc->nr_updates, 0);
+	atomic64_set (&rc->nr_invalidates, 0);
+	atomic64_set (&rc->nr_evictions, 0);
+
+	return rc;
+}
+
+void bdbm_hlm_rcache_destroy (bdbm_hlm_rcache_t* rc)
+{
+	uint64_t i;
+
+	if (rc == NULL)
+		return;
+
+	for (i = 0; i < HLM_RCACHE_NR_SHARDS; i++) {
+		HASH_CLEAR (hh, rc->shards[i].ht);
+		bdbm_spin_lock_destory (&rc->shards[i].lock);
+	}
+	bdbm_free (rc->data);
+	bdbm_free (rc->entries);
+	bdbm_free (rc);
+}
+
+/* copy a cached page to lr; if it is not cached, the page is reserved for 
+ * 'owner', which fills it with bdbm_hlm_rcache_fill () after the read */
+uint8_t bdbm_hlm_rcache_read (
+	bdbm_hlm_rcache_t* rc, 
+	bdbm_llm_req_t* lr,
+	void* owner)
+{
+	int64_t lpa = lr->logaddr.lpa[0];
+	bdbm_hlm_rcache_shard_t* s = __hlm_rcache_get_shard (rc, lpa);
+	bdbm_hlm_rcache_entry_t* e = NULL;
+	unsigned long flags;
+	uint8_t hit = 0;
+	uint64_t i;
+
+	atomic64_inc (&rc->nr_lookups);
+
+	bdbm_spin_lock_irqsave (&s->lock, flags);
+	HASH_FIND (hh, s->ht, &lpa, sizeof (int64_t), e);
+	if (e != NULL && e->status == HLM_RCACHE_VALID) {
+		for (i = 0; i < BDBM_MAX_PAGES; i++) {
+			if (lr->fmain.kp_stt[i] == KP_STT_DATA)
+				bdbm_memcpy (lr->fmain.kp_ptr[i], e->data + KPAGE_SIZE * i, KPAGE_SIZE);
+		}
+		__hlm_rcache_touch (s, e);
+		hit = 1;
+	} else if (e == NULL && __hlm_rcache_is_full_page (lr)) {
+		e = __hlm_rcache_alloc (rc, s, lpa);
+		e->status = HLM_RCACHE_FILLING;
+		e->owner = owner;
+	}
+	bdbm_spin_unlock_irqrestore (&s->lock, flags);
+
+	if (hit)
+		atomic64_inc (&rc->nr_hits);
+
+	return hit;
+}
+
+/* keep the page read from flash; it is dropped if the page was written or 
+ * trimmed after it was reserved by bdbm_hlm_rcache_read () */
+void bdbm_hlm_rcache_fill (
+	bdbm_hlm_rcache_t* rc, 
+	bdbm_llm_req_t* lr,
+	void* owner)
+{
+	int64_t lpa = lr->logaddr.lpa[0];
+	bdbm_hlm_rcache_shard_t* s = __hlm_rcache_get_shard (rc, lpa);
+	bdbm_hlm_rcache_entry_t* e = NULL;
+	unsigned long flags;
+	uint64_t i;
+
+	bdbm_spin_lock_irqsave (&s->lock, flags);
+	HASH_FIND (hh, s->ht, &lpa, sizeof (int64_t), e);
+	if (e != NULL && e->status == HLM_RCACHE_FILLING && e->owner == owner) {
+		for (i = 0; i < BDBM_MAX_PAGES; i++)
+			bdbm_memcpy (e->data + KPAGE_SIZE * i, lr->fmain.kp_ptr[i], KPAGE_SIZE);
+		e->status = HLM_RCACHE_VALID;
+		e->owner = NULL;
+		atomic64_inc (&rc->nr_fills);
+	}
+	bdbm_spin_unlock_irqrestore (&s->lock, flags);
+}
+
+/* a write makes the cached page up-to-date if it covers the whole page; 
+ * otherwise the page is dropped */
+void bdbm_hlm_rcache_write (
+	bdbm_hlm_rcache_t* rc, 
+	bdbm_llm_req_t* lr)
+{
+	int64_t lpa = lr->logaddr.lpa[0];
+	bdbm_hlm_rcache_shard_t* s = __hlm_rcache_get_shard (rc, lpa);
+	bdbm_hlm_rcache_entry_t* e = NULL;
+	unsigned long flags;
+	uint64_t i;
+
+	bdbm_spin_lock_irqsave (&s->lock, flags);
+	HASH_FIND (hh, s->ht, &lpa, sizeof (int64_t), e);
+	if (bdbm_is_normal (lr->req_type) && __hlm_rcache_is_full_page (lr)) {
+		if (e == NULL)
+			e = __hlm_rcache_alloc (rc, s, lpa);
+		for (i = 0; i < BDBM_MAX_PAGES; i++)
+			bdbm_memcpy (e->data + KPAGE_SIZE * i, lr->fmain.kp_ptr[i], KPAGE_SIZE);
+		e->status = HLM_RCACHE_VALID;
+		e->owner = NULL;
+		atomic64_inc (&rc->nr_updates);
+	} else if (e != NULL) {
+		__hlm_rcache_remove (s, e);
+		atomic64_inc (&rc->nr_invalidates);
+	}
+	bdbm_spin_unlock_irqrestore (&s->lock, flags);
+}
+
+void bdbm_hlm_rcache_trim (
+	bdbm_hlm_rcache_t* rc, 
+	int64_t lpa, 
+	int64_t len)
+{
+	bdbm_hlm_rcache_shard_t* s = NULL;
+	bdbm_hlm_rcache_entry_t* e = NULL;
+	bdbm_hlm_rcache_entry_t* tmp = NULL;
+	unsigned long flags;
+	int64_t i;
+
+	if (len <= (int64_t)rc->nr_pages) {
+		/* look up every page in the range */
+		for (i = lpa; i < lpa + len; i++) {
+			s = __hlm_rcache_get_shard (rc, i);
+			bdbm_spin_lock_irqsave (&s->lock, flags);
+			HASH_FIND (hh, s->ht, &i, sizeof (int64_t), e);
+			if (e != NULL) {
+				__hlm_rcache_remove (s, e);
+				atomic64_inc (&rc->nr_invalidates);
+			}
+			bdbm_spin_unlock_irqrestore (&s->lock, flags);
+		}
+		return;
+	}
+
+	/* the range is larger than the cache; scan the cache instead */
+	for (i = 0; i < HLM_RCACHE_NR_SHARDS; i++) {
+		s = &rc->shards[i];
+		bdbm_spin_lock_irqsave (&s->lock, flags);
+		HASH_ITER (hh, s->ht, e, tmp) {
+			if (e->lpa >= lpa && e->lpa < lpa + len) {
+				__hlm_rcache_remove (s, e);
+				atomic64_inc (&rc->nr_invalidates);
+			}
+		}
+		bdbm_spin_unlock_irqrestore (&s->lock, flags);
+	}
+}
+
+void bdbm_hlm_rcache_display (bdbm_hlm_rcache_t* rc)
+{
+	int64_t nr_lookups = atomic64_read (&rc->nr_lookups);
+	int64_t nr_hits = atomic64_read (&rc->nr_hits);
+
+	bdbm_msg ("hlm read cache: %llu pages, %lld lookups, %lld hits (%lld.%02lld%%)",
+		rc->nr_pages, nr_lookups, nr_hits,
+		nr_lookups ? (nr_hits * 100 / nr_lookups) : 0,
+		nr_lookups ? (nr_hits * 10000 / nr_lookups) % 100 : 0);
+	bdbm_msg ("hlm read cache: %lld fills, %lld updates, %lld invalidates, %lld evictions",
+		atomic64_read (&rc->nr_fills),
+		atomic64_read (&rc->nr_updates),
+		atomic64_read (&rc->nr_invalidates),
+		atomic64_read (&rc->nr_evictions));
+}
@@ -0,0 +1,81 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2015 CSAIL, MIT
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _BLUEDBM_HLM_RCACHE_H
+#define _BLUEDBM_HLM_RCACHE_H
+
+#include "bdbm_drv.h"
+#include "../3rd/uthash.h"
+
+/* # of independent partitions of the cache; each has its own lock, so 
+ * requests for different lpas rarely contend */
+#define HLM_RCACHE_NR_SHARDS	16
+
+typedef struct {
+	int64_t lpa;
+	uint8_t* data;
+	uint8_t status;		/* HLM_RCACHE_FILLING or HLM_RCACHE_VALID */
+	uint8_t is_protected;
+	void* owner;		/* a read request that will fill the page */
+	struct list_head list;
+	UT_hash_handle hh;
+} bdbm_hlm_rcache_entry_t;
+
+/* a segmented LRU: pages enter the probationary segment and are moved to 
+ * the protected one when they are hit again, so a long scan only flushes 
+ * the probationary segment */
+typedef struct {
+	bdbm_spinlock_t lock;
+	bdbm_hlm_rcache_entry_t* ht;
+	struct list_head probation_list;
+	struct list_head protected_list;
+	struct list_head free_list;
+	uint64_t nr_protected;
+	uint64_t max_protected;
+} bdbm_hlm_rcache_shard_t;
+
+typedef struct {
+	uint64_t nr_pages;
+	bdbm_hlm_rcache_entry_t* entries;
+	uint8_t* data;
+	bdbm_hlm_rcache_shard_t shards[HLM_RCACHE_NR_SHARDS];
+
+	/* statistics */
+	atomic64_t nr_lookups;
+	atomic64_t nr_hits;
+	atomic64_t nr_fills;
+	atomic64_t nr_updates;
+	atomic64_t nr_invalidates;
+	atomic64_t nr_evictions;
+} bdbm_hlm_rcache_t;
+
+bdbm_hlm_rcache_t* bdbm_hlm_rcache_create (uint64_t nr_pages);
+void bdbm_hlm_rcache_destroy (bdbm_hlm_rcache_t* rc);
+uint8_t bdbm_hlm_rcache_read (bdbm_hlm_rcache_t* rc, bdbm_llm_req_t* lr, void* owner);
+void bdbm_hlm_rcache_fill (bdbm_hlm_rcache_t* rc, bdbm_llm_req_t* lr, void* owner);
+void bdbm_hlm_rcache_write (bdbm_hlm_rcache_t* rc, bdbm_llm_req_t* lr);
+void bdbm_hlm_rcache_trim (bdbm_hlm_rcache_t* rc, int64_t lpa, int64_t len);
+void bdbm_hlm_rcache_display (bdbm_hlm_rcache_t* rc);
+
+#endif
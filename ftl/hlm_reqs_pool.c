@@ -44,12 +44,160 @@ THE SOFTWARE.
 #define DEFAULT_POOL_SIZE		128
 #define DEFAULT_POOL_INC_SIZE	DEFAULT_POOL_SIZE / 5
 
+/* a magazine keeps up to 2 * HLM_REQS_POOL_MAG_SIZE items */
+#define HLM_REQS_POOL_MAG_MAX	(HLM_REQS_POOL_MAG_SIZE * 2)
+
+/* pick a magazine for the caller: one per CPU in the kernel and one per
+ * thread in user-level */
+#if defined(KERNEL_MODE)
+static inline int32_t __hlm_reqs_pool_get_mag_id (void)
+{
+	return raw_smp_processor_id () % HLM_REQS_POOL_NR_MAGS;
+}
+#elif defined(USER_MODE)
+static __thread int32_t __hlm_reqs_pool_mag_id = -1;
+static atomic64_t __hlm_reqs_pool_nr_threads = ATOMIC64_INIT (0);
+
+static inline int32_t __hlm_reqs_pool_get_mag_id (void)
+{
+	if (__hlm_reqs_pool_mag_id == -1) {
+		/* two threads may get the same magazine; it is safe because 
+		 * magazines are locked anyway */
+		atomic64_inc (&__hlm_reqs_pool_nr_threads);
+		__hlm_reqs_pool_mag_id = 
+			atomic64_read (&__hlm_reqs_pool_nr_threads) % HLM_REQS_POOL_NR_MAGS;
+	}
+	return __hlm_reqs_pool_mag_id;
+}
+#endif
+
+/* items don't have pad pages; they are attached when requests are built */
+static bdbm_hlm_req_t* __hlm_reqs_pool_alloc_item (void)
+{
+	bdbm_hlm_req_t* item = NULL;
+	int i = 0;
+
+	if ((item = (bdbm_hlm_req_t*)bdbm_malloc (sizeof (bdbm_hlm_req_t))) == NULL) {
+		bdbm_error ("bdbm_malloc () failed");
+		return NULL;
+	}
+	for (i = 0; i < BDBM_BLKIO_MAX_VECS; i++)
+		item->llm_reqs[i].foob.data = (uint8_t*)bdbm_malloc (8*BDBM_MAX_PAGES);
+	bdbm_sema_init (&item->done);
+
+	return item;
+}
+
+static void __hlm_reqs_pool_free_items (struct list_head* list, int32_t* count)
+{
+	struct list_head* next = NULL;
+	struct list_head* temp = NULL;
+	bdbm_hlm_req_t* item = NULL;
+	int i = 0;
+
+	list_for_each_safe (next, temp, list) {
+		item = list_entry (next, bdbm_hlm_req_t, list);
+		list_del (&item->list);
+		for (i = 0; i < BDBM_BLKIO_MAX_VECS; i++)
+			bdbm_free (item->llm_reqs[i].foob.data);
+		bdbm_sema_free (&item->done);
+		bdbm_free (item);
+		(*count)++;
+	}
+}
+
+static uint8_t* __hlm_reqs_pool_get_pad (bdbm_hlm_reqs_pool_t* pool)
+{
+	uint8_t* pad = NULL;
+	unsigned long flags;
+
+	bdbm_spin_lock_irqsave (&pool->pad_lock, flags);
+	if ((pad = pool->pad_free_list) != NULL) {
+		pool->pad_free_list = *(uint8_t**)pad;
+		pool->nr_free_pads--;
+	}
+	bdbm_spin_unlock_irqrestore (&pool->pad_lock, flags);
+
+	/* the slab grows on demand */
+	if (pad == NULL) {
+		if ((pad = (uint8_t*)bdbm_malloc (KPAGE_SIZE)) == NULL) {
+			bdbm_error ("bdbm_malloc () failed");
+			return NULL;
+		}
+		bdbm_spin_lock_irqsave (&pool->pad_lock, flags);
+		pool->nr_pads++;
+		bdbm_spin_unlock_irqrestore (&pool->pad_lock, flags);
+	}
+
+	return pad;
+}
+
+static void __hlm_reqs_pool_put_pad (bdbm_hlm_reqs_pool_t* pool, uint8_t* pad)
+{
+	unsigned long flags;
+
+	bdbm_spin_lock_irqsave (&pool->pad_lock, flags);
+	*(uint8_t**)pad = pool->pad_free_list;
+	pool->pad_free_list = pad;
+	pool->nr_free_pads++;
+	bdbm_spin_unlock_irqrestore (&pool->pad_lock, flags);
+}
+
+/* attach pad pages to holes of a request being built; only rmw needs 
+ * them (to keep the old data). The other holes are left without buffers 
+ * (kp_ptr == NULL), and devices skip them. */
+static int __hlm_reqs_pool_attach_pads (
+	bdbm_hlm_reqs_pool_t* pool, 
+	bdbm_hlm_req_t* hr)
+{
+	bdbm_flash_page_main_t* fm = NULL;
+	uint64_t i = 0;
+	int j = 0;
+
+	for (i = 0; i < hr->nr_llm_reqs; i++) {
+		if (!bdbm_is_rmw (hr->llm_reqs[i].req_type))
+			continue;
+		fm = &hr->llm_reqs[i].fmain;
+		for (j = 0; j < BDBM_MAX_PAGES; j++) {
+			if (fm->kp_stt[j] == KP_STT_DATA)
+				continue;
+			if ((fm->kp_pad[j] = __hlm_reqs_pool_get_pad (pool)) == NULL)
+				return 1;
+			fm->kp_ptr[j] = fm->kp_pad[j];
+			hr->nr_padded = i + 1;
+		}
+	}
+
+	return 0;
+}
+
+static void __hlm_reqs_pool_detach_pads (
+	bdbm_hlm_reqs_pool_t* pool, 
+	bdbm_hlm_req_t* hr)
+{
+	bdbm_flash_page_main_t* fm = NULL;
+	uint64_t i = 0;
+	int j = 0;
+
+	for (i = 0; i < hr->nr_padded; i++) {
+		fm = &hr->llm_reqs[i].fmain;
+		for (j = 0; j < BDBM_MAX_PAGES; j++) {
+			if (fm->kp_pad[j] != NULL) {
+				__hlm_reqs_pool_put_pad (pool, fm->kp_pad[j]);
+				fm->kp_pad[j] = NULL;
+			}
+		}
+	}
+	hr->nr_padded = 0;
+}
+
 bdbm_hlm_reqs_pool_t* bdbm_hlm_reqs_pool_create (
 	int32_t mapping_unit_size, 
 	int32_t io_unit_size)
 {
 	bdbm_hlm_reqs_pool_t* pool = NULL;
 	int in_place_rmw = 0;
+	int32_t count = 0;
 	int i = 0;
 
 	/* check input arguments */
@@ -73,22 +221,28 @@ bdbm_hlm_reqs_pool_t* bdbm_hlm_reqs_pool_create (
 
 	/* initialize variables */
 	bdbm_spin_lock_init (&pool->lock);
-	INIT_LIST_HEAD (&pool->used_list);
 	INIT_LIST_HEAD (&pool->free_list);
 	pool->pool_size = DEFAULT_POOL_SIZE;
 	pool->map_unit = mapping_unit_size;
 	pool->io_unit = io_unit_size;
 	pool->in_place_rmw = in_place_rmw;
+	for (i = 0; i < HLM_REQS_POOL_NR_MAGS; i++) {
+		bdbm_spin_lock_init (&pool->mags[i].lock);
+		INIT_LIST_HEAD (&pool->mags[i].free_list);
+		pool->mags[i].nr_items = 0;
+	}
+	atomic64_set (&pool->nr_refills, 0);
+	atomic64_set (&pool->nr_spills, 0);
+	bdbm_spin_lock_init (&pool->pad_lock);
+	pool->pad_free_list = NULL;
+	pool->nr_pads = 0;
+	pool->nr_free_pads = 0;
 
 	/* add hlm_reqs to the free-list */
 	for (i = 0; i < DEFAULT_POOL_SIZE; i++) {
 		bdbm_hlm_req_t* item = NULL;
-		if ((item = (bdbm_hlm_req_t*)bdbm_malloc (sizeof (bdbm_hlm_req_t))) == NULL) {
-			bdbm_error ("bdbm_malloc () failed");
+		if ((item = __hlm_reqs_pool_alloc_item ()) == NULL)
 			goto fail;
-		}
-		hlm_reqs_pool_allocate_llm_reqs (item->llm_reqs, BDBM_BLKIO_MAX_VECS, RP_MEM_VIRT);
-		bdbm_sema_init (&item->done);
 		list_add_tail (&item->list, &pool->free_list);
 	}
 
@@ -96,126 +250,182 @@ bdbm_hlm_reqs_pool_t* bdbm_hlm_reqs_pool_create (
 
 fail:
 	/* oops! it failed */
-	if (pool) {
-		struct list_head* next = NULL;
-		struct list_head* temp = NULL;
-		bdbm_hlm_req_t* item = NULL;
-		list_for_each_safe (next, temp, &pool->free_list) {
-			item = list_entry (next, bdbm_hlm_req_t, list);
-			list_del (&item->list);
-			hlm_reqs_pool_release_llm_reqs (item->llm_reqs, BDBM_BLKIO_MAX_VECS, RP_MEM_VIRT);
-			bdbm_sema_free (&item->done);
-			bdbm_free (item);
-		}
-		bdbm_spin_lock_destory (&pool->lock);
-		bdbm_free (pool);
-		pool = NULL;
-	}
+	__hlm_reqs_pool_free_items (&pool->free_list, &count);
+	for (i = 0; i < HLM_REQS_POOL_NR_MAGS; i++)
+		bdbm_spin_lock_destory (&pool->mags[i].lock);
+	bdbm_spin_lock_destory (&pool->pad_lock);
+	bdbm_spin_lock_destory (&pool->lock);
+	bdbm_free (pool);
 	return NULL;
 }
 
 void bdbm_hlm_reqs_pool_destroy (
 	bdbm_hlm_reqs_pool_t* pool)
 {
-	struct list_head* next = NULL;
-	struct list_head* temp = NULL;
-	bdbm_hlm_req_t* item = NULL;
 	int32_t count = 0;
+	int i = 0;
 
 	if (!pool) return;
 
-	/* free & remove items from the used_list */
-	list_for_each_safe (next, temp, &pool->used_list) {
-		item = list_entry (next, bdbm_hlm_req_t, list);
-		list_del (&item->list);
-		hlm_reqs_pool_release_llm_reqs (item->llm_reqs, BDBM_BLKIO_MAX_VECS, RP_MEM_VIRT);
-		bdbm_sema_free (&item->done);
-		bdbm_free (item);
-		count++;
-	}
-
-	/* free & remove items from the free_list */
-	list_for_each_safe (next, temp, &pool->free_list) {
-		item = list_entry (next, bdbm_hlm_req_t, list);
-		list_del (&item->list);
-		hlm_reqs_pool_release_llm_reqs (item->llm_reqs, BDBM_BLKIO_MAX_VECS, RP_MEM_VIRT);
-		bdbm_sema_free (&item->done);
-		bdbm_free (item);
-		count++;
+	/* free & remove items from magazines and the free_list */
+	for (i = 0; i < HLM_REQS_POOL_NR_MAGS; i++) {
+		__hlm_reqs_pool_free_items (&pool->mags[i].free_list, &count);
+		bdbm_spin_lock_destory (&pool->mags[i].lock);
 	}
+	__hlm_reqs_pool_free_items (&pool->free_list, &count);
 
 	if (count != pool->pool_size) {
 		bdbm_warning ("oops! count != pool->pool_size (%d != %d)",
 			count, pool->pool_size);
 	}
+	bdbm_msg ("hlm_reqs_pool: %d items, %lld refills, %lld spills",
+		pool->pool_size, 
+		atomic64_read (&pool->nr_refills), 
+		atomic64_read (&pool->nr_spills));
+
+	/* free pad pages */
+	if (pool->nr_free_pads != pool->nr_pads) {
+		bdbm_warning ("oops! nr_free_pads != nr_pads (%lld != %lld)",
+			pool->nr_free_pads, pool->nr_pads);
+	}
+	bdbm_msg ("hlm_reqs_pool: %lld pad pages", pool->nr_pads);
+	while (pool->pad_free_list != NULL) {
+		uint8_t* pad = pool->pad_free_list;
+		pool->pad_free_list = *(uint8_t**)pad;
+		bdbm_free (pad);
+	}
 
 	/* free other stuff */
+	bdbm_spin_lock_destory (&pool->pad_lock);
 	bdbm_spin_lock_destory (&pool->lock);
 	bdbm_free (pool);
 }
 
-bdbm_hlm_req_t* bdbm_hlm_reqs_pool_get_item (
-	bdbm_hlm_reqs_pool_t* pool)
+/* add more items to the global free_list; they are allocated with no 
+ * locks held since bdbm_malloc () may sleep */
+static int __hlm_reqs_pool_grow (bdbm_hlm_reqs_pool_t* pool)
+{
+	struct list_head items;
+	bdbm_hlm_req_t* item = NULL;
+	unsigned long flags;
+	int i = 0;
+
+	INIT_LIST_HEAD (&items);
+	for (i = 0; i < DEFAULT_POOL_INC_SIZE; i++) {
+		if ((item = __hlm_reqs_pool_alloc_item ()) == NULL)
+			break;
+		list_add_tail (&item->list, &items);
+	}
+	if (i == 0)
+		return 1;
+
+	bdbm_spin_lock_irqsave (&pool->lock, flags);
+	list_splice (&items, &pool->free_list);
+	/* increase the size of the pool */
+	pool->pool_size += i;
+	bdbm_spin_unlock_irqrestore (&pool->lock, flags);
+
+	return 0;
+}
+
+/* move a batch of items from the global free_list to an empty magazine; 
+ * it returns 1 if the free_list is empty */
+static int __hlm_reqs_pool_refill (
+	bdbm_hlm_reqs_pool_t* pool,
+	bdbm_hlm_reqs_mag_t* mag)
 {
-	struct list_head* pos = NULL;
 	bdbm_hlm_req_t* item = NULL;
+	int i = 0;
 
 	bdbm_spin_lock (&pool->lock);
+	for (i = 0; i < HLM_REQS_POOL_MAG_SIZE && !list_empty (&pool->free_list); i++) {
+		item = list_entry (pool->free_list.next, bdbm_hlm_req_t, list);
+		list_move_tail (&item->list, &mag->free_list);
+		mag->nr_items++;
+	}
+	bdbm_spin_unlock (&pool->lock);
 
-again:
-	/* see if there are free items in the free_list */
-	list_for_each (pos, &pool->free_list) {
-		item = list_entry (pos, bdbm_hlm_req_t, list);
-		break;
-	}
-
-	/* oops! there are no free items in the free-list */
-	if (item == NULL) {
-		int i = 0;
-		/* add more items to the free-list */
-		for (i = 0; i < DEFAULT_POOL_INC_SIZE; i++) {
-			bdbm_hlm_req_t* item = NULL;
-			if ((item = (bdbm_hlm_req_t*)bdbm_malloc (sizeof (bdbm_hlm_req_t))) == NULL) {
-				bdbm_error ("bdbm_malloc () failed");
-				goto fail;
-			}
-			hlm_reqs_pool_allocate_llm_reqs (item->llm_reqs, BDBM_BLKIO_MAX_VECS, RP_MEM_VIRT);
-			bdbm_sema_init (&item->done);
-			list_add_tail (&item->list, &pool->free_list);
-		}
-		/* increase the size of the pool */
-		pool->pool_size += DEFAULT_POOL_INC_SIZE;
+	if (i == 0)
+		return 1;
+
+	atomic64_inc (&pool->nr_refills);
+
+	return 0;
+}
 
-		/* try it again */
-		goto again;
+/* give half of a full magazine back to the global free_list */
+static void __hlm_reqs_pool_spill (
+	bdbm_hlm_reqs_pool_t* pool,
+	bdbm_hlm_reqs_mag_t* mag)
+{
+	bdbm_hlm_req_t* item = NULL;
+	int i = 0;
+
+	bdbm_spin_lock (&pool->lock);
+	for (i = 0; i < HLM_REQS_POOL_MAG_SIZE; i++) {
+		item = list_entry (mag->free_list.next, bdbm_hlm_req_t, list);
+		list_move_tail (&item->list, &pool->free_list);
+		mag->nr_items--;
 	}
+	bdbm_spin_unlock (&pool->lock);
+
+	atomic64_inc (&pool->nr_spills);
+}
+
+bdbm_hlm_req_t* bdbm_hlm_reqs_pool_get_item (
+	bdbm_hlm_reqs_pool_t* pool)
+{
+	int32_t mag_id = __hlm_reqs_pool_get_mag_id ();
+	bdbm_hlm_reqs_mag_t* mag = &pool->mags[mag_id];
+	bdbm_hlm_req_t* item = NULL;
+	unsigned long flags;
 
-	if (item == NULL)
-		goto fail;
+	bdbm_spin_lock_irqsave (&mag->lock, flags);
+
+	/* get more items if the magazine is empty; the pool grows with the 
+	 * magazine unlocked, so other threads may refill it meanwhile */
+	while (mag->nr_items == 0 && __hlm_reqs_pool_refill (pool, mag) != 0) {
+		bdbm_spin_unlock_irqrestore (&mag->lock, flags);
+		if (__hlm_reqs_pool_grow (pool) != 0) {
+			bdbm_error ("bdbm_malloc () failed");
+			return NULL;
+		}
+		bdbm_spin_lock_irqsave (&mag->lock, flags);
+	}
 
-	/* move it to the used_list */
+	item = list_entry (mag->free_list.next, bdbm_hlm_req_t, list);
 	list_del (&item->list);
-	list_add_tail (&item->list, &pool->used_list);
+	mag->nr_items--;
 
-	bdbm_spin_unlock (&pool->lock);
-	return item;
+	bdbm_spin_unlock_irqrestore (&mag->lock, flags);
 
-fail:
+	item->mag_id = mag_id;
 
-	bdbm_spin_unlock (&pool->lock);
-	return NULL;
+	return item;
 }
 
 void bdbm_hlm_reqs_pool_free_item (
 	bdbm_hlm_reqs_pool_t* pool, 
 	bdbm_hlm_req_t* item)
 {
+	/* requests are often completed by other threads (e.g., llm or device 
+	 * threads); items go back to the magazine they were taken from, 
+	 * otherwise the submitter's magazine keeps running dry and the 
+	 * completer's keeps spilling, both through pool->lock */
+	bdbm_hlm_reqs_mag_t* mag = &pool->mags[item->mag_id];
+	unsigned long flags;
+
 	bdbm_sema_unlock (&item->done);
 
-	bdbm_spin_lock (&pool->lock);
-	list_del (&item->list);
-	list_add_tail (&item->list, &pool->free_list);
-	bdbm_spin_unlock (&pool->lock);
+	/* give pad pages back to the slab */
+	__hlm_reqs_pool_detach_pads (pool, item);
+
+	bdbm_spin_lock_irqsave (&mag->lock, flags);
+	list_add (&item->list, &mag->free_list);	/* reuse it first; it is still in cache */
+	mag->nr_items++;
+	if (mag->nr_items >= HLM_REQS_POOL_MAG_MAX)
+		__hlm_reqs_pool_spill (pool, mag);
+	bdbm_spin_unlock_irqrestore (&mag->lock, flags);
 }
 
 static int __hlm_reqs_pool_create_trim_req  (
@@ -245,6 +455,22 @@ static int __hlm_reqs_pool_create_trim_req  (
 	return 0;
 }
 
+static int __hlm_reqs_pool_create_flush_req  (
+	bdbm_hlm_reqs_pool_t* pool, 
+	bdbm_hlm_req_t* hr,
+	bdbm_blkio_req_t* br)
+{
+	/* a flush has no data */
+	hr->req_type = br->bi_rw;
+	bdbm_stopwatch_start (&hr->sw);
+	hr->lpa = 0;
+	hr->len = 0;
+	hr->blkio_req = (void*)br;
+	hr->ret = 0;
+
+	return 0;
+}
+
 void hlm_reqs_pool_allocate_llm_reqs (
 	bdbm_llm_req_t* llm_reqs, 
 	int32_t nr_llm_reqs,
@@ -291,7 +517,7 @@ void hlm_reqs_pool_release_llm_reqs (
 		if (flag == RP_MEM_PHY)
 			bdbm_free_phy (fo->data);
 		else
-			bdbm_free (fm->kp_pad[j]);
+			bdbm_free (fo->data);
 	}
 }
 
@@ -384,6 +610,7 @@ static int __hlm_reqs_pool_create_write_req (
 
 		/* go to the next */
 		ptr_lr->ptr_hlm_req = (void*)hr;
+		ptr_lr->tenant_id = br->bi_tenant;
 		ptr_lr++;
 	}
 
@@ -436,6 +663,7 @@ static int __hlm_reqs_pool_create_read_req (
 		else
 			ptr_lr->logaddr.ofs = offset;	/* it must be adjusted after getting physical locations */
 		ptr_lr->ptr_hlm_req = (void*)hr;
+		ptr_lr->tenant_id = br->bi_tenant;
 
 		/* go to the next */
 		pg_start++;
@@ -470,6 +698,8 @@ int bdbm_hlm_reqs_pool_build_req (
 		ret = __hlm_reqs_pool_create_write_req (pool, hr, br);
 	} else if (br->bi_rw == REQTYPE_READ) {
 		ret = __hlm_reqs_pool_create_read_req (pool, hr, br);
+	} else if (br->bi_rw == REQTYPE_FLUSH) {
+		ret = __hlm_reqs_pool_create_flush_req (pool, hr, br);
 	}
 
 	/* are there any errors? */
@@ -477,6 +707,16 @@ int bdbm_hlm_reqs_pool_build_req (
 		bdbm_error ("oops! invalid request type: (%llx)", br->bi_rw);
 		return 1;
 	}
+	hr->tenant_id = br->bi_tenant;
+
+	/* holes of rmw need pad pages */
+	hr->nr_padded = 0;
+	if (br->bi_rw == REQTYPE_WRITE) {
+		if (__hlm_reqs_pool_attach_pads (pool, hr) != 0) {
+			__hlm_reqs_pool_detach_pads (pool, hr);
+			return 1;
+		}
+	}
 
 	return 0;
 }
@@ -484,6 +724,11 @@ int bdbm_hlm_reqs_pool_build_req (
 void hlm_reqs_pool_relocate_kp (bdbm_llm_req_t* lr, uint64_t new_sp_ofs)
 {
 	if (new_sp_ofs != lr->logaddr.ofs) {
+		/* the pad page of the hole moves with it */
+		uint8_t* pad = lr->fmain.kp_pad[new_sp_ofs];
+		lr->fmain.kp_pad[new_sp_ofs] = lr->fmain.kp_pad[lr->logaddr.ofs];
+		lr->fmain.kp_pad[lr->logaddr.ofs] = pad;
+
 		lr->fmain.kp_stt[new_sp_ofs] = KP_STT_DATA;
 		lr->fmain.kp_ptr[new_sp_ofs] = lr->fmain.kp_ptr[lr->logaddr.ofs];
 		lr->fmain.kp_stt[lr->logaddr.ofs] = KP_STT_HOLE;
@@ -496,8 +741,9 @@ void hlm_reqs_pool_write_compaction (
 	bdbm_hlm_req_gc_t* src, 
 	bdbm_device_params_t* np)
 {
-	uint64_t dst_loop = 0, dst_kp = 0, src_kp = 0, i = 0;
+	uint64_t dst_loop = 0, dst_kp = 0, src_kp = 0, i = 0, k = 0;
 	uint64_t nr_punits = np->nr_chips_per_channel * np->nr_channels;
+	uint64_t nr_kps = np->page_main_size / KPAGE_SIZE;
 
 	bdbm_llm_req_t* dst_r = NULL;
 	bdbm_llm_req_t* src_r = NULL;
@@ -507,9 +753,11 @@ void hlm_reqs_pool_write_compaction (
 		hlm_reqs_pool_reset_fmain (&dst->llm_reqs[i].fmain);
 	}
 
+	/* only the reqs of src read this time have valid data; the rest may be 
+	 * left over from earlier (and larger) gc runs */
 	dst_r = &dst->llm_reqs[0];
 	dst->nr_llm_reqs = 1;
-	for (i = 0; i < nr_punits * np->nr_pages_per_block; i++) {
+	for (i = 0; i < src->nr_llm_reqs; i++) {
 		src_r = &src->llm_reqs[i];
 
 		for (src_kp = 0; src_kp < np->nr_subpages_per_page; src_kp++) {
@@ -519,6 +767,12 @@ void hlm_reqs_pool_write_compaction (
 				dst_r->fmain.kp_ptr[dst_kp] = src_r->fmain.kp_ptr[src_kp];
 				dst_r->logaddr.lpa[dst_kp] = src_r->logaddr.lpa[src_kp];
 				((int64_t*)dst_r->foob.data)[dst_kp] = ((int64_t*)src_r->foob.data)[src_kp];
+				/* a page mapped as a whole (in-place rmw) moves with all 
+				 * of its kernel pages */
+				for (k = 1; np->nr_subpages_per_page == 1 && k < nr_kps; k++) {
+					dst_r->fmain.kp_stt[k] = src_r->fmain.kp_stt[k];
+					dst_r->fmain.kp_ptr[k] = src_r->fmain.kp_ptr[k];
+				}
 			} else {
 				/* otherwise, skip it */
 				continue;
@@ -25,10 +25,30 @@ THE SOFTWARE.
 #ifndef _BDBM_HLM_REQ_POOL_H
 #define _BDBM_HLM_REQ_POOL_H
 
+/* # of magazines (per-CPU caches of free items) and # of items moved 
+ * between a magazine and the global free_list at once */
+#define HLM_REQS_POOL_NR_MAGS	16
+#define HLM_REQS_POOL_MAG_SIZE	16
+
 typedef struct {
 	bdbm_spinlock_t lock;
-	struct list_head used_list;
 	struct list_head free_list;
+	int32_t nr_items;
+} __attribute__((aligned(64))) bdbm_hlm_reqs_mag_t;
+
+typedef struct {
+	bdbm_hlm_reqs_mag_t mags[HLM_REQS_POOL_NR_MAGS];
+	bdbm_spinlock_t lock;	/* for free_list and pool_size */
+	struct list_head free_list;
+	atomic64_t nr_refills;
+	atomic64_t nr_spills;
+
+	/* pad pages for holes in requests; they are shared by all items and 
+	 * attached only to kernel pages that carry no host data */
+	bdbm_spinlock_t pad_lock;
+	uint8_t* pad_free_list;	/* free pages linked through their first bytes */
+	int64_t nr_pads;
+	int64_t nr_free_pads;
 	int32_t pool_size; 	/* # of items */
 	int32_t map_unit;	/* bytes */
 	int32_t io_unit;	/* bytes */
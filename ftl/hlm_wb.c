@@ -0,0 +1,846 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2015 CSAIL, MIT
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#if defined(KERNEL_MODE)
+#include <linux/module.h>
+#include <linux/blkdev.h>
+
+#elif defined(USER_MODE)
+#include <stdio.h>
+#include <stdint.h>
+
+#else
+#error Invalid Platform (KERNEL_MODE or USER_MODE)
+#endif
+
+#include "debug.h"
+#include "params.h"
+#include "bdbm_drv.h"
+#include "hlm_nobuf.h"
+#include "hlm_reqs_pool.h"
+#include "hlm_wb.h"
+#include "uthread.h"
+#include "utime.h"
+#include "umemory.h"
+#include "ucredit.h"
+#include "../3rd/uthash.h"
+
+
+/* interface for hlm_wb */
+bdbm_hlm_inf_t _hlm_wb_inf = {
+	.ptr_private = NULL,
+	.create = hlm_wb_create,
+	.destroy = hlm_wb_destroy,
+	.make_req = hlm_wb_make_req,
+	.end_req = hlm_wb_end_req,
+};
+
+/* # of destage requests that can be in flight together */
+#define HLM_WB_NR_DESTAGES	4
+
+#define HLM_WB_PAGE_SIZE	(KPAGE_SIZE * BDBM_MAX_PAGES)
+
+/* how long a partially written page waits for the rest of its data before 
+ * it is destaged with read-modify-write */
+#define HLM_WB_MERGE_WINDOW_US	5000
+
+/* a buffered page; it is in the hash table while it is dirty or being 
+ * written to flash, so reads always see the latest data */
+typedef struct {
+	int64_t lpa;		/* -1 if it is trimmed while being destaged */
+	uint8_t* data;
+	kp_stt_t kp_stt[BDBM_MAX_PAGES];	/* kernel pages holding data */
+	uint64_t version;	/* increased whenever it is overwritten */
+	uint8_t is_destaging;
+	uint8_t is_partial;	/* some kernel pages have no data yet */
+	bdbm_stopwatch_t sw;	/* when the first fragment of a partial page arrived */
+	struct list_head list;	/* dirty_list, partial_list, or free_list */
+	UT_hash_handle hh;
+} bdbm_hlm_wb_entry_t;
+
+/* a write request that destages buffered pages to flash */
+typedef struct {
+	bdbm_hlm_req_t hr;	/* it must be on top of this structure */
+	bdbm_hlm_wb_entry_t* entries[BDBM_BLKIO_MAX_VECS];
+	uint64_t versions[BDBM_BLKIO_MAX_VECS];
+	uint8_t in_use;
+} bdbm_hlm_wb_destage_t;
+
+typedef struct {
+	bdbm_ftl_inf_t* ptr_ftl_inf;	/* for hlm_nobuff (it must be on top of this structure) */
+
+	/* the write-back buffer */
+	bdbm_spinlock_t lock;
+	uint64_t nr_entries;
+	bdbm_hlm_wb_entry_t* entries;
+	uint8_t* data;
+	bdbm_hlm_wb_entry_t* ht;	/* buffered pages indexed by lpa */
+	struct list_head dirty_list;	/* full pages in the order of updates */
+	struct list_head partial_list;	/* partial pages in the order of arrival */
+	struct list_head free_list;
+	uint64_t nr_dirty;	/* full and partial pages */
+	uint64_t nr_partial;
+	uint64_t nr_destaging;
+	bdbm_credit_t free_credit;	/* for free entries */
+
+	/* for destaging */
+	uint64_t destage_unit;	/* a full stripe (one page per punit) */
+	uint64_t high_watermark;
+	bdbm_hlm_wb_destage_t* destages;
+	bdbm_credit_t destage_credit;	/* for destage requests */
+	atomic64_t nr_flushes;	/* flushes waiting for destaging */
+	bdbm_thread_t* destage_thread;
+
+	/* FTL functions are not thread-safe */
+	bdbm_mutex_t ftl_lock;
+
+	/* statistics */
+	atomic64_t nr_writes;
+	atomic64_t nr_overwrites;
+	atomic64_t nr_read_hits;
+	atomic64_t nr_destaged;
+	atomic64_t nr_merges;
+	atomic64_t nr_rmws;
+} bdbm_hlm_wb_private_t;
+
+
+/* partial pages are destaged only if they cannot wait any longer */
+static uint8_t __hlm_wb_can_destage_partial (bdbm_hlm_wb_private_t* p)
+{
+	bdbm_hlm_wb_entry_t* e = NULL;
+
+	if (list_empty (&p->partial_list))
+		return 0;
+	if (atomic64_read (&p->nr_flushes) > 0)
+		return 1;
+	if (bdbm_credit_get_nr_available (&p->free_credit) < p->destage_unit)
+		return 1;
+	e = list_entry (p->partial_list.next, bdbm_hlm_wb_entry_t, list);
+	if (bdbm_stopwatch_get_elapsed_time_us (&e->sw) >= HLM_WB_MERGE_WINDOW_US)
+		return 1;	/* the merge window is over */
+	return 0;
+}
+
+static uint8_t __hlm_wb_need_destage (bdbm_hlm_wb_private_t* p)
+{
+	uint64_t nr_full = p->nr_dirty - p->nr_partial;
+
+	if (p->nr_dirty == 0)
+		return 0;
+	if (atomic64_read (&p->nr_flushes) > 0)
+		return 1;	/* destage everything */
+	if (bdbm_credit_get_nr_available (&p->free_credit) < p->destage_unit)
+		return 1;	/* writers are (or will be soon) waiting for free pages */
+	if (nr_full >= p->high_watermark && nr_full >= p->destage_unit)
+		return 1;	/* a full stripe */
+	if (__hlm_wb_can_destage_partial (p))
+		return 1;
+	return 0;
+}
+
+static uint8_t __hlm_wb_is_full (kp_stt_t* kp_stt)
+{
+	uint64_t i;
+
+	for (i = 0; i < BDBM_MAX_PAGES; i++) {
+		if (kp_stt[i] != KP_STT_DATA)
+			return 0;
+	}
+	return 1;
+}
+
+/* put a dirty page on the list it belongs to */
+static void __hlm_wb_add_dirty (
+	bdbm_hlm_wb_private_t* p, 
+	bdbm_hlm_wb_entry_t* e)
+{
+	if (__hlm_wb_is_full (e->kp_stt)) {
+		e->is_partial = 0;
+		list_add_tail (&e->list, &p->dirty_list);
+	} else {
+		e->is_partial = 1;
+		bdbm_stopwatch_start (&e->sw);
+		list_add_tail (&e->list, &p->partial_list);
+		p->nr_partial++;
+	}
+	p->nr_dirty++;
+}
+
+static void __hlm_wb_del_dirty (
+	bdbm_hlm_wb_private_t* p, 
+	bdbm_hlm_wb_entry_t* e)
+{
+	list_del (&e->list);
+	if (e->is_partial)
+		p->nr_partial--;
+	p->nr_dirty--;
+}
+
+static void __hlm_wb_free_entry (
+	bdbm_hlm_wb_private_t* p, 
+	bdbm_hlm_wb_entry_t* e)
+{
+	e->lpa = -1;
+	e->is_destaging = 0;
+	list_add_tail (&e->list, &p->free_list);
+}
+
+/* take a stripe of dirty pages and write them to flash; it returns # of 
+ * pages destaged */
+static uint64_t __hlm_wb_destage (bdbm_drv_info_t* bdi)
+{
+	bdbm_hlm_wb_private_t* p = (bdbm_hlm_wb_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_hlm_wb_destage_t* d = NULL;
+	bdbm_hlm_wb_entry_t* e = NULL;
+	bdbm_llm_req_t* lr = NULL;
+	unsigned long flags;
+	uint64_t i, n;
+
+	/* get a free destage request */
+	bdbm_credit_acquire (&p->destage_credit, 1);
+	bdbm_spin_lock_irqsave (&p->lock, flags);
+	for (i = 0; i < HLM_WB_NR_DESTAGES; i++) {
+		if (p->destages[i].in_use == 0) {
+			d = &p->destages[i];
+			d->in_use = 1;
+			break;
+		}
+	}
+	bdbm_spin_unlock_irqrestore (&p->lock, flags);
+	bdbm_bug_on (d == NULL);
+
+	/* copy the oldest dirty pages to the request; pages are copied with the 
+	 * lock held, so writers can keep updating the buffer. ftl_lock is held 
+	 * from here until the pages are queued in llm: a trim that drops one of 
+	 * them meanwhile invalidates its lpa only after that, so the old data is 
+	 * not mapped back over the trim, and a read of a hole of a partial page 
+	 * is queued behind its rmw rather than reading the new location early */
+	bdbm_mutex_lock (&p->ftl_lock);
+	for (n = 0; n < p->destage_unit; n++) {
+		bdbm_spin_lock_irqsave (&p->lock, flags);
+		if (!list_empty (&p->dirty_list)) {
+			e = list_entry (p->dirty_list.next, bdbm_hlm_wb_entry_t, list);
+		} else if (__hlm_wb_can_destage_partial (p)) {
+			e = list_entry (p->partial_list.next, bdbm_hlm_wb_entry_t, list);
+		} else {
+			bdbm_spin_unlock_irqrestore (&p->lock, flags);
+			break;
+		}
+		__hlm_wb_del_dirty (p, e);
+		e->is_destaging = 1;
+		p->nr_destaging++;
+
+		lr = &d->hr.llm_reqs[n];
+		hlm_reqs_pool_reset_fmain (&lr->fmain);
+		hlm_reqs_pool_reset_logaddr (&lr->logaddr);
+		for (i = 0; i < BDBM_MAX_PAGES; i++) {
+			if (e->kp_stt[i] != KP_STT_DATA)
+				continue;	/* a hole; it is filled with the data on flash */
+			bdbm_memcpy (lr->fmain.kp_pad[i], e->data + KPAGE_SIZE * i, KPAGE_SIZE);
+			lr->fmain.kp_stt[i] = KP_STT_DATA;
+		}
+		lr->logaddr.lpa[0] = e->lpa;
+		lr->req_type = e->is_partial ? REQTYPE_RMW_READ : REQTYPE_WRITE;
+		d->entries[n] = e;
+		d->versions[n] = e->version;
+		bdbm_spin_unlock_irqrestore (&p->lock, flags);
+
+		if (bdbm_is_rmw (lr->req_type))
+			atomic64_inc (&p->nr_rmws);
+		lr->ptr_hlm_req = (void*)&d->hr;
+	}
+
+	if (n == 0) {
+		bdbm_mutex_unlock (&p->ftl_lock);
+		d->in_use = 0;
+		bdbm_credit_release (&p->destage_credit, 1);
+		return 0;
+	}
+
+	/* send it to flash */
+	d->hr.req_type = REQTYPE_WRITE;
+	d->hr.nr_llm_reqs = n;
+	atomic64_set (&d->hr.nr_llm_reqs_done, 0);
+	d->hr.blkio_req = NULL;
+	d->hr.ret = 0;
+
+	if (hlm_nobuf_map_req (bdi, &d->hr) != 0) {
+		bdbm_error ("hlm_nobuf_map_req failed");
+		bdbm_bug_on (1);
+	}
+	hlm_nobuf_submit_req (bdi, &d->hr);
+	bdbm_mutex_unlock (&p->ftl_lock);
+
+	atomic64_add (n, &p->nr_destaged);
+
+	return n;
+}
+
+static void __hlm_wb_finish_destage (
+	bdbm_drv_info_t* bdi,
+	bdbm_hlm_wb_destage_t* d)
+{
+	bdbm_hlm_wb_private_t* p = (bdbm_hlm_wb_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_hlm_wb_entry_t* e = NULL;
+	unsigned long flags;
+	uint64_t i, nr_freed = 0;
+	uint64_t nr_llm_reqs = d->hr.nr_llm_reqs;	/* d is reused once it is released */
+
+	bdbm_spin_lock_irqsave (&p->lock, flags);
+	for (i = 0; i < nr_llm_reqs; i++) {
+		e = d->entries[i];
+		if (e->lpa == -1) {
+			/* it was trimmed */
+			__hlm_wb_free_entry (p, e);
+			nr_freed++;
+		} else if (e->version == d->versions[i]) {
+			/* the data on flash is up-to-date */
+			HASH_DEL (p->ht, e);
+			__hlm_wb_free_entry (p, e);
+			nr_freed++;
+		} else {
+			/* it was overwritten during destaging; keep it dirty */
+			e->is_destaging = 0;
+			__hlm_wb_add_dirty (p, e);
+		}
+	}
+	d->in_use = 0;
+	bdbm_spin_unlock_irqrestore (&p->lock, flags);
+
+	bdbm_credit_release (&p->free_credit, nr_freed);
+	bdbm_credit_release (&p->destage_credit, 1);
+
+	/* see if there are more pages to destage */
+	bdbm_thread_wakeup (p->destage_thread);
+
+	/* this comes last, so a flush that sees it does not race with the 
+	 * rest of the destage */
+	bdbm_spin_lock_irqsave (&p->lock, flags);
+	p->nr_destaging -= nr_llm_reqs;
+	bdbm_spin_unlock_irqrestore (&p->lock, flags);
+}
+
+int __hlm_wb_destage_thread (void* arg)
+{
+	bdbm_drv_info_t* bdi = (bdbm_drv_info_t*)arg;
+	bdbm_hlm_wb_private_t* p = (bdbm_hlm_wb_private_t*)BDBM_HLM_PRIV(bdi);
+
+	for (;;) {
+		if (!__hlm_wb_need_destage (p)) {
+			if (p->nr_partial > 0) {
+				/* wait for the merge window of partial pages to close */
+				bdbm_thread_msleep (1);
+				continue;
+			}
+			if (bdbm_thread_schedule (p->destage_thread) == SIGKILL) {
+				break;
+			}
+		}
+
+		/* destage stripes until the buffer has enough room */
+		while (__hlm_wb_need_destage (p)) {
+			if (__hlm_wb_destage (bdi) == 0)
+				break;
+		}
+	}
+
+	return 0;
+}
+
+/* wait until all the buffered pages are on flash */
+static void __hlm_wb_flush (bdbm_drv_info_t* bdi)
+{
+	bdbm_hlm_wb_private_t* p = (bdbm_hlm_wb_private_t*)BDBM_HLM_PRIV(bdi);
+	unsigned long flags;
+	uint8_t busy;
+
+	atomic64_inc (&p->nr_flushes);
+	for (;;) {
+		bdbm_spin_lock_irqsave (&p->lock, flags);
+		busy = (p->nr_dirty > 0 || p->nr_destaging > 0);
+		bdbm_spin_unlock_irqrestore (&p->lock, flags);
+		if (!busy)
+			break;
+		bdbm_thread_wakeup (p->destage_thread);
+		bdbm_thread_msleep (1);
+	}
+	atomic64_dec (&p->nr_flushes);
+}
+
+/* merge the data part of lr into a buffered page */
+static void __hlm_wb_update_entry (
+	bdbm_hlm_wb_private_t* p, 
+	bdbm_hlm_wb_entry_t* e,
+	bdbm_llm_req_t* lr)
+{
+	uint8_t was_partial = e->is_partial;
+	uint64_t i;
+
+	for (i = 0; i < BDBM_MAX_PAGES; i++) {
+		if (lr->fmain.kp_stt[i] == KP_STT_DATA) {
+			bdbm_memcpy (e->data + KPAGE_SIZE * i, lr->fmain.kp_ptr[i], KPAGE_SIZE);
+			e->kp_stt[i] = KP_STT_DATA;
+		}
+	}
+	e->version++;
+
+	if (e->is_destaging)
+		return;
+
+	/* keep hot pages longer in the buffer; a partial page stays where it 
+	 * is until it is completed */
+	if (!was_partial || __hlm_wb_is_full (e->kp_stt)) {
+		__hlm_wb_del_dirty (p, e);
+		__hlm_wb_add_dirty (p, e);
+	}
+	if (was_partial)
+		atomic64_inc (&p->nr_merges);
+}
+
+/* buffer a page; it sleeps if there are no free pages */
+static void __hlm_wb_write_page (
+	bdbm_drv_info_t* bdi,
+	bdbm_llm_req_t* lr)
+{
+	bdbm_hlm_wb_private_t* p = (bdbm_hlm_wb_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_hlm_wb_entry_t* e = NULL;
+	int64_t lpa = lr->logaddr.lpa[0];
+	unsigned long flags;
+	uint64_t i;
+
+	atomic64_inc (&p->nr_writes);
+
+	/* overwrite the page in place if it is buffered */
+	bdbm_spin_lock_irqsave (&p->lock, flags);
+	HASH_FIND (hh, p->ht, &lpa, sizeof (int64_t), e);
+	if (e != NULL) {
+		__hlm_wb_update_entry (p, e, lr);
+		bdbm_spin_unlock_irqrestore (&p->lock, flags);
+		atomic64_inc (&p->nr_overwrites);
+		return;
+	}
+	bdbm_spin_unlock_irqrestore (&p->lock, flags);
+
+	/* get a free page */
+	if (bdbm_credit_get_nr_available (&p->free_credit) <= p->destage_unit)
+		bdbm_thread_wakeup (p->destage_thread);
+	bdbm_credit_acquire (&p->free_credit, 1);
+
+	bdbm_spin_lock_irqsave (&p->lock, flags);
+	HASH_FIND (hh, p->ht, &lpa, sizeof (int64_t), e);
+	if (e != NULL) {
+		/* somebody else has buffered it meanwhile */
+		__hlm_wb_update_entry (p, e, lr);
+		bdbm_spin_unlock_irqrestore (&p->lock, flags);
+		bdbm_credit_release (&p->free_credit, 1);
+		atomic64_inc (&p->nr_overwrites);
+		return;
+	}
+	bdbm_bug_on (list_empty (&p->free_list));
+	e = list_entry (p->free_list.next, bdbm_hlm_wb_entry_t, list);
+	list_del (&e->list);
+	e->lpa = lpa;
+	e->is_destaging = 0;
+	for (i = 0; i < BDBM_MAX_PAGES; i++) {
+		if (lr->fmain.kp_stt[i] == KP_STT_DATA)
+			bdbm_memcpy (e->data + KPAGE_SIZE * i, lr->fmain.kp_ptr[i], KPAGE_SIZE);
+		e->kp_stt[i] = lr->fmain.kp_stt[i];
+	}
+	e->version++;
+	HASH_ADD (hh, p->ht, lpa, sizeof (int64_t), e);
+	__hlm_wb_add_dirty (p, e);
+	bdbm_spin_unlock_irqrestore (&p->lock, flags);
+}
+
+static uint32_t __hlm_wb_submit (
+	bdbm_drv_info_t* bdi, 
+	bdbm_hlm_req_t* hr,
+	uint8_t* hits)
+{
+	bdbm_hlm_wb_private_t* p = (bdbm_hlm_wb_private_t*)BDBM_HLM_PRIV(bdi);
+	uint64_t i;
+	uint32_t ret;
+
+	/* reqs are queued in llm in the order they are mapped (see 
+	 * __hlm_wb_destage ()) */
+	bdbm_mutex_lock (&p->ftl_lock);
+	if ((ret = hlm_nobuf_map_req (bdi, hr)) != 0) {
+		bdbm_mutex_unlock (&p->ftl_lock);
+		return ret;
+	}
+
+	/* pages read from the buffer don't go to flash */
+	if (hits != NULL) {
+		for (i = 0; i < hr->nr_llm_reqs; i++) {
+			if (hits[i])
+				hr->llm_reqs[i].req_type = REQTYPE_READ_DUMMY;
+		}
+	}
+
+	ret = hlm_nobuf_submit_req (bdi, hr);
+	bdbm_mutex_unlock (&p->ftl_lock);
+
+	return ret;
+}
+
+static uint32_t __hlm_wb_make_write_req (
+	bdbm_drv_info_t* bdi, 
+	bdbm_hlm_req_t* hr)
+{
+	bdbm_hlm_wb_private_t* p = (bdbm_hlm_wb_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_blkio_req_t* br = (bdbm_blkio_req_t*)hr->blkio_req;
+	bdbm_hlm_wb_entry_t* e = NULL;
+	bdbm_llm_req_t* lr = NULL;
+	uint8_t write_through = 0;
+	unsigned long flags;
+	uint64_t i = 0;
+
+	/* a preflush */
+	if (br && (br->bi_flags & BDBM_BLKIO_FLUSH))
+		__hlm_wb_flush (bdi);
+
+	/* FUA writes go to flash directly; partial writes are merged in the 
+	 * buffer, so they don't need rmw unless they stay partial */
+	if (br && (br->bi_flags & BDBM_BLKIO_FUA))
+		write_through = 1;
+
+	if (write_through) {
+		/* buffered pages must not be older than flash */
+		bdbm_hlm_for_each_llm_req (lr, hr, i) {
+			int64_t lpa = lr->logaddr.lpa[0];
+			bdbm_spin_lock_irqsave (&p->lock, flags);
+			HASH_FIND (hh, p->ht, &lpa, sizeof (int64_t), e);
+			if (e != NULL)
+				__hlm_wb_update_entry (p, e, lr);
+			bdbm_spin_unlock_irqrestore (&p->lock, flags);
+		}
+		return __hlm_wb_submit (bdi, hr, NULL);
+	}
+
+	/* buffer pages and acknowledge the write */
+	bdbm_hlm_for_each_llm_req (lr, hr, i) {
+		__hlm_wb_write_page (bdi, lr);
+	}
+	if (__hlm_wb_need_destage (p))
+		bdbm_thread_wakeup (p->destage_thread);
+
+	bdi->ptr_host_inf->end_req (bdi, hr);
+
+	return 0;
+}
+
+static uint32_t __hlm_wb_make_read_req (
+	bdbm_drv_info_t* bdi, 
+	bdbm_hlm_req_t* hr)
+{
+	bdbm_hlm_wb_private_t* p = (bdbm_hlm_wb_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_hlm_wb_entry_t* e = NULL;
+	bdbm_llm_req_t* lr = NULL;
+	uint8_t hits[BDBM_BLKIO_MAX_VECS];
+	uint64_t i = 0, j, nr_hits = 0;
+	uint8_t need_flush = 0;
+	unsigned long flags;
+
+again:
+	/* read pages from the buffer if they are there */
+	bdbm_hlm_for_each_llm_req (lr, hr, i) {
+		int64_t lpa = lr->logaddr.lpa[0];
+		uint64_t nr_staged = 0, nr_wanted = 0;
+
+		hits[i] = 0;
+		bdbm_spin_lock_irqsave (&p->lock, flags);
+		HASH_FIND (hh, p->ht, &lpa, sizeof (int64_t), e);
+		if (e != NULL) {
+			for (j = 0; j < BDBM_MAX_PAGES; j++) {
+				if (lr->fmain.kp_stt[j] != KP_STT_DATA)
+					continue;
+				nr_wanted++;
+				if (e->kp_stt[j] == KP_STT_DATA)
+					nr_staged++;
+			}
+			if (nr_staged == nr_wanted) {
+				for (j = 0; j < BDBM_MAX_PAGES; j++) {
+					if (lr->fmain.kp_stt[j] == KP_STT_DATA)
+						bdbm_memcpy (lr->fmain.kp_ptr[j], e->data + KPAGE_SIZE * j, KPAGE_SIZE);
+				}
+				hits[i] = 1;
+				nr_hits++;
+			} else if (nr_staged > 0) {
+				/* a part of it is only in the buffer */
+				need_flush = 1;
+			}
+		}
+		bdbm_spin_unlock_irqrestore (&p->lock, flags);
+		if (need_flush)
+			break;
+	}
+
+	/* write partial pages to flash and read everything from there */
+	if (need_flush) {
+		__hlm_wb_flush (bdi);
+		need_flush = 0;
+		nr_hits = 0;
+		goto again;
+	}
+	atomic64_add (nr_hits, &p->nr_read_hits);
+
+	if (nr_hits == hr->nr_llm_reqs) {
+		bdi->ptr_host_inf->end_req (bdi, hr);
+		return 0;
+	}
+
+	return __hlm_wb_submit (bdi, hr, hits);
+}
+
+static uint32_t __hlm_wb_make_trim_req (
+	bdbm_drv_info_t* bdi, 
+	bdbm_hlm_req_t* hr)
+{
+	bdbm_hlm_wb_private_t* p = (bdbm_hlm_wb_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_hlm_wb_entry_t* e = NULL;
+	bdbm_hlm_wb_entry_t* tmp = NULL;
+	unsigned long flags;
+	uint64_t nr_freed = 0;
+
+	/* drop buffered pages in the range */
+	bdbm_spin_lock_irqsave (&p->lock, flags);
+	HASH_ITER (hh, p->ht, e, tmp) {
+		if (e->lpa < hr->lpa || e->lpa >= hr->lpa + hr->len)
+			continue;
+		HASH_DEL (p->ht, e);
+		if (e->is_destaging) {
+			/* it is freed when destaging is finished; the destage has 
+			 * mapped it already, so __hlm_wb_submit () below unmaps it */
+			e->lpa = -1;
+		} else {
+			__hlm_wb_del_dirty (p, e);
+			__hlm_wb_free_entry (p, e);
+			nr_freed++;
+		}
+	}
+	bdbm_spin_unlock_irqrestore (&p->lock, flags);
+	bdbm_credit_release (&p->free_credit, nr_freed);
+
+	return __hlm_wb_submit (bdi, hr, NULL);
+}
+
+/* interface functions for hlm_wb */
+uint32_t hlm_wb_create (bdbm_drv_info_t* bdi)
+{
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	bdbm_hlm_wb_private_t* p = NULL;
+	uint64_t i;
+
+	if (np->nr_subpages_per_page != 1) {
+		bdbm_error ("hlm_wb does not support sub-pages");
+		return 1;
+	}
+
+	/* create private */
+	if ((p = (bdbm_hlm_wb_private_t*)bdbm_zmalloc
+			(sizeof (bdbm_hlm_wb_private_t))) == NULL) {
+		bdbm_error ("bdbm_zmalloc failed");
+		return 1;
+	}
+
+	/* setup FTL function pointers */
+	if ((p->ptr_ftl_inf = BDBM_GET_FTL_INF (bdi)) == NULL) {
+		bdbm_error ("ftl is not valid");
+		bdbm_free (p);
+		return 1;
+	}
+
+	/* a stripe has a page per punit */
+	p->destage_unit = BDBM_GET_NR_PUNITS (bdi->parm_dev);
+	if (p->destage_unit > BDBM_BLKIO_MAX_VECS)
+		p->destage_unit = BDBM_BLKIO_MAX_VECS;
+
+	/* the buffer keeps at least two stripes */
+	p->nr_entries = BDBM_GET_DRIVER_PARAMS (bdi)->hlm_wb_nr_pages;
+	if (p->nr_entries < p->destage_unit * 2)
+		p->nr_entries = p->destage_unit * 2;
+	p->high_watermark = p->nr_entries / 2;
+
+	/* create the buffer */
+	if ((p->entries = (bdbm_hlm_wb_entry_t*)bdbm_zmalloc 
+			(sizeof (bdbm_hlm_wb_entry_t) * p->nr_entries)) == NULL ||
+		(p->data = (uint8_t*)bdbm_malloc 
+			(HLM_WB_PAGE_SIZE * p->nr_entries)) == NULL) {
+		bdbm_error ("bdbm_malloc failed");
+		goto fail;
+	}
+	bdbm_spin_lock_init (&p->lock);
+	p->ht = NULL;
+	INIT_LIST_HEAD (&p->dirty_list);
+	INIT_LIST_HEAD (&p->partial_list);
+	INIT_LIST_HEAD (&p->free_list);
+	for (i = 0; i < p->nr_entries; i++) {
+		p->entries[i].data = p->data + HLM_WB_PAGE_SIZE * i;
+		p->entries[i].version = 0;
+		__hlm_wb_free_entry (p, &p->entries[i]);
+	}
+	p->nr_dirty = 0;
+	p->nr_partial = 0;
+	p->nr_destaging = 0;
+	bdbm_credit_init (&p->free_credit, p->nr_entries);
+
+	/* create destage requests */
+	if ((p->destages = (bdbm_hlm_wb_destage_t*)bdbm_zmalloc
+			(sizeof (bdbm_hlm_wb_destage_t) * HLM_WB_NR_DESTAGES)) == NULL) {
+		bdbm_error ("bdbm_zmalloc failed");
+		goto fail;
+	}
+	for (i = 0; i < HLM_WB_NR_DESTAGES; i++) {
+		hlm_reqs_pool_allocate_llm_reqs (
+			p->destages[i].hr.llm_reqs, p->destage_unit, RP_MEM_VIRT);
+		bdbm_sema_init (&p->destages[i].hr.done);
+	}
+	bdbm_credit_init (&p->destage_credit, HLM_WB_NR_DESTAGES);
+	atomic64_set (&p->nr_flushes, 0);
+	bdbm_mutex_init (&p->ftl_lock);
+
+	atomic64_set (&p->nr_writes, 0);
+	atomic64_set (&p->nr_overwrites, 0);
+	atomic64_set (&p->nr_read_hits, 0);
+	atomic64_set (&p->nr_destaged, 0);
+	atomic64_set (&p->nr_merges, 0);
+	atomic64_set (&p->nr_rmws, 0);
+
+	/* keep the private structure */
+	bdi->ptr_hlm_inf->ptr_private = (void*)p;
+
+	/* create & run a thread */
+	if ((p->destage_thread = bdbm_thread_create (
+			__hlm_wb_destage_thread, bdi, "__hlm_wb_destage_thread")) == NULL) {
+		bdbm_error ("kthread_create failed");
+		bdi->ptr_hlm_inf->ptr_private = NULL;
+		goto fail_thread;
+	}
+	bdbm_thread_run (p->destage_thread);
+
+	bdbm_msg ("hlm_wb: %llu pages, %llu pages per stripe", 
+		p->nr_entries, p->destage_unit);
+
+	return 0;
+
+fail_thread:
+	for (i = 0; i < HLM_WB_NR_DESTAGES; i++) {
+		hlm_reqs_pool_release_llm_reqs (
+			p->destages[i].hr.llm_reqs, p->destage_unit, RP_MEM_VIRT);
+		bdbm_sema_free (&p->destages[i].hr.done);
+	}
+	bdbm_credit_free (&p->destage_credit);
+	bdbm_credit_free (&p->free_credit);
+	bdbm_mutex_free (&p->ftl_lock);
+	bdbm_spin_lock_destory (&p->lock);
+
+fail:
+	if (p->destages)
+		bdbm_free (p->destages);
+	if (p->data)
+		bdbm_free (p->data);
+	if (p->entries)
+		bdbm_free (p->entries);
+	bdbm_free (p);
+	return 1;
+}
+
+void hlm_wb_destroy (bdbm_drv_info_t* bdi)
+{
+	bdbm_hlm_wb_private_t* p = (bdbm_hlm_wb_private_t*)BDBM_HLM_PRIV(bdi);
+	uint64_t i;
+
+	/* write back all the buffered pages */
+	__hlm_wb_flush (bdi);
+
+	/* kill kthread */
+	bdbm_thread_stop (p->destage_thread);
+
+	bdbm_msg ("hlm_wb: %lld writes, %lld overwrites, %lld read hits, %lld pages destaged",
+		atomic64_read (&p->nr_writes),
+		atomic64_read (&p->nr_overwrites),
+		atomic64_read (&p->nr_read_hits),
+		atomic64_read (&p->nr_destaged));
+	bdbm_msg ("hlm_wb: %lld sub-page merges, %lld pages destaged with rmw",
+		atomic64_read (&p->nr_merges),
+		atomic64_read (&p->nr_rmws));
+
+	HASH_CLEAR (hh, p->ht);
+	for (i = 0; i < HLM_WB_NR_DESTAGES; i++) {
+		hlm_reqs_pool_release_llm_reqs (
+			p->destages[i].hr.llm_reqs, p->destage_unit, RP_MEM_VIRT);
+		bdbm_sema_free (&p->destages[i].hr.done);
+	}
+	bdbm_credit_free (&p->destage_credit);
+	bdbm_credit_free (&p->free_credit);
+	bdbm_mutex_free (&p->ftl_lock);
+	bdbm_spin_lock_destory (&p->lock);
+
+	bdbm_free (p->destages);
+	bdbm_free (p->data);
+	bdbm_free (p->entries);
+	bdbm_free (p);
+}
+
+uint32_t hlm_wb_make_req (
+	bdbm_drv_info_t* bdi, 
+	bdbm_hlm_req_t* hr)
+{
+	if (bdbm_is_flush (hr->req_type)) {
+		__hlm_wb_flush (bdi);
+		bdi->ptr_host_inf->end_req (bdi, hr);
+		return 0;
+	}
+	if (bdbm_is_trim (hr->req_type))
+		return __hlm_wb_make_trim_req (bdi, hr);
+	if (bdbm_is_write (hr->req_type))
+		return __hlm_wb_make_write_req (bdi, hr);
+	if (bdbm_is_read (hr->req_type))
+		return __hlm_wb_make_read_req (bdi, hr);
+
+	bdbm_error ("oops! invalid type (%x)", hr->req_type);
+	return 1;
+}
+
+void hlm_wb_end_req (
+	bdbm_drv_info_t* bdi, 
+	bdbm_llm_req_t* lr)
+{
+	bdbm_hlm_wb_private_t* p = (bdbm_hlm_wb_private_t*)BDBM_HLM_PRIV(bdi);
+	bdbm_hlm_wb_destage_t* d = (bdbm_hlm_wb_destage_t*)lr->ptr_hlm_req;
+
+	/* host requests and gc requests */
+	if (bdbm_is_gc (lr->req_type) ||
+		d < p->destages || d >= p->destages + HLM_WB_NR_DESTAGES) {
+		hlm_nobuf_end_req (bdi, lr);
+		return;
+	}
+
+	/* destage requests */
+	atomic64_inc (&d->hr.nr_llm_reqs_done);
+	lr->req_type |= REQTYPE_DONE;
+	if (atomic64_read (&d->hr.nr_llm_reqs_done) == d->hr.nr_llm_reqs) {
+		__hlm_wb_finish_destage (bdi, d);
+	}
+}
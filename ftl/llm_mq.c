@@ -39,6 +39,7 @@ THE SOFTWARE.
 #include "params.h"
 #include "bdbm_drv.h"
 #include "uthread.h"
+#include "ucredit.h"
 #include "pmu.h"
 #include "utime.h"
 
@@ -60,13 +61,63 @@ bdbm_llm_inf_t _llm_mq_inf = {
 	.make_req = llm_mq_make_req,
 	.flush = llm_mq_flush,
 	.end_req = llm_mq_end_req,
+	.get_punit_load = llm_mq_get_punit_load,
 };
 
+/* what a punit is doing, for program/erase suspend */
+typedef struct {
+	bdbm_spinlock_t lock;
+	bdbm_llm_req_t* busy;	/* the req that holds the punit lock */
+	int64_t busy_us;	/* its expected time; 0 if it cannot be suspended */
+	bdbm_stopwatch_t sw;
+	bdbm_llm_req_t* rd;	/* a read sent by suspending busy */
+	uint8_t suspended;	/* busy was suspended once already */
+} bdbm_llm_mq_punit_t;
+
+/* deficit round-robin among the tenants of a punit */
+typedef struct {
+	uint64_t cur;	/* the tenant whose turn it is */
+	int64_t deficit[LLM_MAX_TENANTS];	/* punit time (us) tenants can use in their turns */
+} bdbm_llm_mq_drr_t;
+
+/* what a tenant got from the llm */
+typedef struct {
+	uint64_t nr_reqs;
+	uint64_t busy_us;	/* expected punit time of its reqs */
+	uint64_t lat_sum_us;	/* from enqueue to completion */
+	uint64_t lat_max_us;
+} bdbm_llm_mq_tenant_t;
+
 /* private */
 struct bdbm_llm_mq_private {
 	uint64_t nr_punits;
 	bdbm_sema_t* punit_locks;
 	bdbm_prior_queue_t* q;
+	bdbm_credit_t credit;	/* for flow control of items in q */
+
+	/* for program/erase suspend */
+	uint8_t suspend;
+	bdbm_llm_mq_punit_t* punits;
+	uint64_t nr_suspends;
+	uint64_t suspend_saved_us;	/* waiting avoided by reads (estimated) */
+
+	/* for multi-plane operations */
+	uint64_t nr_planes;
+	uint64_t nr_mp_ops;
+	uint64_t nr_mp_reqs;
+
+	/* for fair sharing of punits; each punit has a sub-queue per tenant */
+	uint64_t nr_tenants;	/* 1: reqs of a punit are served in order */
+	int64_t quantum_us;	/* punit time a tenant of weight 1 gets per turn */
+	int64_t weights[LLM_MAX_TENANTS];
+	bdbm_llm_mq_drr_t* drr;
+	bdbm_spinlock_t tenant_lock;
+	bdbm_llm_mq_tenant_t tenants[LLM_MAX_TENANTS];
+	bdbm_stopwatch_t sw;
+
+	/* for read forwarding from queued writes */
+	uint8_t read_forward;
+	atomic64_t nr_fwd_reads;
 
 	/* for debugging */
 #if defined(ENABLE_SEQ_DBG)
@@ -77,6 +128,321 @@ struct bdbm_llm_mq_private {
 	bdbm_thread_t* llm_thread;
 };
 
+static inline uint64_t __llm_mq_get_qid (
+	struct bdbm_llm_mq_private* p, 
+	uint64_t punit_id, 
+	uint32_t tenant_id)
+{
+	return punit_id * p->nr_tenants + tenant_id % p->nr_tenants;
+}
+
+/* the expected punit time of r; it is at least 1 us so that a tenant 
+ * cannot keep a punit with free reqs */
+static int64_t __llm_mq_get_cost_us (
+	bdbm_drv_info_t* bdi, 
+	bdbm_llm_req_t* r)
+{
+	uint64_t us;
+
+	if (bdbm_is_erase (r->req_type))
+		us = bdi->parm_dev.block_erase_time_us;
+	else if (bdbm_is_write (r->req_type))
+		us = bdi->parm_dev.page_prog_time_us;
+	else
+		us = bdi->parm_dev.page_read_time_us;
+
+	return us > 0 ? us : 1;
+}
+
+/* DEFICIT ROUND-ROBIN:
+ * the tenants of a punit take turns. a tenant gets its weight times 
+ * quantum_us of punit time in its turn and keeps sending reqs while their 
+ * expected time fits in what is left (its deficit); the rest is carried 
+ * over to its next turn unless its queue becomes empty. it returns the 
+ * sub-queue to serve next, or -1 if all of them are empty */
+static int64_t __llm_mq_get_next_qid (
+	bdbm_drv_info_t* bdi, 
+	struct bdbm_llm_mq_private* p, 
+	uint64_t punit_id)
+{
+	bdbm_llm_mq_drr_t* d = NULL;
+	bdbm_llm_req_t* r = NULL;
+	uint64_t nr_empty = 0;
+
+	if (p->nr_tenants == 1)
+		return punit_id;
+
+	d = &p->drr[punit_id];
+	for (;;) {
+		r = (bdbm_llm_req_t*)bdbm_prior_queue_peek (p->q, punit_id * p->nr_tenants + d->cur);
+		if (r == NULL) {
+			/* idle tenants do not save up punit time */
+			d->deficit[d->cur] = 0;
+			if (++nr_empty == p->nr_tenants)
+				return -1;
+		} else if (__llm_mq_get_cost_us (bdi, r) <= d->deficit[d->cur]) {
+			return punit_id * p->nr_tenants + d->cur;
+		} else {
+			nr_empty = 0;
+		}
+		d->cur = (d->cur + 1) % p->nr_tenants;
+		d->deficit[d->cur] += p->quantum_us * p->weights[d->cur];
+	}
+}
+
+/* dequeue a req from a sub-queue and charge its tenant for it */
+static bdbm_llm_req_t* __llm_mq_dequeue (
+	bdbm_drv_info_t* bdi, 
+	struct bdbm_llm_mq_private* p, 
+	uint64_t qid, 
+	bdbm_prior_queue_item_t** qitem)
+{
+	bdbm_llm_req_t* r = NULL;
+
+	r = (bdbm_llm_req_t*)bdbm_prior_queue_dequeue (p->q, qid, qitem);
+	if (r != NULL && p->nr_tenants > 1) {
+		p->drr[qid / p->nr_tenants].deficit[qid % p->nr_tenants] -= 
+			__llm_mq_get_cost_us (bdi, r);
+	}
+
+	return r;
+}
+
+/* a req of a tenant is served; done is 0 for the read of rmw */
+static void __llm_mq_account (
+	bdbm_drv_info_t* bdi, 
+	struct bdbm_llm_mq_private* p, 
+	bdbm_llm_req_t* r, 
+	bdbm_prior_queue_item_t* qitem, 
+	uint8_t done)
+{
+	bdbm_llm_mq_tenant_t* t = &p->tenants[qitem->qid % p->nr_tenants];
+	uint64_t lat_us = bdbm_stopwatch_get_elapsed_time_us (&qitem->sw);
+	unsigned long flags;
+
+	bdbm_spin_lock_irqsave (&p->tenant_lock, flags);
+	/* a multi-plane operation takes the time of one */
+	if (!r->mp_follower)
+		t->busy_us += __llm_mq_get_cost_us (bdi, r);
+	if (done) {
+		t->nr_reqs++;
+		t->lat_sum_us += lat_us;
+		if (t->lat_max_us < lat_us)
+			t->lat_max_us = lat_us;
+	}
+	bdbm_spin_unlock_irqrestore (&p->tenant_lock, flags);
+}
+
+/* chain reqs waiting in sub-queue qid to r if they have the same type and
+ * page offset as r and are on the other planes, so that the device serves 
+ * them as one multi-plane operation; they are not charged to the tenant */
+static void __llm_mq_group_planes (
+	bdbm_drv_info_t* bdi, 
+	struct bdbm_llm_mq_private* p, 
+	uint64_t qid, 
+	bdbm_llm_req_t* r)
+{
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	bdbm_prior_queue_item_t* qitem = NULL;
+	bdbm_llm_req_t* tail = r;
+	bdbm_llm_req_t* n = NULL;
+	uint64_t planes, nr_reqs = 1;
+
+	if (bdbm_is_rmw (r->req_type) || 
+		!(bdbm_is_read (r->req_type) || bdbm_is_write (r->req_type) || bdbm_is_erase (r->req_type)))
+		return;
+
+	planes = 1ULL << BDBM_GET_PLANE_NO (np, &r->phyaddr);
+	while (nr_reqs < p->nr_planes) {
+		n = (bdbm_llm_req_t*)bdbm_prior_queue_peek (p->q, qid);
+		if (n == NULL || n->req_type != r->req_type ||
+			(!bdbm_is_erase (r->req_type) && n->phyaddr.page_no != r->phyaddr.page_no) ||
+			(planes & (1ULL << BDBM_GET_PLANE_NO (np, &n->phyaddr))))
+			break;
+
+		n = (bdbm_llm_req_t*)bdbm_prior_queue_dequeue (p->q, qid, &qitem);
+		n->ptr_qitem = qitem;
+		n->mp_next = NULL;
+		n->mp_follower = 1;
+		pmu_update_q (bdi, n);
+
+		tail->mp_next = n;
+		tail = n;
+		planes |= 1ULL << BDBM_GET_PLANE_NO (np, &n->phyaddr);
+		nr_reqs++;
+	}
+
+	if (nr_reqs > 1) {
+		p->nr_mp_ops++;
+		p->nr_mp_reqs += nr_reqs;
+	}
+}
+
+static void __llm_mq_punit_busy (
+	bdbm_drv_info_t* bdi, 
+	struct bdbm_llm_mq_private* p, 
+	uint64_t punit_id, 
+	bdbm_llm_req_t* r)
+{
+	bdbm_llm_mq_punit_t* pu = &p->punits[punit_id];
+	unsigned long flags;
+
+	bdbm_spin_lock_irqsave (&pu->lock, flags);
+	pu->busy = r;
+	if (bdbm_is_write (r->req_type))
+		pu->busy_us = bdi->parm_dev.page_prog_time_us;
+	else if (bdbm_is_erase (r->req_type))
+		pu->busy_us = bdi->parm_dev.block_erase_time_us;
+	else
+		pu->busy_us = 0;
+	pu->suspended = 0;
+	bdbm_stopwatch_start (&pu->sw);
+	bdbm_spin_unlock_irqrestore (&pu->lock, flags);
+}
+
+/* send the read waiting first on a punit busy with a program/erase if the 
+ * program/erase has more left to run than the cost of suspending it */
+static void __llm_mq_try_suspend (
+	bdbm_drv_info_t* bdi, 
+	struct bdbm_llm_mq_private* p, 
+	uint64_t punit_id)
+{
+	bdbm_llm_mq_punit_t* pu = &p->punits[punit_id];
+	bdbm_prior_queue_item_t* qitem = NULL;
+	bdbm_llm_req_t* r = NULL;
+	int64_t remain_us, qid;
+	unsigned long flags;
+
+	bdbm_spin_lock_irqsave (&pu->lock, flags);
+	if (pu->busy == NULL || pu->rd != NULL || pu->suspended) {
+		bdbm_spin_unlock_irqrestore (&pu->lock, flags);
+		return;
+	}
+	remain_us = pu->busy_us - bdbm_stopwatch_get_elapsed_time_us (&pu->sw);
+	if (remain_us <= (int64_t)bdi->parm_dev.suspend_overhead_us) {
+		bdbm_spin_unlock_irqrestore (&pu->lock, flags);
+		return;
+	}
+	if ((qid = __llm_mq_get_next_qid (bdi, p, punit_id)) < 0 ||
+		(r = (bdbm_llm_req_t*)bdbm_prior_queue_peek (p->q, qid)) == NULL || 
+		r->req_type != REQTYPE_READ) {
+		bdbm_spin_unlock_irqrestore (&pu->lock, flags);
+		return;
+	}
+	r = __llm_mq_dequeue (bdi, p, qid, &qitem);
+	r->ptr_qitem = qitem;
+	r->mp_next = NULL;
+	r->mp_follower = 0;
+	pu->rd = r;
+	pu->suspended = 1;
+	bdbm_spin_unlock_irqrestore (&pu->lock, flags);
+
+	p->nr_suspends++;
+	p->suspend_saved_us += remain_us - bdi->parm_dev.suspend_overhead_us;
+
+	pmu_update_q (bdi, r);
+
+	if (bdi->ptr_dm_inf->suspend_req (bdi, r)) {
+		bdi->ptr_llm_inf->end_req (bdi, r);
+		bdbm_warning ("oops! suspend_req failed");
+	}
+}
+
+/* READ FORWARDING:
+ * the mapping of a read points to a write still waiting in the queue if 
+ * the write has not reached flash yet; the read then copies the data from 
+ * the buffer of the write and never goes to the device. the write is the 
+ * one at the same physical page and subpage, so it is looked up in the lpa 
+ * chain of the first subpage of the write */
+static uint8_t __llm_mq_forward_page (void* req, void* arg)
+{
+	bdbm_llm_req_t* w = (bdbm_llm_req_t*)req;
+	bdbm_llm_req_t* r = ((void**)arg)[0];
+	bdbm_device_params_t* np = ((void**)arg)[1];
+	uint64_t i;
+
+	/* host writes only; holes of rmw are not filled yet */
+	if (w->req_type != REQTYPE_WRITE ||
+		w->phyaddr.channel_no != r->phyaddr.channel_no ||
+		w->phyaddr.chip_no != r->phyaddr.chip_no ||
+		w->phyaddr.block_no != r->phyaddr.block_no ||
+		w->phyaddr.page_no != r->phyaddr.page_no)
+		return 0;
+	for (i = 0; i < np->nr_subpages_per_page; i++) {
+		if (r->fmain.kp_stt[i] == KP_STT_DATA && 
+			(w->fmain.kp_stt[i] != KP_STT_DATA || w->logaddr.lpa[i] != r->logaddr.lpa[0]))
+			return 0;
+	}
+
+	/* the write stays in the queue, so its buffer is alive */
+	for (i = 0; i < np->nr_subpages_per_page; i++) {
+		if (r->fmain.kp_stt[i] == KP_STT_DATA)
+			bdbm_memcpy (r->fmain.kp_ptr[i], w->fmain.kp_ptr[i], KPAGE_SIZE);
+	}
+	bdbm_memcpy (r->foob.data, w->foob.data, sizeof (int64_t) * np->nr_subpages_per_page);
+
+	return 1;
+}
+
+static uint8_t __llm_mq_forward_read (
+	bdbm_drv_info_t* bdi, 
+	struct bdbm_llm_mq_private* p, 
+	bdbm_llm_req_t* r)
+{
+	bdbm_device_params_t* np = BDBM_GET_DEVICE_PARAMS (bdi);
+	void* arg[2] = { (void*)r, (void*)np };
+	uint64_t i;
+
+	if (!p->read_forward || r->req_type != REQTYPE_READ)
+		return 0;
+
+	/* the subpage of the read is where its lpa is in the write */
+	for (i = 0; i < np->nr_subpages_per_page; i++) {
+		if (r->fmain.kp_stt[i] == KP_STT_DATA)
+			break;
+	}
+	if (i == np->nr_subpages_per_page || r->logaddr.lpa[0] < (int64_t)i)
+		return 0;
+
+	return bdbm_prior_queue_find_lpa (p->q, r->logaddr.lpa[0] - i, __llm_mq_forward_page, (void*)arg);
+}
+
+/* a req that holds a punit is done. the punit lock stays held while a 
+ * suspended program/erase is pending, and passes to the read if the 
+ * program/erase finished before the device saw the read */
+static void __llm_mq_punit_release (
+	struct bdbm_llm_mq_private* p, 
+	bdbm_llm_req_t* r)
+{
+	bdbm_llm_mq_punit_t* pu;
+	uint8_t unlock = 1;
+	unsigned long flags;
+
+	/* the first req of a multi-plane operation holds the punit */
+	if (r->mp_follower)
+		return;
+
+	if (p->suspend) {
+		pu = &p->punits[r->phyaddr.punit_id];
+		bdbm_spin_lock_irqsave (&pu->lock, flags);
+		if (pu->rd == r) {
+			pu->rd = NULL;
+			unlock = 0;
+		} else if (pu->rd != NULL) {
+			pu->busy = pu->rd;
+			pu->busy_us = 0;
+			pu->rd = NULL;
+			unlock = 0;
+		} else {
+			pu->busy = NULL;
+		}
+		bdbm_spin_unlock_irqrestore (&pu->lock, flags);
+	}
+
+	if (unlock)
+		bdbm_sema_unlock (&p->punit_locks[r->phyaddr.punit_id]);
+}
+
 int __llm_mq_thread (void* arg)
 {
 	bdbm_drv_info_t* bdi = (bdbm_drv_info_t*)arg;
@@ -108,29 +474,49 @@ int __llm_mq_thread (void* arg)
 		for (loop = 0; loop < p->nr_punits; loop++) {
 			bdbm_prior_queue_item_t* qitem = NULL;
 			bdbm_llm_req_t* r = NULL;
+			int64_t qid;
 
 			/* if pu is busy, then go to the next pnit */
-			if (!bdbm_sema_try_lock (&p->punit_locks[loop]))
+			if (!bdbm_sema_try_lock (&p->punit_locks[loop])) {
+				if (p->suspend)
+					__llm_mq_try_suspend (bdi, p, loop);
 				continue;
+			}
 			
-			if ((r = (bdbm_llm_req_t*)bdbm_prior_queue_dequeue (p->q, loop, &qitem)) == NULL) {
+			if ((qid = __llm_mq_get_next_qid (bdi, p, loop)) < 0 ||
+				(r = __llm_mq_dequeue (bdi, p, qid, &qitem)) == NULL) {
 				bdbm_sema_unlock (&p->punit_locks[loop]);
 				continue;
 			}
 
 			r->ptr_qitem = qitem;
+			r->mp_next = NULL;
+			r->mp_follower = 0;
 
 			pmu_update_q (bdi, r);
 
+			if (p->nr_planes > 1)
+				__llm_mq_group_planes (bdi, p, qid, r);
+
+			if (p->suspend)
+				__llm_mq_punit_busy (bdi, p, loop, r);
+
 			if (cnt % 50000 == 0) {
 				bdbm_msg ("llm_make_req: %llu, %llu", cnt, bdbm_prior_queue_get_nr_items (p->q));
 			}
 
-			if (bdi->ptr_dm_inf->make_req (bdi, r)) {
+			if ((r->mp_next == NULL ? 
+					bdi->ptr_dm_inf->make_req (bdi, r) : 
+					bdi->ptr_dm_inf->make_mp_req (bdi, r))) {
+				bdbm_llm_req_t* n = NULL;
+
 				bdbm_sema_unlock (&p->punit_locks[loop]);
 
 				/* TODO: I do not check whether it works well or not */
-				bdi->ptr_llm_inf->end_req (bdi, r);
+				for (; r != NULL; r = n) {
+					n = r->mp_next;
+					bdi->ptr_llm_inf->end_req (bdi, r);
+				}
 				bdbm_warning ("oops! make_req failed");
 			}
 
@@ -144,7 +530,7 @@ int __llm_mq_thread (void* arg)
 uint32_t llm_mq_create (bdbm_drv_info_t* bdi)
 {
 	struct bdbm_llm_mq_private* p;
-	uint64_t loop;
+	uint64_t loop, queue_depth;
 
 	/* create a private info for llm_nt */
 	if ((p = (struct bdbm_llm_mq_private*)bdbm_malloc_atomic
@@ -156,8 +542,34 @@ uint32_t llm_mq_create (bdbm_drv_info_t* bdi)
 	/* get the total number of parallel units */
 	p->nr_punits = BDBM_GET_NR_PUNITS (bdi->parm_dev);
 
-	/* create queue */
-	if ((p->q = bdbm_prior_queue_create (p->nr_punits, INFINITE_QUEUE)) == NULL) {
+	/* setup flow control */
+	queue_depth = BDBM_GET_DRIVER_PARAMS (bdi)->llm_queue_depth >= 2 ? 
+		BDBM_GET_DRIVER_PARAMS (bdi)->llm_queue_depth : 96;
+	bdbm_credit_init (&p->credit, queue_depth);
+
+	/* share punits among tenants if there are more than one */
+	p->nr_tenants = 1;
+	if (BDBM_GET_DRIVER_PARAMS (bdi)->llm_nr_tenants > 1) {
+		p->nr_tenants = BDBM_GET_DRIVER_PARAMS (bdi)->llm_nr_tenants;
+		if (p->nr_tenants > LLM_MAX_TENANTS) {
+			bdbm_warning ("# of tenants is limited to %d", LLM_MAX_TENANTS);
+			p->nr_tenants = LLM_MAX_TENANTS;
+		}
+		for (loop = 0; loop < p->nr_tenants; loop++)
+			p->weights[loop] = BDBM_GET_DRIVER_PARAMS (bdi)->llm_tenant_weights[loop];
+		p->quantum_us = bdi->parm_dev.page_prog_time_us > 0 ? 
+			bdi->parm_dev.page_prog_time_us : 1;
+		if ((p->drr = (bdbm_llm_mq_drr_t*)bdbm_malloc_atomic
+				(sizeof (bdbm_llm_mq_drr_t) * p->nr_punits)) == NULL) {
+			bdbm_error ("bdbm_malloc_atomic failed");
+			goto fail;
+		}
+		bdbm_spin_lock_init (&p->tenant_lock);
+		bdbm_stopwatch_start (&p->sw);
+	}
+
+	/* create queue; credits keep it from overflowing */
+	if ((p->q = bdbm_prior_queue_create (p->nr_punits * p->nr_tenants, queue_depth)) == NULL) {
 		bdbm_error ("bdbm_prior_queue_create failed");
 		goto fail;
 	}
@@ -172,6 +584,33 @@ uint32_t llm_mq_create (bdbm_drv_info_t* bdi)
 		bdbm_sema_init (&p->punit_locks[loop]);
 	}
 
+	/* group reqs on sibling planes if the device has them; a bitmap keeps 
+	 * the planes of a group */
+	p->nr_planes = bdi->ptr_dm_inf->make_mp_req != NULL ? 
+		bdi->parm_dev.nr_planes_per_chip : 1;
+	if (p->nr_planes > 64) {
+		bdbm_warning ("multi-plane operations are not used for %llu planes", p->nr_planes);
+		p->nr_planes = 1;
+	}
+
+	/* suspend programs/erases for reads if the device supports it */
+	if (BDBM_GET_DRIVER_PARAMS (bdi)->llm_suspend && 
+		bdi->ptr_dm_inf->suspend_req != NULL) {
+		if ((p->punits = (bdbm_llm_mq_punit_t*)bdbm_malloc_atomic
+				(sizeof (bdbm_llm_mq_punit_t) * p->nr_punits)) == NULL) {
+			bdbm_error ("bdbm_malloc_atomic failed");
+			goto fail;
+		}
+		for (loop = 0; loop < p->nr_punits; loop++) {
+			bdbm_spin_lock_init (&p->punits[loop].lock);
+		}
+		p->suspend = 1;
+	}
+
+	/* serve reads from queued writes */
+	p->read_forward = BDBM_GET_DRIVER_PARAMS (bdi)->llm_read_forward ? 1 : 0;
+	atomic64_set (&p->nr_fwd_reads, 0);
+
 	/* keep the private structures for llm_nt */
 	bdi->ptr_llm_inf->ptr_private = (void*)p;
 
@@ -190,6 +629,10 @@ uint32_t llm_mq_create (bdbm_drv_info_t* bdi)
 	return 0;
 
 fail:
+	if (p->drr)
+		bdbm_free_atomic (p->drr);
+	if (p->punits)
+		bdbm_free_atomic (p->punits);
 	if (p->punit_locks)
 		bdbm_free_atomic (p->punit_locks);
 	if (p->q)
@@ -223,6 +666,44 @@ void llm_mq_destroy (bdbm_drv_info_t* bdi)
 		bdbm_sema_lock (&p->punit_locks[loop]);
 	}
 
+	bdbm_msg ("llm submitters slept %llu times for credits", 
+		bdbm_credit_get_nr_waits (&p->credit));
+	bdbm_credit_free (&p->credit);
+
+	if (p->nr_planes > 1) {
+		bdbm_msg ("llm multi-plane: %llu reqs served by %llu multi-plane operations",
+			p->nr_mp_reqs, p->nr_mp_ops);
+	}
+
+	if (p->read_forward) {
+		bdbm_msg ("llm read forwarding: %lld reads served from queued writes",
+			(int64_t)atomic64_read (&p->nr_fwd_reads));
+	}
+
+	if (p->suspend) {
+		bdbm_msg ("llm suspends: %llu reads served by suspending programs/erases (%llu us of waiting avoided, estimated)",
+			p->nr_suspends, p->suspend_saved_us);
+		for (loop = 0; loop < p->nr_punits; loop++) {
+			bdbm_spin_lock_destory (&p->punits[loop].lock);
+		}
+		bdbm_free_atomic (p->punits);
+	}
+
+	if (p->nr_tenants > 1) {
+		uint64_t elapsed_ms = bdbm_stopwatch_get_elapsed_time_ms (&p->sw);
+		for (loop = 0; loop < p->nr_tenants; loop++) {
+			bdbm_llm_mq_tenant_t* t = &p->tenants[loop];
+			bdbm_msg ("llm tenant %llu (weight %lld): %llu reqs (%llu reqs/s), %llu ms of punit time, latency mean=%llu us max=%llu us",
+				loop, p->weights[loop], t->nr_reqs, 
+				elapsed_ms > 0 ? t->nr_reqs * 1000 / elapsed_ms : 0,
+				t->busy_us / 1000, 
+				t->nr_reqs > 0 ? t->lat_sum_us / t->nr_reqs : 0, 
+				t->lat_max_us);
+		}
+		bdbm_spin_lock_destory (&p->tenant_lock);
+		bdbm_free_atomic (p->drr);
+	}
+
 	/* release all the relevant data structures */
 	if (p->q)
 		bdbm_prior_queue_destroy (p->q);
@@ -243,26 +724,38 @@ uint32_t llm_mq_make_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* r)
 	/* obtain the elapsed time taken by FTL algorithms */
 	pmu_update_sw (bdi, r);
 
-	/* wait until there are enough free slots in Q */
-	while (bdbm_prior_queue_get_nr_items (p->q) >= 96) {
-		bdbm_thread_yield ();
+	/* a read of a queued write is done without the device */
+	if (__llm_mq_forward_read (bdi, p, r)) {
+		atomic64_inc (&p->nr_fwd_reads);
+#if defined(ENABLE_SEQ_DBG)
+		bdbm_sema_unlock (&p->dbg_seq);
+#endif
+		bdi->ptr_hlm_inf->end_req (bdi, r);
+		return 0;
 	}
 
+	/* wait until there are enough free slots in Q; rmw takes two */
+	bdbm_credit_acquire (&p->credit, 
+		(bdbm_is_rmw (r->req_type) && bdbm_is_read (r->req_type)) ? 2 : 1);
+
 	/* put a request into Q */
 	if (bdbm_is_rmw (r->req_type) && bdbm_is_read (r->req_type)) {
 		/* step 1: put READ first */
 		r->phyaddr = r->phyaddr_src;
-		if ((ret = bdbm_prior_queue_enqueue (p->q, r->phyaddr_src.punit_id, r->logaddr.lpa[0], (void*)r))) {
+		if ((ret = bdbm_prior_queue_enqueue (p->q, 
+				__llm_mq_get_qid (p, r->phyaddr_src.punit_id, r->tenant_id), r->logaddr.lpa[0], (void*)r))) {
 			bdbm_msg ("bdbm_prior_queue_enqueue failed");
 		}
 		/* step 2: put WRITE second with the same LPA */
-		if ((ret = bdbm_prior_queue_enqueue (p->q, r->phyaddr_dst.punit_id, r->logaddr.lpa[0], (void*)r))) {
+		if ((ret = bdbm_prior_queue_enqueue (p->q, 
+				__llm_mq_get_qid (p, r->phyaddr_dst.punit_id, r->tenant_id), r->logaddr.lpa[0], (void*)r))) {
 			bdbm_msg ("bdbm_prior_queue_enqueue failed");
 		}
 	} else if (bdbm_is_rmw (r->req_type) && bdbm_is_read (r->req_type)) {
 		bdbm_bug_on (1);
 	} else {
-		if ((ret = bdbm_prior_queue_enqueue (p->q, r->phyaddr.punit_id, r->logaddr.lpa[0], (void*)r))) {
+		if ((ret = bdbm_prior_queue_enqueue (p->q, 
+				__llm_mq_get_qid (p, r->phyaddr.punit_id, r->tenant_id), r->logaddr.lpa[0], (void*)r))) {
 			bdbm_msg ("bdbm_prior_queue_enqueue failed");
 		}
 	}
@@ -291,7 +784,7 @@ void llm_mq_end_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* r)
 	if (bdbm_is_rmw (r->req_type) && bdbm_is_read(r->req_type)) {
 		/* get a parallel unit ID */
 		/*bdbm_msg ("unlock: %lld", r->phyaddr.punit_id);*/
-		bdbm_sema_unlock (&p->punit_locks[r->phyaddr.punit_id]);
+		__llm_mq_punit_release (p, r);
 
 		/*bdbm_msg ("LLM Done: lpa=%llu", r->logaddr.lpa[0]);*/
 
@@ -301,18 +794,26 @@ void llm_mq_end_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* r)
 		r->req_type = REQTYPE_RMW_WRITE;
 		r->phyaddr = r->phyaddr_dst;
 
+		if (p->nr_tenants > 1)
+			__llm_mq_account (bdi, p, r, qitem, 0);
+
 		/* remove it from the Q; this automatically triggers another request to be sent to NAND flash */
 		bdbm_prior_queue_remove (p->q, qitem);
+		bdbm_credit_release (&p->credit, 1);
 
 		/* wake up thread if it sleeps */
 		bdbm_thread_wakeup (p->llm_thread);
 	} else {
+		if (p->nr_tenants > 1)
+			__llm_mq_account (bdi, p, r, qitem, 1);
+
 		/* get a parallel unit ID */
 		bdbm_prior_queue_remove (p->q, qitem);
+		bdbm_credit_release (&p->credit, 1);
 
 		/* complete a lock */
 		/*bdbm_msg ("unlock: %lld", r->phyaddr.punit_id);*/
-		bdbm_sema_unlock (&p->punit_locks[r->phyaddr.punit_id]);
+		__llm_mq_punit_release (p, r);
 
 		/* update the elapsed time taken by NAND devices */
 		pmu_update_tot (bdi, r);
@@ -327,3 +828,15 @@ void llm_mq_end_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* r)
 #endif
 	}
 }
+
+/* # of reqs queued for or being served by a punit */
+uint64_t llm_mq_get_punit_load (bdbm_drv_info_t* bdi, uint64_t punit_id)
+{
+	struct bdbm_llm_mq_private* p = (struct bdbm_llm_mq_private*)BDBM_LLM_PRIV(bdi);
+	uint64_t i, load = 0;
+
+	for (i = 0; i < p->nr_tenants; i++)
+		load += bdbm_prior_queue_get_nr_items_qid (p->q, punit_id * p->nr_tenants + i);
+
+	return load;
+}
@@ -32,5 +32,6 @@ void llm_mq_destroy (bdbm_drv_info_t* bdi);
 uint32_t llm_mq_make_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* req);
 void llm_mq_flush (bdbm_drv_info_t* bdi);
 void llm_mq_end_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* req);
+uint64_t llm_mq_get_punit_load (bdbm_drv_info_t* bdi, uint64_t punit_id);
 
 #endif
@@ -39,6 +39,7 @@ THE SOFTWARE.
 #include "params.h"
 #include "bdbm_drv.h"
 #include "uthread.h"
+#include "ucredit.h"
 #include "pmu.h"
 #include "utime.h"
 
@@ -51,10 +52,6 @@ THE SOFTWARE.
  * it is useful for debugging */
 /*#define ENABLE_SEQ_DBG*/
 
-/* NOTE: This is just a quick fix to support RMW; 
- * it must be improved later for better performance */
-#define QUICK_FIX_FOR_RWM	
-
 
 /* llm interface */
 bdbm_llm_inf_t _llm_rmq_inf = {
@@ -71,6 +68,7 @@ struct bdbm_llm_rmq_private {
 	uint64_t nr_punits;
 	bdbm_sema_t* punit_locks;
 	bdbm_rd_prior_queue_t* q;
+	bdbm_credit_t credit;	/* for flow control of items in q */
 
 	/* for debugging */
 #if defined(ENABLE_SEQ_DBG)
@@ -160,12 +158,19 @@ uint32_t llm_rmq_create (bdbm_drv_info_t* bdi)
 	/* get the total number of parallel units */
 	p->nr_punits = BDBM_GET_NR_PUNITS (bdi->parm_dev);
 
-	/* create queue */
-	if ((p->q = bdbm_rd_prior_queue_create (p->nr_punits, INFINITE_QUEUE)) == NULL) {
-		bdbm_error ("bdbm_prior_queue_create failed");
+	/* create queue; writes and erases waiting longer than the deadline 
+	 * are served before reads */
+	if ((p->q = bdbm_rd_prior_queue_create (p->nr_punits, INFINITE_QUEUE, 
+			BDBM_GET_DRIVER_PARAMS (bdi)->llm_write_deadline_us)) == NULL) {
+		bdbm_error ("bdbm_rd_prior_queue_create failed");
 		goto fail;
 	}
 
+	/* setup flow control */
+	bdbm_credit_init (&p->credit, 
+		BDBM_GET_DRIVER_PARAMS (bdi)->llm_queue_depth >= 2 ? 
+		BDBM_GET_DRIVER_PARAMS (bdi)->llm_queue_depth : 96);
+
 	/* create completion locks for parallel units */
 	if ((p->punit_locks = (bdbm_sema_t*)bdbm_malloc_atomic
 			(sizeof (bdbm_sema_t) * p->nr_punits)) == NULL) {
@@ -227,6 +232,11 @@ void llm_rmq_destroy (bdbm_drv_info_t* bdi)
 		bdbm_sema_lock (&p->punit_locks[loop]);
 	}
 
+	bdbm_msg ("llm submitters slept %llu times for credits", 
+		bdbm_credit_get_nr_waits (&p->credit));
+	bdbm_msg ("llm writes served for their deadlines: %llu", p->q->nr_promoted);
+	bdbm_credit_free (&p->credit);
+
 	/* release all the relevant data structures */
 	if (p->q)
 		bdbm_rd_prior_queue_destroy (p->q);
@@ -238,21 +248,8 @@ void llm_rmq_destroy (bdbm_drv_info_t* bdi)
 uint32_t llm_rmq_make_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* r)
 {
 	uint32_t ret;
-	uint64_t punit_id;
 	struct bdbm_llm_rmq_private* p = (struct bdbm_llm_rmq_private*)BDBM_LLM_PRIV(bdi);
 
-	/* FIXME: ugry */
-	rd_prior_iotype_t type;
-	if (r->req_type == REQTYPE_READ ||
-		r->req_type == REQTYPE_READ_DUMMY ||
-		r->req_type == REQTYPE_RMW_READ || 
-		r->req_type == REQTYPE_GC_READ ||
-		r->req_type == REQTYPE_META_READ) {
-		type = RD_PRIORITY_READ;
-	} else {
-		type = RD_PRIORITY_WRITE;
-	}
-
 #if defined(ENABLE_SEQ_DBG)
 	bdbm_sema_lock (&p->dbg_seq);
 #endif
@@ -260,38 +257,32 @@ uint32_t llm_rmq_make_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* r)
 	/* obtain the elapsed time taken by FTL algorithms */
 	pmu_update_sw (bdi, r);
 
-	/* get a parallel unit ID */
-	punit_id = r->phyaddr->punit_id;
-
-	while (bdbm_rd_prior_queue_get_nr_items (p->q) >= 96) {
-		/*yield ();*/
-		bdbm_thread_yield ();
-	}
+	/* wait until there are enough free slots in Q; rmw takes two */
+	bdbm_credit_acquire (&p->credit, 
+		(bdbm_is_rmw (r->req_type) && bdbm_is_read (r->req_type)) ? 2 : 1);
 
 	/* put a request into Q */
-#if defined(QUICK_FIX_FOR_RWM)
-	if (r->req_type == REQTYPE_RMW_READ) {
-		/* FIXME: this is a quick fix to support RMW; it must be improved later */
+	if (bdbm_is_rmw (r->req_type) && bdbm_is_read (r->req_type)) {
 		/* step 1: put READ first */
-		if ((ret = bdbm_rd_prior_queue_enqueue (p->q, punit_id, r->lpa, (void*)r, type))) {
-			bdbm_msg ("bdbm_prior_queue_enqueue failed");
+		r->phyaddr = r->phyaddr_src;
+		if ((ret = bdbm_rd_prior_queue_enqueue (p->q, r->phyaddr_src.punit_id, 
+				r->logaddr.lpa[0], (void*)r, RD_PRIORITY_READ))) {
+			bdbm_msg ("bdbm_rd_prior_queue_enqueue failed");
 		}
-
 		/* step 2: put WRITE second with the same LPA */
-		punit_id = r->phyaddr_w.punit_id;
-		if ((ret = bdbm_rd_prior_queue_enqueue (p->q, punit_id, r->lpa, (void*)r, type))) {
-			bdbm_msg ("bdbm_prior_queue_enqueue failed");
+		if ((ret = bdbm_rd_prior_queue_enqueue (p->q, r->phyaddr_dst.punit_id, 
+				r->logaddr.lpa[0], (void*)r, RD_PRIORITY_WRITE))) {
+			bdbm_msg ("bdbm_rd_prior_queue_enqueue failed");
 		}
 	} else {
-		if ((ret = bdbm_rd_prior_queue_enqueue (p->q, punit_id, r->lpa, (void*)r, type))) {
-			bdbm_msg ("bdbm_prior_queue_enqueue failed");
+		/* reads (including gc and meta reads) go first; writes, erases, 
+		 * and trims wait unless their deadlines pass */
+		if ((ret = bdbm_rd_prior_queue_enqueue (p->q, r->phyaddr.punit_id, 
+				r->logaddr.lpa[0], (void*)r, 
+				bdbm_is_read (r->req_type) ? RD_PRIORITY_READ : RD_PRIORITY_WRITE))) {
+			bdbm_msg ("bdbm_rd_prior_queue_enqueue failed");
 		}
 	}
-#else
-	if ((ret = bdbm_rd_prior_queue_enqueue (p->q, punit_id, r->lpa, (void*)r, type))) {
-		bdbm_msg ("bdbm_prior_queue_enqueue failed");
-	}
-#endif
 
 	/* wake up thread if it sleeps */
 	bdbm_thread_wakeup (p->llm_thread);
@@ -314,58 +305,29 @@ void llm_rmq_end_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* r)
 	struct bdbm_llm_rmq_private* p = (struct bdbm_llm_rmq_private*)BDBM_LLM_PRIV(bdi);
 	bdbm_rd_prior_queue_item_t* qitem = (bdbm_rd_prior_queue_item_t*)r->ptr_qitem;
 
-	switch (r->req_type) {
-	case REQTYPE_RMW_READ:
+	if (bdbm_is_rmw (r->req_type) && bdbm_is_read(r->req_type)) {
 		/* get a parallel unit ID */
-		bdbm_sema_unlock (&p->punit_locks[r->phyaddr->punit_id]);
+		bdbm_sema_unlock (&p->punit_locks[r->phyaddr.punit_id]);
+
+		pmu_inc (bdi, r);
 
 		/* change its type to WRITE if req_type is RMW */
-		r->phyaddr = &r->phyaddr_w;
 		r->req_type = REQTYPE_RMW_WRITE;
+		r->phyaddr = r->phyaddr_dst;
 
-#ifdef QUICK_FIX_FOR_RWM
+		/* remove it from the Q; this automatically triggers another request to be sent to NAND flash */
 		bdbm_rd_prior_queue_remove (p->q, qitem);
-#else
-		/* put it to Q again */
-		if (bdbm_rd_prior_queue_move (p->q, r->phyaddr->punit_id, qitem)) {
-			bdbm_msg ("bdbm_prior_queue_enqueue failed");
-			bdbm_bug_on (1);
-		}
-#endif
-
-		pmu_inc (bdi, r);
+		bdbm_credit_release (&p->credit, 1);
 
 		/* wake up thread if it sleeps */
 		bdbm_thread_wakeup (p->llm_thread);
-		break;
-
-	case REQTYPE_META_WRITE:
-	case REQTYPE_META_READ:
-	case REQTYPE_READ:
-	case REQTYPE_READ_DUMMY:
-	case REQTYPE_WRITE:
-	case REQTYPE_RMW_WRITE:
-	case REQTYPE_GC_READ:
-	case REQTYPE_GC_WRITE:
-	case REQTYPE_GC_ERASE:
-	case REQTYPE_TRIM:
+	} else {
 		/* get a parallel unit ID */
 		bdbm_rd_prior_queue_remove (p->q, qitem);
-
-		/*
-		if (r->req_type == REQTYPE_GC_WRITE && (int64_t)r->lpa == -2LL) {
-			bdbm_msg ("done - writing mapping pages: llu phy: %lld %lld %lld %lld, oob: %lld %lld", 
-				r->phyaddr->channel_no, 
-				r->phyaddr->chip_no,
-				r->phyaddr->block_no,
-				r->phyaddr->page_no,
-				((uint64_t*)r->ptr_oob)[0],
-				((uint64_t*)r->ptr_oob)[1]);
-		}
-		*/
+		bdbm_credit_release (&p->credit, 1);
 
 		/* complete a lock */
-		bdbm_sema_unlock (&p->punit_locks[r->phyaddr->punit_id]);
+		bdbm_sema_unlock (&p->punit_locks[r->phyaddr.punit_id]);
 
 		/* update the elapsed time taken by NAND devices */
 		pmu_update_tot (bdi, r);
@@ -377,11 +339,5 @@ void llm_rmq_end_req (bdbm_drv_info_t* bdi, bdbm_llm_req_t* r)
 #if defined(ENABLE_SEQ_DBG)
 		bdbm_sema_unlock (&p->dbg_seq);
 #endif
-		break;
-
-	default:
-		bdbm_error ("invalid req-type (%u)", r->req_type);
-		break;
 	}
 }
-
@@ -41,62 +41,41 @@ THE SOFTWARE.
 #include "prior_queue.h"
 
 
-/*static uint64_t max_queue_items = 0;*/
-
-static uint64_t get_highest_priority_tag (
-	bdbm_prior_queue_t* mq, 
-	uint64_t lpa)
+static inline uint64_t __lpa_hash (bdbm_prior_queue_t* mq, uint64_t lpa)
 {
-	bdbm_prior_lpa_item_t* q = NULL;
-
-	HASH_FIND_INT (mq->hash_lpa, &lpa, q);
-	if (q)
-		return q->cur_tag;
-	return -1;
+	return ((lpa * 0x9E3779B97F4A7C15ULL) >> 32) & mq->lpa_mask;
 }
 
-static void remove_highest_priority_tag (
-	bdbm_prior_queue_t* mq, 
-	uint64_t lpa)
+/* find the slot of lpa; it returns an empty slot if there is no chain */
+static bdbm_prior_lpa_slot_t* __lpa_find (bdbm_prior_queue_t* mq, uint64_t lpa)
 {
-	bdbm_prior_lpa_item_t* q = NULL;
-
-	HASH_FIND_INT (mq->hash_lpa, &lpa, q);
-	if (q && q->lpa == lpa) {
-		if (q->max_tag == q->cur_tag) {
-			HASH_DEL (mq->hash_lpa, q);
-			bdbm_free_atomic (q);
-			q = NULL;
-		} else if (q->max_tag > q->cur_tag)
-			q->cur_tag++;
-		else {
-			bdbm_error ("oops!!!");
-			bdbm_bug_on (1);
-		}
-	}
-}
+	uint64_t i = __lpa_hash (mq, lpa);
 
-static uint64_t get_new_priority_tag (
-	bdbm_prior_queue_t* mq, 
-	uint64_t lpa)
-{
-	bdbm_prior_lpa_item_t* q = NULL;
+	while (mq->lpa_slots[i].head != NULL && mq->lpa_slots[i].lpa != lpa)
+		i = (i + 1) & mq->lpa_mask;
 
-	HASH_FIND_INT (mq->hash_lpa, &lpa, q);
-	if (q == NULL) {
-		if ((q = (bdbm_prior_lpa_item_t*)bdbm_malloc_atomic 
-				(sizeof (bdbm_prior_lpa_item_t))) == NULL) {
-			bdbm_error ("bdbm_malloc_atomic failed");
-			bdbm_bug_on (1);
-		}
-		q->lpa = lpa;
-		q->max_tag = 1;
-		q->cur_tag = 1;
-		HASH_ADD_INT (mq->hash_lpa, lpa, q);
-	} else
-		q->max_tag++;
+	return &mq->lpa_slots[i];
+}
 
-	return q->max_tag;
+/* empty a slot and shift the following ones back so that lookups never 
+ * stop at a hole (no tombstones are needed) */
+static void __lpa_delete (bdbm_prior_queue_t* mq, bdbm_prior_lpa_slot_t* s)
+{
+	uint64_t i = s - mq->lpa_slots, j = i, k;
+
+	mq->lpa_slots[i].head = NULL;
+	for (;;) {
+		j = (j + 1) & mq->lpa_mask;
+		if (mq->lpa_slots[j].head == NULL)
+			break;
+		k = __lpa_hash (mq, mq->lpa_slots[j].lpa);
+		/* leave it if its home is cyclically in (i, j] */
+		if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+		mq->lpa_slots[i] = mq->lpa_slots[j];
+		mq->lpa_slots[j].head = NULL;
+		i = j;
+	}
 }
 
 bdbm_prior_queue_t* bdbm_prior_queue_create (
@@ -104,7 +83,12 @@ bdbm_prior_queue_t* bdbm_prior_queue_create (
 	int64_t max_size)
 {
 	bdbm_prior_queue_t* mq;
-	uint64_t loop;
+	uint64_t loop, nr_slots = 1;
+
+	if (max_size <= 0) {
+		bdbm_error ("the size of prior_queue must be finite (%lld)", max_size);
+		return NULL;
+	}
 
 	/* create a private structure */
 	if ((mq = bdbm_malloc_atomic (sizeof (bdbm_prior_queue_t))) == NULL) {
@@ -116,34 +100,61 @@ bdbm_prior_queue_t* bdbm_prior_queue_create (
 	mq->qic = 0;
 	bdbm_spin_lock_init (&mq->lock);
 
-	/* create linked-lists */
+	/* create ready lists */
 	if ((mq->qlh = bdbm_malloc_atomic (sizeof (struct list_head) * mq->nr_queues)) == NULL) {
 		bdbm_msg ("bdbm_malloc_alloc failed");
-		bdbm_free_atomic (mq);
-		return NULL;
+		goto fail;
 	}
 	for (loop = 0; loop < mq->nr_queues; loop++)
 		INIT_LIST_HEAD (&mq->qlh[loop]);
+	if ((mq->qcnt = bdbm_malloc_atomic (sizeof (int64_t) * mq->nr_queues)) == NULL) {
+		bdbm_msg ("bdbm_malloc_alloc failed");
+		goto fail;
+	}
 
-	/* create hash */
-	mq->hash_lpa = NULL;
+	/* create items */
+	if ((mq->items = bdbm_malloc_atomic (sizeof (bdbm_prior_queue_item_t) * max_size)) == NULL) {
+		bdbm_msg ("bdbm_malloc_alloc failed");
+		goto fail;
+	}
+	INIT_LIST_HEAD (&mq->free_list);
+	for (loop = 0; loop < max_size; loop++)
+		list_add_tail (&mq->items[loop].list, &mq->free_list);
+
+	/* create the lpa table; keep it at most half full */
+	while (nr_slots < max_size * 2)
+		nr_slots <<= 1;
+	if ((mq->lpa_slots = bdbm_malloc_atomic (sizeof (bdbm_prior_lpa_slot_t) * nr_slots)) == NULL) {
+		bdbm_msg ("bdbm_malloc_alloc failed");
+		goto fail;
+	}
+	mq->lpa_mask = nr_slots - 1;
 
 	return mq;
+
+fail:
+	if (mq->items)
+		bdbm_free_atomic (mq->items);
+	if (mq->qcnt)
+		bdbm_free_atomic (mq->qcnt);
+	if (mq->qlh)
+		bdbm_free_atomic (mq->qlh);
+	bdbm_free_atomic (mq);
+	return NULL;
 }
 
 /* NOTE: it must be called when mq is empty. */
 void bdbm_prior_queue_destroy (bdbm_prior_queue_t* mq)
 {
-	bdbm_prior_lpa_item_t *c, *tmp;
-
 	if (mq == NULL)
 		return;
 
-	HASH_ITER (hh, mq->hash_lpa, c, tmp) {
-		bdbm_warning ("hmm.. there are still some items in the hash table");
-		HASH_DEL (mq->hash_lpa, c);
-		bdbm_free_atomic (c);
-	}
+	if (mq->qic > 0)
+		bdbm_warning ("hmm.. there are still %lld items in the queue", mq->qic);
+
+	bdbm_free_atomic (mq->lpa_slots);
+	bdbm_free_atomic (mq->items);
+	bdbm_free_atomic (mq->qcnt);
 	bdbm_free_atomic (mq->qlh);
 	bdbm_free_atomic (mq);
 }
@@ -163,27 +174,32 @@ uint8_t bdbm_prior_queue_enqueue (
 	}
 
 	bdbm_spin_lock_irqsave (&mq->lock, flags);
-	if (mq->max_size == INFINITE_PRIOR_QUEUE || mq->qic < mq->max_size) {
-		bdbm_prior_queue_item_t* q = NULL;
-		if ((q = bdbm_malloc_atomic (sizeof (bdbm_prior_queue_item_t))) == NULL) {
-			bdbm_error ("bdbm_malloc_atomic failed");
-			bdbm_bug_on (1);
+	if (!list_empty (&mq->free_list)) {
+		bdbm_prior_queue_item_t* q = list_entry (mq->free_list.next, bdbm_prior_queue_item_t, list);
+		bdbm_prior_lpa_slot_t* s = __lpa_find (mq, lpa);
+
+		list_del (&q->list);
+		q->next = NULL;
+		q->lpa = lpa;
+		q->qid = qid;
+		q->lock = 0;
+		q->ptr_req = (void*)req;
+		bdbm_stopwatch_start (&q->sw);
+
+		if (s->head == NULL) {
+			/* no earlier request to lpa; it is ready to go */
+			s->lpa = lpa;
+			s->head = s->tail = q;
+			list_add_tail (&q->list, &mq->qlh[qid]);
 		} else {
-			q->tag = get_new_priority_tag (mq, lpa);;
-			q->lpa = lpa;
-			q->lock = 0;
-			q->ptr_req = (void*)req;
-			list_add_tail (&q->list, &mq->qlh[qid]);	/* add to tail */
-			mq->qic++;
-			ret = 0;
-
-			/*
-			if (mq->qic > max_queue_items) {
-				max_queue_items = mq->qic;
-				bdbm_msg ("max queue items: %llu", max_queue_items);
-			}
-			*/
+			/* wait behind the earlier ones */
+			s->tail->next = q;
+			s->tail = q;
+			INIT_LIST_HEAD (&q->list);
 		}
+		mq->qcnt[qid]++;
+		mq->qic++;
+		ret = 0;
 	}
 	bdbm_spin_unlock_irqrestore (&mq->lock, flags);
 
@@ -195,22 +211,10 @@ uint8_t bdbm_prior_queue_is_empty (
 	uint64_t qid)
 {
 	unsigned long flags;
-	struct list_head* pos = NULL;
-	bdbm_prior_queue_item_t* q = NULL;
-	uint8_t ret = 1;
+	uint8_t ret;
 
 	bdbm_spin_lock_irqsave (&mq->lock, flags);
-	if (mq->qic > 0) {
-		list_for_each (pos, &mq->qlh[qid]) {
-			q = list_entry (pos, bdbm_prior_queue_item_t, list);
-			if (q && q->lock == 0)
-				break;
-			q = NULL;
-			break; /* [CAUSION] it could incur a dead-lock problem */
-		}
-		if (q != NULL)
-			ret = 0;
-	}
+	ret = list_empty (&mq->qlh[qid]) ? 1 : 0;
 	bdbm_spin_unlock_irqrestore (&mq->lock, flags);
 
 	return ret;
@@ -222,28 +226,34 @@ void* bdbm_prior_queue_dequeue (
 	bdbm_prior_queue_item_t** oq)
 {
 	unsigned long flags;
-	struct list_head* pos = NULL;
 	bdbm_prior_queue_item_t* q = NULL;
 	void* req = NULL;
 
 	bdbm_spin_lock_irqsave (&mq->lock, flags);
-	if (mq->qic > 0) {
-		list_for_each (pos, &mq->qlh[qid]) {
-			if ((q = list_entry (pos, bdbm_prior_queue_item_t, list))) {
-				if (q->lock == 0) {
-					uint64_t highest_tag = get_highest_priority_tag (mq, q->lpa);
-					if (highest_tag == q->tag)
-						break;
-				}
-			}
-			q = NULL;
-			break; /* [CAUSION] it could incur a dead-lock problem */
-		}
-		if (q != NULL) {
-			q->lock = 1;	/* mark it use */
-			req = q->ptr_req;
-			*oq= q;
-		}
+	if (!list_empty (&mq->qlh[qid])) {
+		/* it stays at the head of its lpa chain until it is removed */
+		q = list_entry (mq->qlh[qid].next, bdbm_prior_queue_item_t, list);
+		list_del_init (&q->list);
+		q->lock = 1;	/* mark it use */
+		req = q->ptr_req;
+		*oq= q;
+	}
+	bdbm_spin_unlock_irqrestore (&mq->lock, flags);
+
+	return req;
+}
+
+/* returns the request the next dequeue would take, leaving it in the queue */
+void* bdbm_prior_queue_peek (
+	bdbm_prior_queue_t* mq, 
+	uint64_t qid)
+{
+	unsigned long flags;
+	void* req = NULL;
+
+	bdbm_spin_lock_irqsave (&mq->lock, flags);
+	if (!list_empty (&mq->qlh[qid])) {
+		req = list_entry (mq->qlh[qid].next, bdbm_prior_queue_item_t, list)->ptr_req;
 	}
 	bdbm_spin_unlock_irqrestore (&mq->lock, flags);
 
@@ -258,11 +268,23 @@ uint8_t bdbm_prior_queue_remove (
 
 	bdbm_spin_lock_irqsave (&mq->lock, flags);
 	if (q) {
-		remove_highest_priority_tag (mq, q->lpa);
+		bdbm_prior_lpa_slot_t* s = __lpa_find (mq, q->lpa);
+
+		if (s->head != q) {
+			bdbm_error ("oops!!! an item is removed out of order");
+			bdbm_bug_on (1);
+		}
+
+		/* let the next request to the same lpa go */
+		if ((s->head = q->next) != NULL)
+			list_add_tail (&s->head->list, &mq->qlh[s->head->qid]);
+		else
+			__lpa_delete (mq, s);
+
 		list_del (&q->list);
-		bdbm_free_atomic (q);
+		list_add (&q->list, &mq->free_list);
+		mq->qcnt[q->qid]--;
 		mq->qic--;
-		/*bdbm_msg ("[QUEUE] # of items in queue = %llu", mq->qic);*/
 	}
 	bdbm_spin_unlock_irqrestore (&mq->lock, flags);
 
@@ -278,9 +300,13 @@ uint8_t bdbm_prior_queue_move (
 
 	bdbm_spin_lock_irqsave (&mq->lock, flags);
 	if (q) {
-		list_del (&q->list); /* remove from the list */
+		/* put a dequeued item back at the head of another queue */
+		list_del (&q->list);
 		q->lock = 0;
-		list_add (&q->list, &mq->qlh[qid]);	/* add to tail */
+		mq->qcnt[q->qid]--;
+		mq->qcnt[qid]++;
+		q->qid = qid;
+		list_add (&q->list, &mq->qlh[qid]);
 	}
 	bdbm_spin_unlock_irqrestore (&mq->lock, flags);
 
@@ -293,14 +319,12 @@ uint8_t bdbm_prior_queue_is_full (bdbm_prior_queue_t* mq)
 	unsigned long flags;
 
 	bdbm_spin_lock_irqsave (&mq->lock, flags);
-	if (mq->max_size != INFINITE_PRIOR_QUEUE) {
-		if (mq->qic > mq->max_size) {
- 			bdbm_error ("oops!!!");
-			bdbm_bug_on (mq->qic > mq->max_size);
-		}
-		if (mq->qic == mq->max_size)
-			ret = 1;
+	if (mq->qic > mq->max_size) {
+		bdbm_error ("oops!!!");
+		bdbm_bug_on (mq->qic > mq->max_size);
 	}
+	if (mq->qic == mq->max_size)
+		ret = 1;
 	bdbm_spin_unlock_irqrestore (&mq->lock, flags);
 
 	return ret;
@@ -333,3 +357,32 @@ uint64_t bdbm_prior_queue_get_nr_items (bdbm_prior_queue_t* mq)
 
 	return nr_items;
 }
+
+/* it is read without the lock, so it is a hint rather than an exact count */
+uint64_t bdbm_prior_queue_get_nr_items_qid (
+	bdbm_prior_queue_t* mq, 
+	uint64_t qid)
+{
+	return mq->qcnt[qid];
+}
+
+/* call fn for the reqs queued for lpa from the oldest one until it returns 
+ * non-zero; the reqs stay in the queue while fn runs since the queue is 
+ * locked. it returns 1 if fn accepted one of them */
+uint8_t bdbm_prior_queue_find_lpa (
+	bdbm_prior_queue_t* mq, 
+	uint64_t lpa, 
+	uint8_t (*fn) (void* req, void* arg), 
+	void* arg)
+{
+	bdbm_prior_queue_item_t* q = NULL;
+	uint8_t ret = 0;
+	unsigned long flags;
+
+	bdbm_spin_lock_irqsave (&mq->lock, flags);
+	for (q = __lpa_find (mq, lpa)->head; q != NULL && ret == 0; q = q->next)
+		ret = fn (q->ptr_req, arg);
+	bdbm_spin_unlock_irqrestore (&mq->lock, flags);
+
+	return ret;
+}
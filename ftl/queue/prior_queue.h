@@ -25,46 +25,54 @@ THE SOFTWARE.
 #ifndef _BLUEDBM_PRIOR_QUEUE_MQ_H
 #define _BLUEDBM_PRIOR_QUEUE_MQ_H
 
-#include "../3rd/uthash.h"
+/* A multi-queue that keeps requests to the same lpa in order.
+ *
+ * Items for the same lpa form a FIFO chain in an open-addressed lpa table, 
+ * and only the head of a chain sits on the ready list of its punit, so 
+ * dequeue takes the first ready item without scanning. Items and the table 
+ * are allocated when the queue is created; its size must be finite. */
 
-enum BDBM_PRIOR_QUEUE_SIZE {
-	INFINITE_PRIOR_QUEUE = -1,
-};
-
-typedef struct {
-	struct list_head list; /* list header */
+typedef struct bdbm_prior_queue_item {
+	struct list_head list; /* a ready list or the free list */
+	struct bdbm_prior_queue_item* next; /* the next item with the same lpa */
 	void* ptr_req;
 	uint64_t lpa;
-	uint64_t tag;
-	uint8_t lock;
+	uint64_t qid;
+	uint8_t lock; /* 1: dequeued and being served */
+	bdbm_stopwatch_t sw; /* started when it is enqueued */
 } bdbm_prior_queue_item_t;
 
 typedef struct {
-	struct list_head list;	/* list header */
 	uint64_t lpa;
-	uint64_t cur_tag;
-	uint64_t max_tag;
-	UT_hash_handle hh;	/* hash header */
-} bdbm_prior_lpa_item_t;
+	bdbm_prior_queue_item_t* head; /* NULL if the slot is empty */
+	bdbm_prior_queue_item_t* tail;
+} bdbm_prior_lpa_slot_t;
 
 typedef struct {
 	uint64_t nr_queues;
 	int64_t max_size;
 	int64_t qic; /* queue item count */
 	bdbm_spinlock_t lock; /* queue lock */
-	struct list_head* qlh; /* queue list header */
- 	bdbm_prior_lpa_item_t* hash_lpa;	/* lpa hash */
+	struct list_head* qlh; /* ready lists of queues */
+	int64_t* qcnt; /* # of items of queues, including ones being served */
+	bdbm_prior_queue_item_t* items; /* preallocated items */
+	struct list_head free_list; /* free items */
+	bdbm_prior_lpa_slot_t* lpa_slots; /* lpa table */
+	uint64_t lpa_mask; /* # of slots - 1 */
 } bdbm_prior_queue_t;
 
 bdbm_prior_queue_t* bdbm_prior_queue_create (uint64_t nr_queues, int64_t size);
 void bdbm_prior_queue_destroy (bdbm_prior_queue_t* mq);
 uint8_t bdbm_prior_queue_enqueue (bdbm_prior_queue_t* mq, uint64_t qid, uint64_t lpa, void* req);
 void* bdbm_prior_queue_dequeue (bdbm_prior_queue_t* mq, uint64_t qid, bdbm_prior_queue_item_t** out_q);
+void* bdbm_prior_queue_peek (bdbm_prior_queue_t* mq, uint64_t qid);
 uint8_t bdbm_prior_queue_remove (bdbm_prior_queue_t* mq, bdbm_prior_queue_item_t* q);
 uint8_t bdbm_prior_queue_move (bdbm_prior_queue_t* mq, uint64_t quid, bdbm_prior_queue_item_t* q);
 uint8_t bdbm_prior_queue_is_full (bdbm_prior_queue_t* mq);
 uint8_t bdbm_prior_queue_is_empty (bdbm_prior_queue_t* mq, uint64_t qid);
 uint8_t bdbm_prior_queue_is_all_empty (bdbm_prior_queue_t* mq);
 uint64_t bdbm_prior_queue_get_nr_items (bdbm_prior_queue_t* mq);
+uint64_t bdbm_prior_queue_get_nr_items_qid (bdbm_prior_queue_t* mq, uint64_t qid);
+uint8_t bdbm_prior_queue_find_lpa (bdbm_prior_queue_t* mq, uint64_t lpa, uint8_t (*fn) (void* req, void* arg), void* arg);
 
 #endif
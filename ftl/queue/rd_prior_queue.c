@@ -101,7 +101,8 @@ static uint64_t get_new_priority_tag (
 
 bdbm_rd_prior_queue_t* bdbm_rd_prior_queue_create (
 	uint64_t nr_queues, 
-	int64_t max_size)
+	int64_t max_size,
+	uint64_t deadline_us)
 {
 	bdbm_rd_prior_queue_t* mq;
 	uint64_t loop;
@@ -114,6 +115,8 @@ bdbm_rd_prior_queue_t* bdbm_rd_prior_queue_create (
 	mq->nr_queues = nr_queues;
 	mq->max_size = max_size;
 	mq->qic = 0;
+	mq->deadline_us = deadline_us;
+	mq->nr_promoted = 0;
 	bdbm_spin_lock_init (&mq->lock);
 
 	/* create linked-lists */
@@ -177,6 +180,7 @@ uint8_t bdbm_rd_prior_queue_enqueue (
 			q->lock = 0;
 			q->ptr_req = (void*)req;
 			q->type = type;
+			bdbm_stopwatch_start (&q->sw);
 			list_add_tail (&q->list, &mq->qlh[qid]);	/* add to tail */
 			mq->qic++;
 			ret = 0;
@@ -242,6 +246,13 @@ void* bdbm_rd_prior_queue_dequeue (
 							/* reads are served first */
 							q = q_tmp;
 							break;
+						} else if (mq->deadline_us > 0 && 
+								bdbm_stopwatch_get_elapsed_time_us (&q_tmp->sw) >= mq->deadline_us) {
+							/* the list is in FIFO order, so this write is older 
+							 * than any read behind it; serve it not to starve */
+							q = q_tmp;
+							mq->nr_promoted++;
+							break;
 						} else if (q == NULL) {
 							/* choose writes if q is NULL */
 							q = q_tmp;
@@ -26,6 +26,7 @@ THE SOFTWARE.
 #define _BLUEDBM_RD_PRIOR_QUEUE_MQ_H
 
 #include "../3rd/uthash.h"
+#include "utime.h"
 
 enum BDBM_RD_PRIOR_QUEUE_SIZE {
 	INFINITE_RD_PRIOR_QUEUE = -1,
@@ -43,6 +44,7 @@ typedef struct {
 	uint64_t tag;
 	uint8_t lock;
 	rd_prior_iotype_t type;
+	bdbm_stopwatch_t sw;	/* started when it is enqueued */
 } bdbm_rd_prior_queue_item_t;
 
 typedef struct {
@@ -57,12 +59,14 @@ typedef struct {
 	uint64_t nr_queues;
 	int64_t max_size;
 	int64_t qic; /* queue item count */
+	uint64_t deadline_us; /* writes waiting longer than it go before reads; 0: never */
+	uint64_t nr_promoted; /* # of writes dequeued because their deadlines passed */
 	bdbm_spinlock_t lock; /* queue lock */
 	struct list_head* qlh; /* queue list header */
  	bdbm_rd_prior_lpa_item_t* hash_lpa;	/* lpa hash */
 } bdbm_rd_prior_queue_t;
 
-bdbm_rd_prior_queue_t* bdbm_rd_prior_queue_create (uint64_t nr_queues, int64_t size);
+bdbm_rd_prior_queue_t* bdbm_rd_prior_queue_create (uint64_t nr_queues, int64_t size, uint64_t deadline_us);
 void bdbm_rd_prior_queue_destroy (bdbm_rd_prior_queue_t* mq);
 uint8_t bdbm_rd_prior_queue_enqueue (bdbm_rd_prior_queue_t* mq, uint64_t qid, uint64_t lpa, void* req, rd_prior_iotype_t type);
 void* bdbm_rd_prior_queue_dequeue (bdbm_rd_prior_queue_t* mq, uint64_t qid, bdbm_rd_prior_queue_item_t** out_q);
@@ -86,6 +86,8 @@ typedef struct _bdbm_drv_info_t bdbm_drv_info_t;
 	(np.nr_channels * np.nr_chips_per_channel)
 #define BDBM_GET_PUNIT_ID(bdi,p) \
 	(p->channel_no * bdi->parm_dev.nr_chips_per_channel + p->chip_no)
+#define BDBM_GET_PLANE_NO(np,p) \
+	((p)->block_no % (np)->nr_planes_per_chip)
 
 /* request types */
 enum BDBM_REQTYPE {
@@ -95,6 +97,7 @@ enum BDBM_REQTYPE {
 	REQTYPE_IO_WRITE 		= 0x000004,
 	REQTYPE_IO_ERASE 		= 0x000008,
 	REQTYPE_IO_TRIM 		= 0x000010,
+	REQTYPE_IO_FLUSH 		= 0x000020,
 	REQTYPE_NORNAL 			= 0x000100,
 	REQTYPE_RMW 			= 0x000200,
 	REQTYPE_GC 				= 0x000400,
@@ -104,6 +107,7 @@ enum BDBM_REQTYPE {
 	REQTYPE_READ_DUMMY 		= REQTYPE_NORNAL 	| REQTYPE_IO_READ_DUMMY,
 	REQTYPE_WRITE 			= REQTYPE_NORNAL 	| REQTYPE_IO_WRITE,
 	REQTYPE_TRIM 			= REQTYPE_NORNAL 	| REQTYPE_IO_TRIM,
+	REQTYPE_FLUSH 			= REQTYPE_NORNAL 	| REQTYPE_IO_FLUSH,
 	REQTYPE_RMW_READ 		= REQTYPE_RMW 		| REQTYPE_IO_READ,
 	REQTYPE_RMW_WRITE 		= REQTYPE_RMW 		| REQTYPE_IO_WRITE,
 	REQTYPE_GC_READ 		= REQTYPE_GC 		| REQTYPE_IO_READ,
@@ -121,6 +125,7 @@ enum BDBM_REQTYPE {
 #define bdbm_is_write(type) (((type & REQTYPE_IO_WRITE) == REQTYPE_IO_WRITE) ? 1 : 0)
 #define bdbm_is_erase(type) (((type & REQTYPE_IO_ERASE) == REQTYPE_IO_ERASE) ? 1 : 0)
 #define bdbm_is_trim(type) (((type & REQTYPE_IO_TRIM) == REQTYPE_IO_TRIM) ? 1 : 0)
+#define bdbm_is_flush(type) (((type & REQTYPE_IO_FLUSH) == REQTYPE_IO_FLUSH) ? 1 : 0)
 
 
 /* a physical address */
@@ -132,14 +137,21 @@ typedef struct {
 	uint64_t page_no;
 } bdbm_phyaddr_t;
 
-/* max kernel pages per physical flash page */
+/* max kernel pages per physical flash page (e.g., 4 for 16KB pages) */
+#ifndef BDBM_MAX_PAGES
 #define BDBM_MAX_PAGES 1
+#endif
 
 /* a bluedbm blockio request */
 #define BDBM_BLKIO_MAX_VECS 256
 
+/* flags of a bluedbm blockio request */
+#define BDBM_BLKIO_FLUSH	0x1	/* data written before must be durable before it */
+#define BDBM_BLKIO_FUA		0x2	/* its data must be durable when it ends */
+
 typedef struct {
 	uint64_t bi_rw; /* REQTYPE_WRITE or REQTYPE_READ */
+	uint64_t bi_flags; /* BDBM_BLKIO_FLUSH or BDBM_BLKIO_FUA */
 	uint64_t bi_offset; /* unit: sector (512B) */
 	uint64_t bi_size; /* unit: sector (512B) */
 	uint64_t bi_bvec_cnt; /* unit: kernel-page (4KB); it must be equal to 'bi_size / 8' */
@@ -148,6 +160,7 @@ typedef struct {
 	void* bio; /* reserved for kernel's bio requests */
 	void* user; /* keep user's data structure */
 	void (*cb_done) (void* req); /* call-back function which is called when a request is done */
+	uint32_t bi_tenant; /* who submits it; the LLM shares punits fairly among tenants */
 } bdbm_blkio_req_t;
 
 #define BDBM_ALIGN_UP(addr,size)		(((addr)+((size)-1))&(~((size)-1)))
@@ -178,11 +191,12 @@ typedef struct {
 	uint8_t* data;
 } bdbm_flash_page_oob_t;
 
-typedef struct {
+typedef struct bdbm_llm_req {
 	uint32_t req_type; /* read, write, or trim */
 	uint8_t ret;	/* old for GC */
 	void* ptr_hlm_req;
 	void* ptr_qitem;
+	uint32_t tenant_id;	/* copied from bdbm_hlm_req_t; 0 for internal reqs like gc */
 	bdbm_sema_t* done;	/* maybe used by applications that require direct notifications from an interrupt handler */
 
 	/* logical / physical info */
@@ -194,10 +208,17 @@ typedef struct {
 	/* physical layout */
 	bdbm_flash_page_main_t fmain;
 	bdbm_flash_page_oob_t foob;
+
+	/* a multi-plane operation: reqs of the same type and page offset on 
+	 * sibling planes of a punit are chained from the first one, and the 
+	 * device serves the chain as one operation */
+	struct bdbm_llm_req* mp_next;
+	uint8_t mp_follower;	/* 1: it is served as a part of another req */
 } bdbm_llm_req_t;
 
 typedef struct {
 	struct list_head list;	/* for hlm_reqs_pool */
+	int32_t mag_id;	/* the magazine it was taken from (for hlm_reqs_pool) */
 	uint32_t req_type; /* read, write, or trim */
 	bdbm_stopwatch_t sw;
 
@@ -221,6 +242,8 @@ typedef struct {
 
 	void* blkio_req;
 	uint8_t ret;
+	uint32_t tenant_id;	/* submitter of blkio_req (bi_tenant) */
+	uint64_t nr_padded;	/* # of llm_reqs that may have pad pages (for hlm_reqs_pool) */
 } bdbm_hlm_req_t;
 
 #define bdbm_hlm_for_each_llm_req(r, h, i) \
@@ -266,6 +289,9 @@ typedef struct {
 	uint32_t (*make_reqs) (bdbm_drv_info_t* bdi, bdbm_hlm_req_t* req);
 	void (*flush) (bdbm_drv_info_t* bdi);
 	void (*end_req) (bdbm_drv_info_t* bdi, bdbm_llm_req_t* req);
+
+	/* interfaces for load-aware placement (optional) */
+	uint64_t (*get_punit_load) (bdbm_drv_info_t* bdi, uint64_t punit_id);
 } bdbm_llm_inf_t;
 
 /* a generic device interface */
@@ -279,8 +305,23 @@ typedef struct {
 	void (*end_req) (bdbm_drv_info_t* bdi, bdbm_llm_req_t* req);
 	uint32_t (*load) (bdbm_drv_info_t* bdi, const char* fn);
 	uint32_t (*store) (bdbm_drv_info_t* bdi, const char* fn);
+
+	/* interfaces for program/erase suspend (optional) */
+	uint32_t (*suspend_req) (bdbm_drv_info_t* bdi, bdbm_llm_req_t* req);
+
+	/* interfaces for multi-plane operations (optional); req is the first 
+	 * of the reqs chained by mp_next */
+	uint32_t (*make_mp_req) (bdbm_drv_info_t* bdi, bdbm_llm_req_t* req);
 } bdbm_dm_inf_t;
 
+/* a waiter for a map page being loaded from flash (DFTL); 'wakeup' is 
+ * called once when the map page is in DRAM */
+typedef struct {
+	struct list_head list;
+	void (*wakeup) (void* arg);
+	void* arg;
+} bdbm_mapblk_waiter_t;
+
 /* a generic FTL interface */
 #if 0
 typedef struct {
@@ -330,11 +371,17 @@ typedef struct {
 	/* interfaces for RSD */
 	uint64_t (*get_segno) (bdbm_drv_info_t* bdi, uint64_t lpa);
 
+	/* interfaces for write throttling (optional) */
+	void (*get_free_space) (bdbm_drv_info_t* bdi, uint64_t* nr_free_blks, uint64_t* nr_total_blks);
+
+	/* interfaces for deferred erases (optional) */
+	void (*run_erases) (bdbm_drv_info_t* bdi);
+
 	/* interfaces for DFTL */
 	uint8_t (*check_mapblk) (bdbm_drv_info_t* bdi, uint64_t lpa);
 	bdbm_llm_req_t* (*prepare_mapblk_eviction) (bdbm_drv_info_t* bdi);
 	void (*finish_mapblk_eviction) (bdbm_drv_info_t* bdi, bdbm_llm_req_t* r);
-	bdbm_llm_req_t* (*prepare_mapblk_load) (bdbm_drv_info_t* bdi, uint64_t lpa);
+	bdbm_llm_req_t* (*prepare_mapblk_load) (bdbm_drv_info_t* bdi, uint64_t lpa, bdbm_mapblk_waiter_t* w);
 	void (*finish_mapblk_load) (bdbm_drv_info_t* bdi, bdbm_llm_req_t* r);
 } bdbm_ftl_inf_t;
 
@@ -82,6 +82,7 @@ enum BDBM_LLM_TYPE {
 	LLM_NOT_SPECIFIED = 0,
 	LLM_NO_QUEUE,
 	LLM_MULTI_QUEUE,
+	LLM_READ_PRIORITY,
 };
 
 enum BDBM_HLM_TYPE {
@@ -89,6 +90,24 @@ enum BDBM_HLM_TYPE {
 	HLM_NO_BUFFER,
 	HLM_BUFFER,
 	HLM_DFTL,
+	HLM_WRITE_BACK,
+};
+
+enum BDBM_WRITE_PLACEMENT {
+	WRITE_PLACEMENT_NOT_SPECIFIED = 0,
+	WRITE_PLACEMENT_ROUND_ROBIN,
+	WRITE_PLACEMENT_LOAD_AWARE,
+};
+
+/* max. # of tenants the multi-queue LLM shares punits among */
+#define LLM_MAX_TENANTS	16
+
+enum BDBM_DFTL_CACHE_POLICY {
+	DFTL_CACHE_POLICY_NOT_SPECIFIED = 0,
+	DFTL_CACHE_POLICY_LRU,
+	DFTL_CACHE_POLICY_2Q,
+	DFTL_CACHE_POLICY_ARC,
+	DFTL_CACHE_POLICY_CLOCK_PRO,
 };
 
 enum BDBM_SNAPSHOT {
@@ -108,12 +127,31 @@ typedef struct {
 	uint32_t hlm_type;
 	uint32_t mapping_type;
 	uint32_t snapshot;	/* 0: disable (default), 1: enable */
+	uint32_t hlm_nr_workers;	/* # of worker threads for HLM_BUFFER */
+	uint32_t hlm_queue_depth;	/* # of requests buffered in hlm */
+	uint32_t llm_queue_depth;	/* # of requests queued in llm */
+	uint32_t llm_write_deadline_us;	/* writes waiting longer than it go before reads (LLM_READ_PRIORITY); 0: never */
+	uint32_t llm_suspend;	/* suspend programs/erases for waiting reads (LLM_MULTI_QUEUE); 0: disable (default), 1: enable */
+	uint32_t llm_read_forward;	/* serve reads from writes waiting in the queue (LLM_MULTI_QUEUE); 0: disable (default), 1: enable */
+	uint32_t hlm_wb_nr_pages;	/* size of the write-back buffer (HLM_WRITE_BACK) */
+	uint32_t hlm_rcache_nr_pages;	/* size of the read cache (HLM_NO_BUFFER); 0 disables it */
+	uint32_t hlm_throttle_free_pct;	/* free space (%) below which host writes are throttled (HLM_NO_BUFFER); 0 disables it */
+	uint32_t hlm_merge_window_us;	/* latency budget for merging sequential requests (HLM_NO_BUFFER); 0 disables it */
+	uint32_t write_placement;	/* how page_ftl picks a punit for a write (BDBM_WRITE_PLACEMENT) */
+	uint32_t gc_slice_pages;	/* max. # of pages page_ftl copies in a gc slice; 0 copies all the victims at once */
+	uint32_t gc_host_ratio;	/* # of host pages written between gc slices per page copied */
+	uint32_t gc_defer_erase;	/* 0: gc erases victims at once, 1: the erase manager of page_ftl does */
+	uint32_t gc_erase_floor;	/* # of free blocks of a chip below which its deferred erases are forced */
+	uint32_t llm_nr_tenants;	/* # of tenants sharing punits by deficit round-robin (LLM_MULTI_QUEUE); 1 disables it */
+	uint32_t llm_tenant_weights[LLM_MAX_TENANTS];	/* shares of punit time of tenants; 0 is taken as 1 */
+	uint32_t dftl_cache_policy;	/* how DFTL picks a map page to evict from DRAM (BDBM_DFTL_CACHE_POLICY) */
 } bdbm_ftl_params;
 
 typedef struct {
 	uint64_t nr_channels;
 	uint64_t nr_chips_per_channel;
 	uint64_t nr_blocks_per_chip;
+	uint64_t nr_planes_per_chip;	/* block b belongs to plane (b % nr_planes_per_chip) */
 	uint64_t nr_pages_per_block;
 	uint64_t page_main_size;
 	uint64_t page_oob_size;
@@ -122,6 +160,9 @@ typedef struct {
 	uint64_t page_prog_time_us;
 	uint64_t page_read_time_us;
 	uint64_t block_erase_time_us;
+	uint64_t suspend_overhead_us;	/* extra time to resume a suspended program/erase */
+	uint64_t chip_bus_trans_time_us;	/* time to move a page over a channel bus */
+	uint64_t host_bus_trans_time_us;	/* time to move a page over the host bus */
 
 	uint64_t nr_blocks_per_channel;
 	uint64_t nr_blocks_per_ssd;